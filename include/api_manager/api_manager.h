@@ -22,6 +22,7 @@
 
 #include "google/api/service.pb.h"
 #include "include/api_manager/env_interface.h"
+#include "include/api_manager/latency_statistics.h"
 #include "include/api_manager/request.h"
 #include "include/api_manager/request_handler_interface.h"
 #include "include/api_manager/service_control.h"
@@ -29,11 +30,67 @@
 namespace google {
 namespace api_manager {
 
+// Counters of the fetches of the token verification keys.
+struct KeyFetchStatistics {
+  // Key fetches started.
+  uint64_t fetches;
+  // Requests which waited for a key fetch started by another request.
+  uint64_t coalesced_waits;
+  // Key fetches started in the background before the key expired.
+  uint64_t refreshes;
+  // Requests verified with an expired key which could not be fetched.
+  uint64_t stale_keys_used;
+
+  // Merge two statistics.
+  void Merge(const KeyFetchStatistics& v) {
+    fetches += v.fetches;
+    coalesced_waits += v.coalesced_waits;
+    refreshes += v.refreshes;
+    stale_keys_used += v.stale_keys_used;
+  }
+};
+
+// Counters and durations of the service config loads.
+struct ConfigLoadStatistics {
+  // Service configs loaded.
+  uint64_t loads;
+  // Service configs built on a background thread of the environment.
+  uint64_t background_loads;
+  // Service configs which could not be loaded.
+  uint64_t failures;
+  // Managed rollouts built after a newer rollout was deployed, and dropped.
+  uint64_t stale_rollouts;
+  // Time spent parsing the service configs, and building their methods and
+  // path matchers, for the last loaded config and in total.
+  uint64_t last_parse_us;
+  uint64_t last_build_us;
+  uint64_t total_parse_us;
+  uint64_t total_build_us;
+};
+
+// Counters of the service config generations, the service contexts built
+// for the service configs of the rollouts.
+struct ServiceGenerationStatistics {
+  // Generations of the current rollout.
+  uint64_t active;
+  // Generations no longer in the rollout, still used by requests or
+  // flushing their reports.
+  uint64_t retired;
+  // Retired generations which were freed.
+  uint64_t reclaimed;
+  // Estimated memory of the active and of the retired generations, in bytes.
+  uint64_t active_memory_bytes;
+  uint64_t retired_memory_bytes;
+};
+
 // Data to summarize the API Manager statistics.
 // Important note: please don't use std::string. These fields are directly
 // copied into a shared memory.
 struct ApiManagerStatistics {
   service_control::Statistics service_control_statistics;
+  KeyFetchStatistics key_fetch_statistics;
+  ConfigLoadStatistics config_load_statistics;
+  ServiceGenerationStatistics service_generation_statistics;
 };
 
 // Service config rollouts information for /endpoints_status
@@ -43,6 +100,9 @@ struct ServiceConfigRolloutsInfo {
   // Maps service configuration IDs to their corresponding traffic percentage.
   // Key is the service configuration ID, Value is the traffic percentage
   std::map<std::string, int> percentages;
+  // Maps service configuration IDs to the estimated memory of their service
+  // configs, in bytes.
+  std::map<std::string, uint64_t> memory_bytes;
 };
 
 class ApiManager {
@@ -99,6 +159,10 @@ class ApiManager {
   virtual utils::Status GetStatistics(
       ApiManagerStatistics *statistics) const = 0;
 
+  // To get the latency histograms of the requests.
+  virtual utils::Status GetLatencyStatistics(
+      LatencyStatistics *statistics) const = 0;
+
   // Load service rollouts. This can be called only once, the data is from
   // server_config.
   virtual utils::Status LoadServiceRollouts() = 0;
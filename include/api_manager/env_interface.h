@@ -24,6 +24,7 @@
 #include "include/api_manager/grpc_request.h"
 #include "include/api_manager/http_request.h"
 #include "include/api_manager/periodic_timer.h"
+#include "include/api_manager/shared_cache.h"
 #include "include/api_manager/utils/status.h"
 
 namespace google {
@@ -47,6 +48,10 @@ class ApiManagerEnvInterface {
 
   virtual void Log(LogLevel level, const char *message) = 0;
 
+  // Returns whether messages of the given level are logged, so that callers
+  // can skip building expensive log messages.
+  virtual bool IsLogEnabled(LogLevel level) { return true; }
+
   // Simple periodic timer support. API Manager uses this method to get
   // called at regular intervals of wall-clock time.
   virtual std::unique_ptr<PeriodicTimer> StartPeriodicTimer(
@@ -61,6 +66,30 @@ class ApiManagerEnvInterface {
   virtual void RunHTTPRequest(std::unique_ptr<HTTPRequest> request) = 0;
 
   virtual void RunGRPCRequest(std::unique_ptr<GRPCRequest> request) = 0;
+
+  // Runs CPU bound work, like verifying a JWT signature, on a thread pool of
+  // the environment, then the continuation on the thread calling the API
+  // Manager. Returns false, running neither, if the environment has no
+  // thread pool or its queue is full: the caller then runs the work inline.
+  virtual bool RunInThreadPool(std::function<void()> work,
+                               std::function<void()> continuation) {
+    return false;
+  }
+
+  // Runs long running work, like building a new service config, on a
+  // background thread of the environment, then the continuation on the
+  // thread calling the API Manager. Returns false, running neither, if the
+  // environment has no background thread: the caller then runs the work
+  // inline.
+  virtual bool RunInBackground(std::function<void()> work,
+                               std::function<void()> continuation) {
+    return false;
+  }
+
+  // Returns the cache shared by all the API Manager instances of the
+  // environment, or nullptr if the environment does not provide one.
+  // The environment retains the ownership of the cache.
+  virtual SharedCache *GetSharedCache() { return nullptr; }
 };
 
 }  // namespace api_manager
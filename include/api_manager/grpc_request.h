@@ -29,7 +29,7 @@ class GRPCRequest {
  public:
   // GRPCRequest constructor without headers in the callback function.
   GRPCRequest(std::function<void(utils::Status, std::string&&)> callback)
-      : callback_(callback) {}
+      : callback_(callback), use_ssl_(false), timeout_ms_(0) {}
 
   // A callback for the environment to invoke when the request is
   // complete. This will be invoked by the environment exactly once,
@@ -83,12 +83,36 @@ class GRPCRequest {
     return *this;
   }
 
+  // Whether to use a TLS channel to the gRPC server.
+  bool use_ssl() const { return use_ssl_; }
+  GRPCRequest& set_use_ssl(bool value) {
+    use_ssl_ = value;
+    return *this;
+  }
+
+  // The OAuth token sent in the "authorization" metadata, if not empty.
+  const std::string& auth_token() const { return auth_token_; }
+  GRPCRequest& set_auth_token(const std::string& value) {
+    auth_token_ = value;
+    return *this;
+  }
+
+  // Deadline, in milliseconds, for the request. 0 for no deadline.
+  int timeout_ms() const { return timeout_ms_; }
+  GRPCRequest& set_timeout_ms(int value) {
+    timeout_ms_ = value;
+    return *this;
+  }
+
  private:
   std::function<void(utils::Status, std::string&&)> callback_;
   std::string method_;
   std::string server_;
   std::string service_;
   std::string body_;
+  bool use_ssl_;
+  std::string auth_token_;
+  int timeout_ms_;
 };
 
 }  // namespace api_manager
@@ -0,0 +1,152 @@
+/* Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_LATENCY_STATISTICS_H_
+#define API_MANAGER_LATENCY_STATISTICS_H_
+
+#include <stdint.h>
+
+namespace google {
+namespace api_manager {
+
+// A log-linear histogram of latencies in microseconds. Latencies below 8us
+// are counted exactly, each larger power of two range is split into 8 linear
+// buckets, so that percentiles are within 12.5% of the recorded latencies.
+// Latencies above 2^27us (~134s) are counted in the last bucket.
+//
+// Recording a latency only increments counters.
+// Important note: please don't use std::string. These fields are directly
+// copied into a shared memory.
+struct LatencyHistogram {
+  static const int kSubBucketBits = 3;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kMaxExponent = 27;
+  static const int kNumBuckets =
+      (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+  // Number of recorded latencies.
+  uint64_t count;
+  // Sum of the recorded latencies.
+  uint64_t sum_us;
+  // Maximum recorded latency.
+  uint64_t max_us;
+  uint64_t buckets[kNumBuckets];
+
+  // Returns the index of the bucket counting the latency.
+  static int BucketIndex(uint64_t latency_us) {
+    if (latency_us < kSubBuckets) {
+      return static_cast<int>(latency_us);
+    }
+    if (latency_us >= (static_cast<uint64_t>(1) << kMaxExponent)) {
+      return kNumBuckets - 1;
+    }
+    int exponent = 63 - __builtin_clzll(latency_us);
+    int shift = exponent - kSubBucketBits;
+    return (shift + 1) * kSubBuckets +
+           static_cast<int>((latency_us >> shift) - kSubBuckets);
+  }
+
+  // Returns the largest latency counted by the bucket.
+  static uint64_t BucketUpperBound(int index) {
+    if (index < kSubBuckets) {
+      return index;
+    }
+    int shift = index / kSubBuckets - 1;
+    uint64_t lower = static_cast<uint64_t>(kSubBuckets + index % kSubBuckets)
+                     << shift;
+    return lower + (static_cast<uint64_t>(1) << shift) - 1;
+  }
+
+  void Record(uint64_t latency_us) {
+    ++count;
+    sum_us += latency_us;
+    if (latency_us > max_us) {
+      max_us = latency_us;
+    }
+    ++buckets[BucketIndex(latency_us)];
+  }
+
+  // Returns an upper bound of the latency below which the given percentage
+  // (0 to 100) of the recorded latencies fall, 0 if nothing was recorded.
+  uint64_t Percentile(double percentage) const {
+    if (count == 0) {
+      return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(percentage / 100 * count + 0.5);
+    if (rank < 1) {
+      rank = 1;
+    } else if (rank > count) {
+      rank = count;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < kNumBuckets; ++i) {
+      seen += buckets[i];
+      if (seen >= rank) {
+        uint64_t bound = BucketUpperBound(i);
+        return bound < max_us ? bound : max_us;
+      }
+    }
+    return max_us;
+  }
+
+  // Merge two histograms.
+  void Merge(const LatencyHistogram& v) {
+    count += v.count;
+    sum_us += v.sum_us;
+    if (v.max_us > max_us) {
+      max_us = v.max_us;
+    }
+    for (int i = 0; i < kNumBuckets; ++i) {
+      buckets[i] += v.buckets[i];
+    }
+  }
+};
+
+// The latency histograms of the request processing stages and of the service
+// control transport.
+// Important note: please don't use std::string. These fields are directly
+// copied into a shared memory.
+struct LatencyStatistics {
+  // Check workflow stages.
+  LatencyHistogram auth;
+  LatencyHistogram security_rules;
+  LatencyHistogram check;
+  LatencyHistogram quota;
+  // Time spent in the backend.
+  LatencyHistogram backend;
+  // Total request time.
+  LatencyHistogram request;
+  // Round trips of the calls to the service control server.
+  LatencyHistogram check_transport;
+  LatencyHistogram quota_transport;
+  LatencyHistogram report_transport;
+
+  // Merge two statistics.
+  void Merge(const LatencyStatistics& v) {
+    auth.Merge(v.auth);
+    security_rules.Merge(v.security_rules);
+    check.Merge(v.check);
+    quota.Merge(v.quota);
+    backend.Merge(v.backend);
+    request.Merge(v.request);
+    check_transport.Merge(v.check_transport);
+    quota_transport.Merge(v.quota_transport);
+    report_transport.Merge(v.report_transport);
+  }
+};
+
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_LATENCY_STATISTICS_H_
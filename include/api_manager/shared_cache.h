@@ -0,0 +1,45 @@
+/* Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_SHARED_CACHE_H_
+#define API_MANAGER_SHARED_CACHE_H_
+
+#include <chrono>
+#include <string>
+
+namespace google {
+namespace api_manager {
+
+// A key-value cache provided by API Manager's environment, shared by all
+// the API Manager instances of the server (for example, by all the nginx
+// worker processes). Entries expire after their time to live, and may be
+// evicted earlier when the cache is full.
+class SharedCache {
+ public:
+  virtual ~SharedCache() {}
+
+  // Looks up the value stored for the key. Returns false if there is no
+  // entry or the entry has expired.
+  virtual bool Lookup(const std::string &key, std::string *value) = 0;
+
+  // Stores the value for the key, replacing an existing entry. Values which
+  // do not fit in the cache are silently dropped.
+  virtual void Insert(const std::string &key, const std::string &value,
+                      std::chrono::milliseconds ttl) = 0;
+};
+
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_SHARED_CACHE_H_
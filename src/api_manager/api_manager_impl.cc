@@ -16,9 +16,11 @@
 //
 #include "src/api_manager/api_manager_impl.h"
 #include "src/api_manager/check_workflow.h"
+#include "src/api_manager/fetch_metadata.h"
 #include "src/api_manager/request_handler.h"
 
 #include <fstream>
+#include <set>
 #include <sstream>
 
 namespace google {
@@ -28,12 +30,78 @@ namespace {
 
 const std::string kConfigRolloutManaged("managed");
 
+// The interval of the service account token refresh.
+const std::chrono::seconds kTokenRefreshInterval(30);
+
+// The JWT tokens expiring within this time (seconds) are regenerated by the
+// token refresh.
+const time_t kJwtTokenRefreshWindow = 300;
+
+// The interval of the checks of the retired service contexts.
+const std::chrono::seconds kReclaimInterval(10);
+
+// The number of checks a retired service context is kept after its service
+// control client is closed, so that the calls flushing its reports complete.
+const int kRetiredServiceGraceChecks = 3;
+
+// The environment of the service configs built on a background thread. It
+// keeps the log messages, which are logged on the calling thread once the
+// configs are built. Config::Create() only logs.
+class BackgroundBuildEnv : public ApiManagerEnvInterface {
+ public:
+  // Must be called on the thread calling the API Manager.
+  BackgroundBuildEnv(ApiManagerEnvInterface *env) : env_(env) {
+    for (int level = DEBUG; level <= ERROR; ++level) {
+      log_enabled_[level] = env_->IsLogEnabled(static_cast<LogLevel>(level));
+    }
+  }
+
+  void Log(LogLevel level, const char *message) override {
+    logs_.emplace_back(level, message);
+  }
+
+  bool IsLogEnabled(LogLevel level) override { return log_enabled_[level]; }
+
+  std::unique_ptr<PeriodicTimer> StartPeriodicTimer(
+      std::chrono::milliseconds, std::function<void()>) override {
+    return nullptr;
+  }
+
+  void RunHTTPRequest(std::unique_ptr<HTTPRequest> request) override {
+    request->OnComplete(
+        utils::Status(Code::FAILED_PRECONDITION, "Not supported"), {}, "");
+  }
+
+  void RunGRPCRequest(std::unique_ptr<GRPCRequest> request) override {
+    request->OnComplete(
+        utils::Status(Code::FAILED_PRECONDITION, "Not supported"), "");
+  }
+
+  // Logs the kept messages to the environment. Must be called on the thread
+  // calling the API Manager.
+  void FlushLogs() {
+    for (const auto &log : logs_) {
+      env_->Log(log.first, log.second.c_str());
+    }
+    logs_.clear();
+  }
+
+ private:
+  ApiManagerEnvInterface *env_;
+  bool log_enabled_[ERROR + 1];
+  std::vector<std::pair<LogLevel, std::string>> logs_;
+};
+
 }  // namespace anonymous
 
 ApiManagerImpl::ApiManagerImpl(std::unique_ptr<ApiManagerEnvInterface> env,
                                const std::string &server_config)
     : global_context_(
-          new context::GlobalContext(std::move(env), server_config)) {
+          new context::GlobalContext(std::move(env), server_config)),
+      reclaimed_services_(0),
+      config_load_statistics_(),
+      rollout_sequence_(0),
+      deployed_rollout_sequence_(0) {
   check_workflow_ = std::unique_ptr<CheckWorkflow>(new CheckWorkflow);
   check_workflow_->RegisterAll();
 
@@ -111,10 +179,20 @@ utils::Status ApiManagerImpl::LoadServiceRollouts() {
 
 utils::Status ApiManagerImpl::AddAndDeployConfigs(
     std::vector<std::pair<std::string, int>> &&configs, bool initialize) {
+  BuiltConfigs built;
+  for (const auto &item : configs) {
+    built.emplace_back(Config::Create(global_context_->env(), item.first),
+                       item.second);
+  }
+  return AddAndDeployConfigs(std::move(built), initialize);
+}
+
+utils::Status ApiManagerImpl::AddAndDeployConfigs(BuiltConfigs &&configs,
+                                                  bool initialize) {
   std::vector<std::pair<std::string, int>> list;
-  for (auto item : configs) {
+  for (auto &item : configs) {
     std::string config_id;
-    if (AddConfig(item.first, initialize, &config_id).ok()) {
+    if (AddConfig(std::move(item.first), initialize, &config_id).ok()) {
       list.push_back({config_id, round(item.second)});
     } else {
       return utils::Status(Code::ABORTED, "Invalid service config");
@@ -134,12 +212,61 @@ utils::Status ApiManagerImpl::AddAndDeployConfigs(
   return utils::Status::OK;
 }
 
+void ApiManagerImpl::ApplyRollout(
+    std::vector<std::pair<std::string, int>> &&configs) {
+  struct RolloutBuild {
+    RolloutBuild(ApiManagerEnvInterface *env) : env(env) {}
+
+    BackgroundBuildEnv env;
+    std::vector<std::pair<std::string, int>> configs;
+    BuiltConfigs built;
+  };
+  std::shared_ptr<RolloutBuild> build =
+      std::make_shared<RolloutBuild>(global_context_->env());
+  build->configs = std::move(configs);
+  size_t num_configs = build->configs.size();
+  uint64_t sequence = ++rollout_sequence_;
+
+  // Only the work runs on the background thread, it must not use this.
+  auto work = [build]() {
+    for (const auto &item : build->configs) {
+      build->built.emplace_back(Config::Create(&build->env, item.first),
+                                item.second);
+    }
+    build->configs.clear();
+  };
+  auto continuation = [this, build, sequence]() {
+    build->env.FlushLogs();
+    if (sequence < deployed_rollout_sequence_) {
+      ++config_load_statistics_.stale_rollouts;
+      global_context_->env()->LogInfo(
+          "Dropped a rollout built after a newer one was deployed");
+      return;
+    }
+    deployed_rollout_sequence_ = sequence;
+    AddAndDeployConfigs(std::move(build->built), true);
+  };
+
+  if (global_context_->env()->RunInBackground(work, continuation)) {
+    config_load_statistics_.background_loads += num_configs;
+  } else {
+    deployed_rollout_sequence_ = sequence;
+    AddAndDeployConfigs(std::move(build->configs), true);
+  }
+}
+
 utils::Status ApiManagerImpl::AddConfig(const std::string &service_config,
                                         bool initialize,
                                         std::string *config_id) {
-  std::unique_ptr<Config> config =
-      Config::Create(global_context_->env(), service_config);
+  return AddConfig(Config::Create(global_context_->env(), service_config),
+                   initialize, config_id);
+}
+
+utils::Status ApiManagerImpl::AddConfig(std::unique_ptr<Config> config,
+                                        bool initialize,
+                                        std::string *config_id) {
   if (config == nullptr) {
+    ++config_load_statistics_.failures;
     return utils::Status(Code::INVALID_ARGUMENT, "Invalid service config");
   }
 
@@ -151,10 +278,17 @@ utils::Status ApiManagerImpl::AddConfig(const std::string &service_config,
       auto err_msg = std::string("Mismatched service name; existing: ") +
                      global_context_->service_name() + ", new: " + service_name;
       global_context_->env()->LogError(err_msg);
+      ++config_load_statistics_.failures;
       return utils::Status(Code::INVALID_ARGUMENT, err_msg);
     }
   }
 
+  ++config_load_statistics_.loads;
+  config_load_statistics_.last_parse_us = config->parse_duration().count();
+  config_load_statistics_.last_build_us = config->build_duration().count();
+  config_load_statistics_.total_parse_us += config->parse_duration().count();
+  config_load_statistics_.total_build_us += config->build_duration().count();
+
   *config_id = config->service().id();
 
   auto context_service = std::make_shared<context::ServiceContext>(
@@ -162,7 +296,13 @@ utils::Status ApiManagerImpl::AddConfig(const std::string &service_config,
   if (initialize == true && context_service->service_control()) {
     context_service->service_control()->Init();
   }
-  service_context_map_[*config_id] = context_service;
+  auto it = service_context_map_.find(*config_id);
+  if (it != service_context_map_.end()) {
+    RetireService(it->second);
+    it->second = context_service;
+  } else {
+    service_context_map_[*config_id] = context_service;
+  }
 
   return utils::Status::OK;
 }
@@ -170,7 +310,48 @@ utils::Status ApiManagerImpl::AddConfig(const std::string &service_config,
 // Deploy these configs according to the traffic percentage.
 void ApiManagerImpl::DeployConfigs(
     std::vector<std::pair<std::string, int>> &&list) {
+  std::set<std::string> config_ids;
+  for (const auto &item : list) {
+    config_ids.insert(item.first);
+  }
   service_selector_.reset(new WeightedSelector(std::move(list)));
+
+  // The requests started from now on only use the deployed configs.
+  for (auto it = service_context_map_.begin();
+       it != service_context_map_.end();) {
+    if (config_ids.find(it->first) == config_ids.end()) {
+      RetireService(it->second);
+      it = service_context_map_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ApiManagerImpl::RetireService(
+    std::shared_ptr<context::ServiceContext> service_context) {
+  global_context_->env()->LogInfo("Retiring service config " +
+                                  service_context->service().id());
+  retired_services_.push_back({service_context, false, 0});
+}
+
+void ApiManagerImpl::ReclaimRetiredServices() {
+  for (auto it = retired_services_.begin(); it != retired_services_.end();) {
+    if (!it->closed) {
+      if (it->service_context->active_requests() == 0) {
+        if (it->service_context->service_control()) {
+          it->service_context->service_control()->Close();
+        }
+        it->closed = true;
+      }
+      ++it;
+    } else if (++it->checks_since_closed >= kRetiredServiceGraceChecks) {
+      it = retired_services_.erase(it);
+      ++reclaimed_services_;
+    } else {
+      ++it;
+    }
+  }
 }
 
 utils::Status ApiManagerImpl::Init() {
@@ -189,13 +370,21 @@ utils::Status ApiManagerImpl::Init() {
     }
   }
 
+  // Refreshes the service account tokens in the background, so that the
+  // requests neither wait for a token fetch nor generate JWT tokens.
+  token_refresh_timer_ = global_context_->env()->StartPeriodicTimer(
+      kTokenRefreshInterval, [this]() { RefreshServiceAccountToken(); });
+
+  reclaim_timer_ = global_context_->env()->StartPeriodicTimer(
+      kReclaimInterval, [this]() { ReclaimRetiredServices(); });
+
   if (global_context_->rollout_strategy() == kConfigRolloutManaged) {
     config_manager_.reset(new ConfigManager(
         global_context_,
         [this](const utils::Status &status,
                std::vector<std::pair<std::string, int>> &&configs) {
           if (status.ok()) {
-            AddAndDeployConfigs(std::move(configs), true);
+            ApplyRollout(std::move(configs));
           }
         }));
 
@@ -212,6 +401,13 @@ utils::Status ApiManagerImpl::Init() {
 }
 
 utils::Status ApiManagerImpl::Close() {
+  if (token_refresh_timer_) {
+    token_refresh_timer_->Stop();
+  }
+  if (reclaim_timer_) {
+    reclaim_timer_->Stop();
+  }
+
   if (global_context_->cloud_trace_aggregator()) {
     global_context_->cloud_trace_aggregator()->SendAndClearTraces();
   }
@@ -221,9 +417,30 @@ utils::Status ApiManagerImpl::Close() {
       it.second->service_control()->Close();
     }
   }
+  for (const auto &retired : retired_services_) {
+    if (!retired.closed && retired.service_context->service_control()) {
+      retired.service_context->service_control()->Close();
+    }
+  }
   return utils::Status::OK;
 }
 
+void ApiManagerImpl::RefreshServiceAccountToken() {
+  auth::ServiceAccountToken *token = global_context_->service_account_token();
+  token->RefreshJwtTokens(kJwtTokenRefreshWindow);
+
+  // Retries a failed access token fetch.
+  if (token->state() == auth::ServiceAccountToken::FAILED) {
+    token->set_state(auth::ServiceAccountToken::NONE);
+  }
+  GlobalFetchServiceAccountToken(global_context_, [this](utils::Status status) {
+    if (!status.ok()) {
+      global_context_->env()->LogDebug(
+          "Failed to refresh service account token: " + status.ToString());
+    }
+  });
+}
+
 bool ApiManagerImpl::Enabled() const {
   for (const auto &it : service_context_map_) {
     if (it.second->Enabled()) {
@@ -262,6 +479,29 @@ utils::Status ApiManagerImpl::GetStatistics(
     ApiManagerStatistics *statistics) const {
   memset(&statistics->service_control_statistics, 0,
          sizeof(service_control::Statistics));
+  // The keys are shared by all the service configs.
+  const auth::Certs::Statistics &certs_stat =
+      global_context_->certs().statistics();
+  statistics->key_fetch_statistics.fetches = certs_stat.fetches;
+  statistics->key_fetch_statistics.coalesced_waits = certs_stat.coalesced_waits;
+  statistics->key_fetch_statistics.refreshes = certs_stat.refreshes;
+  statistics->key_fetch_statistics.stale_keys_used =
+      certs_stat.stale_certs_used;
+  statistics->config_load_statistics = config_load_statistics_;
+
+  ServiceGenerationStatistics &generation_stat =
+      statistics->service_generation_statistics;
+  memset(&generation_stat, 0, sizeof(generation_stat));
+  generation_stat.active = service_context_map_.size();
+  for (const auto &it : service_context_map_) {
+    generation_stat.active_memory_bytes += it.second->config()->memory_bytes();
+  }
+  generation_stat.retired = retired_services_.size();
+  for (const auto &retired : retired_services_) {
+    generation_stat.retired_memory_bytes +=
+        retired.service_context->config()->memory_bytes();
+  }
+  generation_stat.reclaimed = reclaimed_services_;
   for (const auto &it : service_context_map_) {
     if (it.second->service_control()) {
       service_control::Statistics stat;
@@ -274,6 +514,13 @@ utils::Status ApiManagerImpl::GetStatistics(
   return utils::Status::OK;
 }
 
+utils::Status ApiManagerImpl::GetLatencyStatistics(
+    LatencyStatistics *statistics) const {
+  // The latencies are recorded for all the service configs.
+  *statistics = global_context_->latency_statistics();
+  return utils::Status::OK;
+}
+
 // Get service config rollout information
 utils::Status ApiManagerImpl::GetServiceConfigRollouts(
     ServiceConfigRolloutsInfo *rollouts) {
@@ -288,6 +535,10 @@ utils::Status ApiManagerImpl::GetServiceConfigRollouts(
 
   for (auto item : service_selector_->list()) {
     rollouts->percentages[item.first] = item.second;
+    const auto &it = service_context_map_.find(item.first);
+    if (it != service_context_map_.end()) {
+      rollouts->memory_bytes[item.first] = it->second->config()->memory_bytes();
+    }
   }
 
   return utils::Status::OK;
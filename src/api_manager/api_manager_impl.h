@@ -15,6 +15,12 @@
 #ifndef API_MANAGER_API_MANAGER_IMPL_H_
 #define API_MANAGER_API_MANAGER_IMPL_H_
 
+#include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "include/api_manager/api_manager.h"
 #include "src/api_manager/config_manager.h"
 #include "src/api_manager/context/global_context.h"
@@ -55,6 +61,8 @@ class ApiManagerImpl : public ApiManager {
   };
 
   utils::Status GetStatistics(ApiManagerStatistics *statistics) const override;
+  utils::Status GetLatencyStatistics(
+      LatencyStatistics *statistics) const override;
 
   // Add a new service config.
   // Return true if service_config is valid, otherwise return false.
@@ -62,6 +70,11 @@ class ApiManagerImpl : public ApiManager {
   utils::Status AddConfig(const std::string &service_config, bool initialize,
                           std::string *config_id);
 
+  // Same as above, with a service config built by Config::Create(), nullptr
+  // if it is invalid.
+  utils::Status AddConfig(std::unique_ptr<Config> config, bool initialize,
+                          std::string *config_id);
+
   // Return ServiceContext for selected by WeightedSelector
   std::shared_ptr<context::ServiceContext> SelectService();
 
@@ -81,10 +94,33 @@ class ApiManagerImpl : public ApiManager {
   // Use these configs according to the traffic percentage.
   void DeployConfigs(std::vector<std::pair<std::string, int>> &&list);
 
+  // Service configs built by Config::Create(), nullptr if invalid, and their
+  // traffic percentages.
+  typedef std::vector<std::pair<std::unique_ptr<Config>, int>> BuiltConfigs;
+
   // Add and deploy service configs. Return utils::Status::OK when everything
   // is ok.
   utils::Status AddAndDeployConfigs(
       std::vector<std::pair<std::string, int>> &&configs, bool initialize);
+  utils::Status AddAndDeployConfigs(BuiltConfigs &&configs, bool initialize);
+
+  // Builds the service configs of a managed rollout on a background thread
+  // of the environment if it has one, then adds and deploys them on the
+  // calling thread. The requests keep using the current configs until the
+  // new ones are deployed. A rollout is dropped if a newer one was deployed
+  // while it was built.
+  void ApplyRollout(std::vector<std::pair<std::string, int>> &&configs);
+
+  // Refreshes the service account tokens which are about to expire.
+  void RefreshServiceAccountToken();
+
+  // Retires a service context which is no longer in the rollout.
+  void RetireService(std::shared_ptr<context::ServiceContext> service_context);
+
+  // Closes the service control client of the retired service contexts
+  // without active requests, which flushes their reports, and frees them
+  // after a grace period of a few checks.
+  void ReclaimRetiredServices();
 
   // The check work flow.
   std::shared_ptr<CheckWorkflow> check_workflow_;
@@ -102,10 +138,40 @@ class ApiManagerImpl : public ApiManager {
   // A weighted service selector.
   std::unique_ptr<WeightedSelector> service_selector_;
 
+  // A service context no longer in the rollout.
+  struct RetiredService {
+    std::shared_ptr<context::ServiceContext> service_context;
+    // Whether the service control client was closed, and the number of
+    // reclaim checks since.
+    bool closed;
+    int checks_since_closed;
+  };
+
+  // The retired service contexts, in retirement order.
+  std::vector<RetiredService> retired_services_;
+
+  // Number of retired service contexts freed.
+  uint64_t reclaimed_services_;
+
+  // The timer reclaiming the retired service contexts.
+  std::unique_ptr<PeriodicTimer> reclaim_timer_;
+
   // A config manager will be initialized when server_config.rollout_strategy is
   // set to "managed"
   std::unique_ptr<ConfigManager> config_manager_;
 
+  // The timer of the service account token refresh.
+  std::unique_ptr<PeriodicTimer> token_refresh_timer_;
+
+  // The statistics of the service config loads.
+  ConfigLoadStatistics config_load_statistics_;
+
+  // The sequence number of the last managed rollout applied, and of the
+  // last one deployed. A rollout is deployed inline when the background
+  // queue is full, before the rollouts queued earlier.
+  uint64_t rollout_sequence_;
+  uint64_t deployed_rollout_sequence_;
+
   std::vector<std::unique_ptr<RewriteRule>> rewrite_rules_;
 };
 
@@ -17,6 +17,7 @@
 #include "gtest/gtest.h"
 #include "src/api_manager/api_manager_impl.h"
 #include "src/api_manager/mock_api_manager_environment.h"
+#include "src/api_manager/mock_request.h"
 
 using ::testing::_;
 using ::testing::Invoke;
@@ -194,6 +195,25 @@ const char kRolloutsResponse1[] = R"(
 }
 )";
 
+const char kRolloutsResponse2[] = R"(
+{
+  "rollouts": [
+    {
+      "rolloutId": "2017-05-01r1",
+      "createTime": "2017-05-02T22:40:09.884Z",
+      "createdBy": "test_user@google.com",
+      "status": "SUCCESS",
+      "trafficPercentStrategy": {
+        "percentages": {
+          "2017-05-01r0": 100
+        }
+      },
+      "serviceName": "service_name_from_server_config"
+    }
+  ]
+}
+)";
+
 const char kServiceForStatistics[] =
     "name: \"service-name\"\n"
     "control: {\n"
@@ -204,16 +224,22 @@ const char kServiceForStatistics[] =
 class MockPeriodicTimer : public PeriodicTimer {
  public:
   MockPeriodicTimer() {}
-  MockPeriodicTimer(std::function<void()> continuation)
-      : continuation_(continuation) {
+  MockPeriodicTimer(std::function<void()> continuation,
+                    std::shared_ptr<bool> active)
+      : continuation_(continuation), active_(active) {
     continuation_();
   }
 
-  virtual ~MockPeriodicTimer() {}
-  void Stop(){};
+  virtual ~MockPeriodicTimer() { Stop(); }
+  void Stop() {
+    if (active_) {
+      *active_ = false;
+    }
+  };
 
  private:
   std::function<void()> continuation_;
+  std::shared_ptr<bool> active_;
 };
 
 class MockTimerApiManagerEnvironment : public MockApiManagerEnvironment {
@@ -223,7 +249,21 @@ class MockTimerApiManagerEnvironment : public MockApiManagerEnvironment {
 
   virtual std::unique_ptr<PeriodicTimer> StartPeriodicTimer(
       std::chrono::milliseconds interval, std::function<void()> continuation) {
-    return std::unique_ptr<PeriodicTimer>(new MockPeriodicTimer(continuation));
+    std::shared_ptr<bool> active = std::make_shared<bool>(true);
+    timers_.push_back({continuation, active});
+    return std::unique_ptr<PeriodicTimer>(
+        new MockPeriodicTimer(continuation, active));
+  }
+
+  // Simulates another event of the periodic timers which are not stopped.
+  void FireTimers() {
+    // The timers may start new timers.
+    for (size_t i = 0, size = timers_.size(); i < size; ++i) {
+      Timer timer = timers_[i];
+      if (*timer.active) {
+        timer.continuation();
+      }
+    }
   }
 
   MOCK_METHOD1(DoRunHTTPRequest, void(HTTPRequest *));
@@ -236,7 +276,13 @@ class MockTimerApiManagerEnvironment : public MockApiManagerEnvironment {
   }
 
  private:
+  struct Timer {
+    std::function<void()> continuation;
+    std::shared_ptr<bool> active;
+  };
+
   std::unique_ptr<PeriodicTimer> periodic_timer_;
+  std::vector<Timer> timers_;
 };
 
 class ApiManagerTest : public ::testing::Test {
@@ -315,6 +361,13 @@ TEST_F(ApiManagerTest, CorrectStatistics) {
   EXPECT_EQ(0, service_control_stat.send_reports_by_flush);
   EXPECT_EQ(0, service_control_stat.send_reports_in_flight);
   EXPECT_EQ(0, service_control_stat.send_report_operations);
+  const ConfigLoadStatistics &config_load_stat =
+      statistics.config_load_statistics;
+  EXPECT_EQ(1, config_load_stat.loads);
+  EXPECT_EQ(0, config_load_stat.background_loads);
+  EXPECT_EQ(0, config_load_stat.failures);
+  EXPECT_EQ(config_load_stat.last_parse_us, config_load_stat.total_parse_us);
+  EXPECT_EQ(config_load_stat.last_build_us, config_load_stat.total_build_us);
 }
 
 TEST_F(ApiManagerTest, InitializedOnApiManagerInstanceCreation) {
@@ -405,7 +458,8 @@ TEST_F(ApiManagerTest, ManagedRolloutStrategy) {
   api_manager->Init();
 
   EXPECT_TRUE(api_manager->Enabled());
-  EXPECT_EQ("2017-05-01r0", api_manager->service("2017-05-01r0").id());
+  // The config which is no longer rolled out is retired.
+  EXPECT_EQ("", api_manager->service("2017-05-01r0").id());
 
   auto service = api_manager->SelectService();
 
@@ -414,6 +468,188 @@ TEST_F(ApiManagerTest, ManagedRolloutStrategy) {
   EXPECT_EQ("2017-05-01r1", service->service().id());
 }
 
+TEST_F(ApiManagerTest, ManagedRolloutBuiltInBackground) {
+  std::unique_ptr<MockTimerApiManagerEnvironment> env(
+      new ::testing::NiceMock<MockTimerApiManagerEnvironment>());
+
+  EXPECT_CALL(*env.get(), DoRunHTTPRequest(_))
+      .WillOnce(Invoke([this](HTTPRequest *req) {
+        req->OnComplete(Status::OK, {}, kRolloutsResponse1);
+      }))
+      .WillOnce(Invoke([this](HTTPRequest *req) {
+        req->OnComplete(Status::OK, {}, kServiceConfig2);
+      }));
+
+  std::function<void()> work;
+  std::function<void()> continuation;
+  EXPECT_CALL(*env.get(), RunInBackground(_, _))
+      .WillOnce(Invoke(
+          [&work, &continuation](std::function<void()> w,
+                                 std::function<void()> c) {
+            work = w;
+            continuation = c;
+            return true;
+          }));
+
+  std::shared_ptr<ApiManagerImpl> api_manager(
+      std::dynamic_pointer_cast<ApiManagerImpl>(MakeApiManager(
+          std::move(env), kServerConfigWithManagedRolloutStrategy)));
+  EXPECT_OK(api_manager->LoadServiceRollouts());
+  api_manager->Init();
+
+  // The current config serves the requests until the new one is deployed.
+  EXPECT_EQ("2017-05-01r0", api_manager->SelectService()->service().id());
+  ASSERT_TRUE(work);
+  work();
+  EXPECT_EQ("2017-05-01r0", api_manager->SelectService()->service().id());
+  continuation();
+  EXPECT_EQ("2017-05-01r1", api_manager->SelectService()->service().id());
+
+  ApiManagerStatistics statistics;
+  api_manager->GetStatistics(&statistics);
+  EXPECT_EQ(2, statistics.config_load_statistics.loads);
+  EXPECT_EQ(1, statistics.config_load_statistics.background_loads);
+  EXPECT_EQ(0, statistics.config_load_statistics.failures);
+
+  // The previous config is retired until its requests are done.
+  EXPECT_EQ("", api_manager->service("2017-05-01r0").id());
+  const ServiceGenerationStatistics &generation_stat =
+      statistics.service_generation_statistics;
+  EXPECT_EQ(1, generation_stat.active);
+  EXPECT_EQ(1, generation_stat.retired);
+  EXPECT_EQ(0, generation_stat.reclaimed);
+  EXPECT_LT(0, generation_stat.active_memory_bytes);
+  EXPECT_LT(0, generation_stat.retired_memory_bytes);
+
+  ServiceConfigRolloutsInfo rollouts;
+  api_manager->GetServiceConfigRollouts(&rollouts);
+  EXPECT_EQ(1, rollouts.memory_bytes.size());
+  EXPECT_EQ(generation_stat.active_memory_bytes,
+            rollouts.memory_bytes["2017-05-01r1"]);
+}
+
+TEST_F(ApiManagerTest, ManagedRolloutNotRolledBackByOlderBuild) {
+  std::unique_ptr<MockTimerApiManagerEnvironment> env(
+      new ::testing::NiceMock<MockTimerApiManagerEnvironment>());
+  MockTimerApiManagerEnvironment *raw_env = env.get();
+
+  EXPECT_CALL(*env.get(), DoRunHTTPRequest(_))
+      .WillOnce(Invoke([this](HTTPRequest *req) {
+        req->OnComplete(Status::OK, {}, kRolloutsResponse1);
+      }))
+      .WillOnce(Invoke([this](HTTPRequest *req) {
+        req->OnComplete(Status::OK, {}, kServiceConfig2);
+      }))
+      .WillOnce(Invoke([this](HTTPRequest *req) {
+        req->OnComplete(Status::OK, {}, kRolloutsResponse2);
+      }))
+      .WillOnce(Invoke([this](HTTPRequest *req) {
+        req->OnComplete(Status::OK, {}, kServiceConfig1);
+      }));
+
+  // The first rollout is queued, the queue is full for the second one.
+  std::function<void()> work;
+  std::function<void()> continuation;
+  EXPECT_CALL(*env.get(), RunInBackground(_, _))
+      .WillOnce(Invoke(
+          [&work, &continuation](std::function<void()> w,
+                                 std::function<void()> c) {
+            work = w;
+            continuation = c;
+            return true;
+          }))
+      .WillOnce(Return(false));
+
+  std::shared_ptr<ApiManagerImpl> api_manager(
+      std::dynamic_pointer_cast<ApiManagerImpl>(MakeApiManager(
+          std::move(env), kServerConfigWithManagedRolloutStrategy)));
+  EXPECT_OK(api_manager->LoadServiceRollouts());
+  api_manager->Init();
+  ASSERT_TRUE(work);
+
+  // The second rollout is deployed inline.
+  raw_env->FireTimers();
+  EXPECT_EQ("2017-05-01r0", api_manager->SelectService()->service().id());
+
+  // The first rollout is built after it: it is dropped rather than rolling
+  // the service back.
+  work();
+  continuation();
+  EXPECT_EQ("2017-05-01r0", api_manager->SelectService()->service().id());
+  EXPECT_EQ("", api_manager->service("2017-05-01r1").id());
+
+  ApiManagerStatistics statistics;
+  api_manager->GetStatistics(&statistics);
+  EXPECT_EQ(1, statistics.config_load_statistics.background_loads);
+  EXPECT_EQ(1, statistics.config_load_statistics.stale_rollouts);
+  EXPECT_EQ(0, statistics.config_load_statistics.failures);
+}
+
+TEST_F(ApiManagerTest, RetiredServiceReclaimedAfterItsRequests) {
+  std::unique_ptr<MockTimerApiManagerEnvironment> env(
+      new ::testing::NiceMock<MockTimerApiManagerEnvironment>());
+  MockTimerApiManagerEnvironment *raw_env = env.get();
+
+  EXPECT_CALL(*env.get(), DoRunHTTPRequest(_))
+      .WillOnce(Invoke([this](HTTPRequest *req) {
+        req->OnComplete(Status::OK, {}, kRolloutsResponse1);
+      }))
+      .WillOnce(Invoke([this](HTTPRequest *req) {
+        req->OnComplete(Status::OK, {}, kServiceConfig2);
+      }))
+      .WillRepeatedly(Invoke([this](HTTPRequest *req) {
+        req->OnComplete(Status::OK, {}, kRolloutsResponse1);
+      }));
+
+  std::shared_ptr<ApiManagerImpl> api_manager(
+      std::dynamic_pointer_cast<ApiManagerImpl>(MakeApiManager(
+          std::move(env), kServerConfigWithManagedRolloutStrategy)));
+  EXPECT_OK(api_manager->LoadServiceRollouts());
+
+  // A request of the first config is in flight when it is retired.
+  std::weak_ptr<context::ServiceContext> retired =
+      api_manager->SelectService();
+  std::unique_ptr<RequestHandlerInterface> request_handler =
+      api_manager->CreateRequestHandler(std::unique_ptr<Request>(
+          new ::testing::NiceMock<MockRequest>()));
+  EXPECT_EQ("2017-05-01r0", request_handler->GetServiceConfigId());
+  api_manager->Init();
+  EXPECT_EQ("2017-05-01r1", api_manager->SelectService()->service().id());
+
+  service_control::Statistics service_control_stat;
+  auto get_retired_statistics = [&]() {
+    std::shared_ptr<context::ServiceContext> service = retired.lock();
+    EXPECT_TRUE(service);
+    return service->service_control()->GetStatistics(&service_control_stat);
+  };
+  auto reclaimed = [&]() {
+    ApiManagerStatistics statistics;
+    api_manager->GetStatistics(&statistics);
+    EXPECT_EQ(1, statistics.service_generation_statistics.active);
+    return statistics.service_generation_statistics.reclaimed;
+  };
+
+  // Not closed while its request is in flight.
+  raw_env->FireTimers();
+  EXPECT_OK(get_retired_statistics());
+  EXPECT_EQ(0, reclaimed());
+
+  // Closed once the request is done.
+  request_handler.reset();
+  raw_env->FireTimers();
+  EXPECT_EQ(Code::INTERNAL, get_retired_statistics().code());
+  EXPECT_EQ(0, reclaimed());
+
+  // Freed after the grace period.
+  raw_env->FireTimers();
+  raw_env->FireTimers();
+  EXPECT_FALSE(retired.expired());
+  EXPECT_EQ(0, reclaimed());
+  raw_env->FireTimers();
+  EXPECT_TRUE(retired.expired());
+  EXPECT_EQ(1, reclaimed());
+}
+
 TEST_F(ApiManagerTest, ServerConfigWithPartialServiceConfig) {
   std::unique_ptr<MockApiManagerEnvironment> env(
       new ::testing::NiceMock<MockApiManagerEnvironment>());
@@ -27,7 +27,15 @@ const int kAuthzCacheTimeout = 300;
 const int kAuthzCacheSize = 10000;
 }  // namespace
 
-AuthzCache::AuthzCache() : cache_(kAuthzCacheSize) {}
+AuthzCache::AuthzCache()
+    : cache_(kAuthzCacheSize),
+      expiration_(std::chrono::seconds(kAuthzCacheTimeout)) {}
+
+AuthzCache::AuthzCache(int cache_size, std::chrono::milliseconds expiration)
+    : cache_(cache_size > 0 ? cache_size : kAuthzCacheSize),
+      expiration_(expiration.count() > 0
+                      ? expiration
+                      : std::chrono::seconds(kAuthzCacheTimeout)) {}
 
 AuthzCache::~AuthzCache() { cache_.Clear(); }
 
@@ -35,7 +43,7 @@ void AuthzCache::Add(const std::string& cache_key, const bool if_success,
                      const std::chrono::system_clock::time_point& now) {
   AuthzValue* newval = new AuthzValue();
   newval->if_success = if_success;
-  newval->exp = now + std::chrono::seconds(kAuthzCacheTimeout);
+  newval->exp = now + expiration_;
   cache_.Insert(cache_key, newval, 1);
 }
 
@@ -58,16 +66,47 @@ bool AuthzCache::Lookup(const std::string& cache_key,
 
 std::string AuthzCache::ComposeAuthzCacheKey(
     const std::string& auth_token, const std::string& request_path,
-    const std::string& request_HTTP_method) {
+    const std::string& request_HTTP_method, const std::string& release_url) {
   google::service_control_client::MD5 hasher;
   hasher.Update(auth_token);
   hasher.Update(request_path);
   hasher.Update(request_HTTP_method);
+  hasher.Update(release_url);
   return hasher.Digest();
 }
 
 int AuthzCache::NumberOfEntries() { return cache_.Entries(); }
 
+bool AuthzCache::StartCheck(const std::string& cache_key,
+                            std::function<void(utils::Status)> on_done) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = pending_checks_.find(cache_key);
+  if (it == pending_checks_.end()) {
+    pending_checks_[cache_key];
+    return true;
+  }
+  it->second.push_back(std::move(on_done));
+  return false;
+}
+
+void AuthzCache::FinishCheck(const std::string& cache_key,
+                             const utils::Status& status) {
+  std::vector<std::function<void(utils::Status)>> waiters;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pending_checks_.find(cache_key);
+    if (it == pending_checks_.end()) {
+      return;
+    }
+    waiters.swap(it->second);
+    pending_checks_.erase(it);
+  }
+  // Called without the lock, since they may start new checks.
+  for (const auto& on_done : waiters) {
+    on_done(status);
+  }
+}
+
 }  // namespace auth
 }  // namespace api_manager
 }  // namespace google
@@ -16,7 +16,13 @@
 #define API_MANAGER_AUTH_AUTHZ_CACHE_H_
 
 #include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <string>
+#include <vector>
+
+#include "include/api_manager/utils/status.h"
 #include "utils/md5.h"
 #include "utils/simple_lru_cache_inl.h"
 
@@ -34,11 +40,19 @@ struct AuthzValue {
 };
 
 // A local cache to expedite the authorization process. The key of the cache is
-// the hash of the concatenation of JWT auth token, request path, and request
-// HTTP method. The value is of type AuthzValue.
+// the hash of the concatenation of JWT auth token, request path, request
+// HTTP method and Firebase release URL. The value is of type AuthzValue.
+//
+// Concurrent checks of the same key are coalesced: while a check is in
+// flight, later checks of the key wait for its result instead of calling the
+// Firebase Rules service again.
 class AuthzCache {
  public:
+  // Creates a cache with the default size and entry lifetime.
   AuthzCache();
+  // Creates a cache of at most cache_size entries, each valid for
+  // expiration. The defaults are used for values <= 0.
+  AuthzCache(int cache_size, std::chrono::milliseconds expiration);
   ~AuthzCache();
   // This method is used to insert cache entry.
   void Add(const std::string& cache_key, const bool if_success,
@@ -48,17 +62,37 @@ class AuthzCache {
               const std::chrono::system_clock::time_point& now,
               AuthzValue* value);
   // This method is used to generate cache key.
+  // The release URL identifies the rules of the service config, so that the
+  // cache can be shared by several service configs.
   static std::string ComposeAuthzCacheKey(
       const std::string& auth_token, const std::string& request_path,
-      const std::string& request_HTTP_method);
+      const std::string& request_HTTP_method, const std::string& release_url);
   // This method returns number of entries stored in cache. Note that this
   // method is only used in testing.
   int NumberOfEntries();
 
+  // Starts a check of the cache key. Returns true if no check of the key is
+  // in flight, the caller then runs the check and calls FinishCheck with its
+  // result. Otherwise, returns false and on_done is called with the result of
+  // the check in flight.
+  bool StartCheck(const std::string& cache_key,
+                  std::function<void(utils::Status)> on_done);
+  // Finishes the check of the cache key started by StartCheck, passing its
+  // result to the checks waiting for it.
+  void FinishCheck(const std::string& cache_key, const utils::Status& status);
+
  private:
   // LRU cache.
   ::google::service_control_client::SimpleLRUCache<std::string, AuthzValue>
       cache_;
+  // The lifetime of the cache entries.
+  std::chrono::milliseconds expiration_;
+
+  // Protects pending_checks_.
+  std::mutex mutex_;
+  // The checks waiting for the check in flight of their cache key.
+  std::map<std::string, std::vector<std::function<void(utils::Status)>>>
+      pending_checks_;
 };
 
 }  // namespace auth
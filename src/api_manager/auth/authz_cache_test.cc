@@ -15,6 +15,9 @@
 ////////////////////////////////////////////////////////////////////////////////
 //
 #include "src/api_manager/auth/authz_cache.h"
+
+#include <vector>
+
 #include "gtest/gtest.h"
 
 namespace google {
@@ -25,6 +28,9 @@ namespace {
 const std::string kPath = "/path/to/resource";
 const std::string kPath1 = "path/to/resources";
 const std::string kHTTPMethod = "GET";
+const std::string kReleaseUrl =
+    "https://firebaserules.googleapis.com/v1/projects/p/releases/"
+    "myservice.com:v1";
 const std::string kAuthToken =
     "eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCJ9.eyJpc3MiOiI2Mjg2NDU3NDE4ODEtbm9hYml1M"
     "jNmNWE4bThvdmQ4dWN2Njk4bGo3OHZ2MGxAZGV2ZWxvcGVyLmdzZXJ2aWNlYWNjb3VudC5jb20"
@@ -42,9 +48,9 @@ class TestAuthzCache : public ::testing::Test {
   void SetUp() {
     now_ = std::chrono::system_clock::now();
     cache_key_ =
-        AuthzCache::ComposeAuthzCacheKey(kAuthToken, kPath, kHTTPMethod);
+        AuthzCache::ComposeAuthzCacheKey(kAuthToken, kPath, kHTTPMethod, "");
     new_cache_key_ =
-        AuthzCache::ComposeAuthzCacheKey(kAuthToken, kPath1, kHTTPMethod);
+        AuthzCache::ComposeAuthzCacheKey(kAuthToken, kPath1, kHTTPMethod, "");
   }
 
   AuthzCache cache_;
@@ -61,6 +67,12 @@ TEST_F(TestAuthzCache, KeyGeneration) {
   ASSERT_EQ(new_cache_key_.length(), 16);
   ASSERT_EQ(new_cache_key_, "\v\xD6\xC3\xD9\x84\"\xF1\x81\xC4\xC5=\x81T^\xDC?");
   ASSERT_NE(cache_key_, new_cache_key_);
+
+  // Service configs with different rules do not share entries.
+  std::string release_cache_key = AuthzCache::ComposeAuthzCacheKey(
+      kAuthToken, kPath, kHTTPMethod, kReleaseUrl);
+  ASSERT_EQ(release_cache_key.length(), 16);
+  ASSERT_NE(cache_key_, release_cache_key);
 }
 
 // Lookup the cache entry that does not exist.
@@ -95,6 +107,42 @@ TEST_F(TestAuthzCache, EntryExistNotExpired) {
   ASSERT_EQ(val.if_success, true);
 }
 
+// The entry lifetime can be configured.
+TEST_F(TestAuthzCache, ConfiguredExpiration) {
+  AuthzCache cache(10, std::chrono::seconds(10));
+  cache.Add(cache_key_, true, now_);
+  AuthzValue val;
+  ASSERT_TRUE(cache.Lookup(cache_key_, now_ + std::chrono::seconds(5), &val));
+  ASSERT_FALSE(cache.Lookup(cache_key_, now_ + std::chrono::seconds(11), &val));
+}
+
+// Checks of a key started while a check of the key is in flight get its
+// result.
+TEST_F(TestAuthzCache, CoalesceChecks) {
+  std::vector<utils::Status> results;
+  auto on_done = [&results](utils::Status status) {
+    results.push_back(status);
+  };
+
+  ASSERT_TRUE(cache_.StartCheck(cache_key_, on_done));
+  ASSERT_FALSE(cache_.StartCheck(cache_key_, on_done));
+  ASSERT_FALSE(cache_.StartCheck(cache_key_, on_done));
+  // Another key is checked separately.
+  ASSERT_TRUE(cache_.StartCheck(new_cache_key_, on_done));
+  ASSERT_TRUE(results.empty());
+
+  cache_.FinishCheck(cache_key_, utils::Status(Code::PERMISSION_DENIED, ""));
+  ASSERT_EQ(results.size(), 2);
+  ASSERT_EQ(results[0].code(), Code::PERMISSION_DENIED);
+  ASSERT_EQ(results[1].code(), Code::PERMISSION_DENIED);
+
+  // The next check of the key runs again.
+  ASSERT_TRUE(cache_.StartCheck(cache_key_, on_done));
+  cache_.FinishCheck(cache_key_, utils::Status::OK);
+  cache_.FinishCheck(new_cache_key_, utils::Status::OK);
+  ASSERT_EQ(results.size(), 2);
+}
+
 }  // namespace
 }  // namespace auth
 }  // namespace api_manager
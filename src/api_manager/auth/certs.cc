@@ -0,0 +1,80 @@
+// Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/api_manager/auth/certs.h"
+
+using std::chrono::system_clock;
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+namespace {
+// The time a failed fetch is not retried, requests keep using the expired
+// cert meanwhile if there is one. Unit: seconds.
+const int kFailedFetchRetryDelay = 10;
+}  // namespace
+
+bool Certs::CanFetch(const std::string& issuer,
+                     system_clock::time_point now) const {
+  if (fetches_.find(issuer) != fetches_.end()) {
+    return false;
+  }
+  auto it = retry_after_.find(issuer);
+  return it == retry_after_.end() || now >= it->second;
+}
+
+bool Certs::StartFetch(const std::string& issuer, FetchCallback callback) {
+  auto it = fetches_.find(issuer);
+  if (it != fetches_.end()) {
+    if (callback) {
+      it->second.push_back(callback);
+      ++statistics_.coalesced_waits;
+    }
+    return false;
+  }
+
+  auto& waiters = fetches_[issuer];
+  if (callback) {
+    waiters.push_back(callback);
+  }
+  ++statistics_.fetches;
+  return true;
+}
+
+void Certs::FetchDone(const std::string& issuer, const utils::Status& status) {
+  if (status.ok()) {
+    retry_after_.erase(issuer);
+  } else {
+    retry_after_[issuer] =
+        system_clock::now() + std::chrono::seconds(kFailedFetchRetryDelay);
+  }
+
+  auto it = fetches_.find(issuer);
+  if (it == fetches_.end()) {
+    return;
+  }
+  // Waiters may start a new fetch of the issuer.
+  std::vector<FetchCallback> waiters = std::move(it->second);
+  fetches_.erase(it);
+  for (const auto& waiter : waiters) {
+    waiter(status);
+  }
+}
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
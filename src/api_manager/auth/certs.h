@@ -16,33 +16,91 @@
 #define API_MANAGER_AUTH_CERTS_H_
 
 #include <chrono>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include "include/api_manager/utils/status.h"
+#include "src/api_manager/auth/lib/public_keys.h"
 
 namespace google {
 namespace api_manager {
 namespace auth {
 
-// A class to manage certs for token validation.
+// A class to manage certs for token validation. The certs are parsed once
+// when they are updated, and verifications use the parsed public keys.
+//
+// It also coordinates the fetches of the certs: at most one fetch per issuer
+// is in flight, and the requests which need the cert of an issuer being
+// fetched wait for that fetch instead of starting their own.
 class Certs {
  public:
+  // Called when the fetch of a cert completes.
+  typedef std::function<void(const utils::Status&)> FetchCallback;
+
+  // Counters of the cert fetches.
+  struct Statistics {
+    // Fetches started.
+    uint64_t fetches;
+    // Requests which waited for a fetch started by another request.
+    uint64_t coalesced_waits;
+    // Fetches started in the background before the cert expired.
+    uint64_t refreshes;
+    // Requests verified with an expired cert which could not be fetched.
+    uint64_t stale_certs_used;
+  };
+
+  Certs() : statistics_() {}
+
   void Update(const std::string& issuer, const std::string& cert,
               std::chrono::system_clock::time_point expiration) {
-    issuer_cert_map_[issuer] = std::make_pair(cert, expiration);
+    std::shared_ptr<const PublicKeys> keys(
+        PublicKeys::Create(cert.data(), cert.size()));
+    issuer_cert_map_[issuer] = std::make_pair(keys, expiration);
   }
 
-  const std::pair<std::string, std::chrono::system_clock::time_point>* GetCert(
-      const std::string& iss) {
+  const std::pair<std::shared_ptr<const PublicKeys>,
+                  std::chrono::system_clock::time_point>*
+  GetCert(const std::string& iss) {
     return issuer_cert_map_.find(iss) == issuer_cert_map_.end()
                ? nullptr
                : &(issuer_cert_map_[iss]);
   }
 
+  // Returns true if a fetch of the cert of the issuer can be started now:
+  // there is no fetch in flight, and the last fetch did not fail recently.
+  bool CanFetch(const std::string& issuer,
+                std::chrono::system_clock::time_point now) const;
+
+  // Adds the callback to the waiters of the fetch of the cert of the issuer.
+  // Returns true if there was no fetch in flight: the caller must then fetch
+  // the cert and call FetchDone. Otherwise, the callback is called when the
+  // fetch in flight completes. The callback may be empty.
+  bool StartFetch(const std::string& issuer, FetchCallback callback);
+
+  // Completes the fetch of the cert of the issuer, and calls its waiters.
+  void FetchDone(const std::string& issuer, const utils::Status& status);
+
+  Statistics* mutable_statistics() { return &statistics_; }
+  const Statistics& statistics() const { return statistics_; }
+
  private:
-  // Map from issuer to a verification key and its absolute expiration time.
-  std::map<std::string,
-           std::pair<std::string, std::chrono::system_clock::time_point> >
+  // Map from issuer to the parsed verification keys and their absolute
+  // expiration time.
+  std::map<std::string, std::pair<std::shared_ptr<const PublicKeys>,
+                                  std::chrono::system_clock::time_point> >
       issuer_cert_map_;
+
+  // Map from issuer to the waiters of its fetch in flight.
+  std::map<std::string, std::vector<FetchCallback> > fetches_;
+
+  // Map from issuer to the time before which a failed fetch is not retried.
+  std::map<std::string, std::chrono::system_clock::time_point> retry_after_;
+
+  Statistics statistics_;
 };
 
 }  // namespace auth
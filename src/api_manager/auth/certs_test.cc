@@ -0,0 +1,94 @@
+// Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/api_manager/auth/certs.h"
+#include "gtest/gtest.h"
+
+using std::chrono::system_clock;
+using ::google::api_manager::utils::Status;
+using ::google::protobuf::util::error::Code;
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+namespace {
+
+const char kIssuer[] = "iss1";
+const char kOtherIssuer[] = "iss2";
+
+TEST(CertsTest, FetchesAreCoalesced) {
+  Certs certs;
+  std::vector<Status> results;
+  auto callback = [&results](const Status &status) {
+    results.push_back(status);
+  };
+
+  EXPECT_TRUE(certs.CanFetch(kIssuer, system_clock::now()));
+  EXPECT_TRUE(certs.StartFetch(kIssuer, callback));
+  EXPECT_FALSE(certs.CanFetch(kIssuer, system_clock::now()));
+  EXPECT_FALSE(certs.StartFetch(kIssuer, callback));
+  EXPECT_FALSE(certs.StartFetch(kIssuer, callback));
+  // Fetches of other issuers are independent.
+  EXPECT_TRUE(certs.StartFetch(kOtherIssuer, nullptr));
+  EXPECT_TRUE(results.empty());
+
+  certs.FetchDone(kIssuer, Status::OK);
+  ASSERT_EQ(3, results.size());
+  for (const auto &status : results) {
+    EXPECT_TRUE(status.ok());
+  }
+  EXPECT_TRUE(certs.CanFetch(kIssuer, system_clock::now()));
+
+  EXPECT_EQ(2, certs.statistics().fetches);
+  EXPECT_EQ(2, certs.statistics().coalesced_waits);
+}
+
+TEST(CertsTest, FailedFetchIsNotRetriedImmediately) {
+  Certs certs;
+  Status result = Status::OK;
+  EXPECT_TRUE(certs.StartFetch(
+      kIssuer, [&result](const Status &status) { result = status; }));
+
+  certs.FetchDone(kIssuer, Status(Code::UNAVAILABLE, "failed"));
+  EXPECT_EQ(Code::UNAVAILABLE, result.code());
+  EXPECT_FALSE(certs.CanFetch(kIssuer, system_clock::now()));
+  EXPECT_TRUE(
+      certs.CanFetch(kIssuer, system_clock::now() + std::chrono::minutes(1)));
+
+  // A successful fetch clears the retry delay.
+  EXPECT_TRUE(certs.StartFetch(kIssuer, nullptr));
+  certs.FetchDone(kIssuer, Status::OK);
+  EXPECT_TRUE(certs.CanFetch(kIssuer, system_clock::now()));
+}
+
+TEST(CertsTest, WaiterCanStartNewFetch) {
+  Certs certs;
+  bool restarted = false;
+  EXPECT_TRUE(certs.StartFetch(kIssuer, [&certs, &restarted](const Status &) {
+    restarted = certs.StartFetch(kIssuer, nullptr);
+  }));
+
+  certs.FetchDone(kIssuer, Status::OK);
+  EXPECT_TRUE(restarted);
+  EXPECT_FALSE(certs.CanFetch(kIssuer, system_clock::now()));
+}
+
+}  // namespace
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,75 @@
+// Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/api_manager/auth/firebase_release_cache.h"
+
+#include <algorithm>
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+namespace {
+// The default time a ruleset name is fresh. Unit: seconds.
+const int kReleaseCacheTimeout = 60;
+// The time after which a refresh is considered lost and another refresh is
+// asked for. Unit: seconds.
+const int kRefreshRetryInterval = 5;
+}  // namespace
+
+FirebaseReleaseCache::FirebaseReleaseCache(
+    std::chrono::milliseconds expiration)
+    : expiration_(expiration.count() > 0
+                      ? expiration
+                      : std::chrono::seconds(kReleaseCacheTimeout)) {}
+
+FirebaseReleaseCache::LookupResult FirebaseReleaseCache::Lookup(
+    const std::string& release_url,
+    const std::chrono::system_clock::time_point& now,
+    std::string* ruleset_name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(release_url);
+  if (it == entries_.end()) {
+    return MISS;
+  }
+  Entry& entry = it->second;
+  if (now >= entry.fetched_at + 2 * expiration_) {
+    entries_.erase(it);
+    return MISS;
+  }
+  *ruleset_name = entry.ruleset_name;
+  if (now < entry.refresh_at) {
+    return HIT;
+  }
+  entry.refresh_at =
+      now + std::min<std::chrono::milliseconds>(
+                expiration_, std::chrono::seconds(kRefreshRetryInterval));
+  return REFRESH;
+}
+
+void FirebaseReleaseCache::Add(
+    const std::string& release_url, const std::string& ruleset_name,
+    const std::chrono::system_clock::time_point& now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = entries_[release_url];
+  entry.ruleset_name = ruleset_name;
+  entry.fetched_at = now;
+  entry.refresh_at = now + expiration_;
+}
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
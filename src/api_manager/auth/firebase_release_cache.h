@@ -0,0 +1,78 @@
+/* Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_AUTH_FIREBASE_RELEASE_CACHE_H_
+#define API_MANAGER_AUTH_FIREBASE_RELEASE_CACHE_H_
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+// A cache of the ruleset names of the Firebase releases, keyed by release
+// URL. A release is rarely updated, so its ruleset name is used for the
+// expiration time and then refreshed in the background: the stale name is
+// still used while the refresh is in flight, and for up to another
+// expiration time if the refresh fails.
+//
+// There is one release per service config, so the cache is not bounded.
+class FirebaseReleaseCache {
+ public:
+  enum LookupResult {
+    // No usable ruleset name is cached.
+    MISS,
+    // The ruleset name is fresh.
+    HIT,
+    // The ruleset name is stale, the caller should refresh it.
+    REFRESH,
+  };
+
+  // Creates a cache whose entries are fresh for expiration, the default is
+  // used for values <= 0.
+  explicit FirebaseReleaseCache(std::chrono::milliseconds expiration);
+
+  // Looks up the ruleset name of the release. A stale entry is only reported
+  // as REFRESH to one caller at a time, a few seconds apart, so that a
+  // single refresh is in flight.
+  LookupResult Lookup(const std::string& release_url,
+                      const std::chrono::system_clock::time_point& now,
+                      std::string* ruleset_name);
+
+  // Stores the ruleset name of the release, fetched at now.
+  void Add(const std::string& release_url, const std::string& ruleset_name,
+           const std::chrono::system_clock::time_point& now);
+
+ private:
+  struct Entry {
+    std::string ruleset_name;
+    std::chrono::system_clock::time_point fetched_at;
+    // When the next lookup should refresh the entry.
+    std::chrono::system_clock::time_point refresh_at;
+  };
+
+  std::chrono::milliseconds expiration_;
+
+  std::mutex mutex_;
+  std::map<std::string, Entry> entries_;
+};
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_AUTH_FIREBASE_RELEASE_CACHE_H_
@@ -0,0 +1,94 @@
+// Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/api_manager/auth/firebase_release_cache.h"
+#include "gtest/gtest.h"
+
+namespace google {
+namespace api_manager {
+namespace auth {
+namespace {
+
+const char kReleaseUrl[] =
+    "https://firebaserules.googleapis.com/v1/projects/p/releases/"
+    "myservice.com:v1";
+const char kRulesetName[] = "projects/p/rulesets/1234";
+
+class FirebaseReleaseCacheTest : public ::testing::Test {
+ public:
+  FirebaseReleaseCacheTest()
+      : cache_(std::chrono::seconds(60)),
+        now_(std::chrono::system_clock::now()) {}
+
+  FirebaseReleaseCache cache_;
+  std::chrono::system_clock::time_point now_;
+};
+
+TEST_F(FirebaseReleaseCacheTest, Miss) {
+  std::string ruleset_name;
+  ASSERT_EQ(FirebaseReleaseCache::MISS,
+            cache_.Lookup(kReleaseUrl, now_, &ruleset_name));
+}
+
+TEST_F(FirebaseReleaseCacheTest, Hit) {
+  cache_.Add(kReleaseUrl, kRulesetName, now_);
+  std::string ruleset_name;
+  ASSERT_EQ(FirebaseReleaseCache::HIT,
+            cache_.Lookup(kReleaseUrl, now_ + std::chrono::seconds(59),
+                          &ruleset_name));
+  ASSERT_EQ(kRulesetName, ruleset_name);
+}
+
+// A stale entry is refreshed by one caller, the others keep using it.
+TEST_F(FirebaseReleaseCacheTest, Refresh) {
+  cache_.Add(kReleaseUrl, kRulesetName, now_);
+  std::string ruleset_name;
+  ASSERT_EQ(FirebaseReleaseCache::REFRESH,
+            cache_.Lookup(kReleaseUrl, now_ + std::chrono::seconds(60),
+                          &ruleset_name));
+  ASSERT_EQ(kRulesetName, ruleset_name);
+  ASSERT_EQ(FirebaseReleaseCache::HIT,
+            cache_.Lookup(kReleaseUrl, now_ + std::chrono::seconds(61),
+                          &ruleset_name));
+
+  // The refresh was lost, asks for another one.
+  ASSERT_EQ(FirebaseReleaseCache::REFRESH,
+            cache_.Lookup(kReleaseUrl, now_ + std::chrono::seconds(65),
+                          &ruleset_name));
+
+  // Refreshed.
+  cache_.Add(kReleaseUrl, "projects/p/rulesets/5678",
+             now_ + std::chrono::seconds(66));
+  ASSERT_EQ(FirebaseReleaseCache::HIT,
+            cache_.Lookup(kReleaseUrl, now_ + std::chrono::seconds(120),
+                          &ruleset_name));
+  ASSERT_EQ("projects/p/rulesets/5678", ruleset_name);
+}
+
+// An entry which could not be refreshed is dropped after twice the
+// expiration time.
+TEST_F(FirebaseReleaseCacheTest, Expired) {
+  cache_.Add(kReleaseUrl, kRulesetName, now_);
+  std::string ruleset_name;
+  ASSERT_EQ(FirebaseReleaseCache::MISS,
+            cache_.Lookup(kReleaseUrl, now_ + std::chrono::seconds(120),
+                          &ruleset_name));
+}
+
+}  // namespace
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
@@ -16,6 +16,14 @@
 //
 #include "src/api_manager/auth/jwt_cache.h"
 
+#include <openssl/sha.h>
+#include <string.h>
+
+#include "src/api_manager/auth/lib/auth_token.h"
+#include "src/api_manager/auth/lib/base64.h"
+#include "src/api_manager/auth/lib/json.h"
+#include "src/api_manager/utils/url_util.h"
+
 using ::google::service_control_client::SimpleLRUCache;
 using std::chrono::system_clock;
 
@@ -36,14 +44,45 @@ JwtCache::JwtCache() : SimpleLRUCache<std::string, JwtValue>(kJwtCacheSize) {}
 
 JwtCache::~JwtCache() { Clear(); }
 
-void JwtCache::Insert(const std::string& jwt, const UserInfo& user_info,
+std::string JwtCache::Key(const std::string& jwt) {
+  unsigned char digest[SHA256_DIGEST_LENGTH];
+  SHA256(reinterpret_cast<const unsigned char*>(jwt.data()), jwt.size(),
+         digest);
+  return std::string(reinterpret_cast<const char*>(digest), sizeof(digest));
+}
+
+std::unique_ptr<JwtValue> JwtCache::CreateValue(const UserInfo& user_info) {
+  std::unique_ptr<JwtValue> value(new JwtValue());
+  value->user_info = user_info;
+  if (!user_info.audiences.empty()) {
+    value->audience = user_info.AudiencesAsString();
+  }
+  value->normalized_issuer = utils::GetUrlContent(user_info.issuer);
+  for (const auto& audience : user_info.audiences) {
+    value->normalized_audiences.insert(utils::GetUrlContent(audience));
+  }
+
+  char* json_buf = WriteUserInfoToJson(user_info);
+  if (json_buf != nullptr) {
+    char* base64_json_buf = esp_base64_encode(
+        json_buf, strlen(json_buf), true, false, true /*padding*/);
+    if (base64_json_buf != nullptr) {
+      value->user_info_header = base64_json_buf;
+      esp_grpc_free(base64_json_buf);
+    }
+    esp_grpc_free(json_buf);
+  }
+  return value;
+}
+
+void JwtCache::Insert(const std::string& key, std::unique_ptr<JwtValue> value,
+                      const std::string& keys_id,
                       const system_clock::time_point& token_exp,
                       const system_clock::time_point& now) {
-  JwtValue* newval = new JwtValue();
-  newval->user_info = user_info;
-  newval->exp =
+  value->keys_id = keys_id;
+  value->exp =
       std::min(token_exp, now + std::chrono::seconds(kJwtCacheTimeout));
-  SimpleLRUCache::Insert(jwt, newval, 1);
+  SimpleLRUCache::Insert(key, value.release(), 1);
 }
 
 }  // namespace auth
@@ -16,6 +16,8 @@
 #define API_MANAGER_AUTH_JWT_CACHE_H_
 
 #include <chrono>
+#include <memory>
+#include <set>
 #include <string>
 
 #include "src/api_manager/auth.h"
@@ -25,18 +27,36 @@ namespace google {
 namespace api_manager {
 namespace auth {
 
-// The value of a JwtCache entry.
+// The value of a JwtCache entry. Besides the user info, it keeps what the
+// requests with the JWT derive from it, so that a cache hit does not derive
+// it again.
 struct JwtValue {
   // User info extracted from the JWT.
   UserInfo user_info;
 
+  // The audiences as a comma separated string, empty if there are none.
+  std::string audience;
+
+  // The issuer and the audiences without their http(s) scheme and trailing
+  // '/', see utils::GetUrlContent().
+  std::string normalized_issuer;
+  std::set<std::string> normalized_audiences;
+
+  // The value of the X-Endpoint-API-UserInfo header sent to the backend:
+  // the base64 encoded JSON of the user info.
+  std::string user_info_header;
+
+  // The id of the keys which verified the JWT, see Config::GetKeysId().
+  std::string keys_id;
+
   // Expiration time of the cache entry. This is the minimum of "exp" field in
   // the JWT and [the time this cache entry is added + kJwtCacheTimeout].
   std::chrono::system_clock::time_point exp;
 };
 
-// A local cache that resides in ESP. The key of the cache is a JWT,
-// and the value is of type JwtValue.
+// A local cache that resides in ESP. The key of the cache is the SHA-256
+// digest of a JWT, so that an entry does not keep the whole token, and the
+// value is of type JwtValue.
 class JwtCache
     : public google::service_control_client::SimpleLRUCache<std::string,
                                                             JwtValue> {
@@ -44,7 +64,17 @@ class JwtCache
   JwtCache();
   ~JwtCache();
 
-  void Insert(const std::string& jwt, const UserInfo& user_info,
+  // Returns the key of the JWT in the cache.
+  static std::string Key(const std::string& jwt);
+
+  // Returns a new value with the user info of a JWT and the fields derived
+  // from it. The keys id and the expiration time are set by Insert().
+  static std::unique_ptr<JwtValue> CreateValue(const UserInfo& user_info);
+
+  // Inserts the value of a JWT verified with the given keys, under the key
+  // returned by Key().
+  void Insert(const std::string& key, std::unique_ptr<JwtValue> value,
+              const std::string& keys_id,
               const std::chrono::system_clock::time_point& token_exp,
               const std::chrono::system_clock::time_point& now);
 };
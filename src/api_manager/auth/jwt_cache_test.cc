@@ -16,6 +16,7 @@
 //
 #include "src/api_manager/auth/jwt_cache.h"
 #include <memory>
+#include <set>
 #include "gtest/gtest.h"
 
 using std::chrono::system_clock;
@@ -30,6 +31,7 @@ const char kId[] = "user1";
 const char kEmail[] = "user1@gmail.com";
 const char kConsumer[] = "consumer1";
 const char kIssuer[] = "iss1";
+const char kKeysId[] = "iss1\nhttps://iss1/jwks";
 const char kJwt[] =
     "eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCJ9.eyJpc3MiOiI2Mjg2NDU3NDE4ODEtbm9hYml1M"
     "jNmNWE4bThvdmQ4dWN2Njk4bGo3OHZ2MGxAZGV2ZWxvcGVyLmdzZXJ2aWNlYWNjb3VudC5jb20"
@@ -51,7 +53,8 @@ class TestJwtCache : public ::testing::Test {
 
 // Test the Insert function in JwtCache class.
 void InsertAndLookupImpl(JwtCache *cache, bool token_exp_earlier) {
-  ASSERT_EQ(nullptr, cache->Lookup(kJwt));
+  const std::string key = JwtCache::Key(kJwt);
+  ASSERT_EQ(nullptr, cache->Lookup(key));
 
   UserInfo user_info;
   user_info.id = kId;
@@ -68,23 +71,25 @@ void InsertAndLookupImpl(JwtCache *cache, bool token_exp_earlier) {
   } else {
     token_exp = now + std::chrono::seconds(kJwtCacheTimeout + 1);
   }
-  cache->Insert(kJwt, user_info, token_exp, now);
-  JwtValue *val = cache->Lookup(kJwt);
+  cache->Insert(key, JwtCache::CreateValue(user_info), kKeysId, token_exp,
+                now);
+  JwtValue *val = cache->Lookup(key);
   ASSERT_NE(nullptr, val);
   ASSERT_EQ(val->user_info.id, kId);
   ASSERT_EQ(val->user_info.email, kEmail);
   ASSERT_EQ(val->user_info.consumer_id, kConsumer);
   ASSERT_EQ(val->user_info.issuer, kIssuer);
   ASSERT_EQ(val->user_info.AudiencesAsString(), "aud1,aud2");
+  ASSERT_EQ(val->keys_id, kKeysId);
   if (token_exp_earlier) {
     ASSERT_EQ(val->exp, token_exp);
   } else {
     ASSERT_EQ(val->exp, now + std::chrono::seconds(kJwtCacheTimeout));
   }
 
-  cache->Release(kJwt, val);
-  cache->Remove(kJwt);
-  ASSERT_EQ(nullptr, cache->Lookup(kJwt));
+  cache->Release(key, val);
+  cache->Remove(key);
+  ASSERT_EQ(nullptr, cache->Lookup(key));
 }
 
 TEST_F(TestJwtCache, InsertAndLookUp) {
@@ -95,6 +100,36 @@ TEST_F(TestJwtCache, InsertAndLookUp) {
   InsertAndLookupImpl(cache_.get(), false);
 }
 
+TEST_F(TestJwtCache, Key) {
+  const std::string key = JwtCache::Key(kJwt);
+  ASSERT_EQ(32u, key.size());
+  ASSERT_EQ(key, JwtCache::Key(kJwt));
+  ASSERT_NE(key, JwtCache::Key(std::string(kJwt) + "x"));
+}
+
+TEST_F(TestJwtCache, CreateValue) {
+  UserInfo user_info;
+  user_info.id = kId;
+  user_info.email = kEmail;
+  user_info.issuer = "https://iss1/";
+  user_info.audiences.insert("https://aud1");
+  user_info.audiences.insert("aud2/");
+
+  std::unique_ptr<JwtValue> val = JwtCache::CreateValue(user_info);
+  ASSERT_EQ(val->user_info.id, kId);
+  ASSERT_EQ(val->audience, "aud2/,https://aud1");
+  ASSERT_EQ(val->normalized_issuer, "iss1");
+  ASSERT_EQ(val->normalized_audiences,
+            std::set<std::string>({"aud1", "aud2"}));
+  ASSERT_FALSE(val->user_info_header.empty());
+
+  // The audience is empty if the JWT has none.
+  user_info.audiences.clear();
+  val = JwtCache::CreateValue(user_info);
+  ASSERT_TRUE(val->audience.empty());
+  ASSERT_TRUE(val->normalized_audiences.empty());
+}
+
 }  // namespace
 
 }  // namespace auth
@@ -90,6 +90,7 @@ class JwtValidatorImpl : public JwtValidator {
   JwtValidatorImpl(const char *jwt, size_t jwt_len);
   Status Parse(UserInfo *user_info);
   Status VerifySignature(const char *pkey, size_t pkey_len);
+  Status VerifySignature(const PublicKeys &keys);
   system_clock::time_point &GetExpirationTime() { return exp_; }
   ~JwtValidatorImpl();
 
@@ -99,8 +100,7 @@ class JwtValidatorImpl : public JwtValidator {
                                     const char *pkey, size_t pkey_len,
                                     const char *aud);
   grpc_jwt_verifier_status ParseImpl();
-  grpc_jwt_verifier_status VerifySignatureImpl(const char *pkey,
-                                               size_t pkey_len);
+  grpc_jwt_verifier_status VerifySignatureImpl(const PublicKeys &keys);
   // Parses the audiences and removes the audiences from the json object.
   void UpdateAudience(grpc_json *json);
 
@@ -109,29 +109,15 @@ class JwtValidatorImpl : public JwtValidator {
   // Checks required fields and fills User Info from claims_.
   // And sets expiration time to exp_.
   grpc_jwt_verifier_status FillUserInfoAndSetExp(UserInfo *user_info);
-  // Finds the public key and verifies JWT signature with it.
-  grpc_jwt_verifier_status FindAndVerifySignature();
-  // Extracts the public key from x509 string (key) and sets it to pkey_.
-  // Returns true if successful.
-  bool ExtractPubkeyFromX509(const char *key);
-  // Extracts the public key from a jwk key (jkey) and sets it to pkey_.
-  // Returns true if successful.
-  bool ExtractPubkeyFromJwk(const grpc_json *jkey);
-  bool ExtractPubkeyFromJwkRSA(const grpc_json *jkey);
-  bool ExtractPubkeyFromJwkEC(const grpc_json *jkey);
-  // Extracts the public key from jwk key set and verifies JWT signature with
-  // it.
-  grpc_jwt_verifier_status ExtractAndVerifyJwkKeys(const grpc_json *jwt_keys);
-  // Extracts the public key from pkey_json_ and verifies JWT signature with
-  // it.
-  grpc_jwt_verifier_status ExtractAndVerifyX509Keys();
+  // Returns true if the key can verify signatures of the JWT algorithm.
+  bool KeyMatchesAlg(const PublicKeys::Key &key);
   // Verifies signature with public key.
-  grpc_jwt_verifier_status VerifyPubkey();
-  grpc_jwt_verifier_status VerifyPubkeyRSA();
-  grpc_jwt_verifier_status VerifyPubkeyEC();
-  // Verifies asymmetric signature, including RS256/384/512 and ES256.
-  grpc_jwt_verifier_status VerifyAsymSignature(const char *pkey,
-                                               size_t pkey_len);
+  grpc_jwt_verifier_status VerifyPubkey(const PublicKeys::Key &key);
+  grpc_jwt_verifier_status VerifyPubkeyRSA(EVP_PKEY *pkey);
+  grpc_jwt_verifier_status VerifyPubkeyEC(EC_KEY *eck);
+  // Finds the public key and verifies asymmetric signature with it, including
+  // RS256/384/512 and ES256.
+  grpc_jwt_verifier_status VerifyAsymSignature(const PublicKeys &keys);
   // Verifies HS (symmetric) signature.
   grpc_jwt_verifier_status VerifyHsSignature(const char *pkey, size_t pkey_len);
 
@@ -149,14 +135,8 @@ class JwtValidatorImpl : public JwtValidator {
   std::set<std::string> audiences_;
   system_clock::time_point exp_;
 
-  grpc_json *pkey_json_;
   grpc_slice pkey_buffer_;
-  BIO *bio_;
-  X509 *x509_;
-  RSA *rsa_;
-  EVP_PKEY *pkey_;
   EVP_MD_CTX *md_ctx_;
-  EC_KEY *eck_;
   ECDSA_SIG *ecdsa_sig_;
   grpc_exec_ctx exec_ctx_;
 };
@@ -171,10 +151,6 @@ size_t HashSizeFromAlg(const char *alg);
 grpc_json *DecodeBase64AndParseJson(grpc_exec_ctx *exec_ctx, const char *str,
                                     size_t len, grpc_slice *buffer);
 
-// Gets BIGNUM from b64 string, used for extracting pkey from jwk.
-// Result owned by rsa_.
-BIGNUM *BigNumFromBase64String(grpc_exec_ctx *exec_ctx, const char *b64);
-
 }  // namespace
 
 std::unique_ptr<JwtValidator> JwtValidator::Create(const char *jwt,
@@ -189,13 +165,7 @@ JwtValidatorImpl::JwtValidatorImpl(const char *jwt, size_t jwt_len)
       header_(nullptr),
       header_json_(nullptr),
       claims_(nullptr),
-      pkey_json_(nullptr),
-      bio_(nullptr),
-      x509_(nullptr),
-      rsa_(nullptr),
-      pkey_(nullptr),
       md_ctx_(nullptr),
-      eck_(nullptr),
       ecdsa_sig_(nullptr),
       exec_ctx_(GRPC_EXEC_CTX_INIT) {
   header_buffer_ = grpc_empty_slice();
@@ -212,9 +182,6 @@ JwtValidatorImpl::~JwtValidatorImpl() {
   if (header_json_ != nullptr) {
     grpc_json_destroy(header_json_);
   }
-  if (pkey_json_ != nullptr) {
-    grpc_json_destroy(pkey_json_);
-  }
   if (claims_ != nullptr) {
     grpc_jwt_claims_destroy(&exec_ctx_, claims_);
   }
@@ -230,24 +197,9 @@ JwtValidatorImpl::~JwtValidatorImpl() {
   if (!GRPC_SLICE_IS_EMPTY(pkey_buffer_)) {
     grpc_slice_unref(pkey_buffer_);
   }
-  if (bio_ != nullptr) {
-    BIO_free(bio_);
-  }
-  if (x509_ != nullptr) {
-    X509_free(x509_);
-  }
-  if (rsa_ != nullptr) {
-    RSA_free(rsa_);
-  }
-  if (pkey_ != nullptr) {
-    EVP_PKEY_free(pkey_);
-  }
   if (md_ctx_ != nullptr) {
     EVP_MD_CTX_destroy(md_ctx_);
   }
-  if (eck_ != nullptr) {
-    EC_KEY_free(eck_);
-  }
   if (ecdsa_sig_ != nullptr) {
     ECDSA_SIG_free(ecdsa_sig_);
   }
@@ -402,7 +354,14 @@ grpc_jwt_verifier_status JwtValidatorImpl::ParseImpl() {
 }
 
 Status JwtValidatorImpl::VerifySignature(const char *pkey, size_t pkey_len) {
-  grpc_jwt_verifier_status status = VerifySignatureImpl(pkey, pkey_len);
+  if (pkey == nullptr) {
+    return VerifySignature(*PublicKeys::Create("", 0));
+  }
+  return VerifySignature(*PublicKeys::Create(pkey, pkey_len));
+}
+
+Status JwtValidatorImpl::VerifySignature(const PublicKeys &keys) {
+  grpc_jwt_verifier_status status = VerifySignatureImpl(keys);
   if (status == GRPC_JWT_VERIFIER_OK) {
     return Status::OK;
   } else {
@@ -412,8 +371,8 @@ Status JwtValidatorImpl::VerifySignature(const char *pkey, size_t pkey_len) {
 }
 
 grpc_jwt_verifier_status JwtValidatorImpl::VerifySignatureImpl(
-    const char *pkey, size_t pkey_len) {
-  if (pkey == nullptr || pkey_len <= 0) {
+    const PublicKeys &keys) {
+  if (keys.raw().empty()) {
     return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
   }
   if (jwt == nullptr || jwt_len <= 0) {
@@ -424,9 +383,9 @@ grpc_jwt_verifier_status JwtValidatorImpl::VerifySignatureImpl(
   }
   if (strncmp(header_->alg, "ES256", 5) == 0 ||
       strncmp(header_->alg, "RS", 2) == 0) {  // Asymmetric keys.
-    return VerifyAsymSignature(pkey, pkey_len);
+    return VerifyAsymSignature(keys);
   } else {  // Symmetric key.
-    return VerifyHsSignature(pkey, pkey_len);
+    return VerifyHsSignature(keys.raw().data(), keys.raw().size());
   }
 }
 
@@ -452,158 +411,49 @@ void JwtValidatorImpl::CreateJoseHeader() {
   header_->kid = GetStringValue(header_json_, "kid");
 }
 
-grpc_jwt_verifier_status JwtValidatorImpl::FindAndVerifySignature() {
-  if (pkey_json_ == nullptr) {
-    gpr_log(GPR_ERROR, "The public keys are empty.");
+grpc_jwt_verifier_status JwtValidatorImpl::VerifyAsymSignature(
+    const PublicKeys &keys) {
+  if (keys.format() == PublicKeys::UNKNOWN) {
+    gpr_log(GPR_ERROR, "The public keys are not valid JSON.");
     return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
   }
-
   if (header_ == nullptr) {
     gpr_log(GPR_ERROR, "JWT header is empty.");
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
-  // JWK set https://tools.ietf.org/html/rfc7517#section-5.
-  const grpc_json *jwk_keys = GetProperty(pkey_json_, "keys");
-  if (jwk_keys == nullptr) {
-    // Currently we only support JWK format for ES256.
-    if (strncmp(header_->alg, "ES256", 5) == 0) {
-      return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
-    }
-    // Try x509 format.
-    return ExtractAndVerifyX509Keys();
-  } else {
-    // JWK format.
-    return ExtractAndVerifyJwkKeys(jwk_keys);
+  // Currently we only support JWK format for ES256.
+  if (keys.format() == PublicKeys::X509 &&
+      strncmp(header_->alg, "ES256", 5) == 0) {
+    return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
   }
-}
 
-grpc_jwt_verifier_status JwtValidatorImpl::ExtractAndVerifyX509Keys() {
-  // Precondition (checked by caller): pkey_json_ and header_ are not nullptr.
   if (header_->kid != nullptr) {
-    const char *value = GetStringValue(pkey_json_, header_->kid);
-    if (value == nullptr) {
-      gpr_log(GPR_ERROR,
-              "Cannot find matching key in key set for kid=%s and alg=%s",
-              header_->kid, header_->alg);
-      return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
-    }
-    if (!ExtractPubkeyFromX509(value)) {
-      gpr_log(GPR_ERROR, "Failed to extract public key from X509 key (%s)",
-              header_->kid);
-      return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
-    }
-    return VerifyPubkey();
-  }
-  // If kid is not specified in the header, try all keys. If the JWT can be
-  // validated with any of the keys, the request is successful.
-  const grpc_json *cur;
-  if (pkey_json_->child == nullptr) {
-    gpr_log(GPR_ERROR, "Failed to extract public key from X509 key (%s)",
-            header_->kid);
-    return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
-  }
-  for (cur = pkey_json_->child; cur != nullptr; cur = cur->next) {
-    if (cur->value == nullptr || !ExtractPubkeyFromX509(cur->value)) {
-      // Failed to extract public key from current X509 key, try next one.
-      continue;
-    }
-    if (VerifyPubkey() == GRPC_JWT_VERIFIER_OK) {
-      return GRPC_JWT_VERIFIER_OK;
+    const std::vector<const PublicKeys::Key *> *kid_keys =
+        keys.Find(header_->kid);
+    if (kid_keys != nullptr) {
+      for (const PublicKeys::Key *key : *kid_keys) {
+        if (KeyMatchesAlg(*key)) {
+          return VerifyPubkey(*key);
+        }
+      }
     }
-  }
-  // header_->kid is nullptr. The JWT cannot be validated with any of the keys.
-  // Return error.
-  gpr_log(GPR_ERROR,
-          "The JWT cannot be validated with any of the public keys.");
-  return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
-}
-
-bool JwtValidatorImpl::ExtractPubkeyFromX509(const char *key) {
-  if (bio_ != nullptr) {
-    BIO_free(bio_);
-  }
-  bio_ = BIO_new(BIO_s_mem());
-  if (bio_ == nullptr) {
-    gpr_log(GPR_ERROR, "Unable to allocate a BIO object.");
-    return false;
-  }
-  if (BIO_write(bio_, key, strlen(key)) <= 0) {
-    gpr_log(GPR_ERROR, "BIO write error for key (%s).", key);
-    return false;
-  }
-  if (x509_ != nullptr) {
-    X509_free(x509_);
-  }
-  x509_ = PEM_read_bio_X509(bio_, nullptr, nullptr, nullptr);
-  if (x509_ == nullptr) {
-    gpr_log(GPR_ERROR, "Unable to parse x509 cert for key (%s).", key);
-    return false;
-  }
-  if (pkey_ != nullptr) {
-    EVP_PKEY_free(pkey_);
-  }
-  pkey_ = X509_get_pubkey(x509_);
-  if (pkey_ == nullptr) {
-    gpr_log(GPR_ERROR, "X509_get_pubkey failed");
-    return false;
-  }
-  return true;
-}
-
-grpc_jwt_verifier_status JwtValidatorImpl::ExtractAndVerifyJwkKeys(
-    const grpc_json *jwk_keys) {
-  // Precondition (checked by caller): jwk_keys and header_ are not nullptr.
-  if (jwk_keys->type != GRPC_JSON_ARRAY) {
     gpr_log(GPR_ERROR,
-            "Unexpected value type of keys property in jwks key set.");
+            "Cannot find matching key in key set for kid=%s and alg=%s",
+            header_->kid, header_->alg);
     return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
   }
 
-  const grpc_json *jkey = nullptr;
-
-  if (jwk_keys->child == nullptr) {
-    gpr_log(GPR_ERROR, "The jwks key set is empty");
+  // If kid is not specified in the header, try all keys. If the JWT can be
+  // validated with any of the keys, the request is successful.
+  if (keys.keys().empty()) {
+    gpr_log(GPR_ERROR, "The public key set is empty.");
     return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
   }
-
-  // JWK format from https://tools.ietf.org/html/rfc7518#section-6.
-  for (jkey = jwk_keys->child; jkey != nullptr; jkey = jkey->next) {
-    if (jkey->type != GRPC_JSON_OBJECT) continue;
-    const char *kid = GetStringValue(jkey, "kid");
-    if (kid == nullptr ||
-        (header_->kid != nullptr && strcmp(kid, header_->kid) != 0)) {
-      continue;
-    }
-    const char *kty = GetStringValue(jkey, "kty");
-    if (kty == nullptr ||
-        (strncmp(header_->alg, "RS", 2) == 0 && strncmp(kty, "RSA", 3) != 0) ||
-        (strncmp(header_->alg, "ES256", 5) == 0 &&
-         strncmp(kty, "EC", 2) != 0)) {
-      gpr_log(GPR_ERROR, "Missing or unsupported key type %s.", kty);
-      continue;
-    }
-
-    if (!ExtractPubkeyFromJwk(jkey)) {
-      // Failed to extract public key from this Jwk key.
-      continue;
-    }
-
-    if (header_->kid != nullptr) {
-      return VerifyPubkey();
-    }
-    // If kid is not specified in the header, try all keys. If the JWT can be
-    // validated with any of the keys, the request is successful.
-    if (VerifyPubkey() == GRPC_JWT_VERIFIER_OK) {
+  for (const auto &key : keys.keys()) {
+    if (KeyMatchesAlg(*key) && VerifyPubkey(*key) == GRPC_JWT_VERIFIER_OK) {
       return GRPC_JWT_VERIFIER_OK;
     }
   }
-
-  if (header_->kid != nullptr) {
-    gpr_log(GPR_ERROR,
-            "Cannot find matching key in key set for kid=%s and alg=%s",
-            header_->kid, header_->alg);
-    return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
-  }
   // header_->kid is nullptr. The JWT cannot be validated with any of the keys.
   // Return error.
   gpr_log(GPR_ERROR,
@@ -611,108 +461,29 @@ grpc_jwt_verifier_status JwtValidatorImpl::ExtractAndVerifyJwkKeys(
   return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
 }
 
-bool JwtValidatorImpl::ExtractPubkeyFromJwk(const grpc_json *jkey) {
+bool JwtValidatorImpl::KeyMatchesAlg(const PublicKeys::Key &key) {
   if (strncmp(header_->alg, "RS", 2) == 0) {
-    return ExtractPubkeyFromJwkRSA(jkey);
+    return key.type == PublicKeys::KEY_TYPE_RSA && key.pkey != nullptr;
   } else if (strncmp(header_->alg, "ES256", 5) == 0) {
-    return ExtractPubkeyFromJwkEC(jkey);
+    return key.type == PublicKeys::KEY_TYPE_EC && key.ec_key != nullptr;
   } else {
     return false;
   }
 }
 
-bool JwtValidatorImpl::ExtractPubkeyFromJwkRSA(const grpc_json *jkey) {
-  if (rsa_ != nullptr) {
-    RSA_free(rsa_);
-  }
-  rsa_ = RSA_new();
-  if (rsa_ == nullptr) {
-    gpr_log(GPR_ERROR, "Could not create rsa key.");
-    return false;
-  }
-
-  const char *rsa_n = GetStringValue(jkey, "n");
-  rsa_->n =
-      rsa_n == nullptr ? nullptr : BigNumFromBase64String(&exec_ctx_, rsa_n);
-  const char *rsa_e = GetStringValue(jkey, "e");
-  rsa_->e =
-      rsa_e == nullptr ? nullptr : BigNumFromBase64String(&exec_ctx_, rsa_e);
-
-  if (rsa_->e == nullptr || rsa_->n == nullptr) {
-    gpr_log(GPR_ERROR, "Missing RSA public key field.");
-    return false;
-  }
-
-  if (pkey_ != nullptr) {
-    EVP_PKEY_free(pkey_);
-  }
-  pkey_ = EVP_PKEY_new();
-  if (EVP_PKEY_set1_RSA(pkey_, rsa_) == 0) {
-    gpr_log(GPR_ERROR, "EVP_PKEY_ste1_RSA failed");
-    return false;
-  }
-  return true;
-}
-
-bool JwtValidatorImpl::ExtractPubkeyFromJwkEC(const grpc_json *jkey) {
-  if (eck_ != nullptr) {
-    EC_KEY_free(eck_);
-  }
-  eck_ = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
-  if (eck_ == nullptr) {
-    gpr_log(GPR_ERROR, "Could not create ec key.");
-    return false;
-  }
-  const char *eck_x = GetStringValue(jkey, "x");
-  const char *eck_y = GetStringValue(jkey, "y");
-  if (eck_x == nullptr || eck_y == nullptr) {
-    gpr_log(GPR_ERROR, "Missing EC public key field.");
-    return false;
-  }
-  BIGNUM *bn_x = BigNumFromBase64String(&exec_ctx_, eck_x);
-  BIGNUM *bn_y = BigNumFromBase64String(&exec_ctx_, eck_y);
-  if (bn_x == nullptr || bn_y == nullptr) {
-    gpr_log(GPR_ERROR, "Could not generate BIGNUM-type x and y fields.");
-    return false;
-  }
-
-  if (EC_KEY_set_public_key_affine_coordinates(eck_, bn_x, bn_y) == 0) {
-    BN_free(bn_x);
-    BN_free(bn_y);
-    gpr_log(GPR_ERROR, "Could not populate ec key coordinates.");
-    return false;
-  }
-  return true;
-}
-
-grpc_jwt_verifier_status JwtValidatorImpl::VerifyAsymSignature(
-    const char *pkey, size_t pkey_len) {
-  pkey_buffer_ = grpc_slice_from_copied_buffer(pkey, pkey_len);
-  if (GRPC_SLICE_IS_EMPTY(pkey_buffer_)) {
-    return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
-  }
-  pkey_json_ = grpc_json_parse_string_with_len(
-      reinterpret_cast<char *>(GRPC_SLICE_START_PTR(pkey_buffer_)),
-      GRPC_SLICE_LENGTH(pkey_buffer_));
-  if (pkey_json_ == nullptr) {
-    return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
-  }
-
-  return FindAndVerifySignature();
-}
-
-grpc_jwt_verifier_status JwtValidatorImpl::VerifyPubkey() {
+grpc_jwt_verifier_status JwtValidatorImpl::VerifyPubkey(
+    const PublicKeys::Key &key) {
   if (strncmp(header_->alg, "RS", 2) == 0) {
-    return VerifyPubkeyRSA();
+    return VerifyPubkeyRSA(key.pkey);
   } else if (strncmp(header_->alg, "ES256", 5) == 0) {
-    return VerifyPubkeyEC();
+    return VerifyPubkeyEC(key.ec_key);
   } else {
     return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
   }
 }
 
-grpc_jwt_verifier_status JwtValidatorImpl::VerifyPubkeyEC() {
-  if (eck_ == nullptr) {
+grpc_jwt_verifier_status JwtValidatorImpl::VerifyPubkeyEC(EC_KEY *eck) {
+  if (eck == nullptr) {
     gpr_log(GPR_ERROR, "Cannot find eck.");
     return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
   }
@@ -733,15 +504,15 @@ grpc_jwt_verifier_status JwtValidatorImpl::VerifyPubkeyEC() {
 
   BN_bin2bn(GRPC_SLICE_START_PTR(sig_buffer_), 32, ecdsa_sig_->r);
   BN_bin2bn(GRPC_SLICE_START_PTR(sig_buffer_) + 32, 32, ecdsa_sig_->s);
-  if (ECDSA_do_verify(digest, SHA256_DIGEST_LENGTH, ecdsa_sig_, eck_) == 0) {
+  if (ECDSA_do_verify(digest, SHA256_DIGEST_LENGTH, ecdsa_sig_, eck) == 0) {
     gpr_log(GPR_ERROR, "JWT signature verification failed.");
     return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
   }
   return GRPC_JWT_VERIFIER_OK;
 }
 
-grpc_jwt_verifier_status JwtValidatorImpl::VerifyPubkeyRSA() {
-  if (pkey_ == nullptr) {
+grpc_jwt_verifier_status JwtValidatorImpl::VerifyPubkeyRSA(EVP_PKEY *pkey) {
+  if (pkey == nullptr) {
     gpr_log(GPR_ERROR, "Cannot find public key.");
     return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
   }
@@ -756,7 +527,7 @@ grpc_jwt_verifier_status JwtValidatorImpl::VerifyPubkeyRSA() {
   const EVP_MD *md = EvpMdFromAlg(header_->alg);
   GPR_ASSERT(md != nullptr);  // Checked before.
 
-  if (EVP_DigestVerifyInit(md_ctx_, nullptr, md, nullptr, pkey_) != 1) {
+  if (EVP_DigestVerifyInit(md_ctx_, nullptr, md, nullptr, pkey) != 1) {
     gpr_log(GPR_ERROR, "EVP_DigestVerifyInit failed.");
     return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
   }
@@ -887,22 +658,6 @@ grpc_json *DecodeBase64AndParseJson(grpc_exec_ctx *exec_ctx, const char *str,
   return json;
 }
 
-BIGNUM *BigNumFromBase64String(grpc_exec_ctx *exec_ctx, const char *b64) {
-  BIGNUM *result = nullptr;
-  grpc_slice bin;
-
-  if (b64 == nullptr) return nullptr;
-  bin = grpc_base64_decode(exec_ctx, b64, 1);
-  if (GRPC_SLICE_IS_EMPTY(bin)) {
-    gpr_log(GPR_ERROR, "Invalid base64 for big num.");
-    return nullptr;
-  }
-  result =
-      BN_bin2bn(GRPC_SLICE_START_PTR(bin), GRPC_SLICE_LENGTH(bin), nullptr);
-  grpc_slice_unref(bin);
-  return result;
-}
-
 }  // namespace
 }  // namespace auth
 }  // namespace api_manager
@@ -408,6 +408,12 @@ void TestTokenWithPubkey(char *token, const char *pkey) {
   ASSERT_TRUE(status.ok());
   ASSERT_EQ(status.message(), "");
 
+  // Verify with the parsed public keys.
+  std::unique_ptr<PublicKeys> keys = PublicKeys::Create(pkey, strlen(pkey));
+  status = validator->VerifySignature(*keys);
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(status.message(), "");
+
   // Wrong length.
   validator = JwtValidator::Create(token + 1, strlen(token));
   status = validator->Parse(&user_info);
@@ -597,6 +603,62 @@ TEST_F(JwtValidatorTest, WrongKeyEC) {
   ASSERT_EQ(status.message(), "KEY_RETRIEVAL_ERROR") << status.message();
 }
 
+TEST_F(JwtValidatorTest, ParsePublicKeys) {
+  std::unique_ptr<PublicKeys> keys =
+      PublicKeys::Create(kPublicKeyJwk, strlen(kPublicKeyJwk));
+  ASSERT_EQ(PublicKeys::JWKS, keys->format());
+  ASSERT_EQ(2U, keys->keys().size());
+  auto *kid_keys = keys->Find("62a93512c9ee4c7f8067b5a216dade2763d32a47");
+  ASSERT_TRUE(kid_keys != nullptr);
+  ASSERT_EQ(1U, kid_keys->size());
+  ASSERT_EQ(PublicKeys::KEY_TYPE_RSA, (*kid_keys)[0]->type);
+  ASSERT_TRUE((*kid_keys)[0]->pkey != nullptr);
+  ASSERT_TRUE(keys->Find("unknown_kid") == nullptr);
+
+  keys = PublicKeys::Create(kPublicKeyX509, strlen(kPublicKeyX509));
+  ASSERT_EQ(PublicKeys::X509, keys->format());
+  ASSERT_EQ(2U, keys->keys().size());
+  kid_keys = keys->Find("b3319a147514df7ee5e4bcdee51350cc890cc89e");
+  ASSERT_TRUE(kid_keys != nullptr);
+  ASSERT_TRUE((*kid_keys)[0]->pkey != nullptr);
+
+  keys = PublicKeys::Create(kPublicKeyJwkEC, strlen(kPublicKeyJwkEC));
+  ASSERT_EQ(PublicKeys::JWKS, keys->format());
+  kid_keys = keys->Find("1a");
+  ASSERT_TRUE(kid_keys != nullptr);
+  ASSERT_EQ(PublicKeys::KEY_TYPE_EC, (*kid_keys)[0]->type);
+  ASSERT_TRUE((*kid_keys)[0]->ec_key != nullptr);
+
+  // Not a JSON object, e.g. an HS secret.
+  keys = PublicKeys::Create("c2VjcmV0", 8);
+  ASSERT_EQ(PublicKeys::UNKNOWN, keys->format());
+  ASSERT_TRUE(keys->keys().empty());
+}
+
+TEST_F(JwtValidatorTest, ParsedPublicKeysVerifyManyTokens) {
+  std::unique_ptr<PublicKeys> keys =
+      PublicKeys::Create(kPublicKeyJwk, strlen(kPublicKeyJwk));
+  for (int i = 0; i < 3; ++i) {
+    UserInfo user_info;
+    std::unique_ptr<JwtValidator> validator =
+        JwtValidator::Create(kTokenNoKid, strlen(kTokenNoKid));
+    Status status = validator->Parse(&user_info);
+    ASSERT_TRUE(status.ok());
+    status = validator->VerifySignature(*keys);
+    ASSERT_TRUE(status.ok()) << status.message();
+  }
+
+  UserInfo user_info;
+  std::unique_ptr<JwtValidator> validator =
+      JwtValidator::Create(kTokenECWrongKey, strlen(kTokenECWrongKey));
+  Status status = validator->Parse(&user_info);
+  ASSERT_TRUE(status.ok());
+  keys = PublicKeys::Create(kPublicKeyJwkEC, strlen(kPublicKeyJwkEC));
+  status = validator->VerifySignature(*keys);
+  ASSERT_FALSE(status.ok());
+  ASSERT_EQ(status.message(), "KEY_RETRIEVAL_ERROR") << status.message();
+}
+
 }  // namespace
 
 }  // namespace auth
@@ -0,0 +1,240 @@
+// Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/api_manager/auth/lib/public_keys.h"
+
+extern "C" {
+#include <grpc/support/log.h>
+}
+
+#include "grpc_internals.h"
+
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <cstring>
+
+#include "src/api_manager/auth/lib/json_util.h"
+
+namespace google {
+namespace api_manager {
+namespace auth {
+namespace {
+
+// Gets BIGNUM from b64 string, used for extracting pkey from jwk.
+// The caller owns the result.
+BIGNUM *BigNumFromBase64String(grpc_exec_ctx *exec_ctx, const char *b64) {
+  BIGNUM *result = nullptr;
+  grpc_slice bin;
+
+  if (b64 == nullptr) return nullptr;
+  bin = grpc_base64_decode(exec_ctx, b64, 1);
+  if (GRPC_SLICE_IS_EMPTY(bin)) {
+    gpr_log(GPR_ERROR, "Invalid base64 for big num.");
+    return nullptr;
+  }
+  result =
+      BN_bin2bn(GRPC_SLICE_START_PTR(bin), GRPC_SLICE_LENGTH(bin), nullptr);
+  grpc_slice_unref(bin);
+  return result;
+}
+
+// Extracts the public key from a PEM x509 certificate.
+void ParseX509Key(PublicKeys::Key *key, const char *pem) {
+  BIO *bio = BIO_new_mem_buf(const_cast<char *>(pem), strlen(pem));
+  if (bio == nullptr) {
+    gpr_log(GPR_ERROR, "Unable to allocate a BIO object.");
+  } else {
+    X509 *x509 = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr);
+    if (x509 == nullptr) {
+      gpr_log(GPR_ERROR, "Unable to parse x509 cert for key (%s).",
+              key->kid.c_str());
+    } else {
+      key->pkey = X509_get_pubkey(x509);
+      if (key->pkey == nullptr) {
+        gpr_log(GPR_ERROR, "X509_get_pubkey failed");
+      }
+      X509_free(x509);
+    }
+    BIO_free(bio);
+  }
+}
+
+// Extracts the public key from the modulus and exponent of a JWK RSA key.
+void ParseJwkRSA(grpc_exec_ctx *exec_ctx, PublicKeys::Key *key, const char *n,
+                 const char *e) {
+  RSA *rsa = RSA_new();
+  if (rsa == nullptr) {
+    gpr_log(GPR_ERROR, "Could not create rsa key.");
+    return;
+  }
+  rsa->n = BigNumFromBase64String(exec_ctx, n);
+  rsa->e = BigNumFromBase64String(exec_ctx, e);
+  if (rsa->e == nullptr || rsa->n == nullptr) {
+    gpr_log(GPR_ERROR, "Missing RSA public key field.");
+    RSA_free(rsa);
+    return;
+  }
+
+  key->pkey = EVP_PKEY_new();
+  if (key->pkey == nullptr || EVP_PKEY_set1_RSA(key->pkey, rsa) == 0) {
+    gpr_log(GPR_ERROR, "EVP_PKEY_set1_RSA failed");
+    if (key->pkey != nullptr) {
+      EVP_PKEY_free(key->pkey);
+      key->pkey = nullptr;
+    }
+  }
+  RSA_free(rsa);
+}
+
+// Extracts the public key from the coordinates of a JWK EC key.
+void ParseJwkEC(grpc_exec_ctx *exec_ctx, PublicKeys::Key *key, const char *x,
+                const char *y) {
+  if (x == nullptr || y == nullptr) {
+    gpr_log(GPR_ERROR, "Missing EC public key field.");
+    return;
+  }
+  EC_KEY *ec_key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+  if (ec_key == nullptr) {
+    gpr_log(GPR_ERROR, "Could not create ec key.");
+    return;
+  }
+  BIGNUM *bn_x = BigNumFromBase64String(exec_ctx, x);
+  BIGNUM *bn_y = BigNumFromBase64String(exec_ctx, y);
+  if (bn_x == nullptr || bn_y == nullptr) {
+    gpr_log(GPR_ERROR, "Could not generate BIGNUM-type x and y fields.");
+  } else if (EC_KEY_set_public_key_affine_coordinates(ec_key, bn_x, bn_y) ==
+             0) {
+    gpr_log(GPR_ERROR, "Could not populate ec key coordinates.");
+  } else {
+    key->ec_key = ec_key;
+    ec_key = nullptr;
+  }
+  if (bn_x != nullptr) {
+    BN_free(bn_x);
+  }
+  if (bn_y != nullptr) {
+    BN_free(bn_y);
+  }
+  if (ec_key != nullptr) {
+    EC_KEY_free(ec_key);
+  }
+}
+
+}  // namespace
+
+PublicKeys::Key::Key() : type(KEY_TYPE_RSA), pkey(nullptr), ec_key(nullptr) {}
+
+PublicKeys::Key::~Key() {
+  if (pkey != nullptr) {
+    EVP_PKEY_free(pkey);
+  }
+  if (ec_key != nullptr) {
+    EC_KEY_free(ec_key);
+  }
+}
+
+std::unique_ptr<PublicKeys> PublicKeys::Create(const char *pkey,
+                                               size_t pkey_len) {
+  std::unique_ptr<PublicKeys> keys(new PublicKeys(pkey, pkey_len));
+  keys->Parse();
+  return keys;
+}
+
+PublicKeys::PublicKeys(const char *pkey, size_t pkey_len)
+    : raw_(pkey, pkey_len), format_(UNKNOWN) {}
+
+const std::vector<const PublicKeys::Key *> *PublicKeys::Find(
+    const char *kid) const {
+  auto it = kid_index_.find(kid);
+  return it == kid_index_.end() ? nullptr : &it->second;
+}
+
+void PublicKeys::Parse() {
+  if (raw_.empty()) {
+    return;
+  }
+  // grpc_json_parse_string_with_len modifies the buffer, and the parsed
+  // values point into it.
+  std::vector<char> buffer(raw_.begin(), raw_.end());
+  grpc_json *json = grpc_json_parse_string_with_len(buffer.data(),
+                                                    buffer.size());
+  if (json == nullptr) {
+    return;
+  }
+  if (json->type != GRPC_JSON_OBJECT) {
+    grpc_json_destroy(json);
+    return;
+  }
+
+  grpc_exec_ctx exec_ctx = GRPC_EXEC_CTX_INIT;
+  // JWK set https://tools.ietf.org/html/rfc7517#section-5.
+  const grpc_json *jwk_keys = GetProperty(json, "keys");
+  if (jwk_keys == nullptr) {
+    // Try x509 format.
+    format_ = X509;
+    for (const grpc_json *cur = json->child; cur != nullptr; cur = cur->next) {
+      if (cur->type == GRPC_JSON_STRING && cur->key != nullptr &&
+          cur->value != nullptr) {
+        std::unique_ptr<Key> key(new Key());
+        key->kid = cur->key;
+        key->type = KEY_TYPE_RSA;
+        ParseX509Key(key.get(), cur->value);
+        AddKey(std::move(key));
+      }
+    }
+  } else {
+    format_ = JWKS;
+    if (jwk_keys->type != GRPC_JSON_ARRAY) {
+      gpr_log(GPR_ERROR,
+              "Unexpected value type of keys property in jwks key set.");
+    } else {
+      // JWK format from https://tools.ietf.org/html/rfc7518#section-6.
+      for (const grpc_json *jkey = jwk_keys->child; jkey != nullptr;
+           jkey = jkey->next) {
+        if (jkey->type != GRPC_JSON_OBJECT) continue;
+        const char *kid = GetStringValue(jkey, "kid");
+        if (kid == nullptr) continue;
+        const char *kty = GetStringValue(jkey, "kty");
+        std::unique_ptr<Key> key(new Key());
+        key->kid = kid;
+        if (kty != nullptr && strncmp(kty, "RSA", 3) == 0) {
+          key->type = KEY_TYPE_RSA;
+          ParseJwkRSA(&exec_ctx, key.get(), GetStringValue(jkey, "n"),
+                      GetStringValue(jkey, "e"));
+        } else if (kty != nullptr && strncmp(kty, "EC", 2) == 0) {
+          key->type = KEY_TYPE_EC;
+          ParseJwkEC(&exec_ctx, key.get(), GetStringValue(jkey, "x"),
+                     GetStringValue(jkey, "y"));
+        } else {
+          gpr_log(GPR_ERROR, "Missing or unsupported key type %s.", kty);
+          continue;
+        }
+        AddKey(std::move(key));
+      }
+    }
+  }
+  grpc_exec_ctx_finish(&exec_ctx);
+  grpc_json_destroy(json);
+}
+
+void PublicKeys::AddKey(std::unique_ptr<Key> key) {
+  kid_index_[key->kid].push_back(key.get());
+  keys_.push_back(std::move(key));
+}
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
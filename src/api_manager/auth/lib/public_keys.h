@@ -0,0 +1,104 @@
+/* Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_AUTH_LIB_PUBLIC_KEYS_H_
+#define API_MANAGER_AUTH_LIB_PUBLIC_KEYS_H_
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+// The public keys of an issuer, parsed from the key document once so that
+// verifying a JWT signature does not have to parse it again.
+//
+// Supports public keys in x509 format (a JSON object mapping key ids to PEM
+// certificates) or JWK set format (https://tools.ietf.org/html/rfc7517).
+// The raw document is kept as well, it is the secret of the HS algorithms.
+class PublicKeys {
+ public:
+  enum Format {
+    // The document is not a JSON object: it can only be an HS secret.
+    UNKNOWN,
+    X509,
+    JWKS,
+  };
+
+  enum KeyType {
+    KEY_TYPE_RSA,
+    KEY_TYPE_EC,
+  };
+
+  // A parsed public key. Owns its OpenSSL objects.
+  struct Key {
+    Key();
+    ~Key();
+
+    // The key id.
+    std::string kid;
+    KeyType type;
+    // The key used for RS signatures, nullptr if the key could not be parsed.
+    EVP_PKEY *pkey;
+    // The key used for ES256 signatures, nullptr if the key could not be
+    // parsed.
+    EC_KEY *ec_key;
+
+   private:
+    Key(const Key &) = delete;
+    Key &operator=(const Key &) = delete;
+  };
+
+  // Parses the key document.
+  static std::unique_ptr<PublicKeys> Create(const char *pkey, size_t pkey_len);
+
+  Format format() const { return format_; }
+
+  // The raw key document.
+  const std::string &raw() const { return raw_; }
+
+  // All the keys, in the document order.
+  const std::vector<std::unique_ptr<Key>> &keys() const { return keys_; }
+
+  // The keys with the given key id, in the document order. Returns nullptr
+  // if there is no such key.
+  const std::vector<const Key *> *Find(const char *kid) const;
+
+ private:
+  PublicKeys(const char *pkey, size_t pkey_len);
+
+  // Parses x509 keys or the JWK set from the document.
+  void Parse();
+
+  void AddKey(std::unique_ptr<Key> key);
+
+  std::string raw_;
+  Format format_;
+  std::vector<std::unique_ptr<Key>> keys_;
+  // Index of keys_ by key id.
+  std::unordered_map<std::string, std::vector<const Key *>> kid_index_;
+};
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_AUTH_LIB_PUBLIC_KEYS_H_
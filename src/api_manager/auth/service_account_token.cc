@@ -44,8 +44,10 @@ Status ServiceAccountToken::SetClientAuthSecret(const std::string& secret) {
 
   client_auth_secret_ = secret;
   for (unsigned int i = 0; i < JWT_TOKEN_TYPE_MAX; i++) {
-    if (!jwt_tokens_[i].audience().empty()) {
-      Status status = jwt_tokens_[i].GenerateJwtToken(client_auth_secret_);
+    if (!audiences_[i].empty()) {
+      Status status =
+          GetJwtTokenInfo(static_cast<JWT_TOKEN_TYPE>(i), audiences_[i])
+              .GenerateJwtToken(client_auth_secret_);
       if (!status.ok()) {
         if (env_) {
           env_->LogError("Failed to generate auth token.");
@@ -60,25 +62,51 @@ Status ServiceAccountToken::SetClientAuthSecret(const std::string& secret) {
 void ServiceAccountToken::SetAudience(JWT_TOKEN_TYPE type,
                                       const std::string& audience) {
   GOOGLE_CHECK(type >= 0 && type < JWT_TOKEN_TYPE_MAX);
-  if (jwt_tokens_[type].audience() != audience) {
-    jwt_tokens_[type].set_token("", 0);
-    jwt_tokens_[type].set_audience(audience);
+  audiences_[type] = audience;
+  if (!client_auth_secret_.empty() && !audience.empty()) {
+    // Generates the token now rather than on the first request.
+    GetAuthToken(type, audience);
+  }
+}
+
+void ServiceAccountToken::RefreshJwtTokens(time_t window) {
+  if (client_auth_secret_.empty()) {
+    return;
+  }
+  for (auto it = jwt_tokens_.begin(); it != jwt_tokens_.end();) {
+    JwtTokenInfo& info = it->second;
+    if (info.is_valid(window)) {
+      ++it;
+      continue;
+    }
+    // The tokens of the audiences set by SetAudience are always kept, the
+    // others only if they are in use.
+    if (!info.used() && audiences_[it->first.first] != it->first.second) {
+      it = jwt_tokens_.erase(it);
+      continue;
+    }
+    info.set_used(false);
+    if (!info.GenerateJwtToken(client_auth_secret_).ok() && env_) {
+      env_->LogError("Failed to refresh auth token.");
+    }
+    ++it;
   }
 }
 
 const std::string& ServiceAccountToken::GetAuthToken(JWT_TOKEN_TYPE type) {
-  return GetAuthToken(type, jwt_tokens_[type].audience());
+  GOOGLE_CHECK(type >= 0 && type < JWT_TOKEN_TYPE_MAX);
+  return GetAuthToken(type, audiences_[type]);
 }
 
 const std::string& ServiceAccountToken::GetAuthToken(
     JWT_TOKEN_TYPE type, const std::string& audience) {
-  SetAudience(type, audience);
-
   // Uses authentication secret if available.
   if (!client_auth_secret_.empty()) {
     GOOGLE_CHECK(type >= 0 && type < JWT_TOKEN_TYPE_MAX);
-    if (!jwt_tokens_[type].is_valid(0)) {
-      Status status = jwt_tokens_[type].GenerateJwtToken(client_auth_secret_);
+    JwtTokenInfo& info = GetJwtTokenInfo(type, audience);
+    info.set_used(true);
+    if (!info.is_valid(0)) {
+      Status status = info.GenerateJwtToken(client_auth_secret_);
       if (!status.ok()) {
         if (env_) {
           env_->LogError("Failed to generate auth token.");
@@ -87,11 +115,23 @@ const std::string& ServiceAccountToken::GetAuthToken(
         return empty;
       }
     }
-    return jwt_tokens_[type].token();
+    return info.token();
   }
   return access_token_.token();
 }
 
+ServiceAccountToken::JwtTokenInfo& ServiceAccountToken::GetJwtTokenInfo(
+    JWT_TOKEN_TYPE type, const std::string& audience) {
+  auto it = jwt_tokens_.find(std::make_pair(type, audience));
+  if (it == jwt_tokens_.end()) {
+    it = jwt_tokens_.emplace(std::make_pair(type, audience), JwtTokenInfo())
+             .first;
+    it->second.set_audience(audience);
+    it->second.set_token("", 0);
+  }
+  return it->second;
+}
+
 Status ServiceAccountToken::JwtTokenInfo::GenerateJwtToken(
     const std::string& client_auth_secret) {
   // Make sure audience is set.
@@ -17,6 +17,10 @@
 
 #include <time.h>
 
+#include <map>
+#include <string>
+#include <utility>
+
 #include "include/api_manager/env_interface.h"
 
 namespace google {
@@ -27,7 +31,9 @@ namespace auth {
 // control and cloud tracing. There are two kinds of auth token:
 // 1) client auth secret is a client secret can be used to generate auth
 // JWT token. But JWT token is audience specific. Need to generate auth
-// JWT token for each service with its audience.
+// JWT token for each service with its audience. The JWT tokens are cached
+// per type and audience, and RefreshJwtTokens regenerates them before they
+// expire, so that the RSA signing is kept off the request path.
 // 2) GCE service account token is fetched from GCP metadata server.
 // This auth token can be used for any Google services.
 class ServiceAccountToken {
@@ -72,16 +78,23 @@ class ServiceAccountToken {
     JWT_TOKEN_FOR_SERVICEMANAGEMENT_SERVICES,
     JWT_TOKEN_TYPE_MAX,
   };
-  // Set audience.  Only calcualtes JWT token with specified audience.
+  // Set the audience of the JWT token returned by GetAuthToken(type), and
+  // generates the token if needed.
   void SetAudience(JWT_TOKEN_TYPE type, const std::string& audience);
 
+  // Regenerates the JWT tokens which expire within `window` seconds, and
+  // drops the ones which were not used since their last refresh. Called
+  // periodically, off the request path.
+  void RefreshJwtTokens(time_t window);
+
   // Gets the auth token to access Google services.
   // If client auth secret is specified, use it to calcualte JWT token.
   // Otherwise, use the access token fetched from metadata server.
   const std::string& GetAuthToken(JWT_TOKEN_TYPE type);
 
   // Gets the auth token to access Google services. This method accepts an
-  // audience parameter to set when generating JWT token.
+  // audience parameter to set when generating JWT token. A JWT token is only
+  // generated on the first use of an audience.
   // If client auth secret is specified, use it to calcualte JWT token.
   // Otherwise, use the access token fetched from metadata server.
   const std::string& GetAuthToken(JWT_TOKEN_TYPE type,
@@ -118,25 +131,39 @@ class ServiceAccountToken {
   // Stores JWT token info
   class JwtTokenInfo : public TokenInfo {
    public:
+    JwtTokenInfo() : used_(false) {}
+
     void set_audience(const std::string audience) { audience_ = audience; }
     const std::string& audience() const { return audience_; }
 
+    // Whether the token was used since it was last refreshed.
+    void set_used(bool used) { used_ = used; }
+    bool used() const { return used_; }
+
     // Generates auth JWT token from client auth secret.
     utils::Status GenerateJwtToken(const std::string& client_auth_secret);
 
    private:
     // The audiences.
     std::string audience_;
+    bool used_;
   };
 
+  // Returns the token info of the type and audience, creating it if needed.
+  JwtTokenInfo& GetJwtTokenInfo(JWT_TOKEN_TYPE type,
+                                const std::string& audience);
+
   // environment interface.
   ApiManagerEnvInterface* env_;
 
   // The client auth secret which can be used to generate JWT auth token.
   std::string client_auth_secret_;
 
-  // JWT tokens calcualted from client auth secrect.
-  JwtTokenInfo jwt_tokens_[JWT_TOKEN_TYPE_MAX];
+  // The audiences set by SetAudience.
+  std::string audiences_[JWT_TOKEN_TYPE_MAX];
+
+  // JWT tokens calcualted from client auth secrect, by type and audience.
+  std::map<std::pair<JWT_TOKEN_TYPE, std::string>, JwtTokenInfo> jwt_tokens_;
 
   // GCE service account access token fetched from GCE metadata server.
   TokenInfo access_token_;
@@ -28,6 +28,16 @@ namespace auth {
 
 namespace {
 
+// A client auth secret with a symmetric key, signing the tokens with HS256.
+const char kClientSecret[] =
+    "{\"client_secret\": \"test-secret\","
+    "\"issuer\": \"test-issuer\","
+    "\"subject\": \"test-subject\"}";
+
+// The tokens expire in an hour, minus a grace period of 100 seconds.
+const time_t kWindowBeforeExpiration = 60;
+const time_t kWindowAfterExpiration = 3600;
+
 class ServiceAccountTokenTest : public ::testing::Test {
  public:
   void SetUp() {
@@ -76,6 +86,72 @@ TEST_F(ServiceAccountTokenTest, TestClientAuthSecret) {
                     ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL));
 }
 
+TEST_F(ServiceAccountTokenTest, TestJwtTokenPerTypeAndAudience) {
+  ASSERT_TRUE(sa_token_->SetClientAuthSecret(kClientSecret).ok());
+
+  const std::string& control = sa_token_->GetAuthToken(
+      ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL, "audience1");
+  const std::string& other_audience = sa_token_->GetAuthToken(
+      ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL, "audience2");
+  const std::string& other_type = sa_token_->GetAuthToken(
+      ServiceAccountToken::JWT_TOKEN_FOR_CLOUD_TRACING, "audience1");
+  ASSERT_FALSE(control.empty());
+  ASSERT_FALSE(other_audience.empty());
+  ASSERT_FALSE(other_type.empty());
+
+  // The audience is part of the token.
+  ASSERT_NE(control, other_audience);
+  // The tokens of different types are stored separately, even with the same
+  // audience.
+  ASSERT_NE(&control, &other_type);
+  ASSERT_EQ(&control,
+            &sa_token_->GetAuthToken(
+                ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL,
+                "audience1"));
+}
+
+TEST_F(ServiceAccountTokenTest, TestJwtTokenReusedBeforeExpiration) {
+  ASSERT_TRUE(sa_token_->SetClientAuthSecret(kClientSecret).ok());
+  std::string token = sa_token_->GetAuthToken(
+      ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL, "audience");
+  ASSERT_FALSE(token.empty());
+
+  // A token generated a second later would have another issue time.
+  sleep(1);
+  ASSERT_EQ(token, sa_token_->GetAuthToken(
+                       ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL,
+                       "audience"));
+}
+
+TEST_F(ServiceAccountTokenTest, TestJwtTokenRefreshedWithinWindow) {
+  ASSERT_TRUE(sa_token_->SetClientAuthSecret(kClientSecret).ok());
+  std::string token = sa_token_->GetAuthToken(
+      ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL, "audience");
+  ASSERT_FALSE(token.empty());
+
+  sleep(1);
+  // The token expires within the window, it is regenerated.
+  sa_token_->RefreshJwtTokens(kWindowAfterExpiration);
+  std::string refreshed = sa_token_->GetAuthToken(
+      ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL, "audience");
+  ASSERT_FALSE(refreshed.empty());
+  ASSERT_NE(token, refreshed);
+}
+
+TEST_F(ServiceAccountTokenTest, TestJwtTokenNotRefreshedOutsideWindow) {
+  ASSERT_TRUE(sa_token_->SetClientAuthSecret(kClientSecret).ok());
+  std::string token = sa_token_->GetAuthToken(
+      ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL, "audience");
+  ASSERT_FALSE(token.empty());
+
+  sleep(1);
+  // The token does not expire within the window, it is kept.
+  sa_token_->RefreshJwtTokens(kWindowBeforeExpiration);
+  ASSERT_EQ(token, sa_token_->GetAuthToken(
+                       ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL,
+                       "audience"));
+}
+
 }  // namespace
 
 }  // namespace auth
@@ -16,6 +16,7 @@
 #include "src/api_manager/check_auth.h"
 
 #include <chrono>
+#include <memory>
 #include <string>
 
 #include "include/api_manager/api_manager.h"
@@ -23,11 +24,8 @@
 #include "src/api_manager/auth.h"
 #include "src/api_manager/auth/lib/auth_jwt_validator.h"
 #include "src/api_manager/auth/lib/auth_token.h"
-#include "src/api_manager/auth/lib/base64.h"
-#include "src/api_manager/auth/lib/json.h"
 #include "src/api_manager/auth/lib/json_util.h"
 #include "src/api_manager/cloud_trace/cloud_trace.h"
-#include "src/api_manager/utils/url_util.h"
 
 using ::google::api_manager::auth::Certs;
 using ::google::api_manager::auth::JwtCache;
@@ -48,6 +46,12 @@ const char kAuthHeaderIAP[] = "x-goog-iap-jwt-assertion";
 const char kBearer[] = "Bearer ";
 // The lifetime of a public key cache entry. Unit: seconds.
 const int kPubKeyCacheDuration = 300;
+// A key used during the last kPubKeyRefreshWindow seconds of its lifetime is
+// refreshed in the background. Unit: seconds.
+const int kPubKeyRefreshWindow = 60;
+// How long after its expiration a key is still used when it cannot be
+// fetched again. Unit: seconds.
+const int kPubKeyMaxStaleness = 3600;
 
 // An AuthChecker object is created for every incoming request. It authenticates
 // the request, extracts user info from the auth token and sets it to the
@@ -76,10 +80,19 @@ class AuthChecker : public std::enable_shared_from_this<AuthChecker> {
 
   void ParseJwt();
 
-  void CheckAudience(bool cache_hit);
+  // Sets the auth info of the request context from the JWT, and checks that
+  // its issuer and audiences are allowed for the method.
+  Status CheckAudience(const JwtValue &value);
 
   void InitKey();
 
+  // Starts a background fetch of the key, the request does not wait for it.
+  void RefreshKey();
+
+  // Fetches the key, with OpenID discovery if needed. Only one request per
+  // issuer fetches the key at a time.
+  void FetchKey();
+
   void DiscoverJwksUri(const std::string &url);
 
   // Callback function for open ID discovery http fetch.
@@ -90,9 +103,20 @@ class AuthChecker : public std::enable_shared_from_this<AuthChecker> {
   // Callback function for public key http fetch.
   void PostFetchPubKey(Status status, std::string &&body);
 
+  // Completes the key fetch, for all the requests waiting for it.
+  void FetchKeyDone(const Status &status);
+
+  // Callback function of the requests waiting for the key fetch.
+  void PostFetchKey(const Status &status);
+
+  // Verifies the signature on the thread pool of the environment if it has
+  // one, inline otherwise.
   void VerifySignature();
 
-  void PassUserInfoOnSuccess();
+  // Callback function of the signature verification.
+  void PostVerifySignature(const Status &status);
+
+  void PassUserInfoOnSuccess(const std::string &user_info_header);
 
   /*** Helper functions ***/
 
@@ -106,11 +130,17 @@ class AuthChecker : public std::enable_shared_from_this<AuthChecker> {
   // Authentication error
   void Unauthenticated(const std::string &error);
 
-  // Authorization error
-  void Unauthorized(const std::string &error);
+  // Completes the check with an error.
+  void Fail(const Status &status);
 
-  // Fetch error, takes upstream error
-  void FetchFailure(const std::string &error, Status status);
+  // Authentication error status.
+  static Status UnauthenticatedStatus(const std::string &error);
+
+  // Authorization error status.
+  static Status UnauthorizedStatus(const std::string &error);
+
+  // Fetch error status, takes upstream error
+  static Status FetchFailureStatus(const std::string &error, Status status);
 
   /*** Member Variables. ***/
 
@@ -123,12 +153,22 @@ class AuthChecker : public std::enable_shared_from_this<AuthChecker> {
   // User info extracted from auth token.
   UserInfo user_info_;
 
+  // The JwtCache value of the auth token, built from user_info_ on a cache
+  // miss.
+  std::unique_ptr<JwtValue> jwt_value_;
+
   // Pointer to access ESP running environment.
   ApiManagerEnvInterface *env_;
 
   // auth token.
   std::string auth_token_;
 
+  // The key of the auth token in the JwtCache.
+  std::string jwt_key_;
+
+  // The id of the verification keys of the issuer in the certs cache.
+  std::string keys_id_;
+
   // The final continuation function.
   std::function<void(Status status)> on_done_;
 
@@ -151,7 +191,8 @@ void AuthChecker::Check() {
   }
 
   // CreateSpan returns nullptr if trace is disabled.
-  trace_span_.reset(CreateSpan(context_->cloud_trace(), "CheckAuth"));
+  trace_span_.reset(
+      CreateSpan(context_->cloud_trace(), cloud_trace::kCheckAuthSpanName));
 
   GetAuthToken();
   if (auth_token_.empty()) {
@@ -194,29 +235,38 @@ void AuthChecker::GetAuthToken() {
 void AuthChecker::LookupJwtCache() {
   bool remove = false;  // whether or not need to remove an expired entry.
   bool cache_hit = false;
+  Status status = Status::OK;
+  std::string user_info_header;
   JwtCache &jwt_cache = context_->service_context()->jwt_cache();
+  jwt_key_ = JwtCache::Key(auth_token_);
   {
-    JwtCache::ScopedLookup lookup(&jwt_cache, auth_token_);
+    JwtCache::ScopedLookup lookup(&jwt_cache, jwt_key_);
     if (lookup.Found()) {
       JwtValue *val = lookup.value();
-      if (system_clock::now() <= val->exp) {
-        // Cache hit and cache entry is not expired.
-        user_info_ = val->user_info;
-        cache_hit = true;
-      } else {
+      if (system_clock::now() > val->exp) {
         // Need to removes the expired cache entry.
         remove = true;
+      } else if (val->keys_id == context_->service_context()->GetKeysId(
+                                     val->user_info.issuer)) {
+        // Cache hit and cache entry is not expired.
+        cache_hit = true;
+        status = CheckAudience(*val);
+        user_info_header = val->user_info_header;
       }
+      // Otherwise the JWT was verified with the keys of another service
+      // config, verify it again.
     }
   }
   if (remove) {
-    jwt_cache.Remove(auth_token_);
+    jwt_cache.Remove(jwt_key_);
   }
 
-  if (cache_hit) {
-    CheckAudience(true);
-  } else {
+  if (!cache_hit) {
     ParseJwt();
+  } else if (!status.ok()) {
+    Fail(status);
+  } else {
+    PassUserInfoOnSuccess(user_info_header);
   }
 }
 
@@ -234,24 +284,25 @@ void AuthChecker::ParseJwt() {
     Unauthenticated(status.message());
     return;
   }
-  CheckAudience(false);
+  jwt_value_ = JwtCache::CreateValue(user_info_);
+  status = CheckAudience(*jwt_value_);
+  if (!status.ok()) {
+    Fail(status);
+    return;
+  }
+  keys_id_ = context_->service_context()->GetKeysId(user_info_.issuer);
+  InitKey();
 }
 
-void AuthChecker::CheckAudience(bool cache_hit) {
-  std::string audience = user_info_.audiences.empty()
-                             ? std::string()
-                             : user_info_.AudiencesAsString();
-  context_->set_auth_issuer(user_info_.issuer);
-  context_->set_auth_audience(audience);
-  context_->set_auth_authorized_party(user_info_.authorized_party);
+Status AuthChecker::CheckAudience(const JwtValue &value) {
+  context_->set_auth_issuer(value.user_info.issuer);
+  context_->set_auth_audience(value.audience);
+  context_->set_auth_authorized_party(value.user_info.authorized_party);
 
-  context_->set_auth_claims(user_info_.claims);
+  context_->set_auth_claims(value.user_info.claims);
 
-  // Remove http/s header and trailing '/' for issuer.
-  std::string issuer = utils::GetUrlContent(user_info_.issuer);
-  if (!context_->method()->isIssuerAllowed(issuer)) {
-    Unauthenticated("Issuer not allowed");
-    return;
+  if (!context_->method()->isIssuerAllowed(value.normalized_issuer)) {
+    return UnauthenticatedStatus("Issuer not allowed");
   }
 
   // The audience from the JWT must
@@ -259,46 +310,78 @@ void AuthChecker::CheckAudience(bool cache_hit) {
   //   - Explicitly allowed by the issuer in the method configuration.
   // Otherwise the JWT is rejected.
   const std::string &service_name = context_->service_context()->service_name();
-  // Remove http/s header and trailing '/' for audiences.
-  std::set<std::string> aud;
-  for (auto &it : user_info_.audiences) {
-    aud.insert(utils::GetUrlContent(it));
-  }
-  if (aud.find(service_name) == aud.end() &&
-      !context_->method()->isAudienceAllowed(issuer, aud)) {
-    Unauthorized("Audience not allowed");
-    return;
-  }
-  if (cache_hit) {
-    PassUserInfoOnSuccess();
-  } else {
-    InitKey();
+  if (value.normalized_audiences.find(service_name) ==
+          value.normalized_audiences.end() &&
+      !context_->method()->isAudienceAllowed(value.normalized_issuer,
+                                             value.normalized_audiences)) {
+    return UnauthorizedStatus("Audience not allowed");
   }
+  return Status::OK;
 }
 
 void AuthChecker::InitKey() {
   Certs &key_cache = context_->service_context()->certs();
-  auto cert = key_cache.GetCert(user_info_.issuer);
-
-  if (cert == nullptr || system_clock::now() > cert->second) {
-    // Key has not been fetched or has expired.
-    std::string url;
-    bool tryOpenId =
-        context_->service_context()->GetJwksUri(user_info_.issuer, &url);
-    if (url.empty()) {
-      Unauthenticated("Cannot determine the URI of the key");
+  auto cert = key_cache.GetCert(keys_id_);
+  auto now = system_clock::now();
+
+  if (cert != nullptr) {
+    if (now <= cert->second) {
+      // Key is in the cache. Refresh it in the background when it is about
+      // to expire, so that requests do not have to wait for the fetch.
+      if (now > cert->second - std::chrono::seconds(kPubKeyRefreshWindow) &&
+          key_cache.CanFetch(keys_id_, now)) {
+        RefreshKey();
+      }
+      VerifySignature();
       return;
     }
 
-    if (tryOpenId) {
-      DiscoverJwksUri(url);
-    } else {
-      // JwksUri is available. No need to try openID discovery.
-      FetchPubKey(url);
+    if (now <= cert->second + std::chrono::seconds(kPubKeyMaxStaleness) &&
+        !key_cache.CanFetch(keys_id_, now)) {
+      // The key is being fetched, or the last fetch failed recently. Keep
+      // using the expired key meanwhile.
+      ++key_cache.mutable_statistics()->stale_certs_used;
+      VerifySignature();
+      return;
     }
+  }
+
+  // Key has not been fetched or has expired. Wait for the fetch, starting it
+  // unless another request already did.
+  auto pChecker = GetPtr();
+  bool start_fetch = key_cache.StartFetch(
+      keys_id_,
+      [pChecker](const Status &status) { pChecker->PostFetchKey(status); });
+  if (start_fetch) {
+    FetchKey();
   } else {
-    // Key is in the cache, next step is to verify signature.
-    VerifySignature();
+    TRACE(trace_span_) << "Waiting for the key fetch in flight";
+  }
+}
+
+void AuthChecker::RefreshKey() {
+  Certs &key_cache = context_->service_context()->certs();
+  if (key_cache.StartFetch(keys_id_, nullptr)) {
+    env_->LogDebug(std::string("Refreshing the key of ") + user_info_.issuer);
+    ++key_cache.mutable_statistics()->refreshes;
+    FetchKey();
+  }
+}
+
+void AuthChecker::FetchKey() {
+  std::string url;
+  bool tryOpenId =
+      context_->service_context()->GetJwksUri(user_info_.issuer, &url);
+  if (url.empty()) {
+    FetchKeyDone(UnauthenticatedStatus("Cannot determine the URI of the key"));
+    return;
+  }
+
+  if (tryOpenId) {
+    DiscoverJwksUri(url);
+  } else {
+    // JwksUri is available. No need to try openID discovery.
+    FetchPubKey(url);
   }
 }
 
@@ -313,7 +396,8 @@ void AuthChecker::PostFetchJwksUri(Status status, std::string &&body) {
   if (!status.ok()) {
     context_->service_context()->SetJwksUri(user_info_.issuer, std::string(),
                                             false);
-    FetchFailure("Unable to fetch URI of the key via OpenID discovery", status);
+    FetchKeyDone(FetchFailureStatus(
+        "Unable to fetch URI of the key via OpenID discovery", status));
     return;
   }
 
@@ -332,7 +416,8 @@ void AuthChecker::PostFetchJwksUri(Status status, std::string &&body) {
     env_->LogError("OpenID discovery failed due to invalid doc format");
     context_->service_context()->SetJwksUri(user_info_.issuer, std::string(),
                                             false);
-    Unauthenticated("Unable to parse URI of the key via OpenID discovery");
+    FetchKeyDone(UnauthenticatedStatus(
+        "Unable to parse URI of the key via OpenID discovery"));
     return;
   }
 
@@ -351,51 +436,93 @@ void AuthChecker::FetchPubKey(const std::string &url) {
 
 void AuthChecker::PostFetchPubKey(Status status, std::string &&body) {
   if (!status.ok() || body.empty()) {
-    FetchFailure("Unable to fetch verification key", status);
+    FetchKeyDone(
+        FetchFailureStatus("Unable to fetch verification key", status));
     return;
   }
 
   Certs &key_cache = context_->service_context()->certs();
   key_cache.Update(
-      user_info_.issuer, std::move(body),
+      keys_id_, std::move(body),
       system_clock::now() + std::chrono::seconds(kPubKeyCacheDuration));
-  VerifySignature();
+  FetchKeyDone(Status::OK);
+}
+
+void AuthChecker::FetchKeyDone(const Status &status) {
+  if (!status.ok()) {
+    env_->LogWarning(std::string("Failed to fetch the key of ") +
+                     user_info_.issuer + ": " + status.message());
+  }
+  context_->service_context()->certs().FetchDone(keys_id_, status);
+}
+
+void AuthChecker::PostFetchKey(const Status &status) {
+  if (status.ok()) {
+    VerifySignature();
+    return;
+  }
+
+  // Keep using the expired key, if it is not too old.
+  Certs &key_cache = context_->service_context()->certs();
+  auto cert = key_cache.GetCert(keys_id_);
+  if (cert != nullptr &&
+      system_clock::now() <=
+          cert->second + std::chrono::seconds(kPubKeyMaxStaleness)) {
+    ++key_cache.mutable_statistics()->stale_certs_used;
+    VerifySignature();
+    return;
+  }
+
+  Fail(status);
 }
 
 void AuthChecker::VerifySignature() {
   Certs &key_cache = context_->service_context()->certs();
-  auto cert = key_cache.GetCert(user_info_.issuer);
+  auto cert = key_cache.GetCert(keys_id_);
   if (cert == nullptr) {
     Unauthenticated("Missing verification key");
     return;
   }
 
-  Status status =
-      validator_->VerifySignature(cert->first.c_str(), cert->first.size());
+  // The keys are shared, so that a key update does not free them during the
+  // verification. The validator is only used by this checker, which the
+  // continuation keeps alive.
+  std::shared_ptr<const auth::PublicKeys> keys = cert->first;
+  auth::JwtValidator *validator = validator_.get();
+  auto status = std::make_shared<Status>(Status::OK);
+  auto pChecker = GetPtr();
+  if (env_->RunInThreadPool(
+          [validator, keys, status]() {
+            *status = validator->VerifySignature(*keys);
+          },
+          [pChecker, status]() { pChecker->PostVerifySignature(*status); })) {
+    return;
+  }
+  PostVerifySignature(validator_->VerifySignature(*keys));
+}
+
+void AuthChecker::PostVerifySignature(const Status &status) {
   if (!status.ok()) {
     Unauthenticated(status.message());
     return;
   }
 
   // Inserts the entry to JwtCache.
+  std::string user_info_header = jwt_value_->user_info_header;
   JwtCache &cache = context_->service_context()->jwt_cache();
-  cache.Insert(auth_token_, user_info_, validator_->GetExpirationTime(),
-               system_clock::now());
+  cache.Insert(jwt_key_, std::move(jwt_value_), keys_id_,
+               validator_->GetExpirationTime(), system_clock::now());
 
-  PassUserInfoOnSuccess();
+  PassUserInfoOnSuccess(user_info_header);
 }
 
-void AuthChecker::PassUserInfoOnSuccess() {
-  char *json_buf = auth::WriteUserInfoToJson(user_info_);
-  if (json_buf == nullptr) {
+void AuthChecker::PassUserInfoOnSuccess(const std::string &user_info_header) {
+  if (user_info_header.empty()) {
+    Unauthenticated("Internal error");
     return;
   }
-  char *base64_json_buf = auth::esp_base64_encode(
-      json_buf, strlen(json_buf), true, false, true /*padding*/);
   context_->request()->AddHeaderToBackend(auth::kEndpointApiUserInfo,
-                                          base64_json_buf);
-  auth::esp_grpc_free(json_buf);
-  auth::esp_grpc_free(base64_json_buf);
+                                          user_info_header);
 
   TRACE(trace_span_) << "Authenticated.";
   trace_span_.reset();
@@ -403,38 +530,46 @@ void AuthChecker::PassUserInfoOnSuccess() {
 }
 
 void AuthChecker::Unauthenticated(const std::string &error) {
-  TRACE(trace_span_) << "Authentication failed: " << error;
-  trace_span_.reset();
-  on_done_(Status(Code::UNAUTHENTICATED,
-                  std::string("JWT validation failed: ") + error,
-                  Status::AUTH));
+  Fail(UnauthenticatedStatus(error));
 }
 
-void AuthChecker::Unauthorized(const std::string &error) {
-  TRACE(trace_span_) << "Authorization failed: " << error;
+void AuthChecker::Fail(const Status &status) {
+  if (status.code() == Code::PERMISSION_DENIED) {
+    TRACE(trace_span_) << "Authorization failed: " << status.message();
+  } else {
+    TRACE(trace_span_) << "Authentication failed: " << status.message();
+  }
   trace_span_.reset();
-  on_done_(Status(Code::PERMISSION_DENIED,
-                  std::string("JWT validation failed: ") + error,
-                  Status::AUTH));
+  on_done_(status);
+}
+
+Status AuthChecker::UnauthenticatedStatus(const std::string &error) {
+  return Status(Code::UNAUTHENTICATED,
+                std::string("JWT validation failed: ") + error, Status::AUTH);
+}
+
+Status AuthChecker::UnauthorizedStatus(const std::string &error) {
+  return Status(Code::PERMISSION_DENIED,
+                std::string("JWT validation failed: ") + error, Status::AUTH);
 }
 
-void AuthChecker::FetchFailure(const std::string &error, Status status) {
+Status AuthChecker::FetchFailureStatus(const std::string &error,
+                                       Status status) {
   // Append HTTP response code for the upstream statuses
-  trace_span_.reset();
-  on_done_(
-      Status(Code::UNAUTHENTICATED,
-             std::string("JWT validation failed: ") + error +
-                 (status.code() >= 300
-                      ? ". HTTP response code: " + std::to_string(status.code())
-                      : ""),
-             Status::AUTH));
+  return Status(
+      Code::UNAUTHENTICATED,
+      std::string("JWT validation failed: ") + error +
+          (status.code() >= 300
+               ? ". HTTP response code: " + std::to_string(status.code())
+               : ""),
+      Status::AUTH);
 }
 
 void AuthChecker::HttpFetch(
     const std::string &url,
     std::function<void(Status, std::string &&)> continuation) {
   std::shared_ptr<cloud_trace::CloudTraceSpan> fetch_span(
-      CreateChildSpan(trace_span_.get(), "HttpFetch"));
+      CreateChildSpan(trace_span_.get(), cloud_trace::kHttpFetchSpanName));
   env_->LogDebug(std::string("http fetch: ") + url);
   TRACE(fetch_span) << "Http request URL: " << url;
 
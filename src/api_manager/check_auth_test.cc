@@ -16,6 +16,8 @@
 //
 #include "src/api_manager/check_auth.h"
 
+#include <thread>
+
 #include "src/api_manager/check_workflow.h"
 #include "src/api_manager/context/service_context.h"
 #include "src/api_manager/mock_api_manager_environment.h"
@@ -333,6 +335,11 @@ class CheckAuthTest : public ::testing::Test {
         std::move(env), "", std::move(config));
     ASSERT_NE(service_context_.get(), nullptr);
 
+    CreateRequestContext();
+  }
+
+  // Creates context_ for a new request to service_context_.
+  void CreateRequestContext() {
     std::unique_ptr<MockRequest> request(
         new ::testing::NiceMock<MockRequest>());
     // save the raw pointer of request before calling std::move(request).
@@ -367,6 +374,11 @@ class CheckAuthTest : public ::testing::Test {
 
   void TestValidToken(const std::string &auth_token);
 
+  // Checks auth with a token which is in the JWT cache, or whose key is in
+  // the key cache.
+  void TestCachedToken(const std::string &auth_token,
+                       const std::string &user_info);
+
   MockApiManagerEnvironment *raw_env_;
   std::shared_ptr<context::ServiceContext> service_context_;
   MockRequest *raw_request_;
@@ -406,6 +418,27 @@ void CheckAuthTest::TestValidToken(const std::string &auth_token) {
   CheckAuth(context_, [](Status status) { ASSERT_TRUE(status.ok()); });
 }
 
+void CheckAuthTest::TestCachedToken(const std::string &auth_token,
+                                    const std::string &user_info) {
+  EXPECT_CALL(*raw_request_, FindHeader("x-goog-iap-jwt-assertion", _))
+      .WillOnce(Invoke([](const std::string &, std::string *token) {
+        *token = "";
+        return false;
+      }));
+  EXPECT_CALL(*raw_request_, FindHeader(kAuthHeader, _))
+      .WillOnce(Invoke([auth_token](const std::string &, std::string *token) {
+        *token = std::string(kBearer) + auth_token;
+        return true;
+      }));
+  EXPECT_CALL(*raw_request_, SetAuthToken(auth_token)).Times(1);
+  EXPECT_CALL(*raw_env_, DoRunHTTPRequest(_)).Times(0);
+  EXPECT_CALL(*raw_request_,
+              AddHeaderToBackend(kEndpointApiUserInfo, user_info))
+      .WillOnce(Return(utils::Status::OK));
+
+  CheckAuth(context_, [](Status status) { ASSERT_TRUE(status.ok()); });
+}
+
 // Positive test.
 // Step 1: Check auth workflow that involves openID discovery and fetching
 //         public key.
@@ -462,6 +495,89 @@ TEST_F(CheckAuthTest, TestOKAuth) {
   CheckAuth(context_, [](Status status) { ASSERT_TRUE(status.ok()); });
 }
 
+// The signature is verified on the thread pool of the environment when it
+// has one, the check completes in the continuation.
+TEST_F(CheckAuthTest, TestVerifySignatureInThreadPool) {
+  std::thread::id main_thread = std::this_thread::get_id();
+  std::thread::id verify_thread = main_thread;
+  std::function<void()> pending_continuation;
+  EXPECT_CALL(*raw_env_, RunInThreadPool(_, _))
+      .WillOnce(Invoke([&](std::function<void()> work,
+                           std::function<void()> continuation) {
+        std::thread thread([&verify_thread, work]() {
+          verify_thread = std::this_thread::get_id();
+          work();
+        });
+        thread.join();
+        pending_continuation = continuation;
+        return true;
+      }));
+
+  EXPECT_CALL(*raw_request_, FindHeader("x-goog-iap-jwt-assertion", _))
+      .WillOnce(Invoke([](const std::string &, std::string *token) {
+        *token = "";
+        return false;
+      }));
+  EXPECT_CALL(*raw_request_, FindHeader(kAuthHeader, _))
+      .WillOnce(Invoke([](const std::string &, std::string *token) {
+        *token = std::string(kBearer) + std::string(kToken);
+        return true;
+      }));
+  EXPECT_CALL(*raw_request_, SetAuthToken(kToken)).Times(1);
+  EXPECT_CALL(*raw_env_, DoRunHTTPRequest(_))
+      .Times(2)
+      .WillOnce(Invoke([](HTTPRequest *req) {
+        std::string body(kOpenIdContent);
+        std::map<std::string, std::string> empty;
+        req->OnComplete(Status::OK, std::move(empty), std::move(body));
+      }))
+      .WillOnce(Invoke([](HTTPRequest *req) {
+        std::string body(kPubkey);
+        std::map<std::string, std::string> empty;
+        req->OnComplete(Status::OK, std::move(empty), std::move(body));
+      }));
+  EXPECT_CALL(*raw_request_,
+              AddHeaderToBackend(kEndpointApiUserInfo, kUserInfo_kSub_kIss))
+      .WillOnce(Return(utils::Status::OK));
+
+  bool done = false;
+  CheckAuth(context_, [&done](Status status) {
+    ASSERT_TRUE(status.ok());
+    done = true;
+  });
+  EXPECT_NE(main_thread, verify_thread);
+  EXPECT_FALSE(done);
+
+  ASSERT_TRUE(pending_continuation != nullptr);
+  pending_continuation();
+  EXPECT_TRUE(done);
+}
+
+// The JWT and key caches are kept when a new service config is deployed.
+TEST_F(CheckAuthTest, TestCachesSharedByServiceConfigs) {
+  TestValidToken(kToken);
+
+  EXPECT_TRUE(Mock::VerifyAndClearExpectations(raw_request_));
+  EXPECT_TRUE(Mock::VerifyAndClearExpectations(raw_env_));
+
+  // Deploy the service config again.
+  std::unique_ptr<Config> config = Config::Create(raw_env_, kServiceConfig);
+  ASSERT_NE(config.get(), nullptr);
+  service_context_ = std::make_shared<context::ServiceContext>(
+      service_context_->global_context(), std::move(config));
+  CreateRequestContext();
+
+  // The token is cached.
+  TestCachedToken(kToken, kUserInfo_kSub_kIss);
+
+  EXPECT_TRUE(Mock::VerifyAndClearExpectations(raw_request_));
+  EXPECT_TRUE(Mock::VerifyAndClearExpectations(raw_env_));
+
+  // The key is cached.
+  CreateRequestContext();
+  TestCachedToken(kToken2, kUserInfo_kSub2_kIss);
+}
+
 // Negative test: Test the case that openID discovery failed.
 // Step 1. Try to fetch key URI via OpenID discovery but failed.
 // Step 2. Use a different token signed by the same issuer, no HTTP request
@@ -26,6 +26,7 @@ using ::google::api_manager::firebase_rules::FirebaseRequest;
 using ::google::api_manager::utils::Status;
 using ::google::api_manager::auth::AuthzCache;
 using ::google::api_manager::auth::AuthzValue;
+using ::google::api_manager::auth::FirebaseReleaseCache;
 using std::chrono::system_clock;
 
 namespace google {
@@ -81,6 +82,20 @@ class AuthzChecker : public std::enable_shared_from_this<AuthzChecker> {
   bool CheckCache(std::shared_ptr<context::RequestContext> context,
                   std::function<void(Status status)> final_continuation);
 
+  // Gets the ruleset name of the Firebase release of the service config,
+  // from the release cache if possible. A stale cached name is used while it
+  // is refreshed in the background.
+  void GetRulesetName(
+      std::shared_ptr<context::RequestContext> context,
+      std::function<void(Status, const std::string &)> continuation);
+
+  // Fetches the ruleset name of the release and stores it in the release
+  // cache. The continuation may be empty.
+  void FetchRulesetName(
+      const std::string &release_url, const std::string &audience,
+      FirebaseReleaseCache *release_cache,
+      std::function<void(Status, const std::string &)> continuation);
+
   // Insert cache entry
   void InsertCache(std::shared_ptr<context::RequestContext> context,
                    int status_code);
@@ -113,7 +128,7 @@ bool AuthzChecker::CheckCache(
   AuthzValue val;
   std::string cache_key = AuthzCache::ComposeAuthzCacheKey(
       context->AuthToken(), context->request()->GetRequestPath(),
-      context->request()->GetRequestHTTPMethod());
+      context->request()->GetRequestHTTPMethod(), GetReleaseUrl(*context));
   system_clock::time_point now = system_clock::now();
 
   if (context->service_context()->authz_cache().Lookup(cache_key, now, &val)) {
@@ -143,38 +158,97 @@ void AuthzChecker::Check(
     return;
   }
 
-  if (!CheckCache(context, final_continuation)) {
-    auto checker = GetPtr();
-    // Fetch the Release attributes and get ruleset name.
-    HttpFetch(GetReleaseUrl(*context), kHttpGetMethod, "",
-              auth::ServiceAccountToken::JWT_TOKEN_FOR_FIREBASE,
-              context->service_context()->config()->GetFirebaseAudience(),
-              [context, final_continuation, checker](Status status,
-                                                     std::string &&body) {
-                std::string ruleset_id;
-                if (status.ok()) {
-                  checker->env_->LogDebug(
-                      std::string("GetReleasName succeeded with ") + body);
-                  status = checker->ParseReleaseResponse(body, &ruleset_id);
-                } else {
-                  checker->env_->LogError(std::string("GetReleaseName for ") +
-                                          GetReleaseUrl(*context.get()) +
-                                          " with status " + status.ToString());
-                  status = Status(Code::INTERNAL, kFailedFirebaseReleaseFetch);
-                }
-
-                // If the parsing of the release body is successful, then call
-                // the
-                // Test Api for firebase rules service.
-                if (status.ok()) {
-                  checker->request_handler_ = std::unique_ptr<FirebaseRequest>(
-                      new FirebaseRequest(ruleset_id, checker->env_, context));
-                  checker->CallNextRequest(context, final_continuation);
-                } else {
-                  final_continuation(status);
-                }
-              });
+  if (CheckCache(context, final_continuation)) {
+    return;
+  }
+
+  // Waits for the result of the check in flight for the same cache key, if
+  // any.
+  AuthzCache &authz_cache = context->service_context()->authz_cache();
+  std::string cache_key = AuthzCache::ComposeAuthzCacheKey(
+      context->AuthToken(), context->request()->GetRequestPath(),
+      context->request()->GetRequestHTTPMethod(), GetReleaseUrl(*context));
+  if (!authz_cache.StartCheck(cache_key, final_continuation)) {
+    env_->LogDebug("Waiting for the Firebase Rules check in flight.");
+    return;
   }
+  auto continuation = [&authz_cache, cache_key,
+                       final_continuation](Status status) {
+    final_continuation(status);
+    authz_cache.FinishCheck(cache_key, status);
+  };
+
+  auto checker = GetPtr();
+  GetRulesetName(context, [context, continuation, checker](
+                              Status status, const std::string &ruleset_id) {
+    // If the release is resolved, then call the Test Api for firebase rules
+    // service.
+    if (status.ok()) {
+      checker->request_handler_ = std::unique_ptr<FirebaseRequest>(
+          new FirebaseRequest(ruleset_id, checker->env_, context));
+      checker->CallNextRequest(context, continuation);
+    } else {
+      continuation(status);
+    }
+  });
+}
+
+void AuthzChecker::GetRulesetName(
+    std::shared_ptr<context::RequestContext> context,
+    std::function<void(Status, const std::string &)> continuation) {
+  FirebaseReleaseCache *release_cache =
+      &context->service_context()->firebase_release_cache();
+  std::string release_url = GetReleaseUrl(*context);
+  const std::string &audience =
+      context->service_context()->config()->GetFirebaseAudience();
+
+  std::string ruleset_id;
+  switch (release_cache->Lookup(release_url, system_clock::now(),
+                                &ruleset_id)) {
+    case FirebaseReleaseCache::HIT:
+      continuation(Status::OK, ruleset_id);
+      break;
+    case FirebaseReleaseCache::REFRESH:
+      env_->LogDebug(std::string("Refreshing the ruleset of ") + release_url);
+      FetchRulesetName(release_url, audience, release_cache, nullptr);
+      continuation(Status::OK, ruleset_id);
+      break;
+    case FirebaseReleaseCache::MISS:
+      FetchRulesetName(release_url, audience, release_cache, continuation);
+      break;
+  }
+}
+
+void AuthzChecker::FetchRulesetName(
+    const std::string &release_url, const std::string &audience,
+    FirebaseReleaseCache *release_cache,
+    std::function<void(Status, const std::string &)> continuation) {
+  auto checker = GetPtr();
+  // Fetch the Release attributes and get ruleset name.
+  HttpFetch(release_url, kHttpGetMethod, "",
+            auth::ServiceAccountToken::JWT_TOKEN_FOR_FIREBASE, audience,
+            [release_url, release_cache, continuation, checker](
+                Status status, std::string &&body) {
+              std::string ruleset_id;
+              if (status.ok()) {
+                checker->env_->LogDebug(
+                    std::string("GetReleasName succeeded with ") + body);
+                status = checker->ParseReleaseResponse(body, &ruleset_id);
+              } else {
+                checker->env_->LogError(std::string("GetReleaseName for ") +
+                                        release_url + " with status " +
+                                        status.ToString());
+                status = Status(Code::INTERNAL, kFailedFirebaseReleaseFetch);
+              }
+
+              if (status.ok()) {
+                release_cache->Add(release_url, ruleset_id,
+                                   system_clock::now());
+              }
+              if (continuation) {
+                continuation(status, ruleset_id);
+              }
+            });
 }
 
 void AuthzChecker::InsertCache(std::shared_ptr<context::RequestContext> context,
@@ -183,7 +257,7 @@ void AuthzChecker::InsertCache(std::shared_ptr<context::RequestContext> context,
     bool res = (status_code == Code::OK) ? true : false;
     std::string cache_key = AuthzCache::ComposeAuthzCacheKey(
         context->AuthToken(), context->request()->GetRequestPath(),
-        context->request()->GetRequestHTTPMethod());
+        context->request()->GetRequestHTTPMethod(), GetReleaseUrl(*context));
     context->service_context()->authz_cache().Add(cache_key, res,
                                                   system_clock::now());
   }
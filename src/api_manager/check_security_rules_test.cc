@@ -461,7 +461,7 @@ TEST_F(CheckSecurityRulesTest, CheckAuthzCacheMissThenHitNegative) {
 }
 
 // Cache miss. In this case no cache entry is added because of the failure of
-// the interaction with firebase.
+// the interaction with firebase. The ruleset name of the release is cached.
 TEST_F(CheckSecurityRulesTest, NoCachingOnBadStatus) {
   std::string service_config = std::string(kServiceName) + kProducerProjectId +
                                kApis + kAuthentication + kHttp;
@@ -475,7 +475,6 @@ TEST_F(CheckSecurityRulesTest, NoCachingOnBadStatus) {
   ExpectCall(ruleset_test_url_, "POST", kFirstRequest,
              BuildTestRulesetResponse(false),
              Status(Code::INTERNAL, "Cannot talk to server"));
-  ExpectCall(release_url_, "GET", "", kRelease);
   ExpectCall(ruleset_test_url_, "POST", kFirstRequest,
              BuildTestRulesetResponse(false));
 
@@ -487,6 +486,43 @@ TEST_F(CheckSecurityRulesTest, NoCachingOnBadStatus) {
   });
 }
 
+// A check started while the check of the same request is in flight waits for
+// its result instead of calling the Firebase Rules service again.
+TEST_F(CheckSecurityRulesTest, CoalesceConcurrentChecks) {
+  std::string service_config = std::string(kServiceName) + kProducerProjectId +
+                               kApis + kAuthentication + kHttp;
+  std::string server_config = kServerConfig;
+  SetUp(service_config, server_config);
+
+  request_context_->set_auth_claims(kJwtEmailPayload);
+
+  int second_check_calls = 0;
+  auto request_context = request_context_;
+  std::string response = BuildTestRulesetResponse(true);
+
+  InSequence s;
+  ExpectCall(release_url_, "GET", "", kRelease);
+  EXPECT_CALL(*raw_env_, DoRunHTTPRequest(HTTPRequestMatches(
+                             ruleset_test_url_, "POST", kFirstRequest)))
+      .WillOnce(Invoke([request_context, response,
+                        &second_check_calls](HTTPRequest *req) {
+        CheckSecurityRules(request_context, [&second_check_calls](
+                                                Status status) {
+          ASSERT_TRUE(status.ok());
+          ++second_check_calls;
+        });
+        ASSERT_EQ(0, second_check_calls);
+
+        std::map<std::string, std::string> empty;
+        std::string body(response);
+        req->OnComplete(Status::OK, std::move(empty), std::move(body));
+      }));
+
+  CheckSecurityRules(request_context_,
+                     [](Status status) { ASSERT_TRUE(status.ok()); });
+  ASSERT_EQ(1, second_check_calls);
+}
+
 // If the release name is bad, then check the following:
 // 1. Ensure that GetRuleset request is inovked on bad release name.
 // 2. In this case return Status with NOT_FOUND
@@ -32,7 +32,8 @@ const std::string kConsumerProjecId = "X-Endpoint-API-Project-ID";
 void CheckServiceControl(std::shared_ptr<context::RequestContext> context,
                          std::function<void(Status status)> continuation) {
   std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span(
-      CreateSpan(context->cloud_trace(), "CheckServiceControl"));
+      CreateSpan(context->cloud_trace(),
+                 cloud_trace::kCheckServiceControlSpanName));
   // If the method is not configured from the service config.
   // or if not need to check service control, skip it.
   if (!context->method()) {
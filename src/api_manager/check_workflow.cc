@@ -21,49 +21,154 @@
 #include "src/api_manager/fetch_metadata.h"
 #include "src/api_manager/quota_control.h"
 
+#include <chrono>
+
 using ::google::api_manager::utils::Status;
 
 namespace google {
 namespace api_manager {
 
+// The state of one run of the workflow for a request.
+class CheckWorkflow::Execution
+    : public std::enable_shared_from_this<CheckWorkflow::Execution> {
+ public:
+  Execution(const std::vector<Stage> &stages,
+            std::shared_ptr<context::RequestContext> context)
+      : stages_(stages),
+        context_(context),
+        states_(stages.size(), PENDING),
+        statuses_(stages.size(), Status::OK),
+        start_times_(stages.size()),
+        in_flight_(0),
+        failed_(false),
+        completed_(false) {}
+
+  // Starts all the stages whose dependencies have succeeded. Stages may
+  // complete synchronously, so this is re-entered from OnStageDone.
+  void StartReadyStages();
+
+ private:
+  enum State { PENDING, RUNNING, DONE };
+
+  // Returns true if all the dependencies of the stage have succeeded.
+  bool IsReady(size_t index) const;
+
+  void OnStageDone(size_t index, Status status);
+
+  // Completes the check once nothing is in flight and either a stage failed
+  // or all the stages succeeded.
+  void MaybeComplete();
+
+  const std::vector<Stage> &stages_;
+  std::shared_ptr<context::RequestContext> context_;
+
+  std::vector<State> states_;
+  std::vector<Status> statuses_;
+  std::vector<std::chrono::steady_clock::time_point> start_times_;
+
+  // Number of stages started and not yet done.
+  size_t in_flight_;
+  // Set when a stage fails: no more stages are started.
+  bool failed_;
+  // Set when CompleteCheck has been called.
+  bool completed_;
+};
+
+bool CheckWorkflow::Execution::IsReady(size_t index) const {
+  for (size_t dependency : stages_[index].dependencies) {
+    if (states_[dependency] != DONE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void CheckWorkflow::Execution::StartReadyStages() {
+  auto self = shared_from_this();
+  for (size_t i = 0; i < stages_.size() && !failed_; ++i) {
+    if (states_[i] != PENDING || !IsReady(i)) {
+      continue;
+    }
+    states_[i] = RUNNING;
+    start_times_[i] = std::chrono::steady_clock::now();
+    ++in_flight_;
+    stages_[i].handler(context_, [self, i](Status status) {
+      self->OnStageDone(i, status);
+    });
+  }
+  MaybeComplete();
+}
+
+void CheckWorkflow::Execution::OnStageDone(size_t index, Status status) {
+  context_->add_check_stage_latency(
+      stages_[index].name,
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start_times_[index]));
+
+  states_[index] = DONE;
+  statuses_[index] = status;
+  --in_flight_;
+  if (!status.ok()) {
+    failed_ = true;
+  }
+  StartReadyStages();
+}
+
+void CheckWorkflow::Execution::MaybeComplete() {
+  if (completed_ || in_flight_ > 0) {
+    return;
+  }
+  if (!failed_) {
+    for (State state : states_) {
+      if (state != DONE) {
+        return;
+      }
+    }
+  }
+
+  completed_ = true;
+  for (const Status &status : statuses_) {
+    if (!status.ok()) {
+      context_->CompleteCheck(status);
+      return;
+    }
+  }
+  context_->CompleteCheck(Status::OK);
+}
+
+
 void CheckWorkflow::RegisterAll() {
   // Fetchs GCE metadata.
-  Register(FetchGceMetadata);
+  size_t metadata = Register("FetchGceMetadata", FetchGceMetadata);
   // Fetchs service account token.
-  Register(FetchServiceAccountToken);
-  // Authentication checks.
-  Register(CheckAuth);
+  size_t token = Register("FetchServiceAccountToken",
+                          FetchServiceAccountToken, {metadata});
+  // Authentication checks, JWT verification does not need the token.
+  size_t auth = Register("CheckAuth", CheckAuth);
   // Check Security Rules.
-  Register(CheckSecurityRules);
-  // Checks service control.
-  Register(CheckServiceControl);
-  // Quota control
-  Register(QuotaControl);
+  size_t security_rules =
+      Register("CheckSecurityRules", CheckSecurityRules, {auth, token});
+  // Checks service control, concurrently with authentication.
+  size_t check = Register("CheckServiceControl", CheckServiceControl, {token});
+  // Quota control. Only allocates quota for the requests which passed all
+  // the checks, and needs the consumer identity returned by Check.
+  Register("QuotaControl", QuotaControl, {auth, security_rules, check});
 }
 
-void CheckWorkflow::Register(CheckHandler handler) {
-  handlers_.push_back(handler);
+size_t CheckWorkflow::Register(const char *name, CheckHandler handler,
+                               const std::vector<size_t> &dependencies) {
+  stages_.push_back({name, handler, dependencies});
+  return stages_.size() - 1;
 }
 
 void CheckWorkflow::Run(std::shared_ptr<context::RequestContext> context) {
-  if (!handlers_.empty()) {
-    RunOneHandler(context, 0);
+  if (!stages_.empty()) {
+    std::make_shared<Execution>(stages_, context)->StartReadyStages();
   } else {
     // Empty check handler list means: not need to check.
     context->CompleteCheck(Status::OK);
   }
 }
 
-void CheckWorkflow::RunOneHandler(
-    std::shared_ptr<context::RequestContext> context, size_t index) {
-  handlers_[index](context, [context, index, this](Status status) {
-    if (status.ok() && index + 1 < handlers_.size()) {
-      RunOneHandler(context, index + 1);
-    } else {
-      context->CompleteCheck(status);
-    }
-  });
-}
-
 }  // namespace api_manager
 }  // namespace google
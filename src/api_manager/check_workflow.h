@@ -15,6 +15,8 @@
 #ifndef API_MANAGER_CHECK_WORKFLOW_H_
 #define API_MANAGER_CHECK_WORKFLOW_H_
 
+#include <vector>
+
 #include "include/api_manager/utils/status.h"
 #include "src/api_manager/context/request_context.h"
 
@@ -27,6 +29,15 @@ typedef std::function<void(std::shared_ptr<context::RequestContext>,
     CheckHandler;
 
 // A workflow to run all CheckHandlers
+//
+// The handlers form a dependency graph: a handler is started as soon as all
+// the handlers it depends on have succeeded, so independent handlers (for
+// example service control Check and authentication) run concurrently.
+//
+// When a handler fails, the handlers which have not started yet are
+// cancelled. The check completes once the handlers already in flight have
+// returned, with the error of the first failed handler in registration
+// order, which is the error a sequential run would have returned.
 class CheckWorkflow {
  public:
   virtual ~CheckWorkflow() {}
@@ -34,20 +45,29 @@ class CheckWorkflow {
   // Registers all known check handlers.
   void RegisterAll();
 
-  // Runs the workflow to call each check handler sequentially.
+  // Registers a check handler, which runs after all the handlers in
+  // dependencies have succeeded. A handler can only depend on handlers
+  // registered before it. Returns the index of the handler, to be used in
+  // the dependencies of later handlers.
+  size_t Register(const char *name, CheckHandler handler,
+                  const std::vector<size_t> &dependencies = {});
+
+  // Runs the workflow to call the check handlers.
   void Run(std::shared_ptr<context::RequestContext> context);
 
  private:
-  // Registers a check handler. The order is important.
-  // They will be executed in the order they are registered.
-  void Register(CheckHandler handler);
+  class Execution;
 
-  // Runs one check handler with index.
-  void RunOneHandler(std::shared_ptr<context::RequestContext> context,
-                     size_t index);
+  // A check handler and the handlers it depends on.
+  struct Stage {
+    // Name used to report the stage latency.
+    const char *name;
+    CheckHandler handler;
+    std::vector<size_t> dependencies;
+  };
 
-  // A vector to store all check handlers.
-  std::vector<CheckHandler> handlers_;
+  // The registered check handlers, in registration order.
+  std::vector<Stage> stages_;
 };
 
 }  // namespace api_manager
@@ -0,0 +1,313 @@
+// Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/api_manager/check_workflow.h"
+
+#include "gmock/gmock.h"
+#include "google/api/servicecontrol/v1/quota_controller.pb.h"
+#include "google/api/servicecontrol/v1/service_controller.pb.h"
+#include "gtest/gtest.h"
+#include "src/api_manager/context/service_context.h"
+#include "src/api_manager/mock_api_manager_environment.h"
+#include "src/api_manager/mock_request.h"
+
+using ::google::api::servicecontrol::v1::AllocateQuotaRequest;
+using ::google::api::servicecontrol::v1::AllocateQuotaResponse;
+using ::google::api::servicecontrol::v1::CheckError;
+using ::google::api::servicecontrol::v1::CheckResponse;
+using ::google::api_manager::utils::Status;
+using ::google::protobuf::util::error::Code;
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+
+namespace google {
+namespace api_manager {
+
+namespace {
+
+const char kServiceConfig[] = "name: \"endpoints-test.cloudendpointsapis.com\"";
+
+const char kQuotaServiceConfig[] = R"(
+name: "endpoints-test.cloudendpointsapis.com"
+control {
+  environment: "http://127.0.0.1:8081"
+}
+http {
+  rules {
+    selector: "ListShelves"
+    get: "/shelves"
+  }
+}
+quota {
+  metric_rules {
+    selector: "ListShelves"
+    metric_costs {
+      key: "metrics_first"
+      value: 2
+    }
+  }
+}
+)";
+
+// A check handler whose continuation is called by the test.
+class PendingHandler {
+ public:
+  PendingHandler() : started_(false) {}
+
+  CheckHandler handler() {
+    return [this](std::shared_ptr<context::RequestContext> context,
+                  std::function<void(Status)> continuation) {
+      started_ = true;
+      continuation_ = continuation;
+    };
+  }
+
+  bool started() const { return started_; }
+
+  void Complete(Status status) {
+    ASSERT_TRUE(continuation_);
+    auto continuation = continuation_;
+    continuation_ = nullptr;
+    continuation(status);
+  }
+
+ private:
+  bool started_;
+  std::function<void(Status)> continuation_;
+};
+
+CheckHandler SyncHandler(Status status) {
+  return [status](std::shared_ptr<context::RequestContext> context,
+                  std::function<void(Status)> continuation) {
+    continuation(status);
+  };
+}
+
+class CheckWorkflowTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    std::unique_ptr<MockApiManagerEnvironment> env(
+        new ::testing::NiceMock<MockApiManagerEnvironment>());
+    std::unique_ptr<Config> config = Config::Create(env.get(), kServiceConfig);
+    ASSERT_NE(config.get(), nullptr);
+
+    service_context_ = std::make_shared<context::ServiceContext>(
+        std::move(env), "", std::move(config));
+
+    std::unique_ptr<MockRequest> request(
+        new ::testing::NiceMock<MockRequest>());
+    context_ = std::make_shared<context::RequestContext>(service_context_,
+                                                         std::move(request));
+
+    completed_ = false;
+    context_->set_check_continuation([this](Status status) {
+      ASSERT_FALSE(completed_);
+      completed_ = true;
+      status_ = status;
+    });
+  }
+
+  CheckWorkflow workflow_;
+  std::shared_ptr<context::ServiceContext> service_context_;
+  std::shared_ptr<context::RequestContext> context_;
+  bool completed_;
+  Status status_;
+};
+
+TEST_F(CheckWorkflowTest, EmptyWorkflow) {
+  workflow_.Run(context_);
+  EXPECT_TRUE(completed_);
+  EXPECT_TRUE(status_.ok());
+}
+
+TEST_F(CheckWorkflowTest, IndependentStagesRunConcurrently) {
+  PendingHandler token, check, quota;
+  size_t token_index = workflow_.Register("token", token.handler());
+  workflow_.Register("check", check.handler(), {token_index});
+  workflow_.Register("quota", quota.handler(), {token_index});
+
+  workflow_.Run(context_);
+  EXPECT_TRUE(token.started());
+  EXPECT_FALSE(check.started());
+  EXPECT_FALSE(quota.started());
+
+  token.Complete(Status::OK);
+  EXPECT_TRUE(check.started());
+  EXPECT_TRUE(quota.started());
+
+  quota.Complete(Status::OK);
+  EXPECT_FALSE(completed_);
+  check.Complete(Status::OK);
+  EXPECT_TRUE(completed_);
+  EXPECT_TRUE(status_.ok());
+
+  ASSERT_EQ(context_->check_stage_latencies().size(), 3);
+  EXPECT_STREQ(context_->check_stage_latencies()[0].first, "token");
+  EXPECT_STREQ(context_->check_stage_latencies()[1].first, "quota");
+  EXPECT_STREQ(context_->check_stage_latencies()[2].first, "check");
+}
+
+TEST_F(CheckWorkflowTest, SynchronousStages) {
+  size_t first = workflow_.Register("first", SyncHandler(Status::OK));
+  workflow_.Register("second", SyncHandler(Status::OK), {first});
+  workflow_.Register("third", SyncHandler(Status::OK));
+
+  workflow_.Run(context_);
+  EXPECT_TRUE(completed_);
+  EXPECT_TRUE(status_.ok());
+  EXPECT_EQ(context_->check_stage_latencies().size(), 3);
+}
+
+TEST_F(CheckWorkflowTest, FailureCancelsPendingStages) {
+  PendingHandler auth, rules;
+  size_t auth_index = workflow_.Register("auth", auth.handler());
+  workflow_.Register("rules", rules.handler(), {auth_index});
+
+  workflow_.Run(context_);
+  auth.Complete(Status(Code::UNAUTHENTICATED, "Unauthenticated"));
+  EXPECT_FALSE(rules.started());
+  EXPECT_TRUE(completed_);
+  EXPECT_EQ(status_.code(), Code::UNAUTHENTICATED);
+}
+
+TEST_F(CheckWorkflowTest, FailureWaitsForStagesInFlight) {
+  PendingHandler auth, check;
+  workflow_.Register("auth", auth.handler());
+  workflow_.Register("check", check.handler());
+
+  workflow_.Run(context_);
+  check.Complete(Status(Code::PERMISSION_DENIED, "Denied"));
+  EXPECT_FALSE(completed_);
+
+  // The error of the first registered stage is returned.
+  auth.Complete(Status(Code::UNAUTHENTICATED, "Unauthenticated"));
+  EXPECT_TRUE(completed_);
+  EXPECT_EQ(status_.code(), Code::UNAUTHENTICATED);
+}
+
+TEST_F(CheckWorkflowTest, SynchronousFailure) {
+  PendingHandler check;
+  workflow_.Register("auth",
+                     SyncHandler(Status(Code::UNAUTHENTICATED, "Error")));
+  workflow_.Register("check", check.handler());
+
+  workflow_.Run(context_);
+  EXPECT_FALSE(check.started());
+  EXPECT_TRUE(completed_);
+  EXPECT_EQ(status_.code(), Code::UNAUTHENTICATED);
+}
+
+// Runs all the registered check handlers against a service control server
+// mocked by the environment.
+class CheckWorkflowRegisterAllTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    std::unique_ptr<MockApiManagerEnvironment> env(
+        new ::testing::NiceMock<MockApiManagerEnvironment>());
+    EXPECT_CALL(*env, DoRunHTTPRequest(_))
+        .WillRepeatedly(
+            Invoke(this, &CheckWorkflowRegisterAllTest::DoRunHTTPRequest));
+    std::unique_ptr<Config> config =
+        Config::Create(env.get(), kQuotaServiceConfig);
+    ASSERT_NE(config.get(), nullptr);
+
+    service_context_ = std::make_shared<context::ServiceContext>(
+        std::move(env), "", std::move(config));
+    ASSERT_TRUE(service_context_->service_control());
+    service_context_->service_control()->Init();
+
+    workflow_.RegisterAll();
+    checks_ = 0;
+    completed_ = false;
+  }
+
+  void TearDown() { service_context_->service_control()->Close(); }
+
+  // Runs the workflow for a "GET /shelves?key=<api_key>" request.
+  void Run(const std::string &api_key) {
+    std::unique_ptr<MockRequest> request(
+        new ::testing::NiceMock<MockRequest>());
+    ON_CALL(*request, GetRequestHTTPMethod()).WillByDefault(Return("GET"));
+    ON_CALL(*request, GetRequestPath()).WillByDefault(Return("/shelves"));
+    ON_CALL(*request, GetUnparsedRequestPath())
+        .WillByDefault(Return("/shelves"));
+    ON_CALL(*request, FindQuery("key", _))
+        .WillByDefault(DoAll(SetArgPointee<1>(api_key), Return(true)));
+
+    auto context = std::make_shared<context::RequestContext>(
+        service_context_, std::move(request));
+    context->set_check_continuation([this](Status status) {
+      ASSERT_FALSE(completed_);
+      completed_ = true;
+      status_ = status;
+    });
+    workflow_.Run(context);
+  }
+
+  void DoRunHTTPRequest(HTTPRequest *request) {
+    std::string body;
+    if (request->url().find(":check") != std::string::npos) {
+      ++checks_;
+      check_response_.SerializeToString(&body);
+    } else if (request->url().find(":allocateQuota") != std::string::npos) {
+      AllocateQuotaRequest quota_request;
+      ASSERT_TRUE(quota_request.ParseFromString(request->body()));
+      quota_requests_.push_back(quota_request);
+      AllocateQuotaResponse().SerializeToString(&body);
+    }
+    request->OnComplete(Status::OK, {}, std::move(body));
+  }
+
+  CheckWorkflow workflow_;
+  std::shared_ptr<context::ServiceContext> service_context_;
+  CheckResponse check_response_;
+  int checks_;
+  std::vector<AllocateQuotaRequest> quota_requests_;
+  bool completed_;
+  Status status_;
+};
+
+TEST_F(CheckWorkflowRegisterAllTest, QuotaAllocatedAfterCheck) {
+  Run("this-is-an-api-key");
+  EXPECT_TRUE(completed_);
+  EXPECT_TRUE(status_.ok());
+  EXPECT_EQ(1, checks_);
+
+  // The quota is charged to the consumer identified by Check.
+  ASSERT_EQ(1, quota_requests_.size());
+  EXPECT_EQ("api_key:this-is-an-api-key",
+            quota_requests_[0].allocate_operation().consumer_id());
+  EXPECT_EQ("ListShelves",
+            quota_requests_[0].allocate_operation().method_name());
+}
+
+TEST_F(CheckWorkflowRegisterAllTest, NoQuotaAllocatedWhenCheckFails) {
+  check_response_.add_check_errors()->set_code(CheckError::API_KEY_INVALID);
+
+  Run("this-is-an-invalid-api-key");
+  EXPECT_TRUE(completed_);
+  EXPECT_FALSE(status_.ok());
+  EXPECT_EQ(1, checks_);
+  EXPECT_TRUE(quota_requests_.empty());
+}
+
+}  // namespace
+
+}  // namespace api_manager
+}  // namespace google
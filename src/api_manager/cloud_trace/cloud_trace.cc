@@ -18,11 +18,15 @@
 
 #include <cctype>
 #include <chrono>
+#include <cstdio>
 #include <iomanip>
 #include <random>
 #include <sstream>
 #include <string>
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 #include "google/protobuf/timestamp.pb.h"
+#include "google/protobuf/wire_format_lite.h"
 #include "include/api_manager/utils/status.h"
 #include "include/api_manager/utils/version.h"
 #include "src/api_manager/utils/marshalling.h"
@@ -32,11 +36,23 @@ using google::devtools::cloudtrace::v1::Trace;
 using google::devtools::cloudtrace::v1::Traces;
 using google::devtools::cloudtrace::v1::TraceSpan;
 using google::devtools::cloudtrace::v1::TraceSpan_SpanKind;
+using google::protobuf::Arena;
 using google::protobuf::Timestamp;
+using google::protobuf::internal::WireFormatLite;
 
 namespace google {
 namespace api_manager {
 namespace cloud_trace {
+
+const char kCheckAuthSpanName[] = "CheckAuth";
+const char kHttpFetchSpanName[] = "HttpFetch";
+const char kCheckServiceControlSpanName[] = "CheckServiceControl";
+const char kCheckServiceControlCacheSpanName[] = "CheckServiceControlCache";
+const char kQuotaControlSpanName[] = "QuotaControl";
+const char kQuotaServiceControlCacheSpanName[] = "QuotaServiceControlCache";
+const char kServiceControlCallSpanName[] = "Call ServiceControl server";
+const char kBackendSpanName[] = "Backend";
+
 namespace {
 
 const char kCloudTraceService[] = "/google.devtools.cloudtrace.v1.TraceService";
@@ -56,14 +72,9 @@ std::string RandomUInt128HexString();
 // Get the timestamp for now.
 void GetNow(Timestamp *ts);
 
-// Get a new Trace object stored in the trace parameter. The new object has
-// the given trace id and contains a root span with default settings.
-void GetNewTrace(std::string trace_id_str, const std::string &root_span_name,
-                 Trace **trace);
-
 // Parse the trace context header.
-// Assigns Trace object to the trace pointer if context is parsed correctly and
-// trace is enabled. Otherwise the pointer is not modified.
+// Returns true if context is parsed correctly and trace is enabled, and sets
+// the trace id and the parent span id, 0 if not provided.
 // If trace is enabled, the option will be modified to the one passed in.
 //
 // Grammar of the context header:
@@ -73,9 +84,9 @@ void GetNewTrace(std::string trace_id_str, const std::string &root_span_name,
 // span-id       := decimal representation of a 64 bit value
 // trace-options := decimal representation of a 32 bit value
 //
-void GetTraceFromContextHeader(const std::string &trace_context,
-                               const std::string &root_span_name, Trace **trace,
-                               std::string *options);
+bool GetTraceFromContextHeader(const std::string &trace_context,
+                               std::string *trace_id,
+                               uint64_t *parent_span_id, std::string *options);
 }  // namespace
 
 Sampler::Sampler(double qps) {
@@ -111,16 +122,19 @@ void Sampler::Refresh() {
 Aggregator::Aggregator(auth::ServiceAccountToken *sa_token,
                        const std::string &cloud_trace_address,
                        int aggregate_time_millisec, int cache_max_size,
+                       int max_batch_bytes, bool binary_export,
                        double minimum_qps, ApiManagerEnvInterface *env)
     : sa_token_(sa_token),
       cloud_trace_address_(cloud_trace_address),
       aggregate_time_millisec_(aggregate_time_millisec),
       cache_max_size_(cache_max_size),
-      traces_(new Traces),
+      max_batch_bytes_(max_batch_bytes),
+      binary_export_(binary_export),
       env_(env),
       sampler_(minimum_qps) {
   sa_token_->SetAudience(auth::ServiceAccountToken::JWT_TOKEN_FOR_CLOUD_TRACING,
                          cloud_trace_address_ + kCloudTraceService);
+  ResetBatch();
 }
 
 void Aggregator::Init() {
@@ -138,26 +152,30 @@ Aggregator::~Aggregator() {
   }
 }
 
+void Aggregator::ResetBatch() {
+  batch_arena_.reset(new Arena);
+  traces_ = Arena::CreateMessage<Traces>(batch_arena_.get());
+  batch_.clear();
+  batch_traces_ = 0;
+  batch_bytes_ = 0;
+}
+
 void Aggregator::SendAndClearTraces() {
-  if (traces_->traces_size() == 0 || project_id_.empty()) {
+  if (batch_traces_ == 0 || project_id_.empty()) {
     env_->LogDebug(
         "Not sending request to CloudTrace: no traces or "
         "project_id is empty.");
-    traces_->clear_traces();
+    ResetBatch();
     return;
   }
 
-  // Add project id into each trace object.
-  for (int i = 0; i < traces_->traces_size(); ++i) {
-    traces_->mutable_traces(i)->set_project_id(project_id_);
-  }
-
+  bool log_debug = env_->IsLogEnabled(ApiManagerEnvInterface::DEBUG);
   std::unique_ptr<HTTPRequest> http_request(new HTTPRequest(
-      [this](Status status, std::map<std::string, std::string> &&,
-             std::string &&body) {
+      [this, log_debug](Status status, std::map<std::string, std::string> &&,
+                        std::string &&body) {
         if (status.code() < 0) {
           env_->LogError("Trace Request Failed." + status.ToString());
-        } else {
+        } else if (log_debug) {
           env_->LogDebug("Trace Response: " + status.ToString() + "\n" + body);
         }
       }));
@@ -166,33 +184,89 @@ void Aggregator::SendAndClearTraces() {
       cloud_trace_address_ + "/v1/projects/" + project_id_ + "/traces";
 
   std::string request_body;
-
-  ProtoToJson(*traces_, &request_body, utils::DEFAULT);
-  traces_->clear_traces();
-  env_->LogDebug("Sending request to Cloud Trace.");
-  env_->LogDebug(request_body);
+  if (binary_export_) {
+    request_body.swap(batch_);
+  } else {
+    // Add project id into each trace object.
+    for (int i = 0; i < traces_->traces_size(); ++i) {
+      traces_->mutable_traces(i)->set_project_id(project_id_);
+    }
+    ProtoToJson(*traces_, &request_body, utils::DEFAULT);
+  }
+  if (log_debug) {
+    env_->LogDebug("Sending request to Cloud Trace: " +
+                   std::to_string(batch_traces_) + " traces, " +
+                   std::to_string(request_body.size()) + " bytes.");
+    if (!binary_export_) {
+      env_->LogDebug(request_body);
+    }
+  }
+  ResetBatch();
 
   http_request->set_url(url)
       .set_method("PATCH")
       .set_auth_token(sa_token_->GetAuthToken(
           auth::ServiceAccountToken::JWT_TOKEN_FOR_CLOUD_TRACING))
-      .set_header("Content-Type", "application/json")
+      .set_header("Content-Type", binary_export_ ? "application/x-protobuf"
+                                                 : "application/json")
       .set_body(request_body);
 
   env_->RunHTTPRequest(std::move(http_request));
 }
 
-void Aggregator::AppendTrace(google::devtools::cloudtrace::v1::Trace *trace) {
-  traces_->mutable_traces()->AddAllocated(trace);
-  if (traces_->traces_size() > cache_max_size_) {
+void Aggregator::AppendTrace(Trace *trace) {
+  if (binary_export_) {
+    // The project id is only known when the trace is appended, as the
+    // trace is serialized right away.
+    if (project_id_.empty()) {
+      env_->LogDebug("Dropping trace: project_id is empty.");
+      return;
+    }
+    trace->set_project_id(project_id_);
+    // Appends the trace as a "traces" field of the Traces message.
+    int size = trace->ByteSize();
+    {
+      protobuf::io::StringOutputStream output(&batch_);
+      protobuf::io::CodedOutputStream coded_output(&output);
+      WireFormatLite::WriteTag(Traces::kTracesFieldNumber,
+                               WireFormatLite::WIRETYPE_LENGTH_DELIMITED,
+                               &coded_output);
+      coded_output.WriteVarint32(size);
+      trace->SerializeWithCachedSizes(&coded_output);
+    }
+    batch_bytes_ = batch_.size();
+  } else {
+    traces_->add_traces()->CopyFrom(*trace);
+    if (max_batch_bytes_ > 0) {
+      batch_bytes_ += trace->ByteSize();
+    }
+  }
+  ++batch_traces_;
+  if (batch_traces_ > cache_max_size_ ||
+      (max_batch_bytes_ > 0 && batch_bytes_ >= max_batch_bytes_)) {
     SendAndClearTraces();
   }
 }
 
-CloudTrace::CloudTrace(Trace *trace, const std::string &options)
-    : trace_(trace), options_(options) {
-  // Root span must exist and must be the only span as of now.
-  root_span_ = trace_->mutable_spans(0);
+CloudTrace::CloudTrace(const std::string &trace_id,
+                       const std::string &root_span_name,
+                       protobuf::uint64 parent_span_id,
+                       const std::string &options)
+    : trace_(Arena::CreateMessage<Trace>(&arena_)), options_(options) {
+  trace_->set_trace_id(trace_id);
+  root_span_ = trace_->add_spans();
+  root_span_->set_kind(TraceSpan_SpanKind::TraceSpan_SpanKind_RPC_SERVER);
+  root_span_->set_span_id(RandomUInt64());
+  // Set parent of root span to the given one if provided.
+  if (parent_span_id != 0) {
+    root_span_->set_parent_span_id(parent_span_id);
+  }
+  root_span_->set_name(root_span_name);
+  // Agent label is defined as "<agent>/<version>".
+  root_span_->mutable_labels()->insert(
+      {kCloudTraceAgentKey,
+       kServiceAgentPrefix + utils::Version::instance().get()});
+  GetNow(root_span_->mutable_start_time());
 }
 
 void CloudTrace::SetProjectId(const std::string &project_id) {
@@ -201,19 +275,17 @@ void CloudTrace::SetProjectId(const std::string &project_id) {
 
 void CloudTrace::EndRootSpan() { GetNow(root_span_->mutable_end_time()); }
 
-CloudTraceSpan::CloudTraceSpan(CloudTrace *cloud_trace,
-                               const std::string &span_name)
-    : cloud_trace_(cloud_trace) {
+CloudTraceSpan::CloudTraceSpan(CloudTrace *cloud_trace, const char *span_name)
+    : cloud_trace_(cloud_trace), num_messages_(0) {
   InitWithParentSpanId(span_name, cloud_trace_->root_span()->span_id());
 }
 
-CloudTraceSpan::CloudTraceSpan(CloudTraceSpan *parent,
-                               const std::string &span_name)
-    : cloud_trace_(parent->cloud_trace_) {
+CloudTraceSpan::CloudTraceSpan(CloudTraceSpan *parent, const char *span_name)
+    : cloud_trace_(parent->cloud_trace_), num_messages_(0) {
   InitWithParentSpanId(span_name, parent->trace_span_->span_id());
 }
 
-void CloudTraceSpan::InitWithParentSpanId(const std::string &span_name,
+void CloudTraceSpan::InitWithParentSpanId(const char *span_name,
                                           protobuf::uint64 parent_span_id) {
   // TODO: this if is not needed, and probably the following two as well.
   // Fully test and remove them.
@@ -235,12 +307,6 @@ CloudTraceSpan::~CloudTraceSpan() {
     return;
   }
   GetNow(trace_span_->mutable_end_time());
-  for (unsigned int i = 0; i < messages.size(); ++i) {
-    std::stringstream stream;
-    stream << std::setfill('0') << std::setw(3) << i;
-    std::string sequence = stream.str();
-    trace_span_->mutable_labels()->insert({sequence, messages[i]});
-  }
 }
 
 void CloudTraceSpan::Write(const std::string &msg) {
@@ -248,32 +314,35 @@ void CloudTraceSpan::Write(const std::string &msg) {
     // Trace is disabled.
     return;
   }
-  messages.push_back(msg);
+  char sequence[16];
+  snprintf(sequence, sizeof(sequence), "%03u", num_messages_++);
+  (*trace_span_->mutable_labels())[sequence] = msg;
 }
 
 CloudTrace *CreateCloudTrace(const std::string &trace_context,
                              const std::string &root_span_name,
                              Sampler *sampler) {
-  Trace *trace = nullptr;
+  std::string trace_id;
+  uint64_t parent_span_id = 0;
   std::string options;
-  GetTraceFromContextHeader(trace_context, root_span_name, &trace, &options);
-  if (trace) {
+  if (GetTraceFromContextHeader(trace_context, &trace_id, &parent_span_id,
+                                &options)) {
     // When trace is triggered by the context header, refresh the previous
     // timestamp in sampler.
     if (sampler) {
       sampler->Refresh();
     }
-    return new CloudTrace(trace, options);
+    return new CloudTrace(trace_id, root_span_name, parent_span_id, options);
   } else if (sampler && sampler->On()) {
     // Trace is turned on by sampler.
-    GetNewTrace(RandomUInt128HexString(), root_span_name, &trace);
-    return new CloudTrace(trace, kDefaultTraceOptions);
+    return new CloudTrace(RandomUInt128HexString(), root_span_name, 0,
+                          kDefaultTraceOptions);
   } else {
     return nullptr;
   }
 }
 
-CloudTraceSpan *CreateSpan(CloudTrace *cloud_trace, const std::string &name) {
+CloudTraceSpan *CreateSpan(CloudTrace *cloud_trace, const char *name) {
   if (cloud_trace != nullptr) {
     return new CloudTraceSpan(cloud_trace, name);
   } else {
@@ -281,8 +350,7 @@ CloudTraceSpan *CreateSpan(CloudTrace *cloud_trace, const std::string &name) {
   }
 }
 
-CloudTraceSpan *CreateChildSpan(CloudTraceSpan *parent,
-                                const std::string &name) {
+CloudTraceSpan *CreateChildSpan(CloudTraceSpan *parent, const char *name) {
   if (parent != nullptr) {
     return new CloudTraceSpan(parent, name);
   } else {
@@ -323,30 +391,15 @@ void GetNow(Timestamp *ts) {
   ts->set_nanos(nanos % 1000000000);
 }
 
-void GetNewTrace(std::string trace_id_str, const std::string &root_span_name,
-                 Trace **trace) {
-  *trace = new Trace;
-  (*trace)->set_trace_id(trace_id_str);
-  TraceSpan *root_span = (*trace)->add_spans();
-  root_span->set_kind(TraceSpan_SpanKind::TraceSpan_SpanKind_RPC_SERVER);
-  root_span->set_span_id(RandomUInt64());
-  root_span->set_name(root_span_name);
-  // Agent label is defined as "<agent>/<version>".
-  root_span->mutable_labels()->insert(
-      {kCloudTraceAgentKey,
-       kServiceAgentPrefix + utils::Version::instance().get()});
-  GetNow(root_span->mutable_start_time());
-}
-
-void GetTraceFromContextHeader(const std::string &trace_context,
-                               const std::string &root_span_name, Trace **trace,
-                               std::string *options) {
+bool GetTraceFromContextHeader(const std::string &trace_context,
+                               std::string *trace_id,
+                               uint64_t *parent_span_id, std::string *options) {
   std::stringstream header_stream(trace_context);
 
   std::string trace_and_span_id;
   if (!getline(header_stream, trace_and_span_id, ';')) {
     // When trace_context is empty;
-    return;
+    return false;
   }
 
   bool trace_enabled = false;
@@ -356,16 +409,16 @@ void GetTraceFromContextHeader(const std::string &trace_context,
       int value;
       std::stringstream option_stream(item.substr(2));
       if ((option_stream >> value).fail() || !option_stream.eof()) {
-        return;
+        return false;
       }
       if (value < 0 || value > 0b11) {
         // invalid option value.
-        return;
+        return false;
       }
       *options = trace_context.substr(trace_context.find_first_of(';') + 1);
       // First bit indicates whether trace is enabled.
       if (!(value & 1)) {
-        return;
+        return false;
       }
       // Trace is enabled, we can stop parsing the header.
       trace_enabled = true;
@@ -373,7 +426,7 @@ void GetTraceFromContextHeader(const std::string &trace_context,
     }
   }
   if (!trace_enabled) {
-    return;
+    return false;
   }
 
   // Parse trace_id/span_id
@@ -388,11 +441,11 @@ void GetTraceFromContextHeader(const std::string &trace_context,
 
   // Trace id should be a 128-bit hex number (32 hex digits).
   if (trace_id_str.size() != 32) {
-    return;
+    return false;
   }
   for (size_t i = 0; i < trace_id_str.size(); ++i) {
     if (!isxdigit(trace_id_str[i])) {
-      return;
+      return false;
     }
   }
 
@@ -401,17 +454,14 @@ void GetTraceFromContextHeader(const std::string &trace_context,
   if (!span_id_str.empty()) {
     std::stringstream span_id_stream(span_id_str);
     if ((span_id_stream >> span_id).fail() || !span_id_stream.eof()) {
-      return;
+      return false;
     }
   }
 
   // At this point, trace is enabled and trace id is successfully parsed.
-  GetNewTrace(trace_id_str, root_span_name, trace);
-  TraceSpan *root_span = (*trace)->mutable_spans(0);
-  // Set parent of root span to the given one if provided.
-  if (span_id != 0) {
-    root_span->set_parent_span_id(span_id);
-  }
+  *trace_id = trace_id_str;
+  *parent_span_id = span_id;
+  return true;
 }
 
 }  // namespace
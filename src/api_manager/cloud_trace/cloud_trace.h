@@ -20,6 +20,7 @@
 #include <vector>
 
 #include "google/devtools/cloudtrace/v1/trace.pb.h"
+#include "google/protobuf/arena.h"
 #include "google/protobuf/map.h"
 #include "include/api_manager/env_interface.h"
 #include "include/api_manager/periodic_timer.h"
@@ -29,6 +30,16 @@ namespace google {
 namespace api_manager {
 namespace cloud_trace {
 
+// Names of the trace spans created by the api manager.
+extern const char kCheckAuthSpanName[];
+extern const char kHttpFetchSpanName[];
+extern const char kCheckServiceControlSpanName[];
+extern const char kCheckServiceControlCacheSpanName[];
+extern const char kQuotaControlSpanName[];
+extern const char kQuotaServiceControlCacheSpanName[];
+extern const char kServiceControlCallSpanName[];
+extern const char kBackendSpanName[];
+
 // A helper class to determine if trace should be enabled for a request.
 // A Sampler instance is put into the Aggregator class.
 // Trace is triggered if the time interval between the request time and the
@@ -56,10 +67,15 @@ class Sampler {
 // only one such instance. The instance is put in service_context.
 class Aggregator final {
  public:
+  // If binary_export is true, traces are sent as binary protobuf instead of
+  // JSON. Cached traces are sent once there are more than cache_max_size of
+  // them, or once their encoded size reaches max_batch_bytes if it is
+  // positive.
   Aggregator(auth::ServiceAccountToken *sa_token,
              const std::string &cloud_trace_address,
              int aggregate_time_millisec, int cache_max_size,
-             double minimum_qps, ApiManagerEnvInterface *env);
+             int max_batch_bytes, bool binary_export, double minimum_qps,
+             ApiManagerEnvInterface *env);
 
   ~Aggregator();
 
@@ -70,8 +86,9 @@ class Aggregator final {
   // Flush traces cached and clear the traces_ proto.
   void SendAndClearTraces();
 
-  // Append a Trace to traces_, the appended trace may not be sent at the time
-  // of this function call.
+  // Appends a copy of the Trace to the cached traces, the appended trace may
+  // not be sent at the time of this function call. The project id of the
+  // trace is set to the producer project id.
   void AppendTrace(google::devtools::cloudtrace::v1::Trace *trace);
 
   // Sets the producer project id
@@ -81,6 +98,9 @@ class Aggregator final {
   Sampler &sampler() { return sampler_; }
 
  private:
+  // Starts a new batch of traces.
+  void ResetBatch();
+
   // ServiceAccountToken object to get auth tokens for Cloud Trace API.
   auth::ServiceAccountToken *sa_token_;
 
@@ -93,8 +113,25 @@ class Aggregator final {
   // The maximum number of traces that can be cached.
   int cache_max_size_;
 
-  // Traces protobuf to hold a list of Trace obejcts.
-  std::unique_ptr<google::devtools::cloudtrace::v1::Traces> traces_;
+  // The maximum encoded size of the cached traces, 0 if unlimited.
+  int max_batch_bytes_;
+
+  // Whether traces are sent as binary protobuf.
+  bool binary_export_;
+
+  // Arena holding the cached traces, freed once they are sent.
+  std::unique_ptr<protobuf::Arena> batch_arena_;
+
+  // Traces protobuf to hold a list of Trace objects, in JSON export mode.
+  google::devtools::cloudtrace::v1::Traces *traces_;
+
+  // The serialized Traces protobuf, in binary export mode. Traces are
+  // appended as encoded repeated fields, so they are never copied.
+  std::string batch_;
+
+  // The number of cached traces and their encoded size.
+  int batch_traces_;
+  int batch_bytes_;
 
   // The producer project id.
   std::string project_id_;
@@ -115,12 +152,15 @@ class Aggregator final {
 // ESP_ROOT that will be a parent span of all other trace spans. Start time
 // of this root span is recorded in constructor and end time is recorded when
 // EndRootSpan is called.
+//
+// The Trace proto and its spans are allocated in an arena owned by the
+// instance, and are all freed at once with it.
 class CloudTrace final {
  public:
-  // Construct with give Trace proto object. This constructor must only be
-  // called with non-null pointer.
-  CloudTrace(google::devtools::cloudtrace::v1::Trace *trace,
-             const std::string &options);
+  // Creates a trace with the given trace id and a root span with the given
+  // name and parent span id, 0 if the root span has no parent.
+  CloudTrace(const std::string &trace_id, const std::string &root_span_name,
+             protobuf::uint64 parent_span_id, const std::string &options);
 
   void SetProjectId(const std::string &project_id);
 
@@ -130,17 +170,13 @@ class CloudTrace final {
     return root_span_;
   }
 
-  google::devtools::cloudtrace::v1::Trace *trace() { return trace_.get(); }
-
-  // Releases ownership of all traces and returns it.
-  google::devtools::cloudtrace::v1::Trace *ReleaseTrace() {
-    return trace_.release();
-  }
+  google::devtools::cloudtrace::v1::Trace *trace() { return trace_; }
 
   const std::string &options() const { return options_; }
 
  private:
-  std::unique_ptr<google::devtools::cloudtrace::v1::Trace> trace_;
+  protobuf::Arena arena_;
+  google::devtools::cloudtrace::v1::Trace *trace_;
   google::devtools::cloudtrace::v1::TraceSpan *root_span_;
   std::string options_;
 };
@@ -149,8 +185,8 @@ class CloudTrace final {
 // multiple trace spans for one request. Typically an instance of this class is
 // initialized at the beginning of a function that needs to be traced.
 //
-// When an instance of CloudTraceSpan is destructed, its messages are written
-// to the corresponding CloudTrace.
+// Messages are written to the labels of the span as they come, keyed by their
+// sequence number.
 //
 // Start time and end time of the trace span is recorded in constructor and
 // destructor.
@@ -162,10 +198,10 @@ class CloudTrace final {
 class CloudTraceSpan {
  public:
   // Initializes a trace span whose parent is the api manager root.
-  CloudTraceSpan(CloudTrace *cloud_trace, const std::string &span_name);
+  CloudTraceSpan(CloudTrace *cloud_trace, const char *span_name);
 
   // Initializes a trace span using the given trace span as parent.
-  CloudTraceSpan(CloudTraceSpan *parent, const std::string &span_name);
+  CloudTraceSpan(CloudTraceSpan *parent, const char *span_name);
 
   ~CloudTraceSpan();
 
@@ -176,11 +212,12 @@ class CloudTraceSpan {
  private:
   friend class TraceStream;
   void Write(const std::string &msg);
-  void InitWithParentSpanId(const std::string &span_name,
+  void InitWithParentSpanId(const char *span_name,
                             protobuf::uint64 parent_span_id);
   CloudTrace *cloud_trace_;
   google::devtools::cloudtrace::v1::TraceSpan *trace_span_;
-  std::vector<std::string> messages;
+  // The number of messages written, used as the label key of the next one.
+  unsigned int num_messages_;
 };
 
 // Parses the trace_context and determines if cloud trace should
@@ -193,12 +230,11 @@ CloudTrace *CreateCloudTrace(const std::string &trace_context,
 
 // Creates trace span if trace is enabled.
 // Returns nullptr when cloud_trace is nullptr.
-CloudTraceSpan *CreateSpan(CloudTrace *cloud_trace, const std::string &name);
+CloudTraceSpan *CreateSpan(CloudTrace *cloud_trace, const char *name);
 
 // Creates a child trace span with the given parent span.
 // Returns nullptr if parent is nullptr.
-CloudTraceSpan *CreateChildSpan(CloudTraceSpan *parent,
-                                const std::string &name);
+CloudTraceSpan *CreateChildSpan(CloudTraceSpan *parent, const char *name);
 
 // A helper class to create a stream-like write traces interface.
 //
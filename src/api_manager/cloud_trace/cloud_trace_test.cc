@@ -20,6 +20,9 @@
 #include "gtest/gtest.h"
 #include "src/api_manager/mock_api_manager_environment.h"
 
+using ::testing::_;
+using ::testing::Invoke;
+using google::devtools::cloudtrace::v1::Traces;
 using google::devtools::cloudtrace::v1::TraceSpan;
 
 namespace google {
@@ -198,6 +201,101 @@ TEST_F(CloudTraceTest, TestParseContextHeader) {
   ASSERT_EQ("o=1;foo=bar", cloud_trace->options());
 }
 
+TEST_F(CloudTraceTest, TestAggregatorBinaryExport) {
+  ::testing::NiceMock<MockApiManagerEnvironment> env;
+  // Traces are sent once their size reaches 1 byte.
+  Aggregator aggregator(sa_token_.get(), "https://cloudtrace.googleapis.com",
+                        0, 100, 1, true, 0, &env);
+  aggregator.SetProjectId("test-project");
+
+  std::unique_ptr<CloudTrace> cloud_trace(
+      CreateCloudTrace("e133eacd437d8a12068fd902af3962d8;o=1", "root-span"));
+  ASSERT_TRUE(cloud_trace);
+
+  HTTPRequest request(nullptr);
+  EXPECT_CALL(env, DoRunHTTPRequest(_))
+      .WillOnce(Invoke([&request](HTTPRequest *req) {
+        request.set_url(req->url()).set_body(req->body());
+        for (const auto &header : req->request_headers()) {
+          request.set_header(header.first, header.second);
+        }
+      }));
+  aggregator.AppendTrace(cloud_trace->trace());
+  ::testing::Mock::VerifyAndClearExpectations(&env);
+
+  ASSERT_EQ("application/x-protobuf",
+            request.request_headers().find("Content-Type")->second);
+  ASSERT_EQ(
+      "https://cloudtrace.googleapis.com/v1/projects/test-project/traces",
+      request.url());
+  Traces traces;
+  ASSERT_TRUE(traces.ParseFromString(request.body()));
+  ASSERT_EQ(1, traces.traces_size());
+  ASSERT_EQ("test-project", traces.traces(0).project_id());
+  ASSERT_EQ("e133eacd437d8a12068fd902af3962d8", traces.traces(0).trace_id());
+  ASSERT_EQ("root-span", traces.traces(0).spans(0).name());
+}
+
+TEST_F(CloudTraceTest, TestAggregatorBatchSize) {
+  ::testing::NiceMock<MockApiManagerEnvironment> env;
+  Aggregator aggregator(sa_token_.get(), "https://cloudtrace.googleapis.com",
+                        0, 100, 1 << 20, true, 0, &env);
+  aggregator.SetProjectId("test-project");
+
+  std::unique_ptr<CloudTrace> cloud_trace(
+      CreateCloudTrace("e133eacd437d8a12068fd902af3962d8;o=1", "root-span"));
+  ASSERT_TRUE(cloud_trace);
+
+  // Traces are cached until they are flushed.
+  EXPECT_CALL(env, DoRunHTTPRequest(_)).Times(0);
+  aggregator.AppendTrace(cloud_trace->trace());
+  aggregator.AppendTrace(cloud_trace->trace());
+  ::testing::Mock::VerifyAndClearExpectations(&env);
+
+  std::string body;
+  EXPECT_CALL(env, DoRunHTTPRequest(_))
+      .WillOnce(Invoke([&body](HTTPRequest *req) { body = req->body(); }));
+  aggregator.SendAndClearTraces();
+
+  Traces traces;
+  ASSERT_TRUE(traces.ParseFromString(body));
+  ASSERT_EQ(2, traces.traces_size());
+
+  // Nothing left to send.
+  EXPECT_CALL(env, DoRunHTTPRequest(_)).Times(0);
+  aggregator.SendAndClearTraces();
+}
+
+TEST_F(CloudTraceTest, TestAggregatorJsonExport) {
+  ::testing::NiceMock<MockApiManagerEnvironment> env;
+  // Traces are sent once there are more than one of them.
+  Aggregator aggregator(sa_token_.get(), "https://cloudtrace.googleapis.com",
+                        0, 1, 1 << 20, false, 0, &env);
+  aggregator.SetProjectId("test-project");
+
+  std::unique_ptr<CloudTrace> cloud_trace(
+      CreateCloudTrace("e133eacd437d8a12068fd902af3962d8;o=1", "root-span"));
+  ASSERT_TRUE(cloud_trace);
+
+  HTTPRequest request(nullptr);
+  EXPECT_CALL(env, DoRunHTTPRequest(_))
+      .WillOnce(Invoke([&request](HTTPRequest *req) {
+        request.set_url(req->url()).set_body(req->body());
+        for (const auto &header : req->request_headers()) {
+          request.set_header(header.first, header.second);
+        }
+      }));
+  aggregator.AppendTrace(cloud_trace->trace());
+  ASSERT_TRUE(request.body().empty());
+  aggregator.AppendTrace(cloud_trace->trace());
+  ::testing::Mock::VerifyAndClearExpectations(&env);
+
+  ASSERT_EQ("application/json",
+            request.request_headers().find("Content-Type")->second);
+  ASSERT_NE(std::string::npos,
+            request.body().find("\"projectId\":\"test-project\""));
+}
+
 }  // namespace
 
 }  // cloud_trace
@@ -0,0 +1,282 @@
+// Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/api_manager/compiled_path_matcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "src/api_manager/http_template.h"
+
+namespace google {
+namespace api_manager {
+
+namespace {
+
+const char* const kInternedHttpMethods[] = {
+    "GET", "POST", "PUT", "DELETE", "PATCH", "HEAD", "OPTIONS", "*",
+};
+
+// Compares two strings given as pointer and size, like std::string::compare.
+int CompareStrings(const char* a, size_t a_size, const char* b,
+                   size_t b_size) {
+  int result = memcmp(a, b, std::min(a_size, b_size));
+  if (result != 0) {
+    return result;
+  }
+  return a_size < b_size ? -1 : (a_size > b_size ? 1 : 0);
+}
+
+}  // namespace
+
+HttpMethodId InternHttpMethod(const std::string& http_method) {
+  for (int i = 0; i < HTTP_METHOD_OTHER; ++i) {
+    if (http_method == kInternedHttpMethods[i]) {
+      return static_cast<HttpMethodId>(i);
+    }
+  }
+  return HTTP_METHOD_OTHER;
+}
+
+CompiledPathMatcher::Node::Node()
+    : first_edge(0),
+      num_edges(0),
+      single_parameter_child(-1),
+      wild_card_path_part_child(-1),
+      wild_card_path_child(-1),
+      wildcard(false),
+      first_other(0),
+      num_others(0) {}
+
+CompiledPathMatcher::CompiledPathMatcher(
+    const PathMatcherNode& root, const std::set<std::string>& custom_verbs)
+    : custom_verbs_(custom_verbs.begin(), custom_verbs.end()) {
+  Flatten(root);
+}
+
+int CompiledPathMatcher::Flatten(const PathMatcherNode& node) {
+  int index = nodes_.size();
+  nodes_.emplace_back();
+  nodes_[index].wildcard = node.wildcard_;
+
+  size_t first_other = others_.size();
+  for (const auto& entry : node.result_map_) {
+    HttpMethodId method_id = InternHttpMethod(entry.first);
+    if (method_id == HTTP_METHOD_OTHER) {
+      others_.push_back({entry.first, entry.second});
+    } else {
+      nodes_[index].results[method_id] = entry.second;
+    }
+  }
+  nodes_[index].first_other = first_other;
+  nodes_[index].num_others = others_.size() - first_other;
+
+  // Flattens the children first, so that the edges of this node are
+  // contiguous in edges_.
+  std::vector<std::pair<std::string, int>> children;
+  for (const auto& entry : node.children_) {
+    children.emplace_back(entry.first, Flatten(*entry.second));
+  }
+  std::sort(children.begin(), children.end());
+
+  // nodes_ may have been reallocated by the recursive calls.
+  Node& flat = nodes_[index];
+  flat.first_edge = edges_.size();
+  flat.num_edges = children.size();
+  for (const auto& child : children) {
+    edges_.push_back({labels_.size(), child.first.size(), child.second});
+    labels_ += child.first;
+    if (child.first == HttpTemplate::kSingleParameterKey) {
+      flat.single_parameter_child = child.second;
+    } else if (child.first == HttpTemplate::kWildCardPathPartKey) {
+      flat.wild_card_path_part_child = child.second;
+    } else if (child.first == HttpTemplate::kWildCardPathKey) {
+      flat.wild_card_path_child = child.second;
+    }
+  }
+  return index;
+}
+
+size_t CompiledPathMatcher::ExtractRequestParts(const std::string& path,
+                                                PathSegment* segments,
+                                                size_t max_segments) const {
+  // Ignores query parameters.
+  size_t end = path.find('?');
+  if (end == std::string::npos) {
+    end = path.size();
+  }
+
+  // The last ':' starts a custom verb if it is after the last '/' and the
+  // verb is configured. But not for /foo:bar/const.
+  size_t verb_colon = std::string::npos;
+  size_t last_colon = std::string::npos;
+  for (size_t i = end; i > 0; --i) {
+    char c = path[i - 1];
+    if (c == '/') {
+      if (last_colon != std::string::npos &&
+          IsCustomVerb({path.data() + last_colon + 1, end - last_colon - 1})) {
+        verb_colon = last_colon;
+      }
+      break;
+    }
+    if (c == ':' && last_colon == std::string::npos) {
+      last_colon = i - 1;
+    }
+  }
+
+  // Splits the path after the leading character, a custom verb is a separate
+  // segment. Trailing empty segments caused by extra "/" are dropped.
+  size_t count = 0;
+  size_t non_empty_count = 0;
+  if (end > 0) {
+    size_t start = 1;
+    for (size_t i = 1; i <= end; ++i) {
+      if (i == end || path[i] == '/' || i == verb_colon) {
+        if (count < max_segments) {
+          segments[count] = {path.data() + start, i - start};
+        }
+        ++count;
+        if (i > start) {
+          non_empty_count = count;
+        }
+        start = i + 1;
+      }
+    }
+  }
+  return non_empty_count;
+}
+
+PathMatcherLookupResult CompiledPathMatcher::Lookup(
+    const std::string& http_method, const PathSegment* segments,
+    size_t num_segments) const {
+  PathMatcherLookupResult result;
+  LookupPath(nodes_[0], segments, segments + num_segments,
+             InternHttpMethod(http_method), http_method, &result);
+  return result;
+}
+
+int CompiledPathMatcher::FindLiteralChild(const Node& node,
+                                          const PathSegment& segment) const {
+  const Edge* begin = edges_.data() + node.first_edge;
+  const Edge* end = begin + node.num_edges;
+  const Edge* it = std::lower_bound(
+      begin, end, segment, [this](const Edge& edge, const PathSegment& s) {
+        return CompareStrings(labels_.data() + edge.label_offset,
+                              edge.label_size, s.data, s.size) < 0;
+      });
+  if (it != end &&
+      CompareStrings(labels_.data() + it->label_offset, it->label_size,
+                     segment.data, segment.size) == 0) {
+    return it->child;
+  }
+  return -1;
+}
+
+// Mirrors PathMatcherNode::LookupPath: the literal child is tried first, then
+// the single-parameter, the "*" and the "**" children, in this order.
+void CompiledPathMatcher::LookupPath(const Node& node,
+                                     const PathSegment* current,
+                                     const PathSegment* end,
+                                     HttpMethodId method_id,
+                                     const std::string& http_method,
+                                     PathMatcherLookupResult* result) const {
+  if (current == end) {
+    if (!GetResultForHttpMethod(node, method_id, http_method, result) &&
+        node.wild_card_path_child >= 0) {
+      // Matches the root with wildcard templates.
+      GetResultForHttpMethod(nodes_[node.wild_card_path_child], method_id,
+                             http_method, result);
+    }
+    return;
+  }
+  if (LookupPathFromChild(FindLiteralChild(node, *current), current, end,
+                          method_id, http_method, result)) {
+    return;
+  }
+  if (node.wildcard) {
+    LookupPath(node, current + 1, end, method_id, http_method, result);
+    return;
+  }
+  for (int child : {node.single_parameter_child,
+                    node.wild_card_path_part_child,
+                    node.wild_card_path_child}) {
+    if (LookupPathFromChild(child, current, end, method_id, http_method,
+                            result)) {
+      return;
+    }
+  }
+}
+
+bool CompiledPathMatcher::LookupPathFromChild(
+    int child, const PathSegment* current, const PathSegment* end,
+    HttpMethodId method_id, const std::string& http_method,
+    PathMatcherLookupResult* result) const {
+  if (child < 0) {
+    return false;
+  }
+  LookupPath(nodes_[child], current + 1, end, method_id, http_method, result);
+  return result->data != nullptr;
+}
+
+bool CompiledPathMatcher::GetResultForHttpMethod(
+    const Node& node, HttpMethodId method_id, const std::string& http_method,
+    PathMatcherLookupResult* result) const {
+  if (method_id != HTTP_METHOD_OTHER) {
+    if (node.results[method_id].data != nullptr) {
+      *result = node.results[method_id];
+      return true;
+    }
+  } else {
+    for (size_t i = node.first_other; i < node.first_other + node.num_others;
+         ++i) {
+      if (others_[i].http_method == http_method) {
+        *result = others_[i].result;
+        return true;
+      }
+    }
+  }
+  if (node.results[HTTP_METHOD_WILD_CARD].data != nullptr) {
+    *result = node.results[HTTP_METHOD_WILD_CARD];
+    return true;
+  }
+  return false;
+}
+
+bool CompiledPathMatcher::IsCustomVerb(const PathSegment& segment) const {
+  auto it = std::lower_bound(
+      custom_verbs_.begin(), custom_verbs_.end(), segment,
+      [](const std::string& verb, const PathSegment& s) {
+        return CompareStrings(verb.data(), verb.size(), s.data, s.size) < 0;
+      });
+  return it != custom_verbs_.end() &&
+         CompareStrings(it->data(), it->size(), segment.data, segment.size) ==
+             0;
+}
+
+RequestPathSegments::RequestPathSegments(const CompiledPathMatcher& matcher,
+                                         const std::string& path)
+    : data_(inline_segments_) {
+  size_ = matcher.ExtractRequestParts(path, inline_segments_, kInlineSegments);
+  if (size_ > kInlineSegments) {
+    overflow_segments_.resize(size_);
+    matcher.ExtractRequestParts(path, overflow_segments_.data(), size_);
+    data_ = overflow_segments_.data();
+  }
+}
+
+}  // namespace api_manager
+}  // namespace google
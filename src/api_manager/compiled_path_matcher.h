@@ -0,0 +1,176 @@
+/* Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_COMPILED_PATH_MATCHER_H_
+#define API_MANAGER_COMPILED_PATH_MATCHER_H_
+
+#include <cstddef>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "src/api_manager/path_matcher_node.h"
+
+namespace google {
+namespace api_manager {
+
+// A segment of a request path. Points into the request path string, which
+// must outlive it.
+struct PathSegment {
+  const char* data;
+  size_t size;
+};
+
+// The HTTP methods interned by the compiled matcher. Templates registered for
+// any other method are looked up by name.
+enum HttpMethodId {
+  HTTP_METHOD_GET,
+  HTTP_METHOD_POST,
+  HTTP_METHOD_PUT,
+  HTTP_METHOD_DELETE,
+  HTTP_METHOD_PATCH,
+  HTTP_METHOD_HEAD,
+  HTTP_METHOD_OPTIONS,
+  // The "*" method, matching any HTTP method.
+  HTTP_METHOD_WILD_CARD,
+  HTTP_METHOD_OTHER,
+};
+
+// Returns the interned id of the HTTP method, HTTP_METHOD_OTHER if the method
+// is not interned.
+HttpMethodId InternHttpMethod(const std::string& http_method);
+
+// CompiledPathMatcher is an immutable, flattened copy of a PathMatcherNode
+// trie. The nodes, the literal edges and the edge labels are stored in
+// contiguous arrays, so that a lookup only scans the request path in place
+// and never allocates.
+//
+// Lookup semantics are identical to PathMatcherNode::LookupPath.
+//
+// Thread safe.
+class CompiledPathMatcher {
+ public:
+  CompiledPathMatcher(const PathMatcherNode& root,
+                      const std::set<std::string>& custom_verbs);
+
+  // Splits the request path into slash separated segments, in the same way
+  // as the trie lookup does:
+  //
+  // - Strips off query string: "/a?foo=bar" --> "/a"
+  // - Collapses trailing slashes: "/a///" --> "/a"
+  // - Splits a configured custom verb into its own segment:
+  //   "/a:verb" --> "a", "verb"
+  //
+  // Writes at most max_segments segments and returns the number of segments
+  // in the path, which may be larger than max_segments.
+  size_t ExtractRequestParts(const std::string& path, PathSegment* segments,
+                             size_t max_segments) const;
+
+  // Looks up the segments of a request path.
+  PathMatcherLookupResult Lookup(const std::string& http_method,
+                                 const PathSegment* segments,
+                                 size_t num_segments) const;
+
+ private:
+  // A literal edge to a child node. The label is stored in labels_.
+  struct Edge {
+    size_t label_offset;
+    size_t label_size;
+    int child;
+  };
+
+  struct Node {
+    Node();
+
+    // The literal children in edges_, sorted by label. The "/.", "*" and
+    // "**" children are included, as a request segment may match them
+    // literally.
+    size_t first_edge;
+    size_t num_edges;
+    // The "/.", "*" and "**" children, -1 if there is no such child.
+    int single_parameter_child;
+    int wild_card_path_part_child;
+    int wild_card_path_child;
+    // True if this node represents a wildcard path '**'.
+    bool wildcard;
+    // The results registered for the interned HTTP methods. The data is
+    // nullptr if no result is registered for the method.
+    PathMatcherLookupResult results[HTTP_METHOD_OTHER];
+    // The results registered for the other HTTP methods, in others_.
+    size_t first_other;
+    size_t num_others;
+  };
+
+  struct OtherResult {
+    HttpMethod http_method;
+    PathMatcherLookupResult result;
+  };
+
+  // Copies the subtrie of the node into the arrays, returns the node index.
+  int Flatten(const PathMatcherNode& node);
+
+  // Returns the child matching the segment literally, -1 if there is none.
+  int FindLiteralChild(const Node& node, const PathSegment& segment) const;
+
+  void LookupPath(const Node& node, const PathSegment* current,
+                  const PathSegment* end, HttpMethodId method_id,
+                  const std::string& http_method,
+                  PathMatcherLookupResult* result) const;
+
+  bool LookupPathFromChild(int child, const PathSegment* current,
+                           const PathSegment* end, HttpMethodId method_id,
+                           const std::string& http_method,
+                           PathMatcherLookupResult* result) const;
+
+  bool GetResultForHttpMethod(const Node& node, HttpMethodId method_id,
+                              const std::string& http_method,
+                              PathMatcherLookupResult* result) const;
+
+  // Returns true if the segment is a configured custom verb.
+  bool IsCustomVerb(const PathSegment& segment) const;
+
+  std::vector<Node> nodes_;
+  std::vector<Edge> edges_;
+  std::string labels_;
+  std::vector<OtherResult> others_;
+  // The configured custom verbs, sorted.
+  std::vector<std::string> custom_verbs_;
+};
+
+// The segments of a request path. Segments are kept on the stack unless the
+// path has more than kInlineSegments segments.
+class RequestPathSegments {
+ public:
+  RequestPathSegments(const CompiledPathMatcher& matcher,
+                      const std::string& path);
+
+  const PathSegment* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  RequestPathSegments(const RequestPathSegments&) = delete;
+  RequestPathSegments& operator=(const RequestPathSegments&) = delete;
+
+  static const size_t kInlineSegments = 32;
+
+  PathSegment inline_segments_[kInlineSegments];
+  std::vector<PathSegment> overflow_segments_;
+  const PathSegment* data_;
+  size_t size_;
+};
+
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_COMPILED_PATH_MATCHER_H_
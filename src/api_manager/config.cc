@@ -81,7 +81,8 @@ bool ReadConfigFromString(const std::string &service_config,
 
 }  // namespace
 
-Config::Config() {}
+Config::Config()
+    : parse_duration_(0), build_duration_(0), memory_bytes_(0) {}
 
 MethodInfoImpl *Config::GetOrCreateMethodInfoImpl(const string &name,
                                                   const string &api_name,
@@ -293,6 +294,8 @@ bool Config::LoadAuthentication(ApiManagerEnvInterface *env) {
     } else {
       SetJwksUri(provider.issuer(), string(), true);
     }
+    issuer_configured_jwks_uri_map_[utils::GetUrlContent(provider.issuer())] =
+        provider.jwks_uri();
     provider_id_provider_map[provider.id()] = &provider;
   }
 
@@ -416,9 +419,12 @@ bool Config::LoadService(ApiManagerEnvInterface *env,
       return false;
     }
 
-    string tf;
-    ::google::protobuf::TextFormat::PrintToString(service_, &tf);
-    env->LogDebug(tf.c_str());
+    // Printing a large service config takes longer than parsing it.
+    if (env->IsLogEnabled(ApiManagerEnvInterface::DEBUG)) {
+      string tf;
+      ::google::protobuf::TextFormat::PrintToString(service_, &tf);
+      env->LogDebug(tf.c_str());
+    }
     return true;
   }
   return false;
@@ -450,10 +456,12 @@ std::unique_ptr<Config> Config::Create(ApiManagerEnvInterface *env,
 
 std::unique_ptr<Config> Config::Create(ApiManagerEnvInterface *env,
                                        const std::string &service_config) {
+  auto start = std::chrono::steady_clock::now();
   std::unique_ptr<Config> config(new Config);
   if (!config->LoadService(env, service_config)) {
     return nullptr;
   }
+  auto parsed = std::chrono::steady_clock::now();
   PathMatcherBuilder<MethodInfo *> pmb;
   // Load apis before http rules to store API versions
   if (!config->LoadRpcMethods(env, &pmb)) {
@@ -478,6 +486,13 @@ std::unique_ptr<Config> Config::Create(ApiManagerEnvInterface *env,
   if (!config->LoadQuotaRule(env)) {
     return nullptr;
   }
+  config->parse_duration_ =
+      std::chrono::duration_cast<std::chrono::microseconds>(parsed - start);
+  config->build_duration_ =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - parsed);
+  config->memory_bytes_ = config->service_.SpaceUsed() +
+                          config->method_map_.size() * sizeof(MethodInfoImpl);
   return config;
 }
 
@@ -539,6 +554,16 @@ bool Config::GetJwksUri(const string &issuer, string *url) const {
   return false;
 }
 
+std::string Config::GetKeysId(const string &issuer) const {
+  std::string iss = utils::GetUrlContent(issuer);
+  auto it = issuer_configured_jwks_uri_map_.find(iss);
+  if (it == issuer_configured_jwks_uri_map_.end()) {
+    return iss;
+  }
+  // A new line can be neither in the issuer nor in the jwksUri.
+  return iss + '\n' + it->second;
+}
+
 void Config::SetJwksUri(const string &issuer, const string &jwks_uri,
                         bool openid_valid) {
   std::string iss = utils::GetUrlContent(issuer);
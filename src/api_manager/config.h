@@ -15,6 +15,7 @@
 #ifndef API_MANAGER_CONFIG_H_
 #define API_MANAGER_CONFIG_H_
 
+#include <chrono>
 #include <map>
 #include <memory>
 #include <set>
@@ -88,6 +89,21 @@ class Config {
   void SetJwksUri(const std::string &issuer, const std::string &jwks_uri,
                   bool openid_valid);
 
+  // Returns the id of the verification keys of a given issuer. Service
+  // configs which fetch the keys of an issuer the same way, from the same
+  // jwksUri or by openId discovery, get the same id, so that they can share
+  // the cached keys.
+  std::string GetKeysId(const std::string &issuer) const;
+
+  // The time Create() spent parsing the service config, and building the
+  // methods and the path matcher from it.
+  std::chrono::microseconds parse_duration() const { return parse_duration_; }
+  std::chrono::microseconds build_duration() const { return build_duration_; }
+
+  // The estimated memory of the service config protobuf and of the methods,
+  // in bytes.
+  size_t memory_bytes() const { return memory_bytes_; }
+
   // Get the Firebase server from Server config
   std::string GetFirebaseServer();
 
@@ -145,6 +161,12 @@ class Config {
   // jwksUri for the issuer. It is set to true if jwksUri is not provided in
   // service config and we have not tried openId discovery to fetch jwksUri.
   std::map<std::string, std::pair<std::string, bool>> issuer_jwks_uri_map_;
+  // Maps issuer to the jwksUri from service config, empty if the jwksUri is
+  // found by openId discovery.
+  std::map<std::string, std::string> issuer_configured_jwks_uri_map_;
+  std::chrono::microseconds parse_duration_;
+  std::chrono::microseconds build_duration_;
+  size_t memory_bytes_;
 };
 
 }  // namespace api_manager
@@ -45,6 +45,13 @@ ConfigManager::ConfigManager(
                                  ->service_management_config()
                                  .refresh_interval_ms();
     }
+    const std::string& config_cache_dir = global_context_->server_config()
+                                              ->service_management_config()
+                                              .config_cache_dir();
+    if (!config_cache_dir.empty() && !global_context_->service_name().empty()) {
+      snapshot_.reset(new ConfigSnapshot(config_cache_dir,
+                                         global_context_->service_name()));
+    }
   }
 
   service_management_fetch_.reset(new ServiceManagementFetch(global_context));
@@ -57,8 +64,15 @@ ConfigManager::~ConfigManager() {
 };
 
 void ConfigManager::Init() {
-  if (global_context_->rollout_strategy() == kRolloutStrategyManaged &&
-      refresh_interval_ms_ > 0) {
+  if (global_context_->rollout_strategy() != kRolloutStrategyManaged) {
+    return;
+  }
+  // Starts with the configs of the last rollout, without waiting for the
+  // fetcher.
+  if (snapshot_) {
+    LoadSnapshot();
+  }
+  if (refresh_interval_ms_ > 0) {
     rollouts_refresh_timer_ = global_context_->env()->StartPeriodicTimer(
         std::chrono::milliseconds(refresh_interval_ms_),
         [this]() { OnRolloutsRefreshTimer(); });
@@ -66,6 +80,10 @@ void ConfigManager::Init() {
 }
 
 void ConfigManager::OnRolloutsRefreshTimer() {
+  if (snapshot_ && !snapshot_->TryBecomeFetcher()) {
+    LoadSnapshot();
+    return;
+  }
   GlobalFetchServiceAccountToken(global_context_, [this](utils::Status status) {
     if (!status.ok()) {
       global_context_->env()->LogError("Unexpected status: " +
@@ -162,14 +180,112 @@ void ConfigManager::FetchConfigs(
           return;
         }
 
-        // Update ApiManager
-        rollout_apply_function_(utils::Status::OK,
-                                std::move(config_fetch_info->configs));
-        current_rollout_id_ = config_fetch_info->rollout_id;
+        OnConfigsFetched(config_fetch_info);
       }
     });
   }
 }
 
+void ConfigManager::OnConfigsFetched(
+    std::shared_ptr<ConfigsFetchInfo> config_fetch_info) {
+  if (snapshot_) {
+    PublishSnapshot(config_fetch_info);
+    return;
+  }
+  // Update ApiManager
+  rollout_apply_function_(utils::Status::OK,
+                          std::move(config_fetch_info->configs));
+  current_rollout_id_ = config_fetch_info->rollout_id;
+}
+
+void ConfigManager::PublishSnapshot(
+    std::shared_ptr<ConfigsFetchInfo> config_fetch_info) {
+  std::shared_ptr<proto::ServiceConfigSnapshot> snapshot =
+      std::make_shared<proto::ServiceConfigSnapshot>();
+  std::shared_ptr<utils::Status> status =
+      std::make_shared<utils::Status>(utils::Status::OK);
+  ConfigSnapshot* store = snapshot_.get();
+
+  auto work = [config_fetch_info, snapshot, status, store]() {
+    snapshot->set_rollout_id(config_fetch_info->rollout_id);
+    for (const auto& config : config_fetch_info->configs) {
+      Service service;
+      *status = utils::JsonToProto(config.first, &service);
+      if (!status->ok()) {
+        snapshot->clear_configs();
+        return;
+      }
+      auto* snapshot_config = snapshot->add_configs();
+      service.SerializeToString(snapshot_config->mutable_service_config());
+      snapshot_config->set_traffic_percentage(config.second);
+    }
+    *status = store->Write(snapshot.get());
+  };
+  auto continuation = [this, config_fetch_info, snapshot, status]() {
+    if (!status->ok()) {
+      global_context_->env()->LogError(
+          "Failed to publish the service configs: " + status->ToString());
+    }
+    if (snapshot->configs_size() == 0) {
+      // Update ApiManager with the downloaded configs.
+      rollout_apply_function_(utils::Status::OK,
+                              std::move(config_fetch_info->configs));
+      current_rollout_id_ = config_fetch_info->rollout_id;
+      return;
+    }
+    ApplySnapshot(*snapshot);
+  };
+  RunInBackground(work, continuation);
+}
+
+void ConfigManager::LoadSnapshot() {
+  std::shared_ptr<proto::ServiceConfigSnapshot> snapshot =
+      std::make_shared<proto::ServiceConfigSnapshot>();
+  std::shared_ptr<utils::Status> status =
+      std::make_shared<utils::Status>(utils::Status::OK);
+  std::shared_ptr<ConfigSnapshot::Version> version =
+      std::make_shared<ConfigSnapshot::Version>(snapshot_version_);
+  ConfigSnapshot* store = snapshot_.get();
+
+  auto work = [snapshot, status, version, store]() {
+    *status = store->Read(snapshot.get(), version.get());
+  };
+  auto continuation = [this, snapshot, status, version]() {
+    snapshot_version_ = *version;
+    if (!status->ok()) {
+      // The fetcher has not published a rollout yet.
+      if (status->code() != Code::NOT_FOUND) {
+        global_context_->env()->LogError(
+            "Failed to load the service configs: " + status->ToString());
+      }
+      return;
+    }
+    if (snapshot->configs_size() > 0 &&
+        snapshot->rollout_id() != current_rollout_id_) {
+      ApplySnapshot(*snapshot);
+    }
+  };
+  RunInBackground(work, continuation);
+}
+
+void ConfigManager::ApplySnapshot(
+    const proto::ServiceConfigSnapshot& snapshot) {
+  std::vector<std::pair<std::string, int>> configs;
+  for (const auto& config : snapshot.configs()) {
+    configs.push_back({config.service_config(), config.traffic_percentage()});
+  }
+  // Update ApiManager
+  rollout_apply_function_(utils::Status::OK, std::move(configs));
+  current_rollout_id_ = snapshot.rollout_id();
+}
+
+void ConfigManager::RunInBackground(std::function<void()> work,
+                                    std::function<void()> continuation) {
+  if (!global_context_->env()->RunInBackground(work, continuation)) {
+    work();
+    continuation();
+  }
+}
+
 }  // namespace api_manager
 }  // namespace google
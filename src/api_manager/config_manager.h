@@ -15,6 +15,7 @@
 #ifndef API_MANAGER_CONFIG_MANAGER_H_
 #define API_MANAGER_CONFIG_MANAGER_H_
 
+#include "src/api_manager/config_snapshot.h"
 #include "src/api_manager/context/global_context.h"
 #include "src/api_manager/service_management_fetch.h"
 
@@ -62,6 +63,10 @@ struct ConfigsFetchInfo {
 }  // namespace anonymous
 
 // Manages configuration downloading
+//
+// If server_config.service_management_config.config_cache_dir is set, a
+// single process of the host downloads the configurations, and publishes
+// them as binary snapshots in the directory for the other processes.
 class ConfigManager {
  public:
   // the periodic timer task initialize by Init() invokes the
@@ -91,6 +96,21 @@ class ConfigManager {
   void OnRolloutsRefreshTimer();
   // Rollout response handler
   void OnRolloutResponse(const utils::Status& status, std::string&& rollouts);
+  // Applies the downloaded ServiceConfigs, publishing them first if the
+  // snapshot is configured.
+  void OnConfigsFetched(std::shared_ptr<ConfigsFetchInfo> config_fetch_info);
+  // Converts the downloaded ServiceConfigs to binary and publishes them in
+  // the background, then applies them.
+  void PublishSnapshot(std::shared_ptr<ConfigsFetchInfo> config_fetch_info);
+  // Loads the snapshot in the background if it was replaced, then applies it
+  // if it is a new rollout.
+  void LoadSnapshot();
+  // Applies the ServiceConfigs of a snapshot.
+  void ApplySnapshot(const proto::ServiceConfigSnapshot& snapshot);
+  // Runs the work on a background thread of the environment if it has one,
+  // then the continuation on the calling thread.
+  void RunInBackground(std::function<void()> work,
+                       std::function<void()> continuation);
 
   // Global context provided by ApiManager
   std::shared_ptr<context::GlobalContext> global_context_;
@@ -104,6 +124,11 @@ class ConfigManager {
   std::unique_ptr<PeriodicTimer> rollouts_refresh_timer_;
   // Previous rollouts id
   std::string current_rollout_id_;
+  // The configurations shared by the processes of the host, nullptr if each
+  // process downloads them.
+  std::unique_ptr<ConfigSnapshot> snapshot_;
+  // The version of the last loaded snapshot.
+  ConfigSnapshot::Version snapshot_version_;
 };
 
 }  // namespace api_manager
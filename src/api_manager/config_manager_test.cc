@@ -14,6 +14,10 @@
  */
 #include "src/api_manager/config_manager.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
 #include "src/api_manager/config.h"
 #include "src/api_manager/context/global_context.h"
 #include "src/api_manager/mock_api_manager_environment.h"
@@ -512,6 +516,140 @@ TEST_F(ConfigManagerServiceNameConfigIdTest,
   ASSERT_EQ(1, sequence);
 }
 
+// One process of the host fetches and publishes the service configs, the
+// other ones load them.
+TEST(ConfigManagerSnapshotTest, FetcherPublishesServiceConfigs) {
+  char dir[] = "/tmp/config_snapshot_XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir));
+  const std::string server_config = std::string(R"(
+{
+  "google_authentication_secret": "{}",
+  "service_management_config": {
+    "config_cache_dir": ")") + dir + R"("
+  },
+  "rollout_strategy": "managed"
+}
+)";
+
+  auto check_configs = [](const std::vector<std::pair<std::string, int>>&
+                              list) {
+    ASSERT_EQ(1, list.size());
+    Service service;
+    ASSERT_TRUE(service.ParseFromString(list[0].first));
+    ASSERT_EQ("2017-05-01r0", service.id());
+    ASSERT_EQ(100, list[0].second);
+  };
+
+  MockTimerApiManagerEnvironment* fetcher_env =
+      new ::testing::NiceMock<MockTimerApiManagerEnvironment>();
+  EXPECT_CALL(*fetcher_env, DoRunHTTPRequest(_))
+      .WillOnce(Invoke([](HTTPRequest* req) {
+        req->OnComplete(Status::OK, {}, kRolloutsResponse1);
+      }))
+      .WillOnce(Invoke([](HTTPRequest* req) {
+        req->OnComplete(Status::OK, {}, kServiceConfig1);
+      }));
+  auto fetcher_context = std::make_shared<context::GlobalContext>(
+      std::unique_ptr<ApiManagerEnvInterface>(fetcher_env), server_config);
+  fetcher_context->set_service_name("service_name_from_metadata");
+
+  int fetcher_sequence = 0;
+  std::shared_ptr<ConfigManager> fetcher(new ConfigManager(
+      fetcher_context,
+      [&](const utils::Status& status,
+          const std::vector<std::pair<std::string, int>>& list) {
+        check_configs(list);
+        fetcher_sequence++;
+      }));
+  fetcher->Init();
+  fetcher_env->RunTimer();
+  ASSERT_EQ(1, fetcher_sequence);
+
+  MockTimerApiManagerEnvironment* env =
+      new ::testing::NiceMock<MockTimerApiManagerEnvironment>();
+  EXPECT_CALL(*env, DoRunHTTPRequest(_)).Times(0);
+  auto global_context = std::make_shared<context::GlobalContext>(
+      std::unique_ptr<ApiManagerEnvInterface>(env), server_config);
+  global_context->set_service_name("service_name_from_metadata");
+
+  int sequence = 0;
+  std::shared_ptr<ConfigManager> config_manager(new ConfigManager(
+      global_context,
+      [&](const utils::Status& status,
+          const std::vector<std::pair<std::string, int>>& list) {
+        check_configs(list);
+        sequence++;
+      }));
+  // Starts with the published configs.
+  config_manager->Init();
+  ASSERT_EQ(1, sequence);
+  // Same rollout_id, no update
+  env->RunTimer();
+  ASSERT_EQ(1, sequence);
+
+  fetcher.reset();
+  config_manager.reset();
+  unlink((std::string(dir) + "/service_name_from_metadata.pb").c_str());
+  unlink((std::string(dir) + "/service_name_from_metadata.lock").c_str());
+  rmdir(dir);
+}
+
+TEST(ConfigSnapshotTest, SkipsUnchangedSnapshot) {
+  char dir[] = "/tmp/config_snapshot_XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir));
+  ConfigSnapshot store(dir, "service_name");
+
+  proto::ServiceConfigSnapshot written;
+  written.set_rollout_id("2017-05-01r0");
+  written.add_configs()->set_traffic_percentage(100);
+  ASSERT_TRUE(store.Write(&written).ok());
+
+  ConfigSnapshot::Version version;
+  proto::ServiceConfigSnapshot snapshot;
+  ASSERT_TRUE(store.Read(&snapshot, &version).ok());
+  ASSERT_EQ("2017-05-01r0", snapshot.rollout_id());
+  ASSERT_EQ("service_name", snapshot.service_name());
+  ASSERT_EQ(1, snapshot.configs_size());
+
+  // Not read again until it is replaced.
+  snapshot.Clear();
+  ASSERT_TRUE(store.Read(&snapshot, &version).ok());
+  ASSERT_EQ(0, snapshot.configs_size());
+
+  written.set_rollout_id("2017-05-01r1");
+  ASSERT_TRUE(store.Write(&written).ok());
+  ASSERT_TRUE(store.Read(&snapshot, &version).ok());
+  ASSERT_EQ("2017-05-01r1", snapshot.rollout_id());
+  ASSERT_EQ(1, snapshot.configs_size());
+
+  unlink((std::string(dir) + "/service_name.pb").c_str());
+  rmdir(dir);
+}
+
+TEST(ConfigSnapshotTest, RejectsSnapshotOfAnotherService) {
+  char dir[] = "/tmp/config_snapshot_XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir));
+  ConfigSnapshot other_store(dir, "other_service_name");
+
+  proto::ServiceConfigSnapshot written;
+  written.set_rollout_id("2017-05-01r0");
+  written.add_configs()->set_traffic_percentage(100);
+  ASSERT_TRUE(other_store.Write(&written).ok());
+  const std::string path = std::string(dir) + "/service_name.pb";
+  ASSERT_EQ(0, rename((std::string(dir) + "/other_service_name.pb").c_str(),
+                      path.c_str()));
+
+  ConfigSnapshot store(dir, "service_name");
+  ConfigSnapshot::Version version;
+  proto::ServiceConfigSnapshot snapshot;
+  Status status = store.Read(&snapshot, &version);
+  ASSERT_EQ(Code::FAILED_PRECONDITION, status.code());
+  ASSERT_EQ(0, snapshot.configs_size());
+
+  unlink(path.c_str());
+  rmdir(dir);
+}
+
 }  // namespace
 }  // namespace api_manager
 }  // namespace google
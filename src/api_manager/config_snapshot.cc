@@ -0,0 +1,125 @@
+/* Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "src/api_manager/config_snapshot.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+
+namespace google {
+namespace api_manager {
+
+namespace {
+
+const char kSnapshotSuffix[] = ".pb";
+const char kLockSuffix[] = ".lock";
+
+}  // namespace anonymous
+
+ConfigSnapshot::ConfigSnapshot(const std::string& dir,
+                               const std::string& service_name)
+    : service_name_(service_name),
+      path_(dir + "/" + service_name + kSnapshotSuffix),
+      lock_path_(dir + "/" + service_name + kLockSuffix),
+      lock_fd_(-1) {}
+
+ConfigSnapshot::~ConfigSnapshot() {
+  if (lock_fd_ >= 0) {
+    close(lock_fd_);
+  }
+}
+
+bool ConfigSnapshot::TryBecomeFetcher() {
+  if (lock_fd_ >= 0) {
+    return true;
+  }
+  int fd = open(lock_path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  // The lock belongs to the open file, not to the process, so that a single
+  // worker of the host holds it.
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    close(fd);
+    return false;
+  }
+  lock_fd_ = fd;
+  return true;
+}
+
+utils::Status ConfigSnapshot::Write(
+    proto::ServiceConfigSnapshot* snapshot) const {
+  snapshot->set_service_name(service_name_);
+  // Only the fetcher writes, the readers never see a partial snapshot.
+  std::string tmp_path = path_ + ".tmp";
+  std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open() || !snapshot->SerializeToOstream(&file)) {
+    return utils::Status(Code::INTERNAL,
+                         "Failed to write the service configs to " + tmp_path);
+  }
+  file.close();
+  if (file.fail() || rename(tmp_path.c_str(), path_.c_str()) != 0) {
+    return utils::Status(Code::INTERNAL,
+                         "Failed to write the service configs to " + path_);
+  }
+  return utils::Status::OK;
+}
+
+utils::Status ConfigSnapshot::Read(proto::ServiceConfigSnapshot* snapshot,
+                                   Version* version) const {
+  int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return utils::Status(Code::NOT_FOUND, "No service configs in " + path_);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return utils::Status(Code::NOT_FOUND, "No service configs in " + path_);
+  }
+  // The fetcher renames a new file over the snapshot, so the same inode and
+  // mtime mean the same snapshot.
+  Version current;
+  current.inode = st.st_ino;
+  current.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                     st.st_mtim.tv_nsec;
+  if (current.inode == version->inode &&
+      current.mtime_ns == version->mtime_ns) {
+    close(fd);
+    return utils::Status::OK;
+  }
+  bool parsed = snapshot->ParseFromFileDescriptor(fd);
+  close(fd);
+  if (!parsed) {
+    snapshot->Clear();
+    return utils::Status(Code::DATA_LOSS,
+                         "Invalid service configs in " + path_);
+  }
+  if (snapshot->service_name() != service_name_) {
+    std::string name = snapshot->service_name();
+    snapshot->Clear();
+    return utils::Status(Code::FAILED_PRECONDITION,
+                         "Service configs of " + name + " in " + path_ +
+                             ", expected " + service_name_);
+  }
+  *version = current;
+  return utils::Status::OK;
+}
+
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,81 @@
+/* Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_CONFIG_SNAPSHOT_H_
+#define API_MANAGER_CONFIG_SNAPSHOT_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <string>
+
+#include "include/api_manager/utils/status.h"
+#include "src/api_manager/proto/config_snapshot.pb.h"
+
+namespace google {
+namespace api_manager {
+
+// The service configs of the latest rollout, shared by the ESP processes of
+// a host through files named after the service in a directory. The process
+// holding the lock file of the service is the fetcher: it fetches the
+// rollouts from the service management API and publishes their configs, the
+// other processes load them. The lock is released when the fetcher exits, so
+// that another process takes over.
+//
+// The snapshot also survives restarts, so that ESP starts with the configs
+// of the last rollout.
+class ConfigSnapshot {
+ public:
+  // Identifies a written snapshot. Each write replaces the file.
+  struct Version {
+    Version() : inode(0), mtime_ns(0) {}
+    ino_t inode;
+    int64_t mtime_ns;
+  };
+
+  ConfigSnapshot(const std::string& dir, const std::string& service_name);
+  ~ConfigSnapshot();
+
+  // Returns true if this process is the fetcher, trying to become it if it
+  // is not.
+  bool TryBecomeFetcher();
+
+  // Replaces the snapshot atomically, setting its service name. Thread safe.
+  utils::Status Write(proto::ServiceConfigSnapshot* snapshot) const;
+
+  // Reads the snapshot if it was written after |version|, which is then
+  // updated. Leaves |snapshot| empty if it is unchanged. Returns NOT_FOUND
+  // if none was written and FAILED_PRECONDITION if it belongs to another
+  // service. Thread safe.
+  utils::Status Read(proto::ServiceConfigSnapshot* snapshot,
+                     Version* version) const;
+
+ private:
+  ConfigSnapshot(const ConfigSnapshot&) = delete;
+  ConfigSnapshot& operator=(const ConfigSnapshot&) = delete;
+
+  // The name of the service.
+  const std::string service_name_;
+  // The path of the snapshot file.
+  const std::string path_;
+  // The path of the lock file.
+  const std::string lock_path_;
+  // The locked lock file, -1 if this process is not the fetcher.
+  int lock_fd_;
+};
+
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_CONFIG_SNAPSHOT_H_
@@ -423,6 +423,18 @@ TEST(Config, TestLoadAuthentication) {
   ASSERT_EQ("https://accounts.google.com/.well-known/openid-configuration",
             url);
   ASSERT_TRUE(ret);
+
+  // Keys ids include the configured jwksUri, and do not change after openId
+  // discovery.
+  ASSERT_EQ("issuer1@gserviceaccount.com\nhttps://www.googleapis.com/jwks_uri1",
+            config->GetKeysId("issuer1@gserviceaccount.com"));
+  ASSERT_EQ("esp-jwk.auth0.com\n", config->GetKeysId("esp-jwk.auth0.com"));
+  config->SetJwksUri("esp-jwk.auth0.com", "https://esp-jwk.auth0.com/jwks",
+                     false);
+  ASSERT_EQ("esp-jwk.auth0.com\n",
+            config->GetKeysId("https://esp-jwk.auth0.com/"));
+  ASSERT_EQ("issuer3@gserviceaccount.com",
+            config->GetKeysId("issuer3@gserviceaccount.com"));
 }
 
 static const char system_parameter_config[] =
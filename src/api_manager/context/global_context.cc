@@ -34,6 +34,9 @@ const int kDefaultAggregateTimeMillisec = 1000;
 // the http request payload with the aggregated traces not reaching MB in size.
 const int kDefaultTraceCacheMaxSize = 100;
 
+// Default maximum encoded size of the aggregated traces.
+const int kDefaultTraceMaxBatchBytes = 1 << 20;
+
 // Default trace sample rate, in QPS.
 const double kDefaultTraceSampleQps = 0.1;
 
@@ -41,17 +44,31 @@ const double kDefaultTraceSampleQps = 0.1;
 // Default to 10s.
 const int kIntermediateReportInterval = 10;
 
+// Returns the security rules check config of the server config, the default
+// config if there is none.
+const proto::ApiCheckSecurityRulesConfig& SecurityRulesConfig(
+    const std::shared_ptr<proto::ServerConfig>& server_config) {
+  return server_config ? server_config->api_check_security_rules_config()
+                       : proto::ApiCheckSecurityRulesConfig::default_instance();
+}
+
 }  // namespace
 
 GlobalContext::GlobalContext(std::unique_ptr<ApiManagerEnvInterface> env,
                              const std::string& server_config)
     : env_(std::move(env)),
+      // Need to load server config first.
+      server_config_(Config::LoadServerConfig(env_.get(), server_config)),
       service_account_token_(env_.get()),
+      authz_cache_(
+          SecurityRulesConfig(server_config_).authz_cache_entries(),
+          std::chrono::milliseconds(
+              SecurityRulesConfig(server_config_).authz_cache_expiration_ms())),
+      firebase_release_cache_(std::chrono::milliseconds(
+          SecurityRulesConfig(server_config_).release_cache_expiration_ms())),
+      latency_statistics_(),
       is_auth_force_disabled_(false),
       intermediate_report_interval_(kIntermediateReportInterval) {
-  // Need to load server config first.
-  server_config_ = Config::LoadServerConfig(env_.get(), server_config);
-
   cloud_trace_aggregator_ = CreateCloudTraceAggregator();
 
   if (server_config_) {
@@ -92,6 +109,8 @@ GlobalContext::CreateCloudTraceAggregator() {
   std::string url = kCloudTraceUrl;
   int aggregate_time_millisec = kDefaultAggregateTimeMillisec;
   int cache_max_size = kDefaultTraceCacheMaxSize;
+  int max_batch_bytes = kDefaultTraceMaxBatchBytes;
+  bool binary_export = false;
   double minimum_qps = kDefaultTraceSampleQps;
   if (server_config_ && server_config_->has_cloud_tracing_config()) {
     // If url_override is set in server config, use it to query Cloud Trace.
@@ -105,8 +124,14 @@ GlobalContext::CreateCloudTraceAggregator() {
       aggregate_time_millisec =
           tracing_config.aggregation_config().time_millisec();
       cache_max_size = tracing_config.aggregation_config().cache_max_size();
+      if (tracing_config.aggregation_config().max_batch_bytes() > 0) {
+        max_batch_bytes = tracing_config.aggregation_config().max_batch_bytes();
+      }
     }
 
+    binary_export =
+        tracing_config.export_format() == proto::CloudTracingConfig::PROTO;
+
     // If sampling config is set, take the values from it.
     if (tracing_config.has_samling_config()) {
       minimum_qps = tracing_config.samling_config().minimum_qps();
@@ -115,7 +140,7 @@ GlobalContext::CreateCloudTraceAggregator() {
 
   return std::unique_ptr<cloud_trace::Aggregator>(new cloud_trace::Aggregator(
       &service_account_token_, url, aggregate_time_millisec, cache_max_size,
-      minimum_qps, env_.get()));
+      max_batch_bytes, binary_export, minimum_qps, env_.get()));
 }
 
 const std::string& GlobalContext::project_id() const {
@@ -15,8 +15,10 @@
 #ifndef API_MANAGER_CONTEXT_GLOBAL_CONTEXT_H_
 #define API_MANAGER_CONTEXT_GLOBAL_CONTEXT_H_
 
+#include "include/api_manager/latency_statistics.h"
 #include "src/api_manager/auth/authz_cache.h"
 #include "src/api_manager/auth/certs.h"
+#include "src/api_manager/auth/firebase_release_cache.h"
 #include "src/api_manager/auth/jwt_cache.h"
 #include "src/api_manager/auth/service_account_token.h"
 #include "src/api_manager/cloud_trace/cloud_trace.h"
@@ -32,7 +34,9 @@ namespace context {
 // * env
 // * server_config
 // * service_account_token
-// * certs and jwt_cache
+// * certs, jwt_cache, authz_cache and firebase_release_cache, shared by the
+//   service configs so that they stay warm across service config rollouts.
+// * latency histograms of the requests of all the service configs.
 // * metadata server and fetched data.
 // * cloud trace object.
 class GlobalContext {
@@ -48,6 +52,20 @@ class GlobalContext {
     return &service_account_token_;
   }
 
+  // the token verification keys, keyed by Config::GetKeysId().
+  auth::Certs &certs() { return certs_; }
+  // the verified JWTs.
+  auth::JwtCache &jwt_cache() { return jwt_cache_; }
+  // the Firebase rules check results.
+  auth::AuthzCache &authz_cache() { return authz_cache_; }
+  // the ruleset names of the Firebase releases.
+  auth::FirebaseReleaseCache &firebase_release_cache() {
+    return firebase_release_cache_;
+  }
+
+  // the latency histograms of the request stages.
+  LatencyStatistics &latency_statistics() { return latency_statistics_; }
+
   const std::string &metadata_server() const { return metadata_server_; }
 
   // fetched metadata.
@@ -108,6 +126,14 @@ class GlobalContext {
   // service account tokens
   auth::ServiceAccountToken service_account_token_;
 
+  // The auth caches.
+  auth::Certs certs_;
+  auth::JwtCache jwt_cache_;
+  auth::AuthzCache authz_cache_;
+  auth::FirebaseReleaseCache firebase_release_cache_;
+
+  LatencyStatistics latency_statistics_;
+
   // The service control object. When trace is force disabled, this will be a
   // nullptr.
   std::unique_ptr<cloud_trace::Aggregator> cloud_trace_aggregator_;
@@ -102,6 +102,7 @@ RequestContext::RequestContext(std::shared_ptr<ServiceContext> service_context,
       is_first_report_(true),
       last_request_bytes_(0),
       last_response_bytes_(0) {
+  service_context_->RequestStarted();
   start_time_ = std::chrono::system_clock::now();
   last_report_time_ = std::chrono::steady_clock::now();
   operation_id_ = GenerateUUID();
@@ -145,6 +146,8 @@ RequestContext::RequestContext(std::shared_ptr<ServiceContext> service_context,
   }
 }
 
+RequestContext::~RequestContext() { service_context_->RequestFinished(); }
+
 std::string RequestContext::GetRequestHTTPMethodWithOverride() {
   std::string method;
 
@@ -373,7 +376,8 @@ const std::string RequestContext::FindClientIPAddress() {
 }
 
 void RequestContext::StartBackendSpanAndSetTraceContext() {
-  backend_span_.reset(CreateSpan(cloud_trace_.get(), "Backend"));
+  backend_span_.reset(
+      CreateSpan(cloud_trace_.get(), cloud_trace::kBackendSpanName));
 
   // Set trace context header to backend. The span id in the header will
   // be the backend span's id.
@@ -18,6 +18,8 @@
 #include <time.h>
 #include <chrono>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "include/api_manager/method.h"
 #include "include/api_manager/request.h"
@@ -35,6 +37,7 @@ class RequestContext {
  public:
   RequestContext(std::shared_ptr<context::ServiceContext> service_context,
                  std::unique_ptr<Request> request);
+  ~RequestContext();
 
   // Get the ApiManagerImpl object.
   context::ServiceContext *service_context() const {
@@ -78,6 +81,19 @@ class RequestContext {
   // Complete check.
   void CompleteCheck(utils::Status status);
 
+  // Records the time spent in a check workflow stage.
+  void add_check_stage_latency(const char *stage,
+                               std::chrono::microseconds latency) {
+    check_stage_latencies_.emplace_back(stage, latency);
+  }
+
+  // Get the latencies of the check workflow stages that were run, in the
+  // order they completed.
+  const std::vector<std::pair<const char *, std::chrono::microseconds>>
+      &check_stage_latencies() const {
+    return check_stage_latencies_;
+  }
+
   // Sets auth issuer to request context.
   void set_auth_issuer(const std::string &issuer) { auth_issuer_ = issuer; }
 
@@ -168,6 +184,10 @@ class RequestContext {
   // The final check continuation
   std::function<void(utils::Status status)> check_continuation_;
 
+  // The latencies of the check workflow stages.
+  std::vector<std::pair<const char *, std::chrono::microseconds>>
+      check_stage_latencies_;
+
   // The method info from service config.
   MethodCallInfo method_call_;
 
@@ -31,7 +31,8 @@ ServiceContext::ServiceContext(std::shared_ptr<GlobalContext> global_context,
                                std::unique_ptr<Config> config)
     : global_context_(global_context),
       config_(std::move(config)),
-      service_control_(CreateInterface()) {
+      service_control_(CreateInterface()),
+      active_requests_(0) {
   config_->set_server_config(global_context_->server_config());
 }
 
@@ -71,7 +72,8 @@ std::unique_ptr<service_control::Interface> ServiceContext::CreateInterface() {
   return std::unique_ptr<service_control::Interface>(
       service_control::Aggregated::Create(
           config_->service(), global_context_->server_config().get(), env(),
-          global_context_->service_account_token()));
+          global_context_->service_account_token(),
+          &global_context_->latency_statistics()));
 }
 
 }  // namespace context
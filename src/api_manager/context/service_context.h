@@ -15,6 +15,8 @@
 #ifndef API_MANAGER_CONTEXT_SERVICE_CONTEXT_H_
 #define API_MANAGER_CONTEXT_SERVICE_CONTEXT_H_
 
+#include <atomic>
+
 #include "include/api_manager/method.h"
 #include "src/api_manager/config.h"
 #include "src/api_manager/context/global_context.h"
@@ -67,10 +69,17 @@ class ServiceContext {
            !config_->GetFirebaseServer().empty();
   }
 
-  auth::Certs &certs() { return certs_; }
-  auth::JwtCache &jwt_cache() { return jwt_cache_; }
+  auth::Certs &certs() { return global_context_->certs(); }
+  auth::JwtCache &jwt_cache() { return global_context_->jwt_cache(); }
 
-  auth::AuthzCache &authz_cache() { return authz_cache_; }
+  auth::AuthzCache &authz_cache() { return global_context_->authz_cache(); }
+  auth::FirebaseReleaseCache &firebase_release_cache() {
+    return global_context_->firebase_release_cache();
+  }
+
+  LatencyStatistics &latency_statistics() {
+    return global_context_->latency_statistics();
+  }
 
   bool GetJwksUri(const std::string &issuer, std::string *url) {
     return config_->GetJwksUri(issuer, url);
@@ -81,6 +90,10 @@ class ServiceContext {
     config_->SetJwksUri(issuer, jwks_uri, openid_valid);
   }
 
+  std::string GetKeysId(const std::string &issuer) const {
+    return config_->GetKeysId(issuer);
+  }
+
   const std::string &metadata_server() const {
     return global_context_->metadata_server();
   }
@@ -96,6 +109,11 @@ class ServiceContext {
 
   std::shared_ptr<GlobalContext> global_context() { return global_context_; }
 
+  // Counts the requests using this service context.
+  void RequestStarted() { ++active_requests_; }
+  void RequestFinished() { --active_requests_; }
+  int64_t active_requests() const { return active_requests_; }
+
  private:
   // Create service control.
   std::unique_ptr<service_control::Interface> CreateInterface();
@@ -105,13 +123,11 @@ class ServiceContext {
   // The service config object.
   std::unique_ptr<Config> config_;
 
-  auth::Certs certs_;
-  auth::JwtCache jwt_cache_;
-
-  auth::AuthzCache authz_cache_;
-
   // The service control object.
   std::unique_ptr<service_control::Interface> service_control_;
+
+  // The number of RequestContext objects of this service context.
+  std::atomic<int64_t> active_requests_;
 };
 
 }  // namespace context
@@ -63,6 +63,59 @@ void FetchMetadata(
       .set_max_retries(retry);
   context->env()->RunHTTPRequest(std::move(request));
 }
+
+// Fetches the service account access token from the metadata server. If the
+// fetch fails while the current token is still valid, the current token is
+// kept and the fetch is retried by the next refresh.
+void FetchAccessToken(context::GlobalContext *context,
+                      std::function<void(Status status)> continuation) {
+  const auto env = context->env();
+  const auto token = context->service_account_token();
+  // Keeps the current token if it's still usable.
+  auto on_failure = [token]() {
+    token->set_state(token->is_access_token_valid(0)
+                         ? auth::ServiceAccountToken::FETCHED
+                         : auth::ServiceAccountToken::FAILED);
+  };
+
+  token->set_state(auth::ServiceAccountToken::FETCHING);
+  FetchMetadata(context, kMetadataServiceAccountToken,
+                kMetadataTokenFetchRetries,
+                [env, token, on_failure, continuation](
+                    Status status, std::map<std::string, std::string> &&,
+                    std::string &&body) {
+                  // fetch failed
+                  if (!status.ok()) {
+                    env->LogDebug("Failed to fetch service account token");
+                    on_failure();
+                    continuation(Status(Code::INTERNAL, kFailedTokenFetch));
+                    return;
+                  }
+
+                  // process token from the body
+                  char *auth_token = nullptr;
+                  int expires = 0;
+                  if (!auth::esp_get_service_account_auth_token(
+                          const_cast<char *>(body.data()), body.length(),
+                          &auth_token, &expires) ||
+                      token == nullptr) {
+                    env->LogDebug("Failed to parse token response body");
+                    on_failure();
+                    continuation(Status(Code::INTERNAL, kFailedTokenParse));
+                    return;
+                  }
+
+                  token->set_state(auth::ServiceAccountToken::FETCHED);
+                  // Set expiration time a little bit earlier to avoid rejection
+                  // of the actual service control requests.
+                  // Even there is a prefetch window of 60 seconds, but prefetch
+                  // window may not kick in if not on-going requests.
+                  token->set_access_token(auth_token, expires - 50);
+                  free(auth_token);
+
+                  continuation(Status::OK);
+                });
+}
 }  // namespace
 
 void GlobalFetchGceMetadata(std::shared_ptr<context::GlobalContext> context,
@@ -132,11 +185,15 @@ void GlobalFetchServiceAccountToken(
 
       // If token is about to expire, initiate fetching a fresh token
       // Expects token to last significantly longer than time lookahead
+      if (token->is_access_token_valid(0)) {
+        // The fresh token is fetched in the background, the current token
+        // is used until it is replaced.
+        env->LogDebug("Refreshing service account token");
+        FetchAccessToken(context.get(), [](Status) {});
+        continuation(Status::OK);
+        return;
+      }
       token->set_state(auth::ServiceAccountToken::NONE);
-
-      // The first request within the token re-fetch window will carry on
-      // the token fetch, while subsequent requests in the window reuse
-      // the old token.
       break;
     case auth::ServiceAccountToken::FETCHING:
       env->LogDebug("Service account token fetch in progress");
@@ -155,43 +212,7 @@ void GlobalFetchServiceAccountToken(
       env->LogDebug("Need to fetch service account token");
   }
 
-  token->set_state(auth::ServiceAccountToken::FETCHING);
-  FetchMetadata(context.get(), kMetadataServiceAccountToken,
-                kMetadataTokenFetchRetries,
-                [env, token, continuation](
-                    Status status, std::map<std::string, std::string> &&,
-                    std::string &&body) {
-                  // fetch failed
-                  if (!status.ok()) {
-                    env->LogDebug("Failed to fetch service account token");
-                    token->set_state(auth::ServiceAccountToken::FAILED);
-                    continuation(Status(Code::INTERNAL, kFailedTokenFetch));
-                    return;
-                  }
-
-                  // process token from the body
-                  char *auth_token = nullptr;
-                  int expires = 0;
-                  if (!auth::esp_get_service_account_auth_token(
-                          const_cast<char *>(body.data()), body.length(),
-                          &auth_token, &expires) ||
-                      token == nullptr) {
-                    env->LogDebug("Failed to parse token response body");
-                    token->set_state(auth::ServiceAccountToken::FAILED);
-                    continuation(Status(Code::INTERNAL, kFailedTokenParse));
-                    return;
-                  }
-
-                  token->set_state(auth::ServiceAccountToken::FETCHED);
-                  // Set expiration time a little bit earlier to avoid rejection
-                  // of the actual service control requests.
-                  // Even there is a prefetch window of 60 seconds, but prefetch
-                  // window may not kick in if not on-going requests.
-                  token->set_access_token(auth_token, expires - 50);
-                  free(auth_token);
-
-                  continuation(Status::OK);
-                });
+  FetchAccessToken(context.get(), continuation);
 }
 
 // Fetchs GCE metadata from metadata server.
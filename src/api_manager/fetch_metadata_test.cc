@@ -63,6 +63,14 @@ const char kMetaData[] = R"(
 
 const char kEmptyBody[] = R"({})";
 
+const char kAccessToken[] = R"(
+{
+    "access_token": "new-token",
+    "expires_in": 3599,
+    "token_type": "Bearer"
+}
+)";
+
 class FetchMetadataTest : public ::testing::Test {
  public:
   void SetUp() {
@@ -134,6 +142,50 @@ TEST_F(FetchMetadataTest, FetchGceMetadataWithStatusINTERNAL) {
   FetchGceMetadata(context_, [](Status status) { ASSERT_TRUE(status.ok()); });
 }
 
+// A token about to expire is refreshed in the background, the request goes
+// on with the current token.
+TEST_F(FetchMetadataTest, RefreshServiceAccountToken) {
+  auto token = global_context_->service_account_token();
+  token->set_access_token("old-token", 30);
+  token->set_state(auth::ServiceAccountToken::FETCHED);
+
+  EXPECT_CALL(*raw_env_, DoRunHTTPRequest(_))
+      .WillOnce(Invoke([](HTTPRequest *req) {
+        std::map<std::string, std::string> empty;
+        std::string body(kAccessToken);
+        req->OnComplete(Status::OK, std::move(empty), std::move(body));
+      }));
+
+  FetchServiceAccountToken(context_,
+                           [](Status status) { ASSERT_TRUE(status.ok()); });
+  ASSERT_EQ(auth::ServiceAccountToken::FETCHED, token->state());
+  ASSERT_EQ("new-token",
+            token->GetAuthToken(
+                auth::ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL));
+}
+
+// The current token is kept if it could not be refreshed.
+TEST_F(FetchMetadataTest, RefreshServiceAccountTokenFailed) {
+  auto token = global_context_->service_account_token();
+  token->set_access_token("old-token", 30);
+  token->set_state(auth::ServiceAccountToken::FETCHED);
+
+  EXPECT_CALL(*raw_env_, DoRunHTTPRequest(_))
+      .WillOnce(Invoke([](HTTPRequest *req) {
+        std::map<std::string, std::string> empty;
+        std::string body(kEmptyBody);
+        req->OnComplete(Status(Code::UNAVAILABLE, ""), std::move(empty),
+                        std::move(body));
+      }));
+
+  FetchServiceAccountToken(context_,
+                           [](Status status) { ASSERT_TRUE(status.ok()); });
+  ASSERT_EQ(auth::ServiceAccountToken::FETCHED, token->state());
+  ASSERT_EQ("old-token",
+            token->GetAuthToken(
+                auth::ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL));
+}
+
 }  // namespace
 
 }  // namespace api_manager
@@ -0,0 +1,87 @@
+// Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "include/api_manager/latency_statistics.h"
+
+#include "gtest/gtest.h"
+
+namespace google {
+namespace api_manager {
+namespace {
+
+TEST(LatencyHistogramTest, BucketBounds) {
+  // Exact buckets.
+  for (uint64_t latency = 0; latency < 8; ++latency) {
+    EXPECT_EQ(latency, LatencyHistogram::BucketIndex(latency));
+    EXPECT_EQ(latency, LatencyHistogram::BucketUpperBound(latency));
+  }
+  // Each bucket ends right before the next one starts.
+  for (int i = 0; i < LatencyHistogram::kNumBuckets - 1; ++i) {
+    uint64_t upper = LatencyHistogram::BucketUpperBound(i);
+    EXPECT_EQ(i, LatencyHistogram::BucketIndex(upper));
+    EXPECT_EQ(i + 1, LatencyHistogram::BucketIndex(upper + 1));
+  }
+  // Buckets are within 12.5% of their lower bound.
+  EXPECT_EQ(8, LatencyHistogram::BucketIndex(8));
+  EXPECT_EQ(1151u, LatencyHistogram::BucketUpperBound(
+                       LatencyHistogram::BucketIndex(1024)));
+  // Large latencies are in the last bucket.
+  EXPECT_EQ(LatencyHistogram::kNumBuckets - 1,
+            LatencyHistogram::BucketIndex(1ULL << 40));
+}
+
+TEST(LatencyHistogramTest, Percentiles) {
+  LatencyHistogram histogram = LatencyHistogram();
+  EXPECT_EQ(0u, histogram.Percentile(50));
+
+  for (uint64_t latency = 1; latency <= 1000; ++latency) {
+    histogram.Record(latency);
+  }
+  EXPECT_EQ(1000u, histogram.count);
+  EXPECT_EQ(500500u, histogram.sum_us);
+  EXPECT_EQ(1000u, histogram.max_us);
+
+  // Upper bounds within 12.5%.
+  EXPECT_GE(histogram.Percentile(50), 500u);
+  EXPECT_LE(histogram.Percentile(50), 500u * 9 / 8);
+  EXPECT_GE(histogram.Percentile(90), 900u);
+  EXPECT_LE(histogram.Percentile(90), 900u * 9 / 8);
+  // Capped by the maximum.
+  EXPECT_EQ(1000u, histogram.Percentile(99.9));
+  EXPECT_EQ(1000u, histogram.Percentile(100));
+  EXPECT_EQ(1u, histogram.Percentile(0));
+}
+
+TEST(LatencyHistogramTest, Merge) {
+  LatencyStatistics stats1 = LatencyStatistics();
+  LatencyStatistics stats2 = LatencyStatistics();
+  stats1.request.Record(10);
+  stats2.request.Record(2000);
+  stats2.check_transport.Record(100);
+
+  stats1.Merge(stats2);
+  EXPECT_EQ(2u, stats1.request.count);
+  EXPECT_EQ(2010u, stats1.request.sum_us);
+  EXPECT_EQ(2000u, stats1.request.max_us);
+  EXPECT_EQ(10u, stats1.request.Percentile(50));
+  EXPECT_EQ(2000u, stats1.request.Percentile(100));
+  EXPECT_EQ(1u, stats1.check_transport.count);
+  EXPECT_EQ(0u, stats1.auth.count);
+}
+
+}  // namespace
+}  // namespace api_manager
+}  // namespace google
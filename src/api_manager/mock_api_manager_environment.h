@@ -30,6 +30,11 @@ class MockApiManagerEnvironment : public ApiManagerEnvInterface {
                                               std::function<void()>));
   MOCK_METHOD1(DoRunHTTPRequest, void(HTTPRequest *));
   MOCK_METHOD1(DoRunGRPCRequest, void(GRPCRequest *));
+  MOCK_METHOD0(GetSharedCache, SharedCache *());
+  MOCK_METHOD2(RunInThreadPool,
+               bool(std::function<void()>, std::function<void()>));
+  MOCK_METHOD2(RunInBackground,
+               bool(std::function<void()>, std::function<void()>));
   virtual void RunHTTPRequest(std::unique_ptr<HTTPRequest> req) {
     DoRunHTTPRequest(req.get());
   }
@@ -22,6 +22,7 @@
 #include <string>
 #include <unordered_map>
 
+#include "src/api_manager/compiled_path_matcher.h"
 #include "src/api_manager/http_template.h"
 #include "src/api_manager/path_matcher_node.h"
 
@@ -63,14 +64,13 @@ class PathMatcher {
   Method Lookup(const std::string& http_method, const std::string& path) const;
 
  private:
-  // Creates a Path Matcher with a Builder by moving the builder's root node.
+  // Creates a Path Matcher with a Builder by compiling the builder's root
+  // node and moving its methods.
   explicit PathMatcher(PathMatcherBuilder<Method>&& builder);
 
-  // A root node shared by all services, i.e. paths of all services will be
-  // registered to this node.
-  std::unique_ptr<PathMatcherNode> root_ptr_;
-  // Holds the set of custom verbs found in configured templates.
-  std::set<std::string> custom_verbs_;
+  // The compiled trie of the paths of all services, with the set of custom
+  // verbs found in configured templates.
+  std::unique_ptr<CompiledPathMatcher> matcher_;
   // Data we store per each registered method
   struct MethodData {
     Method method;
@@ -191,9 +191,9 @@ inline int hex_digit_to_int(char c) {
 //
 // If the next three characters are an escaped character then this function will
 // also return what character is escaped.
-bool GetEscapedChar(const std::string& src, size_t i,
+bool GetEscapedChar(const char* src, size_t size, size_t i,
                     bool unescape_reserved_chars, char* out) {
-  if (i + 2 < src.size() && src[i] == '%') {
+  if (i + 2 < size && src[i] == '%') {
     if (ascii_isxdigit(src[i + 1]) && ascii_isxdigit(src[i + 2])) {
       char c =
           (hex_digit_to_int(src[i + 1]) << 4) | hex_digit_to_int(src[i + 2]);
@@ -210,30 +210,30 @@ bool GetEscapedChar(const std::string& src, size_t i,
 // Unescapes string 'part' and returns the unescaped string. Reserved characters
 // (as specified in RFC 6570) are not escaped if unescape_reserved_chars is
 // false.
-std::string UrlUnescapeString(const std::string& part,
+std::string UrlUnescapeString(const char* part, size_t size,
                               bool unescape_reserved_chars) {
   std::string unescaped;
   // Check whether we need to escape at all.
   bool needs_unescaping = false;
   char ch = '\0';
-  for (size_t i = 0; i < part.size(); ++i) {
-    if (GetEscapedChar(part, i, unescape_reserved_chars, &ch)) {
+  for (size_t i = 0; i < size; ++i) {
+    if (GetEscapedChar(part, size, i, unescape_reserved_chars, &ch)) {
       needs_unescaping = true;
       break;
     }
   }
   if (!needs_unescaping) {
-    unescaped = part;
+    unescaped.assign(part, size);
     return unescaped;
   }
 
-  unescaped.resize(part.size());
+  unescaped.resize(size);
 
   char* begin = &(unescaped)[0];
   char* p = begin;
 
-  for (size_t i = 0; i < part.size();) {
-    if (GetEscapedChar(part, i, unescape_reserved_chars, &ch)) {
+  for (size_t i = 0; i < size;) {
+    if (GetEscapedChar(part, size, i, unescape_reserved_chars, &ch)) {
       *p++ = ch;
       i += 3;
     } else {
@@ -248,7 +248,7 @@ std::string UrlUnescapeString(const std::string& part,
 
 template <class VariableBinding>
 void ExtractBindingsFromPath(const std::vector<HttpTemplate::Variable>& vars,
-                             const std::vector<std::string>& parts,
+                             const RequestPathSegments& parts,
                              std::vector<VariableBinding>* bindings) {
   for (const auto& var : vars) {
     // Determine the subpath bound to the variable based on the
@@ -270,7 +270,8 @@ void ExtractBindingsFromPath(const std::vector<HttpTemplate::Variable>& vars,
     // Joins parts with "/"  to form a path string.
     for (size_t i = var.start_segment; i < end_segment; ++i) {
       // For multipart matches only unescape non-reserved characters.
-      binding.value += UrlUnescapeString(parts[i], !is_multipart);
+      const PathSegment& part = parts.data()[i];
+      binding.value += UrlUnescapeString(part.data, part.size, !is_multipart);
       if (i < end_segment - 1) {
         binding.value += "/";
       }
@@ -302,62 +303,14 @@ void ExtractBindingsFromQueryParameters(
         // in the request, e.g. `book.author.name`.
         VariableBinding binding;
         split(name, '.', binding.field_path);
-        binding.value = UrlUnescapeString(param.substr(pos + 1), true);
+        binding.value = UrlUnescapeString(param.data() + pos + 1,
+                                          param.size() - pos - 1, true);
         bindings->emplace_back(std::move(binding));
       }
     }
   }
 }
 
-// Converts a request path into a format that can be used to perform a request
-// lookup in the PathMatcher trie. This utility method sanitizes the request
-// path and then splits the path into slash separated parts. Returns an empty
-// vector if the sanitized path is "/".
-//
-// custom_verbs is a set of configured custom verbs that are used to match
-// against any custom verbs in request path. If the request_path contains a
-// custom verb not found in custom_verbs, it is treated as a part of the path.
-//
-// - Strips off query string: "/a?foo=bar" --> "/a"
-// - Collapses extra slashes: "///" --> "/"
-std::vector<std::string> ExtractRequestParts(
-    std::string path, const std::set<std::string>& custom_verbs) {
-  // Remove query parameters.
-  path = path.substr(0, path.find_first_of('?'));
-
-  // Replace last ':' with '/' to handle custom verb.
-  // But not for /foo:bar/const.
-  std::size_t last_colon_pos = path.find_last_of(':');
-  std::size_t last_slash_pos = path.find_last_of('/');
-  if (last_colon_pos != std::string::npos && last_colon_pos > last_slash_pos) {
-    std::string verb = path.substr(last_colon_pos + 1);
-    // only verb in the configured custom verbs, treat it as verb
-    // replace ":" with / as a separate segment.
-    if (custom_verbs.find(verb) != custom_verbs.end()) {
-      path[last_colon_pos] = '/';
-    }
-  }
-
-  std::vector<std::string> result;
-  if (path.size() > 0) {
-    split(path.substr(1), '/', result);
-  }
-  // Removes all trailing empty parts caused by extra "/".
-  while (!result.empty() && (*(--result.end())).empty()) {
-    result.pop_back();
-  }
-  return result;
-}
-
-// Looks up on a PathMatcherNode.
-PathMatcherLookupResult LookupInPathMatcherNode(
-    const PathMatcherNode& root, const std::vector<std::string>& parts,
-    const HttpMethod& http_method) {
-  PathMatcherLookupResult result;
-  root.LookupPath(parts.begin(), parts.end(), http_method, &result);
-  return result;
-}
-
 PathMatcherNode::PathInfo TransformHttpTemplate(const HttpTemplate& ht) {
   PathMatcherNode::PathInfo::Builder builder;
 
@@ -375,16 +328,15 @@ PathMatcherNode::PathInfo TransformHttpTemplate(const HttpTemplate& ht) {
 
 template <class Method>
 PathMatcher<Method>::PathMatcher(PathMatcherBuilder<Method>&& builder)
-    : root_ptr_(std::move(builder.root_ptr_)),
-      custom_verbs_(std::move(builder.custom_verbs_)),
+    : matcher_(new CompiledPathMatcher(*builder.root_ptr_,
+                                       builder.custom_verbs_)),
       methods_(std::move(builder.methods_)) {}
 
-// Lookup is a wrapper method for the recursive node Lookup. First, the wrapper
-// splits the request path into slash-separated path parts. Next, the method
-// checks that the |http_method| is supported. If not, then it returns an empty
-// WrapperGraph::SharedPtr. Next, this method invokes the node's Lookup on
-// the extracted |parts|. Finally, it fills the mapping from variables to their
-// values parsed from the path.
+// Lookup is a wrapper method for the compiled matcher Lookup. First, the
+// wrapper splits the request path into slash-separated path parts, which point
+// into |path|. Next, this method invokes the matcher's Lookup on the extracted
+// |parts|. Finally, it fills the mapping from variables to their values parsed
+// from the path. No memory is allocated unless bindings are requested.
 // TODO: cache results by adding get/put methods here (if profiling reveals
 // benefit)
 template <class Method>
@@ -394,17 +346,9 @@ Method PathMatcher<Method>::Lookup(
     const std::string& query_params,
     std::vector<VariableBinding>* variable_bindings,
     std::string* body_field_path) const {
-  const std::vector<std::string> parts =
-      ExtractRequestParts(path, custom_verbs_);
-
-  // If service_name has not been registered to ESP and strict_service_matching_
-  // is set to false, tries to lookup the method in all registered services.
-  if (root_ptr_ == nullptr) {
-    return nullptr;
-  }
-
+  RequestPathSegments parts(*matcher_, path);
   PathMatcherLookupResult lookup_result =
-      LookupInPathMatcherNode(*root_ptr_, parts, http_method);
+      matcher_->Lookup(http_method, parts.data(), parts.size());
   // Return nullptr if nothing is found.
   // Not need to check duplication. Only first item is stored for duplicated
   if (lookup_result.data == nullptr) {
@@ -428,17 +372,9 @@ Method PathMatcher<Method>::Lookup(
 template <class Method>
 Method PathMatcher<Method>::Lookup(const std::string& http_method,
                                    const std::string& path) const {
-  const std::vector<std::string> parts =
-      ExtractRequestParts(path, custom_verbs_);
-
-  // If service_name has not been registered to ESP and strict_service_matching_
-  // is set to false, tries to lookup the method in all registered services.
-  if (root_ptr_ == nullptr) {
-    return nullptr;
-  }
-
+  RequestPathSegments parts(*matcher_, path);
   PathMatcherLookupResult lookup_result =
-      LookupInPathMatcherNode(*root_ptr_, parts, http_method);
+      matcher_->Lookup(http_method, parts.data(), parts.size());
   // Return nullptr if nothing is found.
   // Not need to check duplication. Only first item is stored for duplicated
   if (lookup_result.data == nullptr) {
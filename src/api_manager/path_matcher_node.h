@@ -140,6 +140,9 @@ class PathMatcherNode {
   void set_wildcard(bool wildcard) { wildcard_ = wildcard; }
 
  private:
+  // Flattens the trie for lookups.
+  friend class CompiledPathMatcher;
+
   // This method inserts a path of nodes into this subtrie (described by the
   // vector<Info>, starting from the |current| position in the iterator of path
   // parts, and if necessary, creating intermediate nodes along the way. The
@@ -783,6 +783,60 @@ TEST_F(PathMatcherTest, VariableBindingsWithQueryParamsAndSystemParams) {
       bindings);
 }
 
+TEST_F(PathMatcherTest, CustomHttpMethod) {
+  MethodInfo* custom = AddPath("CUSTOM", "/a/b");
+  MethodInfo* any = AddPath("*", "/a/c");
+  Build();
+
+  EXPECT_NE(nullptr, custom);
+  EXPECT_NE(nullptr, any);
+
+  EXPECT_EQ(LookupNoBindings("CUSTOM", "/a/b"), custom);
+  EXPECT_EQ(LookupNoBindings("GET", "/a/b"), nullptr);
+  EXPECT_EQ(LookupNoBindings("OTHER", "/a/b"), nullptr);
+  EXPECT_EQ(LookupNoBindings("CUSTOM", "/a/c"), any);
+  EXPECT_EQ(LookupNoBindings("OTHER", "/a/c"), any);
+}
+
+TEST_F(PathMatcherTest, LongPaths) {
+  // More segments than the matcher keeps on the stack.
+  std::string long_template;
+  std::string long_path;
+  for (int i = 0; i < 100; ++i) {
+    long_template += "/s" + std::to_string(i);
+    long_path += "/s" + std::to_string(i);
+  }
+  MethodInfo* a = AddGetPath(long_template + "/{x}");
+  MethodInfo* b = AddGetPath("/b/{x=**}");
+  Build();
+
+  EXPECT_NE(nullptr, a);
+  EXPECT_NE(nullptr, b);
+
+  Bindings bindings;
+  EXPECT_EQ(Lookup("GET", long_path + "/hello", &bindings), a);
+  EXPECT_EQ(Bindings({Binding{FieldPath{"x"}, "hello"}}), bindings);
+  EXPECT_EQ(LookupNoBindings("GET", long_path + "/hello/world"), nullptr);
+
+  EXPECT_EQ(Lookup("GET", "/b" + long_path + "///", &bindings), b);
+  EXPECT_EQ(Bindings({Binding{FieldPath{"x"}, long_path.substr(1)}}),
+            bindings);
+}
+
+TEST_F(PathMatcherTest, EmptySegments) {
+  MethodInfo* a_b = AddGetPath("/a/{x}/b");
+  Build();
+
+  EXPECT_NE(nullptr, a_b);
+
+  Bindings bindings;
+  EXPECT_EQ(Lookup("GET", "/a//b", &bindings), a_b);
+  EXPECT_EQ(Bindings({Binding{FieldPath{"x"}, ""}}), bindings);
+  EXPECT_EQ(Lookup("GET", "/a/x/b//?c=d", &bindings), a_b);
+  EXPECT_EQ(Bindings({Binding{FieldPath{"x"}, "x"}}), bindings);
+  EXPECT_EQ(Lookup("GET", "/a/x//b", &bindings), nullptr);
+}
+
 }  // namespace
 
 }  // namespace api_manager
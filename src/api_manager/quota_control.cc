@@ -29,7 +29,7 @@ namespace api_manager {
 void QuotaControl(std::shared_ptr<context::RequestContext> context,
                   std::function<void(Status status)> continuation) {
   std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span(
-      CreateSpan(context->cloud_trace(), "QuotaControl"));
+      CreateSpan(context->cloud_trace(), cloud_trace::kQuotaControlSpanName));
 
   if (context->method()->metric_cost_vector().size() == 0 ||
       context->method()->skip_service_control()) {
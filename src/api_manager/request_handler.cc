@@ -16,6 +16,8 @@
 //
 #include "src/api_manager/request_handler.h"
 
+#include <cstring>
+
 #include "google/devtools/cloudtrace/v1/trace.pb.h"
 #include "google/protobuf/stubs/logging.h"
 #include "src/api_manager/auth/service_account_token.h"
@@ -30,6 +32,51 @@ using google::devtools::cloudtrace::v1::Traces;
 namespace google {
 namespace api_manager {
 
+namespace {
+
+// Returns the histogram of a check workflow stage, nullptr if the latency of
+// the stage is not recorded.
+LatencyHistogram *GetStageLatency(LatencyStatistics *stats,
+                                  const char *stage) {
+  if (strcmp(stage, "CheckAuth") == 0) {
+    return &stats->auth;
+  } else if (strcmp(stage, "CheckSecurityRules") == 0) {
+    return &stats->security_rules;
+  } else if (strcmp(stage, "CheckServiceControl") == 0) {
+    return &stats->check;
+  } else if (strcmp(stage, "QuotaControl") == 0) {
+    return &stats->quota;
+  }
+  return nullptr;
+}
+
+// Records the latencies of the check workflow stages, the backend and the
+// whole request.
+void RecordLatencies(const context::RequestContext &context,
+                     Response *response, LatencyStatistics *stats) {
+  for (const auto &stage : context.check_stage_latencies()) {
+    LatencyHistogram *histogram = GetStageLatency(stats, stage.first);
+    if (histogram != nullptr) {
+      histogram->Record(stage.second.count());
+    }
+  }
+  if (response == nullptr) {
+    return;
+  }
+  service_control::LatencyInfo latency;
+  if (!response->GetLatencyInfo(&latency).ok()) {
+    return;
+  }
+  if (latency.backend_time_ms >= 0) {
+    stats->backend.Record(latency.backend_time_ms * 1000);
+  }
+  if (latency.request_time_ms >= 0) {
+    stats->request.Record(latency.request_time_ms * 1000);
+  }
+}
+
+}  // namespace
+
 RequestHandler::RequestHandler(
     std::shared_ptr<CheckWorkflow> check_workflow,
     std::shared_ptr<context::ServiceContext> service_context,
@@ -97,6 +144,9 @@ void RequestHandler::AttemptIntermediateReport() {
 // Sends a report.
 void RequestHandler::Report(std::unique_ptr<Response> response,
                             std::function<void(void)> continuation) {
+  RecordLatencies(*context_, response.get(),
+                  &context_->service_context()->latency_statistics());
+
   if (context_->method() && context_->method()->skip_service_control()) {
     continuation();
     return;
@@ -131,7 +181,7 @@ void RequestHandler::Report(std::unique_ptr<Response> response,
     context_->service_context()->cloud_trace_aggregator()->SetProjectId(
         context_->service_context()->project_id());
     context_->service_context()->cloud_trace_aggregator()->AppendTrace(
-        context_->cloud_trace()->ReleaseTrace());
+        context_->cloud_trace()->trace());
   }
 
   continuation();
@@ -0,0 +1,465 @@
+// Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Benchmarks of request routing and config loading, by the number of HTTP
+// rules of the service:
+// 1. PathMatcher::Lookup without variable bindings, as in
+//    Config::GetMethodInfo.
+// 2. PathMatcher::Lookup with variable bindings, as in
+//    Config::GetMethodCallInfo.
+// 3. HttpTemplate::Parse of the templates of the rules.
+// 4. Config::Create of the test bookstore service config, scaled up to the
+//    number of rules.
+//
+// The allocations are counted by replacing the global operators new and
+// delete.
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "google/api/service.pb.h"
+#include "include/api_manager/env_interface.h"
+#include "include/api_manager/method_call_info.h"
+#include "src/api_manager/config.h"
+#include "src/api_manager/http_template.h"
+#include "src/api_manager/path_matcher.h"
+#include "src/api_manager/utils/marshalling.h"
+
+using ::google::api::HttpRule;
+using ::google::api::Service;
+using ::google::api_manager::ApiManagerEnvInterface;
+using ::google::api_manager::Config;
+using ::google::api_manager::GRPCRequest;
+using ::google::api_manager::HTTPRequest;
+using ::google::api_manager::HttpTemplate;
+using ::google::api_manager::PathMatcherBuilder;
+using ::google::api_manager::PathMatcherPtr;
+using ::google::api_manager::PeriodicTimer;
+using ::google::api_manager::VariableBinding;
+
+namespace {
+
+// Heap usage, updated by the replaced operator new and delete. The benchmark
+// is single threaded.
+struct HeapStats {
+  size_t allocations;
+  size_t live_bytes;
+  size_t peak_bytes;
+};
+
+HeapStats heap_stats;
+
+// Allocations are prefixed with their size and the address returned by
+// malloc, so that the live bytes can be tracked and over-aligned allocations
+// freed. The prefix keeps the alignment of malloc.
+struct SizePrefix {
+  size_t size;
+  void *block;
+};
+
+const size_t kSizePrefix = 16;
+static_assert(sizeof(SizePrefix) <= kSizePrefix, "SizePrefix too large");
+
+void *TryAllocate(size_t size, size_t alignment) {
+  size_t offset = alignment > kSizePrefix ? alignment : kSizePrefix;
+  void *block = nullptr;
+  if (alignment > kSizePrefix) {
+    if (posix_memalign(&block, alignment, size + offset) != 0) {
+      return nullptr;
+    }
+  } else {
+    block = malloc(size + offset);
+    if (block == nullptr) {
+      return nullptr;
+    }
+  }
+  char *p = static_cast<char *>(block) + offset;
+  SizePrefix *prefix = reinterpret_cast<SizePrefix *>(p - kSizePrefix);
+  prefix->size = size;
+  prefix->block = block;
+  ++heap_stats.allocations;
+  heap_stats.live_bytes += size;
+  if (heap_stats.live_bytes > heap_stats.peak_bytes) {
+    heap_stats.peak_bytes = heap_stats.live_bytes;
+  }
+  return p;
+}
+
+void *Allocate(size_t size, size_t alignment) {
+  void *p = TryAllocate(size, alignment);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void Deallocate(void *ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  SizePrefix *prefix =
+      reinterpret_cast<SizePrefix *>(static_cast<char *>(ptr) - kSizePrefix);
+  heap_stats.live_bytes -= prefix->size;
+  free(prefix->block);
+}
+
+}  // namespace
+
+// All the replaceable forms of operator new and delete are replaced, so that
+// no allocation escapes the counters, and no pointer allocated by the
+// replacements is freed by the default implementations.
+void *operator new(size_t size) { return Allocate(size, 0); }
+void *operator new[](size_t size) { return Allocate(size, 0); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return TryAllocate(size, 0);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return TryAllocate(size, 0);
+}
+void operator delete(void *ptr) noexcept { Deallocate(ptr); }
+void operator delete[](void *ptr) noexcept { Deallocate(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  Deallocate(ptr);
+}
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  Deallocate(ptr);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void *ptr, size_t) noexcept { Deallocate(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { Deallocate(ptr); }
+#endif
+
+#if defined(__cpp_aligned_new)
+void *operator new(size_t size, std::align_val_t alignment) {
+  return Allocate(size, static_cast<size_t>(alignment));
+}
+void *operator new[](size_t size, std::align_val_t alignment) {
+  return Allocate(size, static_cast<size_t>(alignment));
+}
+void *operator new(size_t size, std::align_val_t alignment,
+                   const std::nothrow_t &) noexcept {
+  return TryAllocate(size, static_cast<size_t>(alignment));
+}
+void *operator new[](size_t size, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept {
+  return TryAllocate(size, static_cast<size_t>(alignment));
+}
+void operator delete(void *ptr, std::align_val_t) noexcept { Deallocate(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+  Deallocate(ptr);
+}
+void operator delete(void *ptr, std::align_val_t,
+                     const std::nothrow_t &) noexcept {
+  Deallocate(ptr);
+}
+void operator delete[](void *ptr, std::align_val_t,
+                       const std::nothrow_t &) noexcept {
+  Deallocate(ptr);
+}
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+  Deallocate(ptr);
+}
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept {
+  Deallocate(ptr);
+}
+#endif
+
+namespace {
+
+const int kRuleCounts[] = {10, 1000, 10000};
+const int kDefaultLookups = 1000000;
+const char kDefaultServiceConfig[] =
+    "src/api_manager/testdata/bookstore_service_config_1.json";
+
+// The method registered to the path matcher, with no system parameters.
+class BenchmarkMethod {
+ public:
+  const std::set<std::string> &system_query_parameter_names() const {
+    return system_query_parameter_names_;
+  }
+
+ private:
+  std::set<std::string> system_query_parameter_names_;
+};
+
+// An HTTP rule of the synthetic service and a request path matching it.
+struct SyntheticRule {
+  std::string http_method;
+  std::string http_template;
+  std::string path;
+};
+
+// Generates the given number of rules, mixing literal paths, variables,
+// wildcards and custom verbs.
+std::vector<SyntheticRule> GenerateRules(int count) {
+  std::vector<SyntheticRule> rules;
+  for (int i = 0; i < count; ++i) {
+    std::string prefix = "/v1/resources" + std::to_string(i);
+    switch (i % 4) {
+      case 0:
+        rules.push_back({"GET", prefix, prefix});
+        break;
+      case 1:
+        rules.push_back({"GET", prefix + "/{id}", prefix + "/123"});
+        break;
+      case 2:
+        rules.push_back({"POST", prefix + "/{id}/items/{item.name}",
+                         prefix + "/123/items/abc"});
+        break;
+      default:
+        rules.push_back(
+            {"DELETE", prefix + "/{name=**}:purge", prefix + "/a/b/c:purge"});
+        break;
+    }
+  }
+  return rules;
+}
+
+class Timer {
+ public:
+  Timer()
+      : start_(std::chrono::steady_clock::now()),
+        start_allocations_(heap_stats.allocations),
+        start_bytes_(heap_stats.live_bytes) {
+    heap_stats.peak_bytes = heap_stats.live_bytes;
+  }
+
+  double seconds() const {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start_;
+    return elapsed.count();
+  }
+
+  size_t allocations() const {
+    return heap_stats.allocations - start_allocations_;
+  }
+
+  size_t peak_bytes() const { return heap_stats.peak_bytes - start_bytes_; }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+  size_t start_allocations_;
+  size_t start_bytes_;
+};
+
+void print_rate(const char *name, int count, int operations,
+                const Timer &timer) {
+  printf("%-24s rules: %6d  %12.0f ops/s  %6.2f allocations/op\n", name, count,
+         operations / timer.seconds(),
+         static_cast<double>(timer.allocations()) / operations);
+}
+
+void BenchmarkPathMatcher(int count, int lookups) {
+  std::vector<SyntheticRule> rules = GenerateRules(count);
+  BenchmarkMethod method;
+  PathMatcherBuilder<BenchmarkMethod *> builder;
+  for (const auto &rule : rules) {
+    if (!builder.Register(rule.http_method, rule.http_template, "", &method)) {
+      fprintf(stderr, "Invalid template %s.\n", rule.http_template.c_str());
+      exit(1);
+    }
+  }
+  PathMatcherPtr<BenchmarkMethod *> matcher = builder.Build();
+
+  {
+    Timer timer;
+    for (int i = 0; i < lookups; ++i) {
+      const SyntheticRule &rule = rules[i % rules.size()];
+      if (matcher->Lookup(rule.http_method, rule.path) == nullptr) {
+        fprintf(stderr, "No match for %s.\n", rule.path.c_str());
+        exit(1);
+      }
+    }
+    print_rate("Lookup", count, lookups, timer);
+  }
+
+  {
+    std::vector<VariableBinding> bindings;
+    std::string body_field_path;
+    Timer timer;
+    for (int i = 0; i < lookups; ++i) {
+      const SyntheticRule &rule = rules[i % rules.size()];
+      if (matcher->Lookup(rule.http_method, rule.path, "", &bindings,
+                          &body_field_path) == nullptr) {
+        fprintf(stderr, "No match for %s.\n", rule.path.c_str());
+        exit(1);
+      }
+    }
+    print_rate("Lookup with bindings", count, lookups, timer);
+  }
+}
+
+void BenchmarkHttpTemplateParse(int count) {
+  std::vector<SyntheticRule> rules = GenerateRules(count);
+  // Parses at least 100000 templates to get a stable rate.
+  int rounds = (100000 + count - 1) / count;
+  Timer timer;
+  for (int round = 0; round < rounds; ++round) {
+    for (const auto &rule : rules) {
+      std::unique_ptr<HttpTemplate> ht(HttpTemplate::Parse(rule.http_template));
+      if (ht == nullptr) {
+        fprintf(stderr, "Invalid template %s.\n", rule.http_template.c_str());
+        exit(1);
+      }
+    }
+  }
+  print_rate("HttpTemplate::Parse", count, rounds * count, timer);
+}
+
+// Logs errors only.
+class BenchmarkEnv : public ApiManagerEnvInterface {
+ public:
+  void Log(LogLevel level, const char *message) override {
+    if (level == ERROR) {
+      fprintf(stderr, "%s\n", message);
+    }
+  }
+  std::unique_ptr<PeriodicTimer> StartPeriodicTimer(
+      std::chrono::milliseconds interval,
+      std::function<void()> continuation) override {
+    return std::unique_ptr<PeriodicTimer>();
+  }
+  void RunHTTPRequest(std::unique_ptr<HTTPRequest> request) override {}
+  void RunGRPCRequest(std::unique_ptr<GRPCRequest> request) override {}
+};
+
+// Returns a pointer to the path of the rule, nullptr for a custom rule with
+// no path.
+std::string *MutablePath(HttpRule *rule) {
+  switch (rule->pattern_case()) {
+    case HttpRule::kGet:
+      return rule->mutable_get();
+    case HttpRule::kPut:
+      return rule->mutable_put();
+    case HttpRule::kPost:
+      return rule->mutable_post();
+    case HttpRule::kDelete:
+      return rule->mutable_delete_();
+    case HttpRule::kPatch:
+      return rule->mutable_patch();
+    case HttpRule::kCustom:
+      return rule->mutable_custom()->mutable_path();
+    default:
+      return nullptr;
+  }
+}
+
+// Scales up the service config to the given number of HTTP rules by copying
+// the HTTP and usage rules of the base config under distinct selectors and
+// path prefixes. Returns the scaled config in JSON, as fetched from the
+// service management API.
+std::string ScaleServiceConfig(const Service &base, int count) {
+  Service service = base;
+  service.mutable_http()->clear_rules();
+  service.mutable_usage()->clear_rules();
+  int base_count = base.http().rules_size();
+  for (int i = 0; i < count; ++i) {
+    std::string suffix = std::to_string(i / base_count);
+    HttpRule *rule = service.mutable_http()->add_rules();
+    *rule = base.http().rules(i % base_count);
+    rule->set_selector(rule->selector() + "_" + suffix);
+    std::string *path = MutablePath(rule);
+    if (path != nullptr) {
+      *path = "/c" + suffix + *path;
+    }
+  }
+  for (int i = 0; i < (count + base_count - 1) / base_count; ++i) {
+    std::string suffix = std::to_string(i);
+    for (const auto &usage_rule : base.usage().rules()) {
+      auto *rule = service.mutable_usage()->add_rules();
+      *rule = usage_rule;
+      rule->set_selector(rule->selector() + "_" + suffix);
+    }
+  }
+  std::string json;
+  ::google::api_manager::utils::ProtoToJson(
+      service, &json, ::google::api_manager::utils::DEFAULT);
+  return json;
+}
+
+void BenchmarkConfigCreate(const Service &base, int count) {
+  std::string service_config = ScaleServiceConfig(base, count);
+  BenchmarkEnv env;
+  Timer timer;
+  std::unique_ptr<Config> config = Config::Create(&env, service_config);
+  double seconds = timer.seconds();
+  if (config == nullptr) {
+    fprintf(stderr, "Config::Create failed.\n");
+    exit(1);
+  }
+  printf("%-24s rules: %6d  %12.3f ms  %12zu bytes peak  %zu allocations\n",
+         "Config::Create", count, seconds * 1000, timer.peak_bytes(),
+         timer.allocations());
+}
+
+bool ReadFile(const char *path, std::string *content) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  *content = buffer.str();
+  return true;
+}
+
+void print_usage() {
+  fprintf(stderr,
+          "Usage: routing_perf [service_config_file] [lookups].\n"
+          "  service_config_file: (default %s) the JSON service config\n"
+          "    scaled up for Config::Create.\n"
+          "  lookups: (default %d) the number of path matcher lookups.\n",
+          kDefaultServiceConfig, kDefaultLookups);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const char *service_config_file =
+      argc > 1 ? argv[1] : kDefaultServiceConfig;
+  std::string json;
+  Service base;
+  if (!ReadFile(service_config_file, &json) ||
+      !::google::api_manager::utils::JsonToProto(json, &base).ok() ||
+      base.http().rules_size() == 0) {
+    print_usage();
+    return 1;
+  }
+  int lookups = argc > 2 ? atoi(argv[2]) : kDefaultLookups;
+  if (lookups <= 0) {
+    print_usage();
+    return 1;
+  }
+
+  for (int count : kRuleCounts) {
+    BenchmarkPathMatcher(count, lookups);
+  }
+  for (int count : kRuleCounts) {
+    BenchmarkHttpTemplateParse(count);
+  }
+  for (int count : kRuleCounts) {
+    BenchmarkConfigCreate(base, count);
+  }
+  return 0;
+}
@@ -16,6 +16,7 @@
 //
 #include "src/api_manager/service_control/aggregated.h"
 
+#include <map>
 #include <sstream>
 #include <typeinfo>
 #include "src/api_manager/service_control/logs_metrics_loader.h"
@@ -65,11 +66,6 @@ const int kAllocateQuotaDefaultTimeoutInMs = 1000;
 // The default connection timeout for report requests.
 const int kReportDefaultTimeoutInMs = 15000;
 
-// The maximum protobuf pool size. All usages of pool alloc() and free() are
-// within a function frame. If no con-current usage, pool size of 1 is enough.
-// This number should correspond to maximum of concurrent calls.
-const int kProtoPoolMaxSize = 100;
-
 // Defines protobuf content type.
 const char application_proto[] = "application/x-protobuf";
 
@@ -81,6 +77,77 @@ const char servicecontrol_service[] =
 const char quotacontrol_service[] =
     "/google.api.servicecontrol.v1.QuotaController";
 
+// The gRPC method names of service control.
+const char check_method[] = "Check";
+const char report_method[] = "Report";
+const char allocate_quota_method[] = "AllocateQuota";
+
+// Returns true if service control should be called over gRPC.
+bool UseGrpcTransport(const ServerConfig* server_config) {
+  return server_config && server_config->has_service_control_config() &&
+         server_config->service_control_config().transport() ==
+             ::google::api_manager::proto::ServiceControlConfig::GRPC;
+}
+
+// Appends a field of a shared cache key. Fields are '\0' terminated so
+// that adjacent fields cannot be confused.
+void AppendKeyField(const std::string& field, std::string* key) {
+  key->append(field);
+  key->push_back('\0');
+}
+
+void AppendKeyLabels(
+    const ::google::protobuf::Map<std::string, std::string>& labels,
+    std::string* key) {
+  // Map iteration order is unspecified, sort the labels.
+  std::map<std::string, std::string> sorted(labels.begin(), labels.end());
+  for (const auto& label : sorted) {
+    AppendKeyField(label.first, key);
+    AppendKeyField(label.second, key);
+  }
+}
+
+// Returns the shared cache key of a check request. Operation ID and
+// timestamps differ for every request and are not part of the key.
+std::string SharedCacheKey(const CheckRequest& request) {
+  const auto& operation = request.operation();
+  std::string key("check");
+  key.push_back('\0');
+  AppendKeyField(request.service_name(), &key);
+  AppendKeyField(request.service_config_id(), &key);
+  AppendKeyField(operation.operation_name(), &key);
+  AppendKeyField(operation.consumer_id(), &key);
+  AppendKeyLabels(operation.labels(), &key);
+  return key;
+}
+
+// Returns the shared cache key of an allocate quota request. Quota costs
+// are not part of the key.
+std::string SharedCacheKey(const AllocateQuotaRequest& request) {
+  const auto& operation = request.allocate_operation();
+  std::string key("quota");
+  key.push_back('\0');
+  AppendKeyField(request.service_name(), &key);
+  AppendKeyField(request.service_config_id(), &key);
+  AppendKeyField(operation.method_name(), &key);
+  AppendKeyField(operation.consumer_id(), &key);
+  AppendKeyLabels(operation.labels(), &key);
+  for (const auto& metric : operation.quota_metrics()) {
+    AppendKeyField(metric.metric_name(), &key);
+  }
+  return key;
+}
+
+// Check responses are the same for every request with the same key, and
+// can be shared by all the workers.
+bool IsSharable(const CheckResponse& response) { return true; }
+
+// Quota allocations are charged per request and cannot be shared. Only the
+// denials are: a consumer out of quota is out of quota for all the workers.
+bool IsSharable(const AllocateQuotaResponse& response) {
+  return response.allocate_errors_size() > 0;
+}
+
 // Generates CheckAggregationOptions.
 CheckAggregationOptions GetCheckAggregationOptions(
     const ServerConfig* server_config) {
@@ -131,41 +198,24 @@ ReportAggregationOptions GetReportAggregationOptions(
 
 }  // namespace
 
-template <class Type>
-std::unique_ptr<Type> Aggregated::ProtoPool<Type>::Alloc() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  if (!pool_.empty()) {
-    auto item = std::move(pool_.front());
-    pool_.pop_front();
-    item->Clear();
-    return item;
-  } else {
-    return std::unique_ptr<Type>(new Type);
-  }
-}
-
-template <class Type>
-void Aggregated::ProtoPool<Type>::Free(std::unique_ptr<Type> item) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  if (pool_.size() < kProtoPoolMaxSize) {
-    pool_.push_back(std::move(item));
-  }
-}
-
 Aggregated::Aggregated(const ::google::api::Service& service,
                        const ServerConfig* server_config,
                        ApiManagerEnvInterface* env,
                        auth::ServiceAccountToken* sa_token,
                        const std::set<std::string>& logs,
                        const std::set<std::string>& metrics,
-                       const std::set<std::string>& labels)
+                       const std::set<std::string>& labels,
+                       LatencyStatistics* latency_statistics)
     : service_(&service),
       server_config_(server_config),
       env_(env),
       sa_token_(sa_token),
+      latency_statistics_(latency_statistics),
       service_control_proto_(logs, metrics, labels, service.name(),
                              service.id()),
       url_(service_, server_config),
+      use_grpc_(UseGrpcTransport(server_config)),
+      shared_cache_(nullptr),
       mismatched_check_config_id_(service.id()),
       mismatched_report_config_id_(service.id()),
       max_report_size_(0) {
@@ -186,8 +236,11 @@ Aggregated::Aggregated(const std::set<std::string>& logs,
       server_config_(nullptr),
       env_(env),
       sa_token_(nullptr),
+      latency_statistics_(nullptr),
       service_control_proto_(logs, "", ""),
       url_(service_, server_config_),
+      use_grpc_(false),
+      shared_cache_(nullptr),
       client_(std::move(client)),
       max_report_size_(0) {}
 
@@ -217,6 +270,12 @@ Status Aggregated::Init() {
      << ", flush_interval_ms: " << options.report_options.flush_interval_ms;
   env_->LogInfo(ss.str().c_str());
 
+  shared_cache_ = env_->GetSharedCache();
+  check_shared_cache_ttl_ =
+      std::chrono::milliseconds(options.check_options.flush_interval_ms);
+  quota_shared_cache_ttl_ =
+      std::chrono::milliseconds(options.quota_options.refresh_interval_ms);
+
   options.check_transport = [this](
       const CheckRequest& request, CheckResponse* response,
       TransportDoneFunc on_done) { Call(request, response, on_done, nullptr); };
@@ -251,10 +310,10 @@ Status Aggregated::Report(const ReportRequestInfo& info) {
   if (!client_) {
     return Status(Code::INTERNAL, "Missing service control client");
   }
-  auto request = report_pool_.Alloc();
-  Status status = service_control_proto_.FillReportRequest(info, request.get());
+  ReportRequest* request = request_arena_.Alloc<ReportRequest>();
+  Status status = service_control_proto_.FillReportRequest(info, request);
   if (!status.ok()) {
-    report_pool_.Free(std::move(request));
+    request_arena_.Free();
     return status;
   }
   ReportResponse* response = new ReportResponse;
@@ -284,7 +343,7 @@ Status Aggregated::Report(const ReportRequestInfo& info) {
       });
   // There is no reference to request anymore at this point and it is safe to
   // free request now.
-  report_pool_.Free(std::move(request));
+  request_arena_.Free();
   return Status::OK;
 }
 
@@ -292,18 +351,19 @@ void Aggregated::Check(
     const CheckRequestInfo& info, cloud_trace::CloudTraceSpan* parent_span,
     std::function<void(Status, const CheckResponseInfo&)> on_done) {
   std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span(
-      CreateChildSpan(parent_span, "CheckServiceControlCache"));
+      CreateChildSpan(parent_span,
+                      cloud_trace::kCheckServiceControlCacheSpanName));
   CheckResponseInfo dummy_response_info;
   if (!client_) {
     on_done(Status(Code::INTERNAL, "Missing service control client"),
             dummy_response_info);
     return;
   }
-  auto request = check_pool_.Alloc();
-  Status status = service_control_proto_.FillCheckRequest(info, request.get());
+  CheckRequest* request = request_arena_.Alloc<CheckRequest>();
+  Status status = service_control_proto_.FillCheckRequest(info, request);
   if (!status.ok()) {
+    request_arena_.Free();
     on_done(status, dummy_response_info);
-    check_pool_.Free(std::move(request));
     return;
   }
 
@@ -359,31 +419,33 @@ void Aggregated::Check(
       *request, response, check_on_done,
       [trace_span, this](const CheckRequest& request, CheckResponse* response,
                          TransportDoneFunc on_done) {
-        Call(request, response, on_done, trace_span.get());
+        CallWithSharedCache(request, response, on_done, trace_span.get(),
+                            check_shared_cache_ttl_);
       });
   // There is no reference to request anymore at this point and it is safe to
   // free request now.
-  check_pool_.Free(std::move(request));
+  request_arena_.Free();
 }
 
 void Aggregated::Quota(const QuotaRequestInfo& info,
                        cloud_trace::CloudTraceSpan* parent_span,
                        std::function<void(utils::Status)> on_done) {
   std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span(
-      CreateChildSpan(parent_span, "QuotaServiceControlCache"));
+      CreateChildSpan(parent_span,
+                      cloud_trace::kQuotaServiceControlCacheSpanName));
 
   if (!client_) {
     on_done(Status(Code::INTERNAL, "Missing service control client"));
     return;
   }
 
-  auto request = quota_pool_.Alloc();
+  AllocateQuotaRequest* request = request_arena_.Alloc<AllocateQuotaRequest>();
 
   Status status =
-      service_control_proto_.FillAllocateQuotaRequest(info, request.get());
+      service_control_proto_.FillAllocateQuotaRequest(info, request);
   if (!status.ok()) {
+    request_arena_.Free();
     on_done(status);
-    quota_pool_.Free(std::move(request));
     return;
   }
 
@@ -409,12 +471,14 @@ void Aggregated::Quota(const QuotaRequestInfo& info,
                  [trace_span, this](const AllocateQuotaRequest& request,
                                     AllocateQuotaResponse* response,
                                     TransportDoneFunc on_done) {
-                   Call(request, response, on_done, trace_span.get());
+                   CallWithSharedCache(request, response, on_done,
+                                       trace_span.get(),
+                                       quota_shared_cache_ttl_);
                  });
 
   // There is no reference to request anymore at this point and it is safe to
   // free request now.
-  quota_pool_.Free(std::move(request));
+  request_arena_.Free();
 }
 
 Status Aggregated::GetStatistics(Statistics* esp_stat) const {
@@ -452,6 +516,27 @@ const std::string& Aggregated::GetApiReqeustUrl() {
   }
 }
 
+template <class RequestType>
+const char* Aggregated::GetGrpcService() {
+  // Skip the leading '/' of the audience.
+  if (typeid(RequestType) == typeid(AllocateQuotaRequest)) {
+    return quotacontrol_service + 1;
+  } else {
+    return servicecontrol_service + 1;
+  }
+}
+
+template <class RequestType>
+const char* Aggregated::GetGrpcMethod() {
+  if (typeid(RequestType) == typeid(CheckRequest)) {
+    return check_method;
+  } else if (typeid(RequestType) == typeid(AllocateQuotaRequest)) {
+    return allocate_quota_method;
+  } else {
+    return report_method;
+  }
+}
+
 template <class RequestType>
 int Aggregated::GetHttpRequestTimeout() {
   int timeout_ms = 0;
@@ -502,12 +587,53 @@ const std::string& Aggregated::GetAuthToken() {
   }
 }
 
+template <class RequestType>
+LatencyHistogram* Aggregated::GetTransportLatency() {
+  if (latency_statistics_ == nullptr) {
+    return nullptr;
+  }
+  if (typeid(RequestType) == typeid(CheckRequest)) {
+    return &latency_statistics_->check_transport;
+  } else if (typeid(RequestType) == typeid(AllocateQuotaRequest)) {
+    return &latency_statistics_->quota_transport;
+  } else {
+    return &latency_statistics_->report_transport;
+  }
+}
+
 template <class RequestType, class ResponseType>
 void Aggregated::Call(const RequestType& request, ResponseType* response,
                       TransportDoneFunc on_done,
                       cloud_trace::CloudTraceSpan* parent_span) {
+  LatencyHistogram* latency = GetTransportLatency<RequestType>();
+  if (latency != nullptr) {
+    // Records the round trip, including failures and timeouts.
+    auto start_time = std::chrono::steady_clock::now();
+    on_done = [latency, start_time,
+               on_done](const ::google::protobuf::util::Status& status) {
+      latency->Record(std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - start_time)
+                          .count());
+      on_done(status);
+    };
+  }
+
   std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span(
-      CreateChildSpan(parent_span, "Call ServiceControl server"));
+      CreateChildSpan(parent_span, cloud_trace::kServiceControlCallSpanName));
+
+  std::string request_body;
+  request.SerializeToString(&request_body);
+
+  if ((typeid(RequestType) == typeid(ReportRequest)) &&
+      (request_body.size() > max_report_size_)) {
+    max_report_size_ = request_body.size();
+  }
+
+  if (use_grpc_) {
+    CallGrpc<RequestType>(std::move(request_body), response, on_done,
+                          trace_span);
+    return;
+  }
 
   const std::string& url = GetApiReqeustUrl<RequestType>();
   TRACE(trace_span) << "Http request URL: " << url;
@@ -541,14 +667,6 @@ void Aggregated::Call(const RequestType& request, ResponseType* response,
     on_done(status.ToProto());
   }));
 
-  std::string request_body;
-  request.SerializeToString(&request_body);
-
-  if ((typeid(RequestType) == typeid(ReportRequest)) &&
-      (request_body.size() > max_report_size_)) {
-    max_report_size_ = request_body.size();
-  }
-
   http_request->set_url(url)
       .set_method("POST")
       .set_auth_token(GetAuthToken<RequestType>())
@@ -560,10 +678,82 @@ void Aggregated::Call(const RequestType& request, ResponseType* response,
   env_->RunHTTPRequest(std::move(http_request));
 }
 
+template <class RequestType, class ResponseType>
+void Aggregated::CallWithSharedCache(
+    const RequestType& request, ResponseType* response,
+    TransportDoneFunc on_done, cloud_trace::CloudTraceSpan* parent_span,
+    std::chrono::milliseconds ttl) {
+  if (shared_cache_ == nullptr || ttl.count() <= 0) {
+    Call(request, response, on_done, parent_span);
+    return;
+  }
+
+  std::string key = SharedCacheKey(request);
+  std::string value;
+  if (shared_cache_->Lookup(key, &value) && response->ParseFromString(value)) {
+    on_done(::google::protobuf::util::Status::OK);
+    return;
+  }
+
+  SharedCache* shared_cache = shared_cache_;
+  Call(request, response,
+       [shared_cache, key, response, on_done,
+        ttl](const ::google::protobuf::util::Status& status) {
+         if (status.ok() && IsSharable(*response)) {
+           std::string value;
+           response->SerializeToString(&value);
+           shared_cache->Insert(key, value, ttl);
+         }
+         on_done(status);
+       },
+       parent_span);
+}
+
+template <class RequestType, class ResponseType>
+void Aggregated::CallGrpc(
+    std::string&& request_body, ResponseType* response,
+    TransportDoneFunc on_done,
+    std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span) {
+  const char* method = GetGrpcMethod<RequestType>();
+  TRACE(trace_span) << "gRPC request method: " << method;
+
+  std::unique_ptr<GRPCRequest> grpc_request(new GRPCRequest([method, response,
+                                                             on_done,
+                                                             trace_span, this](
+      Status status, std::string&& body) {
+    TRACE(trace_span) << "gRPC response status: " << status.ToString();
+    if (status.ok()) {
+      if (!response->ParseFromString(body)) {
+        status =
+            Status(Code::INVALID_ARGUMENT, std::string("Invalid response"));
+      }
+    } else {
+      env_->LogError(std::string("Failed to call service control ") + method +
+                     ", Error: " + status.ToString());
+
+      status = Status(Code::UNAVAILABLE,
+                      "Service control gRPC request failed: " +
+                          status.ToString());
+    }
+    on_done(status.ToProto());
+  }));
+
+  grpc_request->set_server(url_.grpc_server())
+      .set_use_ssl(url_.grpc_use_ssl())
+      .set_service(GetGrpcService<RequestType>())
+      .set_method(method)
+      .set_auth_token(GetAuthToken<RequestType>())
+      .set_timeout_ms(GetHttpRequestTimeout<RequestType>())
+      .set_body(std::move(request_body));
+
+  env_->RunGRPCRequest(std::move(grpc_request));
+}
+
 Interface* Aggregated::Create(const ::google::api::Service& service,
                               const ServerConfig* server_config,
                               ApiManagerEnvInterface* env,
-                              auth::ServiceAccountToken* sa_token) {
+                              auth::ServiceAccountToken* sa_token,
+                              LatencyStatistics* latency_statistics) {
   if (server_config &&
       server_config->service_control_config().force_disable()) {
     env->LogError("Service control is disabled.");
@@ -578,7 +768,7 @@ Interface* Aggregated::Create(const ::google::api::Service& service,
   std::set<std::string> logs, metrics, labels;
   Status s = LogsMetricsLoader::Load(service, &logs, &metrics, &labels);
   return new Aggregated(service, server_config, env, sa_token, logs, metrics,
-                        labels);
+                        labels, latency_statistics);
 }
 
 }  // namespace service_control
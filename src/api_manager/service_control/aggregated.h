@@ -19,16 +19,17 @@
 #include "google/api/servicecontrol/v1/quota_controller.pb.h"
 #include "google/api/servicecontrol/v1/service_controller.pb.h"
 #include "include/api_manager/env_interface.h"
+#include "include/api_manager/latency_statistics.h"
 #include "include/service_control_client.h"
 #include "src/api_manager/auth/service_account_token.h"
 #include "src/api_manager/cloud_trace/cloud_trace.h"
 #include "src/api_manager/proto/server_config.pb.h"
 #include "src/api_manager/service_control/interface.h"
 #include "src/api_manager/service_control/proto.h"
+#include "src/api_manager/service_control/request_arena.h"
 #include "src/api_manager/service_control/url.h"
 
-#include <list>
-#include <mutex>
+#include <chrono>
 
 namespace google {
 namespace api_manager {
@@ -37,10 +38,13 @@ namespace service_control {
 // This implementation uses service-control-client-cxx module.
 class Aggregated : public Interface {
  public:
+  // The round trips of the calls to the service control server are recorded
+  // in latency_statistics, unless it is nullptr.
   static Interface* Create(const ::google::api::Service& service,
                            const proto::ServerConfig* server_config,
                            ApiManagerEnvInterface* env,
-                           auth::ServiceAccountToken* sa_token);
+                           auth::ServiceAccountToken* sa_token,
+                           LatencyStatistics* latency_statistics = nullptr);
 
   virtual ~Aggregated();
 
@@ -77,25 +81,6 @@ class Aggregated : public Interface {
     std::unique_ptr<::google::api_manager::PeriodicTimer> esp_timer_;
   };
 
-  // The protobuf pool to reuse protobuf. Performance tests showed that reusing
-  // protobuf is faster than allocating a new protobuf.
-  template <class Type>
-  class ProtoPool {
-   public:
-    // Allocates a protobuf. If there is one in the pool, uses it, otherwise
-    // creates a new one.
-    std::unique_ptr<Type> Alloc();
-    // Frees a protobuf. If pool did not reach maximum size, stores it in the
-    // pool, otherwise frees it.
-    void Free(std::unique_ptr<Type> item);
-
-   private:
-    // Protobuf pool to store used protobufs.
-    std::list<std::unique_ptr<Type>> pool_;
-    // Mutex to protect the protobuf pool.
-    std::mutex mutex_;
-  };
-
   friend class AggregatedTestWithMockedClient;
   // Constructor for unit-test only.
   Aggregated(
@@ -108,7 +93,8 @@ class Aggregated : public Interface {
              ApiManagerEnvInterface* env, auth::ServiceAccountToken* sa_token,
              const std::set<std::string>& logs,
              const std::set<std::string>& metrics,
-             const std::set<std::string>& labels);
+             const std::set<std::string>& labels,
+             LatencyStatistics* latency_statistics);
 
   // Calls to service control server.
   template <class RequestType, class ResponseType>
@@ -116,10 +102,31 @@ class Aggregated : public Interface {
             ::google::service_control_client::TransportDoneFunc on_done,
             cloud_trace::CloudTraceSpan* parent_span);
 
+  // Calls to service control server, unless the response is found in the
+  // cache shared by all the workers. Sharable responses are stored in the
+  // shared cache for ttl.
+  template <class RequestType, class ResponseType>
+  void CallWithSharedCache(
+      const RequestType& request, ResponseType* response,
+      ::google::service_control_client::TransportDoneFunc on_done,
+      cloud_trace::CloudTraceSpan* parent_span, std::chrono::milliseconds ttl);
+
+  // Calls to service control server over gRPC.
+  template <class RequestType, class ResponseType>
+  void CallGrpc(std::string&& request_body, ResponseType* response,
+                ::google::service_control_client::TransportDoneFunc on_done,
+                std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span);
+
   // Returns API request url based on RequestType
   template <class RequestType>
   const std::string& GetApiReqeustUrl();
 
+  // Returns gRPC service and method names based on RequestType
+  template <class RequestType>
+  const char* GetGrpcService();
+  template <class RequestType>
+  const char* GetGrpcMethod();
+
   // Returns API request timeout in ms based on RequestType
   template <class RequestType>
   int GetHttpRequestTimeout();
@@ -128,6 +135,11 @@ class Aggregated : public Interface {
   template <class RequestType>
   const std::string& GetAuthToken();
 
+  // Returns the histogram of the round trips based on RequestType, nullptr
+  // if latencies are not recorded.
+  template <class RequestType>
+  LatencyHistogram* GetTransportLatency();
+
   // the sevice config.
   const ::google::api::Service* service_;
   // the server config.
@@ -139,24 +151,32 @@ class Aggregated : public Interface {
   // service account token.
   auth::ServiceAccountToken* sa_token_;
 
+  // The latency histograms, nullptr if latencies are not recorded.
+  LatencyStatistics* latency_statistics_;
+
   // The object to fill service control Check and Report protobuf.
   Proto service_control_proto_;
 
   // Stores service control urls.
   Url url_;
 
+  // If true, service control is called over gRPC instead of HTTP.
+  bool use_grpc_;
+
+  // The cache shared by all the workers, nullptr if not available.
+  SharedCache* shared_cache_;
+  // How long check responses and quota denials are kept in the shared cache.
+  std::chrono::milliseconds check_shared_cache_ttl_;
+  std::chrono::milliseconds quota_shared_cache_ttl_;
+
   // The service control client instance.
   std::unique_ptr<::google::service_control_client::ServiceControlClient>
       client_;
 
-  // The protobuf pool to reuse AllocateQuotaRequest protobuf.
-  ProtoPool<::google::api::servicecontrol::v1::AllocateQuotaRequest>
-      quota_pool_;
-
-  // The protobuf pool to reuse CheckRequest protobuf.
-  ProtoPool<::google::api::servicecontrol::v1::CheckRequest> check_pool_;
-  // The protobuf pool to reuse ReportRequest protobuf.
-  ProtoPool<::google::api::servicecontrol::v1::ReportRequest> report_pool_;
+  // The arena to build CheckRequest, AllocateQuotaRequest and ReportRequest
+  // protobufs on. Performance tests showed that building them on an arena is
+  // faster than reusing cleared protobufs.
+  RequestArena request_arena_;
 
   // Mismatched config ID received for a check request
   std::string mismatched_check_config_id_;
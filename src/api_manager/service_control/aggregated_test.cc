@@ -241,6 +241,223 @@ TEST_F(AggregatedTestWithRealClient, CheckOKTest) {
   EXPECT_EQ(stat.send_report_operations, 0);
 }
 
+class AggregatedTestWithGrpcTransport : public ::testing::Test {
+ public:
+  void SetUp() {
+    service_.set_name("test_service");
+    service_.mutable_control()->set_environment(
+        "servicecontrol.googleapis.com");
+    server_config_.mutable_service_control_config()->set_transport(
+        proto::ServiceControlConfig::GRPC);
+    env_.reset(new ::testing::NiceMock<MockApiManagerEnvironment>);
+    sc_lib_.reset(
+        Aggregated::Create(service_, &server_config_, env_.get(), nullptr));
+    ASSERT_TRUE((bool)(sc_lib_));
+    sc_lib_->Init();
+  }
+
+  void DoRunGRPCRequest(GRPCRequest* request) {
+    EXPECT_EQ(request->server(), "servicecontrol.googleapis.com:443");
+    EXPECT_TRUE(request->use_ssl());
+    EXPECT_EQ(request->service(),
+              "google.api.servicecontrol.v1.ServiceController");
+    EXPECT_EQ(request->method(), "Check");
+
+    CheckRequest check_request;
+    ASSERT_TRUE(check_request.ParseFromString(request->body()));
+    EXPECT_EQ(check_request.service_name(), "test_service");
+
+    CheckResponse check_response;
+    check_response.set_operation_id("operation_id");
+    std::string body;
+    check_response.SerializeToString(&body);
+    request->OnComplete(Status::OK, std::move(body));
+  }
+
+  void DoRunGRPCRequestFailed(GRPCRequest* request) {
+    request->OnComplete(Status(Code::DEADLINE_EXCEEDED, "Deadline Exceeded"),
+                        std::string());
+  }
+
+  ::google::api::Service service_;
+  proto::ServerConfig server_config_;
+  std::unique_ptr<MockApiManagerEnvironment> env_;
+  std::unique_ptr<Interface> sc_lib_;
+};
+
+TEST_F(AggregatedTestWithGrpcTransport, CheckOKTest) {
+  EXPECT_CALL(*env_, DoRunHTTPRequest(_)).Times(0);
+  EXPECT_CALL(*env_, DoRunGRPCRequest(_))
+      .WillOnce(
+          Invoke(this, &AggregatedTestWithGrpcTransport::DoRunGRPCRequest));
+
+  bool done = false;
+  CheckRequestInfo info;
+  FillOperationInfo(&info);
+  sc_lib_->Check(info, nullptr,
+                 [&done](Status status, const CheckResponseInfo& info) {
+                   ASSERT_TRUE(status.ok());
+                   done = true;
+                 });
+  EXPECT_TRUE(done);
+}
+
+TEST_F(AggregatedTestWithGrpcTransport, CheckFailedTest) {
+  EXPECT_CALL(*env_, DoRunGRPCRequest(_))
+      .WillOnce(Invoke(
+          this, &AggregatedTestWithGrpcTransport::DoRunGRPCRequestFailed));
+
+  bool done = false;
+  CheckRequestInfo info;
+  FillOperationInfo(&info);
+  sc_lib_->Check(info, nullptr,
+                 [&done](Status status, const CheckResponseInfo& info) {
+                   ASSERT_EQ(status.code(), Code::UNAVAILABLE);
+                   done = true;
+                 });
+  EXPECT_TRUE(done);
+}
+
+// An in-process SharedCache which ignores the expiration.
+class FakeSharedCache : public SharedCache {
+ public:
+  bool Lookup(const std::string& key, std::string* value) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+      return false;
+    }
+    *value = it->second;
+    return true;
+  }
+
+  void Insert(const std::string& key, const std::string& value,
+              std::chrono::milliseconds ttl) {
+    entries_[key] = value;
+  }
+
+  std::map<std::string, std::string> entries_;
+};
+
+class AggregatedTestWithSharedCache : public ::testing::Test {
+ public:
+  void SetUp() {
+    service_.set_name("test_service");
+    service_.mutable_control()->set_environment(
+        "servicecontrol.googleapis.com");
+    env_.reset(new ::testing::NiceMock<MockApiManagerEnvironment>);
+    ON_CALL(*env_, GetSharedCache()).WillByDefault(Return(&shared_cache_));
+  }
+
+  std::unique_ptr<Interface> CreateWorker() {
+    std::unique_ptr<Interface> sc_lib(
+        Aggregated::Create(service_, nullptr, env_.get(), nullptr));
+    sc_lib->Init();
+    return sc_lib;
+  }
+
+  void DoRunHTTPRequest(HTTPRequest* request) {
+    CheckResponse response;
+    response.set_operation_id("operation_id");
+    std::map<std::string, std::string> headers;
+    request->OnComplete(Status::OK, std::move(headers),
+                        response.SerializeAsString());
+  }
+
+  void DoRunHTTPRequestAllocateQuota(HTTPRequest* request) {
+    RunAllocateQuotaRequest(request, kAllocateQuotaResponse);
+  }
+
+  void DoRunHTTPRequestAllocationFailed(HTTPRequest* request) {
+    RunAllocateQuotaRequest(request, kAllocateQuotaResponseErrorExhausted);
+  }
+
+  void RunAllocateQuotaRequest(HTTPRequest* request, const char* response) {
+    AllocateQuotaResponse quota_response;
+    ::google::protobuf::TextFormat::ParseFromString(response, &quota_response);
+    std::map<std::string, std::string> headers;
+    request->OnComplete(Status::OK, std::move(headers),
+                        quota_response.SerializeAsString());
+  }
+
+  ::google::api::Service service_;
+  FakeSharedCache shared_cache_;
+  std::unique_ptr<MockApiManagerEnvironment> env_;
+  std::vector<std::pair<std::string, int>> metric_cost_vector_ = {
+      {"metric_first", 1}};
+};
+
+TEST_F(AggregatedTestWithSharedCache, CheckSharedByWorkers) {
+  // Only the first worker calls service control.
+  EXPECT_CALL(*env_, DoRunHTTPRequest(_))
+      .WillOnce(Invoke(this, &AggregatedTestWithSharedCache::DoRunHTTPRequest));
+
+  auto worker1 = CreateWorker();
+  auto worker2 = CreateWorker();
+
+  CheckRequestInfo info;
+  FillOperationInfo(&info);
+
+  int done = 0;
+  auto on_done = [&done](Status status, const CheckResponseInfo& info) {
+    ASSERT_TRUE(status.ok());
+    ++done;
+  };
+  worker1->Check(info, nullptr, on_done);
+  EXPECT_EQ(shared_cache_.entries_.size(), 1);
+
+  // A different operation ID is the same check.
+  info.operation_id = "another_operation_id";
+  worker2->Check(info, nullptr, on_done);
+  EXPECT_EQ(done, 2);
+}
+
+TEST_F(AggregatedTestWithSharedCache, QuotaAllocationNotShared) {
+  // Both workers allocate quota.
+  EXPECT_CALL(*env_, DoRunHTTPRequest(_))
+      .Times(2)
+      .WillRepeatedly(Invoke(this, &AggregatedTestWithSharedCache::
+                                       DoRunHTTPRequestAllocateQuota));
+
+  auto worker1 = CreateWorker();
+  auto worker2 = CreateWorker();
+
+  QuotaRequestInfo info;
+  info.metric_cost_vector = &metric_cost_vector_;
+  FillOperationInfo(&info);
+
+  worker1->Quota(info, nullptr,
+                 [](Status status) { ASSERT_TRUE(status.ok()); });
+  worker2->Quota(info, nullptr,
+                 [](Status status) { ASSERT_TRUE(status.ok()); });
+  EXPECT_TRUE(shared_cache_.entries_.empty());
+}
+
+TEST_F(AggregatedTestWithSharedCache, QuotaDenialSharedByWorkers) {
+  // Only the first worker calls service control.
+  EXPECT_CALL(*env_, DoRunHTTPRequest(_))
+      .WillOnce(Invoke(this, &AggregatedTestWithSharedCache::
+                                 DoRunHTTPRequestAllocationFailed));
+
+  auto worker1 = CreateWorker();
+  auto worker2 = CreateWorker();
+
+  QuotaRequestInfo info;
+  info.metric_cost_vector = &metric_cost_vector_;
+  FillOperationInfo(&info);
+
+  // Quota cache always allows the first call, and the negative response
+  // takes effect on the second call.
+  worker1->Quota(info, nullptr,
+                 [](Status status) { EXPECT_EQ(status.code(), Code::OK); });
+  EXPECT_EQ(shared_cache_.entries_.size(), 1);
+
+  worker2->Quota(info, nullptr,
+                 [](Status status) { EXPECT_EQ(status.code(), Code::OK); });
+  worker2->Quota(info, nullptr, [](Status status) {
+    EXPECT_EQ(status.code(), Code::RESOURCE_EXHAUSTED);
+  });
+}
+
 class QuotaAllocationTestWithRealClient : public ::testing::Test {
  public:
   void SetUp() {
@@ -822,6 +822,32 @@ const SupportedLabel supported_labels[] = {
 const int supported_labels_count =
     sizeof(supported_labels) / sizeof(supported_labels[0]);
 
+// Returns true if the value of the label only depends on the method and on
+// the configuration, so that it is filled once in the report templates.
+bool IsStaticLabel(const SupportedLabel* l) {
+  return l->set == set_location || l->set == set_api_method ||
+         l->set == set_api_version || l->set == set_platform ||
+         l->set == set_service_agent || l->set == set_user_agent;
+}
+
+// Returns true if the metric is sent in the first, intermediate or final
+// reports as given.
+bool IsReportedMetric(const SupportedMetric* m, bool is_first_report,
+                      bool is_final_report) {
+  return (is_first_report && m->tag == SupportedMetric::START) ||
+         (is_final_report && (m->tag == SupportedMetric::FINAL ||
+                              m->tag == SupportedMetric::INTERMEDIATE)) ||
+         (!is_final_report && m->tag == SupportedMetric::INTERMEDIATE);
+}
+
+// Returns the index of the metrics of a report in Proto::report_metrics_
+// and Proto::by_consumer_metrics_.
+int ReportMetricsIndex(bool is_first_report, bool is_final_report,
+                       bool send_consumer_metric) {
+  return (is_first_report ? 1 : 0) | (is_final_report ? 2 : 0) |
+         (send_consumer_metric ? 4 : 0);
+}
+
 // Supported intrinsic labels:
 // "servicecontrol.googleapis.com/operation_name": Operation.operation_name
 // "servicecontrol.googleapis.com/consumer_id": Operation.consumer_id
@@ -902,43 +928,52 @@ void SetOperationCommonFields(const OperationInfo& info,
   *op->mutable_end_time() = current_time;
 }
 
-void FillLogEntry(const ReportRequestInfo& info, const std::string& name,
-                  const Timestamp& current_time, LogEntry* log_entry) {
+// Fills the fields of the log entry which only depend on the method and on
+// the configuration.
+void FillLogEntryTemplate(const ReportRequestInfo& info,
+                          const std::string& name, LogEntry* log_entry) {
   log_entry->set_name(name);
-  *log_entry->mutable_timestamp() = current_time;
-  auto severity = (info.response_code >= 400) ? google::logging::type::ERROR
-                                              : google::logging::type::INFO;
-  log_entry->set_severity(severity);
 
   auto* fields = log_entry->mutable_struct_payload()->mutable_fields();
-  (*fields)[kLogFieldNameTimestamp].set_number_value(
-      (double)current_time.seconds() +
-      (double)current_time.nanos() / (double)1000000000.0);
   if (!info.producer_project_id.empty()) {
     (*fields)[kLogFieldNameProducerProjectId].set_string_value(
         info.producer_project_id);
   }
-  if (!info.api_key.empty()) {
-    (*fields)[kLogFieldNameApiKey].set_string_value(info.api_key);
-  }
-  if (!info.referer.empty()) {
-    (*fields)[kLogFieldNameReferer].set_string_value(info.referer);
-  }
   if (!info.api_name.empty()) {
     (*fields)[kLogFieldNameApiName].set_string_value(info.api_name);
   }
   if (!info.api_version.empty()) {
     (*fields)[kLogFieldNameApiVersion].set_string_value(info.api_version);
   }
-  if (!info.url.empty()) {
-    (*fields)[kLogFieldNameUrl].set_string_value(info.url);
-  }
   if (!info.api_method.empty()) {
     (*fields)[kLogFieldNameApiMethod].set_string_value(info.api_method);
   }
   if (!info.location.empty()) {
     (*fields)[kLogFieldNameLocation].set_string_value(info.location);
   }
+}
+
+// Fills the fields of a log entry copied from a report template.
+void FillLogEntry(const ReportRequestInfo& info, const Timestamp& current_time,
+                  LogEntry* log_entry) {
+  *log_entry->mutable_timestamp() = current_time;
+  auto severity = (info.response_code >= 400) ? google::logging::type::ERROR
+                                              : google::logging::type::INFO;
+  log_entry->set_severity(severity);
+
+  auto* fields = log_entry->mutable_struct_payload()->mutable_fields();
+  (*fields)[kLogFieldNameTimestamp].set_number_value(
+      (double)current_time.seconds() +
+      (double)current_time.nanos() / (double)1000000000.0);
+  if (!info.api_key.empty()) {
+    (*fields)[kLogFieldNameApiKey].set_string_value(info.api_key);
+  }
+  if (!info.referer.empty()) {
+    (*fields)[kLogFieldNameReferer].set_string_value(info.referer);
+  }
+  if (!info.url.empty()) {
+    (*fields)[kLogFieldNameUrl].set_string_value(info.url);
+  }
   if (!info.log_message.empty()) {
     (*fields)[kLogFieldNameLogMessage].set_string_value(info.log_message);
   }
@@ -980,6 +1015,37 @@ std::vector<const Element*> FilterPointers(
 
 }  // namespace
 
+// The parts of the reports of a method which do not depend on the request.
+struct ReportTemplate {
+  ReportTemplate(const ReportRequestInfo& info)
+      : api_name(info.api_name),
+        api_version(info.api_version),
+        location(info.location),
+        producer_project_id(info.producer_project_id),
+        compute_platform(info.compute_platform) {}
+
+  // Returns true if the template was built from the same request fields.
+  bool Matches(const ReportRequestInfo& info) const {
+    return api_name == info.api_name && api_version == info.api_version &&
+           location == info.location &&
+           producer_project_id == info.producer_project_id &&
+           compute_platform == info.compute_platform;
+  }
+
+  // The request fields, other than the api method, the template was built
+  // from.
+  const std::string api_name;
+  const std::string api_version;
+  const std::string location;
+  const std::string producer_project_id;
+  const compute_platform::ComputePlatform compute_platform;
+
+  // The values of the static labels.
+  Map<std::string, std::string> labels;
+  // The log entries of the configured logs, with their static fields.
+  std::vector<LogEntry> log_entries;
+};
+
 Proto::Proto(const std::set<std::string>& logs, const std::string& service_name,
              const std::string& service_config_id)
     : logs_(logs.begin(), logs.end()),
@@ -990,7 +1056,10 @@ Proto::Proto(const std::set<std::string>& logs, const std::string& service_name,
           supported_labels, supported_labels + supported_labels_count,
           [](const struct SupportedLabel* l) { return l->set != nullptr; })),
       service_name_(service_name),
-      service_config_id_(service_config_id) {}
+      service_config_id_(service_config_id),
+      service_agent_(kServiceAgentPrefix + utils::Version::instance().get()) {
+  Init();
+}
 
 Proto::Proto(const std::set<std::string>& logs,
              const std::set<std::string>& metrics,
@@ -1010,7 +1079,66 @@ Proto::Proto(const std::set<std::string>& logs,
                               labels.find(l->name) != labels.end());
           })),
       service_name_(service_name),
-      service_config_id_(service_config_id) {}
+      service_config_id_(service_config_id),
+      service_agent_(kServiceAgentPrefix + utils::Version::instance().get()) {
+  Init();
+}
+
+Proto::~Proto() {}
+
+void Proto::Init() {
+  for (const SupportedLabel* l : labels_) {
+    if (IsStaticLabel(l)) {
+      static_labels_.push_back(l);
+    } else {
+      dynamic_labels_.push_back(l);
+    }
+  }
+
+  for (bool is_first_report : {false, true}) {
+    for (bool is_final_report : {false, true}) {
+      for (const SupportedMetric* m : metrics_) {
+        if (!IsReportedMetric(m, is_first_report, is_final_report)) {
+          continue;
+        }
+        if (m->mark == SupportedMetric::PRODUCER_BY_CONSUMER) {
+          by_consumer_metrics_[ReportMetricsIndex(is_first_report,
+                                                  is_final_report, false)]
+              .push_back(m);
+          continue;
+        }
+        // Consumer metrics are only sent if there is an api key.
+        for (bool send_consumer_metric : {false, true}) {
+          if (send_consumer_metric || m->mark != SupportedMetric::CONSUMER) {
+            report_metrics_[ReportMetricsIndex(is_first_report,
+                                               is_final_report,
+                                               send_consumer_metric)]
+                .push_back(m);
+          }
+        }
+      }
+    }
+  }
+}
+
+const ReportTemplate& Proto::GetReportTemplate(const ReportRequestInfo& info) {
+  std::unique_ptr<ReportTemplate>& report_template =
+      report_templates_[info.api_method];
+  if (report_template && report_template->Matches(info)) {
+    return *report_template;
+  }
+
+  report_template.reset(new ReportTemplate(info));
+  for (const SupportedLabel* l : static_labels_) {
+    // The static labels never fail.
+    (l->set)(*l, info, &report_template->labels);
+  }
+  for (const std::string& name : logs_) {
+    report_template->log_entries.emplace_back();
+    FillLogEntryTemplate(info, name, &report_template->log_entries.back());
+  }
+  return *report_template;
+}
 
 utils::Status Proto::FillAllocateQuotaRequest(
     const QuotaRequestInfo& info,
@@ -1055,8 +1183,7 @@ utils::Status Proto::FillAllocateQuotaRequest(
     (*labels)[kServiceControlReferer] = info.referer;
   }
   (*labels)[kServiceControlUserAgent] = kUserAgent;
-  (*labels)[kServiceControlServiceAgent] =
-      kServiceAgentPrefix + utils::Version::instance().get();
+  (*labels)[kServiceControlServiceAgent] = service_agent_;
 
   if (info.metric_cost_vector) {
     for (auto metric : *info.metric_cost_vector) {
@@ -1092,8 +1219,7 @@ Status Proto::FillCheckRequest(const CheckRequestInfo& info,
     (*labels)[kServiceControlReferer] = info.referer;
   }
   (*labels)[kServiceControlUserAgent] = kUserAgent;
-  (*labels)[kServiceControlServiceAgent] =
-      kServiceAgentPrefix + utils::Version::instance().get();
+  (*labels)[kServiceControlServiceAgent] = service_agent_;
 
   if (!info.android_package_name.empty()) {
     (*labels)[kServiceControlAndroidPackageName] = info.android_package_name;
@@ -1121,14 +1247,16 @@ Status Proto::FillReportRequest(const ReportRequestInfo& info,
   Timestamp current_time = GetCurrentTimestamp();
   Operation* op = request->add_operations();
   SetOperationCommonFields(info, current_time, op);
+  const ReportTemplate& report_template = GetReportTemplate(info);
 
   // Only populate metrics if we can associate them with a method/operation.
   if (!info.operation_id.empty() && !info.operation_name.empty()) {
     Map<std::string, std::string>* labels = op->mutable_labels();
-    // Set all labels with by_consumer_only is false
-    for (auto it = labels_.begin(), end = labels_.end(); it != end; it++) {
-      const SupportedLabel* l = *it;
-      if (l->set && !l->by_consumer_only) {
+    labels->insert(report_template.labels.begin(),
+                   report_template.labels.end());
+    // Set all other labels with by_consumer_only is false
+    for (const SupportedLabel* l : dynamic_labels_) {
+      if (!l->by_consumer_only) {
         status = (l->set)(*l, info, labels);
         if (!status.ok()) return status;
       }
@@ -1142,28 +1270,20 @@ Status Proto::FillReportRequest(const ReportRequestInfo& info,
     bool send_consumer_metric = !info.api_key.empty();
 
     // Populate all metrics.
-    for (auto it = metrics_.begin(), end = metrics_.end(); it != end; it++) {
-      const SupportedMetric* m = *it;
-      if (send_consumer_metric || m->mark != SupportedMetric::CONSUMER) {
-        if (m->set && m->mark != SupportedMetric::PRODUCER_BY_CONSUMER) {
-          if ((info.is_first_report && m->tag == SupportedMetric::START) ||
-              (info.is_final_report &&
-               (m->tag == SupportedMetric::FINAL ||
-                m->tag == SupportedMetric::INTERMEDIATE)) ||
-              (!info.is_final_report &&
-               m->tag == SupportedMetric::INTERMEDIATE)) {
-            status = (m->set)(*m, info, op);
-            if (!status.ok()) return status;
-          }
-        }
-      }
+    for (const SupportedMetric* m : report_metrics_[ReportMetricsIndex(
+             info.is_first_report, info.is_final_report,
+             send_consumer_metric)]) {
+      status = (m->set)(*m, info, op);
+      if (!status.ok()) return status;
     }
   }
 
   // Fill log entries.
   if (info.is_final_report) {
-    for (auto it = logs_.begin(), end = logs_.end(); it != end; it++) {
-      FillLogEntry(info, *it, current_time, op->add_log_entries());
+    for (const LogEntry& log_entry : report_template.log_entries) {
+      LogEntry* new_log_entry = op->add_log_entries();
+      *new_log_entry = log_entry;
+      FillLogEntry(info, current_time, new_log_entry);
     }
   }
 
@@ -1186,29 +1306,20 @@ utils::Status Proto::AppendByConsumerOperations(
   // Only populate metrics if we can associate them with a method/operation.
   if (!info.operation_id.empty() && !info.operation_name.empty()) {
     Map<std::string, std::string>* labels = op->mutable_labels();
-    // Set all labels.
-    for (auto it = labels_.begin(), end = labels_.end(); it != end; it++) {
-      const SupportedLabel* l = *it;
-      if (l->set) {
-        Status status = (l->set)(*l, info, labels);
-        if (!status.ok()) return status;
-      }
+    const ReportTemplate& report_template = GetReportTemplate(info);
+    labels->insert(report_template.labels.begin(),
+                   report_template.labels.end());
+    // Set all other labels.
+    for (const SupportedLabel* l : dynamic_labels_) {
+      Status status = (l->set)(*l, info, labels);
+      if (!status.ok()) return status;
     }
 
     // Populate all metrics.
-    for (auto it = metrics_.begin(), end = metrics_.end(); it != end; it++) {
-      const SupportedMetric* m = *it;
-      if (m->set && m->mark == SupportedMetric::PRODUCER_BY_CONSUMER) {
-        if ((info.is_first_report && m->tag == SupportedMetric::START) ||
-            (info.is_final_report &&
-             (m->tag == SupportedMetric::FINAL ||
-              m->tag == SupportedMetric::INTERMEDIATE)) ||
-            (!info.is_final_report &&
-             m->tag == SupportedMetric::INTERMEDIATE)) {
-          Status status = (m->set)(*m, info, op);
-          if (!status.ok()) return status;
-        }
-      }
+    for (const SupportedMetric* m : by_consumer_metrics_[ReportMetricsIndex(
+             info.is_first_report, info.is_final_report, false)]) {
+      Status status = (m->set)(*m, info, op);
+      if (!status.ok()) return status;
     }
   }
 
@@ -15,6 +15,11 @@
 #ifndef API_MANAGER_SERVICE_CONTROL_PROTO_H_
 #define API_MANAGER_SERVICE_CONTROL_PROTO_H_
 
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "google/api/label.pb.h"
 #include "google/api/metric.pb.h"
 #include "google/api/servicecontrol/v1/quota_controller.pb.h"
@@ -27,6 +32,9 @@ namespace google {
 namespace api_manager {
 namespace service_control {
 
+struct ReportTemplate;
+
+// Not thread safe: FillReportRequest caches the report templates.
 class Proto final {
  public:
   // Initializes Proto with all supported metrics and labels.
@@ -39,6 +47,8 @@ class Proto final {
         const std::set<std::string>& labels, const std::string& service_name,
         const std::string& service_config_id);
 
+  ~Proto();
+
   // Fills the CheckRequest protobuf from info.
   // There are some logic inside the Fill functions beside just filling
   // the fields, such as if both consumer_projecd_id and api_key present,
@@ -87,11 +97,37 @@ class Proto final {
   const std::string& service_config_id() const { return service_config_id_; }
 
  private:
+  // Splits the labels into static and dynamic ones, and selects the metrics
+  // of each kind of report.
+  void Init();
+
+  // Returns the template of the reports of the method of info, building it
+  // if needed.
+  const ReportTemplate& GetReportTemplate(const ReportRequestInfo& info);
+
   const std::vector<std::string> logs_;
   const std::vector<const struct SupportedMetric*> metrics_;
   const std::vector<const struct SupportedLabel*> labels_;
   const std::string service_name_;
   const std::string service_config_id_;
+
+  // The labels whose values only depend on the method and on the
+  // configuration, they are filled once in the report templates.
+  std::vector<const struct SupportedLabel*> static_labels_;
+  // The labels filled for every report.
+  std::vector<const struct SupportedLabel*> dynamic_labels_;
+
+  // The metrics of the reports, indexed by ReportMetricsIndex().
+  std::vector<const struct SupportedMetric*> report_metrics_[8];
+  // The metrics of the by consumer reports, indexed by ReportMetricsIndex().
+  std::vector<const struct SupportedMetric*> by_consumer_metrics_[4];
+
+  // The report templates, by api method.
+  std::unordered_map<std::string, std::unique_ptr<ReportTemplate>>
+      report_templates_;
+
+  // The service agent label value.
+  const std::string service_agent_;
 };
 
 }  // namespace service_control
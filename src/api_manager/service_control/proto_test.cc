@@ -411,6 +411,67 @@ TEST_F(ProtoTest, CredentailIdIssuerAudienceTest) {
             "jwtauth:issuer=YXV0aC1pc3N1ZXI&audience=YXV0aC1hdWRpZW5jZQ");
 }
 
+TEST_F(ProtoTest, ReportTemplateTest) {
+  ReportRequestInfo info;
+  FillOperationInfo(&info);
+  FillReportRequestInfo(&info);
+  info.is_final_report = true;
+
+  gasv1::ReportRequest first_request;
+  ASSERT_TRUE(scp_.FillReportRequest(info, &first_request).ok());
+
+  // The report template of the method is reused.
+  gasv1::ReportRequest second_request;
+  ASSERT_TRUE(scp_.FillReportRequest(info, &second_request).ok());
+  ASSERT_EQ(ReportRequestToString(&first_request),
+            ReportRequestToString(&second_request));
+
+  // The report template is rebuilt if a static field changes.
+  info.location = "";
+  info.api_version = "v2";
+  gasv1::ReportRequest request;
+  ASSERT_TRUE(scp_.FillReportRequest(info, &request).ok());
+  const auto& labels = request.operations(0).labels();
+  ASSERT_EQ("global", labels.at("cloud.googleapis.com/location"));
+  ASSERT_EQ("v2", labels.at("serviceruntime.googleapis.com/api_version"));
+  const auto& fields =
+      request.operations(0).log_entries(0).struct_payload().fields();
+  ASSERT_EQ(fields.end(), fields.find("location"));
+  ASSERT_EQ("v2", fields.at("api_version").string_value());
+}
+
+TEST_F(ProtoTest, ReportTemplatePerMethodTest) {
+  ReportRequestInfo first_info;
+  FillOperationInfo(&first_info);
+  FillReportRequestInfo(&first_info);
+  first_info.is_final_report = true;
+
+  ReportRequestInfo second_info;
+  FillOperationInfo(&second_info);
+  FillReportRequestInfo(&second_info);
+  second_info.is_final_report = true;
+  second_info.api_method = "other-api-method";
+  second_info.api_version = "other-api-version";
+
+  // The methods alternate, each report has the labels and log fields of its
+  // own method.
+  for (int i = 0; i < 2; ++i) {
+    for (const ReportRequestInfo* info : {&first_info, &second_info}) {
+      gasv1::ReportRequest request;
+      ASSERT_TRUE(scp_.FillReportRequest(*info, &request).ok());
+      const auto& labels = request.operations(0).labels();
+      ASSERT_EQ(info->api_method,
+                labels.at("serviceruntime.googleapis.com/api_method"));
+      ASSERT_EQ(info->api_version,
+                labels.at("serviceruntime.googleapis.com/api_version"));
+      const auto& fields =
+          request.operations(0).log_entries(0).struct_payload().fields();
+      ASSERT_EQ(info->api_method, fields.at("api_method").string_value());
+      ASSERT_EQ(info->api_version, fields.at("api_version").string_value());
+    }
+  }
+}
+
 }  // namespace
 
 }  // namespace service_control
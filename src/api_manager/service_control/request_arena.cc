@@ -0,0 +1,65 @@
+// Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/api_manager/service_control/request_arena.h"
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+namespace {
+
+// The initial size of the block reused by the arena.
+const size_t kInitialBlockSize = 8 * 1024;
+
+// The maximum size of the block reused by the arena. Larger requests still
+// allocate from the heap.
+const size_t kMaxBlockSize = 256 * 1024;
+
+}  // namespace
+
+RequestArena::RequestArena() : in_use_(0) { NewArena(kInitialBlockSize); }
+
+void RequestArena::Free() {
+  if (--in_use_ > 0) {
+    return;
+  }
+  size_t allocated = arena_->SpaceAllocated();
+  if (allocated > block_size_ && block_size_ < kMaxBlockSize) {
+    // The requests did not fit in the block, grow it.
+    size_t block_size = block_size_;
+    while (block_size < allocated && block_size < kMaxBlockSize) {
+      block_size *= 2;
+    }
+    NewArena(block_size);
+  } else {
+    arena_->Reset();
+  }
+}
+
+void RequestArena::NewArena(size_t block_size) {
+  arena_.reset();
+  block_size_ = block_size;
+  block_.reset(new char[block_size]);
+  ::google::protobuf::ArenaOptions options;
+  options.initial_block = block_.get();
+  options.initial_block_size = block_size;
+  arena_.reset(new ::google::protobuf::Arena(options));
+}
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
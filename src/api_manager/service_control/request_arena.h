@@ -0,0 +1,72 @@
+/* Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_SERVICE_CONTROL_REQUEST_ARENA_H_
+#define API_MANAGER_SERVICE_CONTROL_REQUEST_ARENA_H_
+
+#include <cstddef>
+#include <memory>
+
+#include "google/protobuf/arena.h"
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+// An arena to build the service control requests on. Requests are built and
+// passed to the service control client within a function frame, so the arena
+// is reset as soon as none of its requests is in use. The arena starts with
+// a reusable block, grown to fit the largest requests seen, so that building
+// a request does not allocate from the heap in the steady state.
+//
+// Not thread safe: requests are only built on the worker thread.
+class RequestArena {
+ public:
+  RequestArena();
+
+  // Creates a message on the arena. The message is valid until the matching
+  // Free() call.
+  template <class Type>
+  Type* Alloc() {
+    ++in_use_;
+    return ::google::protobuf::Arena::CreateMessage<Type>(arena_.get());
+  }
+
+  // Releases a message created by Alloc(). The arena is reset once all the
+  // messages are released.
+  void Free();
+
+  // Returns the size of the block reused by the arena.
+  size_t block_size() const { return block_size_; }
+
+ private:
+  RequestArena(const RequestArena&) = delete;
+  RequestArena& operator=(const RequestArena&) = delete;
+
+  // Replaces the arena with a new one using a block of the given size.
+  void NewArena(size_t block_size);
+
+  size_t block_size_;
+  std::unique_ptr<char[]> block_;
+  // Declared after block_, so that it is destroyed before its block.
+  std::unique_ptr<::google::protobuf::Arena> arena_;
+  // The number of messages allocated and not freed yet.
+  int in_use_;
+};
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_SERVICE_CONTROL_REQUEST_ARENA_H_
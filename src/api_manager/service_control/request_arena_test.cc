@@ -0,0 +1,78 @@
+// Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/api_manager/service_control/request_arena.h"
+
+#include "google/protobuf/struct.pb.h"
+#include "gtest/gtest.h"
+
+using ::google::protobuf::Struct;
+using ::google::protobuf::Value;
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+namespace {
+
+TEST(RequestArenaTest, ReusesBlock) {
+  RequestArena arena;
+  size_t block_size = arena.block_size();
+
+  Struct* request = arena.Alloc<Struct>();
+  (*request->mutable_fields())["key"].set_string_value("value");
+  ASSERT_EQ(1, request->fields_size());
+  arena.Free();
+
+  // The arena was reset, small requests keep using the same block.
+  request = arena.Alloc<Struct>();
+  ASSERT_EQ(0, request->fields_size());
+  arena.Free();
+  ASSERT_EQ(block_size, arena.block_size());
+}
+
+TEST(RequestArenaTest, NestedRequests) {
+  RequestArena arena;
+  Struct* first = arena.Alloc<Struct>();
+  (*first->mutable_fields())["key"].set_string_value("first");
+
+  // A request built while the first one is in use does not reset the arena.
+  Struct* second = arena.Alloc<Struct>();
+  (*second->mutable_fields())["key"].set_string_value("second");
+  arena.Free();
+  ASSERT_EQ("first", first->fields().at("key").string_value());
+  arena.Free();
+}
+
+TEST(RequestArenaTest, GrowsBlock) {
+  RequestArena arena;
+  size_t block_size = arena.block_size();
+
+  Struct* request = arena.Alloc<Struct>();
+  Value* value = &(*request->mutable_fields())["key"];
+  value->set_string_value(std::string(block_size * 2, 'x'));
+  for (int i = 0; i < 1000; ++i) {
+    (*request->mutable_fields())[std::to_string(i)].set_number_value(i);
+  }
+  arena.Free();
+
+  // The block grew to fit the request.
+  ASSERT_GT(arena.block_size(), block_size);
+}
+
+}  // namespace
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
@@ -52,7 +52,8 @@ const std::string& GetServiceControlAddress(
 }  // namespace
 
 Url::Url(const ::google::api::Service* service,
-         const proto::ServerConfig* server_config) {
+         const proto::ServerConfig* server_config)
+    : grpc_use_ssl_(false) {
   // Precompute check and report URLs
   if (service) {
     service_control_ = GetServiceControlAddress(service, server_config);
@@ -68,6 +69,20 @@ Url::Url(const ::google::api::Service* service,
     check_url_ = path + check_verb;
     report_url_ = path + report_verb;
     quota_url_ = path + quota_verb;
+
+    // The gRPC target is the host and port of the URL, without any path.
+    grpc_use_ssl_ =
+        service_control_.compare(0, sizeof(https) - 1, https) == 0;
+    size_t host_begin = grpc_use_ssl_ ? sizeof(https) - 1 : sizeof(http) - 1;
+    size_t host_end = service_control_.find('/', host_begin);
+    grpc_server_ = service_control_.substr(
+        host_begin,
+        host_end == std::string::npos ? host_end : host_end - host_begin);
+    size_t colon = grpc_server_.rfind(':');
+    if (colon == std::string::npos ||
+        grpc_server_.find(']', colon) != std::string::npos) {
+      grpc_server_ += grpc_use_ssl_ ? ":443" : ":80";
+    }
   }
 }
 
@@ -34,12 +34,19 @@ class Url {
   const std::string& quota_url() const { return quota_url_; }
   const std::string& report_url() const { return report_url_; }
 
+  // Pre-computed gRPC target ("host:port") of service control and whether
+  // the gRPC channel should use TLS.
+  const std::string& grpc_server() const { return grpc_server_; }
+  bool grpc_use_ssl() const { return grpc_use_ssl_; }
+
  private:
   // Pre-computed url for service control methods.
   std::string service_control_;
   std::string check_url_;
   std::string quota_url_;
   std::string report_url_;
+  std::string grpc_server_;
+  bool grpc_use_ssl_;
 };
 
 }  // namespace service_control
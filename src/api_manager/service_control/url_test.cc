@@ -63,6 +63,34 @@ TEST(UrlTest, PrependHttps) {
       url.quota_url());
 }
 
+TEST(UrlTest, GrpcServer) {
+  std::unique_ptr<ApiManagerEnvInterface> env(
+      new ::testing::NiceMock<MockApiManagerEnvironmentWithLog>());
+  std::unique_ptr<Config> config(
+      Config::Create(env.get(), prepend_https_config, ""));
+  ASSERT_TRUE(config);
+  Url url(&config->service(), config->server_config());
+  // The default port of https is used.
+  ASSERT_EQ("servicecontrol.googleapis.com:443", url.grpc_server());
+  ASSERT_TRUE(url.grpc_use_ssl());
+}
+
+TEST(UrlTest, GrpcServerOverride) {
+  std::unique_ptr<ApiManagerEnvInterface> env(
+      new ::testing::NiceMock<MockApiManagerEnvironmentWithLog>());
+  std::unique_ptr<Config> config(Config::Create(env.get(), prepend_https_config,
+                                                R"(
+service_control_config {
+  url_override: "http://127.0.0.1:8081/"
+  transport: GRPC
+}
+)"));
+  ASSERT_TRUE(config);
+  Url url(&config->service(), config->server_config());
+  ASSERT_EQ("127.0.0.1:8081", url.grpc_server());
+  ASSERT_FALSE(url.grpc_use_ssl());
+}
+
 TEST(UrlTest, ServerControlOverride) {
   std::unique_ptr<ApiManagerEnvInterface> env(
       new ::testing::NiceMock<MockApiManagerEnvironmentWithLog>());
@@ -201,9 +201,11 @@ void ProxyFlow::Start(AsyncGrpcQueue *async_grpc_queue,
                       std::shared_ptr<ServerCall> server_call,
                       std::shared_ptr<::grpc::GenericStub> upstream_stub,
                       const std::string &method,
-                      const std::multimap<std::string, std::string> &headers) {
+                      const std::multimap<std::string, std::string> &headers,
+                      std::function<void(const Status &)> on_finish) {
   auto flow = std::make_shared<ProxyFlow>(
-      async_grpc_queue, std::move(server_call), upstream_stub);
+      async_grpc_queue, std::move(server_call), upstream_stub,
+      std::move(on_finish));
   Status status = ProcessDownstreamHeaders(headers, &flow->upstream_context_);
   if (status.ok()) {
     ProxyFlow::StartUpstreamCall(flow, method);
@@ -214,13 +216,15 @@ void ProxyFlow::Start(AsyncGrpcQueue *async_grpc_queue,
 
 ProxyFlow::ProxyFlow(AsyncGrpcQueue *async_grpc_queue,
                      std::shared_ptr<ServerCall> server_call,
-                     std::shared_ptr<::grpc::GenericStub> upstream_stub)
+                     std::shared_ptr<::grpc::GenericStub> upstream_stub,
+                     std::function<void(const Status &)> on_finish)
     : sent_upstream_writes_done_(false),
       started_upstream_finish_(false),
       sent_downstream_finish_(false),
       async_grpc_queue_(async_grpc_queue),
       server_call_(std::move(server_call)),
       upstream_stub_(std::move(upstream_stub)),
+      on_finish_(std::move(on_finish)),
       status_from_esp_(Status::OK) {}
 
 Status ProxyFlow::StatusFromGRPCStatus(const ::grpc::Status &status) {
@@ -448,6 +452,14 @@ void ProxyFlow::StartDownstreamFinish(std::shared_ptr<ProxyFlow> flow,
                              .count();
   flow->server_call_->RecordBackendTime(backend_time);
   flow->server_call_->Finish(status, std::move(response_trailers));
+
+  // The flow may outlive the call until its pending tags complete, so
+  // on_finish_ and whatever it holds are released now.
+  std::function<void(const Status &)> on_finish;
+  on_finish.swap(flow->on_finish_);
+  if (on_finish) {
+    on_finish(status);
+  }
 }
 
 }  // namespace grpc
@@ -26,6 +26,7 @@
 #ifndef GRPC_PROXY_FLOW_H_
 #define GRPC_PROXY_FLOW_H_
 
+#include <functional>
 #include <memory>
 #include <mutex>
 
@@ -44,15 +45,21 @@ class ProxyFlow {
   // Invoked when a call is accepted by the server.  This call
   // instantiates an asynchronous ProxyFlow object which handles
   // proxying the GRPC call to an upstream backend server.
-  static void Start(AsyncGrpcQueue *async_grpc_queue,
-                    std::shared_ptr<ServerCall> server_call,
-                    std::shared_ptr<::grpc::GenericStub> upstream_stub,
-                    const std::string &method,
-                    const std::multimap<std::string, std::string> &headers);
+  //
+  // If set, on_finish is called with the final status of the call
+  // when it is sent to the downstream client, and is released right
+  // after.
+  static void Start(
+      AsyncGrpcQueue *async_grpc_queue, std::shared_ptr<ServerCall> server_call,
+      std::shared_ptr<::grpc::GenericStub> upstream_stub,
+      const std::string &method,
+      const std::multimap<std::string, std::string> &headers,
+      std::function<void(const utils::Status &)> on_finish = nullptr);
 
   ProxyFlow(AsyncGrpcQueue *async_grpc_queue,
             std::shared_ptr<ServerCall> server_call,
-            std::shared_ptr<::grpc::GenericStub> upstream_stub);
+            std::shared_ptr<::grpc::GenericStub> upstream_stub,
+            std::function<void(const utils::Status &)> on_finish);
   ~ProxyFlow() {}
 
  private:
@@ -97,6 +104,7 @@ class ProxyFlow {
   AsyncGrpcQueue *async_grpc_queue_;
   std::shared_ptr<ServerCall> server_call_;
   std::shared_ptr<::grpc::GenericStub> upstream_stub_;
+  std::function<void(const utils::Status &)> on_finish_;
   ::grpc::ClientContext upstream_context_;
   std::unique_ptr<::grpc::GenericClientAsyncReaderWriter>
       upstream_reader_writer_;
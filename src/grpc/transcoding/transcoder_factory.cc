@@ -47,7 +47,6 @@ using ::google::grpc::transcoding::RequestWeaver;
 using ::google::grpc::transcoding::ResponseToJsonTranslator;
 using ::google::grpc::transcoding::Transcoder;
 using ::google::grpc::transcoding::TranscoderInputStream;
-using ::google::grpc::transcoding::TypeHelper;
 
 // Transcoder implementation based on JsonRequestTranslator &
 // ResponseToJsonTranslator
@@ -80,28 +79,35 @@ class TranscoderImpl : public Transcoder {
   std::unique_ptr<TranscoderInputStream> response_stream_;
 };
 
-// Converts MethodCallInfo into a RequestInfo structure needed by the
-// JsonRequestTranslator.
-pbutil::Status MethodCallInfoToRequestInfo(TypeHelper* type_helper,
-                                           const MethodCallInfo& call_info,
-                                           RequestInfo* request_info) {
-  // Try to resolve the request type
-  const auto& request_type_url = call_info.method_info->request_type_url();
-  request_info->message_type =
-      type_helper->Info()->GetTypeByTypeUrl(request_type_url);
-  if (nullptr == request_info->message_type) {
-    return pbutil::Status(pberr::NOT_FOUND,
-                          "Could not resolve the type \"" + request_type_url +
-                              "\". Invalid service configuration.");
-  }
+// The maximum number of binding field paths cached per method. The field
+// paths of the bindings of a method come from its HTTP templates, but also
+// from the query parameters of the requests.
+const size_t kMaxBindingFieldPaths = 64;
 
-  // Copy the body field path
-  request_info->body_field_path = call_info.body_field_path;
+}  // namespace
 
-  // Resolve the field paths of the bindings and add to the request_info
-  for (const auto& unresolved_binding : call_info.variable_bindings) {
-    RequestWeaver::BindingInfo resolved_binding;
+TranscoderFactory::TranscoderFactory(
+    const ::google::api::Service& service,
+    const ::google::protobuf::util::JsonPrintOptions& json_print_options)
+    : type_helper_(service.types(), service.enums()),
+      json_print_options_(json_print_options) {}
 
+pbutil::Status TranscoderFactory::Create(
+    const MethodCallInfo& call_info, pbio::ZeroCopyInputStream* request_input,
+    TranscoderInputStream* response_input,
+    std::unique_ptr<Transcoder>* transcoder) {
+  MethodPlan* plan = nullptr;
+  auto status = GetMethodPlan(call_info.method_info, &plan);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Convert MethodCallInfo into RequestInfo
+  RequestInfo request_info;
+  request_info.message_type = plan->request_type;
+  request_info.body_field_path = call_info.body_field_path;
+  request_info.variable_bindings.reserve(call_info.variable_bindings.size());
+  for (const auto& unresolved_binding : call_info.variable_bindings) {
     // Verify that the value is valid UTF8 before continuing
     if (!pb::internal::IsStructurallyValidUTF8(
             unresolved_binding.value.c_str(),
@@ -110,42 +116,17 @@ pbutil::Status MethodCallInfoToRequestInfo(TypeHelper* type_helper,
                             "Encountered non UTF-8 code points.");
     }
 
-    resolved_binding.value = unresolved_binding.value;
-
-    // Try to resolve the field path
-    auto status = type_helper->ResolveFieldPath(*request_info->message_type,
-                                                unresolved_binding.field_path,
-                                                &resolved_binding.field_path);
+    RequestWeaver::BindingInfo resolved_binding;
+    status = ResolveFieldPath(plan, unresolved_binding.field_path,
+                              &resolved_binding.field_path);
     if (!status.ok()) {
       // Field path could not be resolved (usually a config error) - return
       // the error.
       return status;
     }
+    resolved_binding.value = unresolved_binding.value;
 
-    request_info->variable_bindings.emplace_back(std::move(resolved_binding));
-  }
-
-  return pbutil::Status::OK;
-}
-
-}  // namespace
-
-TranscoderFactory::TranscoderFactory(
-    const ::google::api::Service& service,
-    const ::google::protobuf::util::JsonPrintOptions& json_print_options)
-    : type_helper_(service.types(), service.enums()),
-      json_print_options_(json_print_options) {}
-
-pbutil::Status TranscoderFactory::Create(
-    const MethodCallInfo& call_info, pbio::ZeroCopyInputStream* request_input,
-    TranscoderInputStream* response_input,
-    std::unique_ptr<Transcoder>* transcoder) {
-  // Convert MethodCallInfo into RequestInfo
-  RequestInfo request_info;
-  auto status =
-      MethodCallInfoToRequestInfo(&type_helper_, call_info, &request_info);
-  if (!status.ok()) {
-    return status;
+    request_info.variable_bindings.emplace_back(std::move(resolved_binding));
   }
 
   // For now we support only HTTP/JSON <=> gRPC transcoding.
@@ -171,6 +152,53 @@ pbutil::Status TranscoderFactory::Create(
   return pbutil::Status::OK;
 }
 
+pbutil::Status TranscoderFactory::GetMethodPlan(const MethodInfo* method_info,
+                                                MethodPlan** plan) {
+  const auto& request_type_url = method_info->request_type_url();
+  std::unique_ptr<MethodPlan>& method_plan =
+      method_plans_[method_info->selector()];
+  // The request type URL is checked in case the method was changed by a
+  // service config with the same id.
+  if (method_plan && method_plan->request_type_url == request_type_url) {
+    *plan = method_plan.get();
+    return pbutil::Status::OK;
+  }
+
+  // Try to resolve the request type
+  const pb::Type* request_type =
+      type_helper_.Info()->GetTypeByTypeUrl(request_type_url);
+  if (nullptr == request_type) {
+    method_plans_.erase(method_info->selector());
+    return pbutil::Status(pberr::NOT_FOUND,
+                          "Could not resolve the type \"" + request_type_url +
+                              "\". Invalid service configuration.");
+  }
+
+  method_plan.reset(new MethodPlan());
+  method_plan->request_type_url = request_type_url;
+  method_plan->request_type = request_type;
+  *plan = method_plan.get();
+  return pbutil::Status::OK;
+}
+
+pbutil::Status TranscoderFactory::ResolveFieldPath(
+    MethodPlan* plan, const std::vector<std::string>& field_path,
+    std::vector<const pb::Field*>* resolved_field_path) {
+  auto it = plan->binding_field_paths.find(field_path);
+  if (it != plan->binding_field_paths.end()) {
+    *resolved_field_path = it->second;
+    return pbutil::Status::OK;
+  }
+
+  auto status = type_helper_.ResolveFieldPath(*plan->request_type, field_path,
+                                              resolved_field_path);
+  if (status.ok() &&
+      plan->binding_field_paths.size() < kMaxBindingFieldPaths) {
+    plan->binding_field_paths.emplace(field_path, *resolved_field_path);
+  }
+  return status;
+}
+
 }  // namespace transcoding
 }  // namespace api_manager
 }  // namespace google
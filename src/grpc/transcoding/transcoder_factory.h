@@ -15,11 +15,16 @@
 #ifndef GRPC_TRANSCODING_TRANSODER_FACTORY_H_
 #define GRPC_TRANSCODING_TRANSODER_FACTORY_H_
 
+#include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "google/api/service.pb.h"
 #include "google/protobuf/io/zero_copy_stream.h"
 #include "google/protobuf/stubs/status.h"
+#include "google/protobuf/type.pb.h"
 #include "google/protobuf/util/json_util.h"
 #include "grpc_transcoding/transcoder.h"
 #include "grpc_transcoding/transcoder_input_stream.h"
@@ -58,6 +63,10 @@ namespace transcoding {
 //                           response_upstream,
 //                           &transcoder);
 //
+// The per method work, resolving the request type and the field paths of the
+// variable bindings, is done on the first request of the method and cached.
+//
+// Not thread safe: Create caches the method plans.
 class TranscoderFactory {
  public:
   // service - The service config for which the factory is created
@@ -80,8 +89,33 @@ class TranscoderFactory {
       std::unique_ptr<::google::grpc::transcoding::Transcoder>* transcoder);
 
  private:
+  // The resolved information of a method, shared by all its transcoders.
+  struct MethodPlan {
+    // The request type URL the plan was built from.
+    std::string request_type_url;
+    // The resolved request type.
+    const ::google::protobuf::Type* request_type;
+    // The resolved field paths of the variable bindings, by field path.
+    std::map<std::vector<std::string>,
+             std::vector<const ::google::protobuf::Field*>>
+        binding_field_paths;
+  };
+
+  // Returns the plan of the method, builds it on the first call.
+  ::google::protobuf::util::Status GetMethodPlan(const MethodInfo* method_info,
+                                                 MethodPlan** plan);
+
+  // Resolves the field path of a binding, using the cache of the plan.
+  ::google::protobuf::util::Status ResolveFieldPath(
+      MethodPlan* plan, const std::vector<std::string>& field_path,
+      std::vector<const ::google::protobuf::Field*>* resolved_field_path);
+
   ::google::grpc::transcoding::TypeHelper type_helper_;
   ::google::protobuf::util::JsonPrintOptions json_print_options_;
+  // The method plans, by method selector. The method infos are owned by the
+  // service configs, which may be freed and replaced while the factory is in
+  // use.
+  std::unordered_map<std::string, std::unique_ptr<MethodPlan>> method_plans_;
 };
 
 }  // namespace transcoding
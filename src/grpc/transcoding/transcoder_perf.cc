@@ -0,0 +1,263 @@
+// Copyright (C) Extensible Service Proxy Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Benchmarks of HTTP/JSON <=> gRPC transcoding with the JSON payloads of the
+// load tests:
+// 1. TranscoderFactory::Create alone.
+// 2. Request translation: JSON payload to a google.protobuf.Value message.
+// 3. Response translation: the Value message back to JSON.
+//
+// The allocations are counted by replacing the global operator new.
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include "google/api/service.pb.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/struct.pb.h"
+#include "google/protobuf/util/json_util.h"
+#include "google/protobuf/util/type_resolver.h"
+#include "google/protobuf/util/type_resolver_util.h"
+#include "grpc_transcoding/message_reader.h"
+#include "grpc_transcoding/transcoder.h"
+#include "include/api_manager/method_call_info.h"
+#include "src/api_manager/method_impl.h"
+#include "src/grpc/transcoding/transcoder_factory.h"
+#include "test/test_common.h"
+
+namespace pb = ::google::protobuf;
+namespace pbio = ::google::protobuf::io;
+namespace pbutil = ::google::protobuf::util;
+
+using ::google::api::Service;
+using ::google::api_manager::MethodCallInfo;
+using ::google::api_manager::MethodInfoImpl;
+using ::google::api_manager::transcoding::TranscoderFactory;
+using ::google::grpc::transcoding::MessageReader;
+using ::google::grpc::transcoding::Transcoder;
+using ::google::grpc::transcoding::testing::TestZeroCopyInputStream;
+
+namespace {
+
+// The number of allocations, updated by the replaced operator new. The
+// benchmark is single threaded.
+size_t heap_allocations = 0;
+
+void *Allocate(size_t size) {
+  void *p = malloc(size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  ++heap_allocations;
+  return p;
+}
+
+}  // namespace
+
+void *operator new(size_t size) { return Allocate(size); }
+void *operator new[](size_t size) { return Allocate(size); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+
+namespace {
+
+const int kDefaultIterations = 10000;
+const char *const kDefaultPayloads[] = {
+    "test/data/8k.json", "test/data/35k.json",
+};
+const char kTypeUrlPrefix[] = "type.googleapis.com";
+const char kValueTypeUrl[] = "type.googleapis.com/google.protobuf.Value";
+
+class Timer {
+ public:
+  Timer()
+      : start_(std::chrono::steady_clock::now()),
+        start_allocations_(heap_allocations) {}
+
+  double seconds() const {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start_;
+    return elapsed.count();
+  }
+
+  size_t allocations() const { return heap_allocations - start_allocations_; }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+  size_t start_allocations_;
+};
+
+void print_rate(const char *name, const char *payload, size_t payload_size,
+                int operations, const Timer &timer) {
+  double seconds = timer.seconds();
+  printf("%-10s %-20s %10.0f ops/s  %8.1f MB/s  %8.1f allocations/op\n", name,
+         payload, operations / seconds,
+         payload_size * operations / seconds / (1 << 20),
+         static_cast<double>(timer.allocations()) / operations);
+}
+
+// Returns a service with the types of google.protobuf.Value, which any JSON
+// payload can be transcoded to.
+Service CreateService() {
+  // Links in the generated descriptors of the struct types.
+  pb::Value::descriptor();
+  std::unique_ptr<pbutil::TypeResolver> resolver(
+      pbutil::NewTypeResolverForDescriptorPool(
+          kTypeUrlPrefix, pb::DescriptorPool::generated_pool()));
+  Service service;
+  for (const char *type : {"google.protobuf.Value", "google.protobuf.Struct",
+                           "google.protobuf.ListValue"}) {
+    resolver->ResolveMessageType(std::string(kTypeUrlPrefix) + "/" + type,
+                                 service.add_types());
+  }
+  resolver->ResolveEnumType(
+      std::string(kTypeUrlPrefix) + "/google.protobuf.NullValue",
+      service.add_enums());
+  return service;
+}
+
+// Returns the message with the gRPC frame header.
+std::string GrpcFrame(const std::string &message) {
+  std::string frame(5, '\0');
+  for (int i = 0; i < 4; ++i) {
+    frame[4 - i] = static_cast<char>((message.size() >> (8 * i)) & 0xff);
+  }
+  return frame + message;
+}
+
+// Drains the stream, returns the number of bytes read.
+size_t ReadAll(pbio::ZeroCopyInputStream *stream) {
+  size_t total = 0;
+  const void *data = nullptr;
+  int size = 0;
+  while (stream->Next(&data, &size) && size != 0) {
+    total += size;
+  }
+  return total;
+}
+
+void Fail(const char *payload, const char *message) {
+  fprintf(stderr, "%s: %s.\n", payload, message);
+  exit(1);
+}
+
+void BenchmarkPayload(TranscoderFactory *factory, const MethodCallInfo &info,
+                      const char *payload, const std::string &json,
+                      int iterations) {
+  pb::Value value;
+  if (!pbutil::JsonStringToMessage(json, &value).ok()) {
+    Fail(payload, "invalid JSON payload");
+  }
+  std::string response = GrpcFrame(value.SerializeAsString());
+
+  {
+    Timer timer;
+    for (int i = 0; i < iterations; ++i) {
+      TestZeroCopyInputStream request_in, response_in;
+      std::unique_ptr<Transcoder> transcoder;
+      if (!factory->Create(info, &request_in, &response_in, &transcoder)
+               .ok()) {
+        Fail(payload, "TranscoderFactory::Create failed");
+      }
+    }
+    print_rate("Create", payload, 0, iterations, timer);
+  }
+
+  {
+    Timer timer;
+    for (int i = 0; i < iterations; ++i) {
+      TestZeroCopyInputStream request_in, response_in;
+      std::unique_ptr<Transcoder> transcoder;
+      factory->Create(info, &request_in, &response_in, &transcoder);
+      request_in.AddChunk(json);
+      request_in.Finish();
+      MessageReader reader(transcoder->RequestOutput());
+      if (reader.NextMessage() == nullptr) {
+        Fail(payload, "request translation failed");
+      }
+    }
+    print_rate("Request", payload, json.size(), iterations, timer);
+  }
+
+  {
+    Timer timer;
+    for (int i = 0; i < iterations; ++i) {
+      TestZeroCopyInputStream request_in, response_in;
+      std::unique_ptr<Transcoder> transcoder;
+      factory->Create(info, &request_in, &response_in, &transcoder);
+      response_in.AddChunk(response);
+      response_in.Finish();
+      if (ReadAll(transcoder->ResponseOutput()) == 0) {
+        Fail(payload, "response translation failed");
+      }
+    }
+    print_rate("Response", payload, json.size(), iterations, timer);
+  }
+}
+
+bool ReadFile(const char *path, std::string *content) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  *content = buffer.str();
+  return true;
+}
+
+void print_usage() {
+  fprintf(stderr,
+          "Usage: transcoder_perf [iterations] [json_file...].\n"
+          "  iterations: (default %d) the number of transcoded requests per\n"
+          "    payload.\n"
+          "  json_file: (default %s %s) the JSON payloads.\n",
+          kDefaultIterations, kDefaultPayloads[0], kDefaultPayloads[1]);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : kDefaultIterations;
+  if (iterations <= 0) {
+    print_usage();
+    return 1;
+  }
+
+  TranscoderFactory factory(CreateService());
+  MethodInfoImpl method("Transcode", "transcoder_perf", "v1");
+  method.set_request_type_url(kValueTypeUrl);
+  method.set_response_type_url(kValueTypeUrl);
+  MethodCallInfo info;
+  info.method_info = &method;
+
+  int num_payloads = argc > 2 ? argc - 2 : 2;
+  for (int i = 0; i < num_payloads; ++i) {
+    const char *payload = argc > 2 ? argv[i + 2] : kDefaultPayloads[i];
+    std::string json;
+    if (!ReadFile(payload, &json)) {
+      print_usage();
+      return 1;
+    }
+    BenchmarkPayload(&factory, info, payload, json, iterations);
+  }
+  return 0;
+}
@@ -59,19 +59,20 @@ class TestMethodInfo : public MethodInfo {
   TestMethodInfo() {}
   TestMethodInfo(const std::string &request_type_url,
                  const std::string &response_type_url, bool request_streaming,
-                 bool response_streaming, const std::string &body_field_path)
+                 bool response_streaming, const std::string &body_field_path,
+                 const std::string &selector)
       : request_type_url_(request_type_url),
         response_type_url_(response_type_url),
         request_streaming_(request_streaming),
         response_streaming_(response_streaming),
-        body_field_path_(body_field_path) {}
+        body_field_path_(body_field_path),
+        selector_(selector) {}
 
   // MethodInfo implementation
   // Methods that the Transcoder doesn't use
   const std::string &name() const { return empty_; }
   const std::string &api_name() const { return empty_; }
   const std::string &api_version() const { return empty_; }
-  const std::string &selector() const { return empty_; }
   bool auth() const { return false; }
   bool allow_unregistered_calls() const { return false; }
   bool skip_service_control() const { return false; }
@@ -106,6 +107,7 @@ class TestMethodInfo : public MethodInfo {
   }
 
   // Methods that the Transcoder does use
+  const std::string &selector() const { return selector_; }
   const std::string &request_type_url() const { return request_type_url_; }
   bool request_streaming() const { return request_streaming_; }
   const std::string &response_type_url() const { return response_type_url_; }
@@ -128,6 +130,7 @@ class TestMethodInfo : public MethodInfo {
   bool request_streaming_;
   bool response_streaming_;
   std::string body_field_path_;
+  std::string selector_;
   std::string empty_;
   std::vector<std::pair<std::string, int>> metric_cost_vector_;
 };
@@ -151,10 +154,11 @@ class TranscoderTest : public ::testing::Test {
                      const std::string &response_type_url,
                      bool request_streaming = false,
                      bool response_streaming = false,
-                     const std::string &body_field_path = "") {
+                     const std::string &body_field_path = "",
+                     const std::string &selector = "") {
     method_info_.reset(new TestMethodInfo(request_type_url, response_type_url,
                                           request_streaming, response_streaming,
-                                          body_field_path));
+                                          body_field_path, selector));
   }
 
   void AddVariableBinding(const std::string &field_path,
@@ -177,6 +181,30 @@ class TranscoderTest : public ::testing::Test {
                                        transcoder);
   }
 
+  // Transcodes the JSON request with the current method info and variable
+  // bindings, and checks the request message.
+  template <class MessageType>
+  void ExpectRequest(const std::string &json,
+                     const std::string &expected_text) {
+    std::unique_ptr<Transcoder> t;
+    TestZeroCopyInputStream request_in, response_in;
+    auto status = Build(&request_in, &response_in, &t);
+    ASSERT_TRUE(status.ok()) << "Error building Transcoder - "
+                             << status.error_message() << std::endl;
+    request_in.AddChunk(json);
+    request_in.Finish();
+
+    MessageReader reader(t->RequestOutput());
+    auto actual_proto = reader.NextMessage();
+    ASSERT_NE(nullptr, actual_proto.get());
+
+    MessageType actual;
+    ASSERT_TRUE(actual.ParseFromZeroCopyStream(actual_proto.get()));
+    MessageType expected;
+    ASSERT_TRUE(pb::TextFormat::ParseFromString(expected_text, &expected));
+    EXPECT_TRUE(pbutil::MessageDifferencer::Equivalent(expected, actual));
+  }
+
  private:
   ::google::api::Service service_;
   std::unique_ptr<TranscoderFactory> transcoder_factory_;
@@ -533,6 +561,103 @@ TEST_F(TranscoderTest, InvalidUTF8InVariableBinding) {
             Build(&request_in, &response_in, &t).error_code());
 }
 
+TEST_F(TranscoderTest, RequestBindingsWithCachedMethodPlan) {
+  ASSERT_TRUE(LoadService("bookstore_service.pb.txt"));
+  SetMethodInfo(/*request_type_url*/ "type.googleapis.com/CreateBookRequest",
+                /*response_type_url*/ "type.googleapis.com/Book",
+                /*request_streaming*/ false,
+                /*response_streaming*/ false,
+                /*body_field_path*/ "book");
+
+  // The requests of the method share the resolved field paths, but not the
+  // values of the bindings.
+  for (const std::string &shelf : {"1", "2"}) {
+    AddVariableBinding("shelf", shelf);
+    AddVariableBinding("book.author", "Author " + shelf);
+
+    std::unique_ptr<Transcoder> t;
+    TestZeroCopyInputStream request_in, response_in;
+    auto status = Build(&request_in, &response_in, &t);
+    ASSERT_TRUE(status.ok()) << "Error building Transcoder - "
+                             << status.error_message() << std::endl;
+    request_in.AddChunk(R"({"title" : "War and Peace"})");
+
+    MessageReader reader(t->RequestOutput());
+    auto actual_proto = reader.NextMessage();
+    ASSERT_NE(nullptr, actual_proto.get());
+
+    CreateBookRequest actual;
+    ASSERT_TRUE(actual.ParseFromZeroCopyStream(actual_proto.get()));
+    CreateBookRequest expected;
+    ASSERT_TRUE(pb::TextFormat::ParseFromString(
+        "shelf : " + shelf + " book { title : \"War and Peace\" " +
+            "author : \"Author " + shelf + "\" }",
+        &expected));
+    EXPECT_TRUE(pbutil::MessageDifferencer::Equivalent(expected, actual));
+
+    // An invalid binding is still rejected after the method plan is cached.
+    AddVariableBinding("invalid.binding", "value");
+    EXPECT_EQ(pberr::INVALID_ARGUMENT,
+              Build(&request_in, &response_in, &t).error_code());
+  }
+}
+
+TEST_F(TranscoderTest, MethodPlansBySelector) {
+  ASSERT_TRUE(LoadService("bookstore_service.pb.txt"));
+
+  // The method infos are recreated for each request, as when the service
+  // config is replaced. The plans are kept by selector, so the methods do
+  // not share a plan even if a new method info reuses the memory of another
+  // method's.
+  for (const std::string &shelf : {"1", "2"}) {
+    SetMethodInfo(/*request_type_url*/ "type.googleapis.com/CreateBookRequest",
+                  /*response_type_url*/ "type.googleapis.com/Book",
+                  /*request_streaming*/ false,
+                  /*response_streaming*/ false,
+                  /*body_field_path*/ "book",
+                  /*selector*/ "Bookstore.CreateBook");
+    AddVariableBinding("shelf", shelf);
+    ExpectRequest<CreateBookRequest>(
+        R"({"title" : "War and Peace"})",
+        "shelf : " + shelf + " book { title : \"War and Peace\" }");
+
+    SetMethodInfo(/*request_type_url*/ "type.googleapis.com/Shelf",
+                  /*response_type_url*/ "type.googleapis.com/Shelf",
+                  /*request_streaming*/ false,
+                  /*response_streaming*/ false,
+                  /*body_field_path*/ "",
+                  /*selector*/ "Bookstore.UpdateShelf");
+    AddVariableBinding("theme", "Fiction");
+    ExpectRequest<Shelf>(R"({"name" : ")" + shelf + R"("})",
+                         "name : \"" + shelf + "\" theme : \"Fiction\"");
+  }
+
+  // A new service config changes the request type of a method: its plan is
+  // rebuilt.
+  SetMethodInfo(/*request_type_url*/ "type.googleapis.com/Shelf",
+                /*response_type_url*/ "type.googleapis.com/Shelf",
+                /*request_streaming*/ false,
+                /*response_streaming*/ false,
+                /*body_field_path*/ "",
+                /*selector*/ "Bookstore.CreateBook");
+  AddVariableBinding("theme", "Fantasy");
+  ExpectRequest<Shelf>(R"({"name" : "3"})",
+                       R"(name : "3" theme : "Fantasy")");
+
+  // The binding of the previous request type does not resolve any more.
+  SetMethodInfo(/*request_type_url*/ "type.googleapis.com/Shelf",
+                /*response_type_url*/ "type.googleapis.com/Shelf",
+                /*request_streaming*/ false,
+                /*response_streaming*/ false,
+                /*body_field_path*/ "",
+                /*selector*/ "Bookstore.CreateBook");
+  AddVariableBinding("shelf", "3");
+  std::unique_ptr<Transcoder> t;
+  TestZeroCopyInputStream request_in, response_in;
+  EXPECT_EQ(pberr::INVALID_ARGUMENT,
+            Build(&request_in, &response_in, &t).error_code());
+}
+
 }  // namespace
 }  // namespace testing
 }  // namespace transcoding
@@ -26,7 +26,9 @@
 //
 #include "src/nginx/environment.h"
 
+#include "src/nginx/grpc_client.h"
 #include "src/nginx/http.h"
+#include "src/nginx/module.h"
 #include "src/nginx/util.h"
 
 #include <stdexcept>
@@ -35,29 +37,51 @@ namespace google {
 namespace api_manager {
 namespace nginx {
 
-void NgxEspEnv::Log(LogLevel level, const char *message) {
-  ngx_uint_t ngx_level;
+namespace {
+
+// Maximum number of service config builds queued for the config pool.
+const size_t kMaxQueuedConfigBuilds = 4;
+
+ngx_uint_t NgxLogLevel(ApiManagerEnvInterface::LogLevel level) {
   switch (level) {
-    case DEBUG:
-      ngx_level = NGX_LOG_DEBUG;
-      break;
-    case INFO:
-      ngx_level = NGX_LOG_INFO;
-      break;
-    case WARNING:
-      ngx_level = NGX_LOG_WARN;
-      break;
-    case ERROR:
+    case ApiManagerEnvInterface::DEBUG:
+      return NGX_LOG_DEBUG;
+    case ApiManagerEnvInterface::INFO:
+      return NGX_LOG_INFO;
+    case ApiManagerEnvInterface::WARNING:
+      return NGX_LOG_WARN;
+    case ApiManagerEnvInterface::ERROR:
     default:
-      ngx_level = NGX_LOG_ERR;
-      break;
+      return NGX_LOG_ERR;
   }
+}
 
+// Returns the ESP main configuration of the current cycle, nullptr if there
+// is none.
+ngx_esp_main_conf_t *GetMainConf() {
+  auto http_cctx = reinterpret_cast<ngx_http_conf_ctx_t *>(
+      ngx_get_conf(ngx_cycle->conf_ctx, ngx_http_module));
+  if (http_cctx == nullptr) {
+    return nullptr;
+  }
+  return reinterpret_cast<ngx_esp_main_conf_t *>(
+      http_cctx->main_conf[ngx_esp_module.ctx_index]);
+}
+
+}  // namespace
+
+void NgxEspEnv::Log(LogLevel level, const char *message) {
+  ngx_uint_t ngx_level = NgxLogLevel(level);
   ngx_str_t msg = {strlen(message),
                    reinterpret_cast<u_char *>(const_cast<char *>(message))};
   ngx_esp_log(log_, ngx_level, msg);
 }
 
+bool NgxEspEnv::IsLogEnabled(LogLevel level) {
+  // Mirrors the level check of ngx_esp_log.
+  return log_ && log_->log_level >= NgxLogLevel(level);
+}
+
 NgxEspTimer::NgxEspTimer(std::chrono::milliseconds interval,
                          std::function<void()> callback, ngx_log_t *log)
     : stopped_(false), interval_(interval), callback_(callback), log_(log) {
@@ -108,7 +132,42 @@ void NgxEspEnv::RunHTTPRequest(std::unique_ptr<HTTPRequest> request) {
   ngx_esp_send_http_request(std::move(request));
 }
 
-void NgxEspEnv::RunGRPCRequest(std::unique_ptr<GRPCRequest> request) {}
+void NgxEspEnv::RunGRPCRequest(std::unique_ptr<GRPCRequest> request) {
+  ngx_esp_send_grpc_request(std::move(request));
+}
+
+bool NgxEspEnv::RunInThreadPool(std::function<void()> work,
+                                std::function<void()> continuation) {
+  ngx_esp_main_conf_t *mc = GetMainConf();
+  if (mc == nullptr || !mc->crypto_pool) {
+    return false;
+  }
+  return mc->crypto_pool->Run(std::move(work), std::move(continuation));
+}
+
+bool NgxEspEnv::RunInBackground(std::function<void()> work,
+                                std::function<void()> continuation) {
+  ngx_esp_main_conf_t *mc = GetMainConf();
+  if (mc == nullptr) {
+    return false;
+  }
+  // The pool is only needed by the managed rollouts, so it is started by the
+  // first one.
+  if (!mc->config_pool) {
+    if (!mc->grpc_queue) {
+      mc->grpc_queue = NgxEspGrpcQueue::Instance(mc->grpc_queue_threads);
+      mc->grpc_queue->Init((ngx_cycle_t *)ngx_cycle);
+    }
+    mc->config_pool.reset(
+        new NgxEspWorkerPool(1, kMaxQueuedConfigBuilds, mc->grpc_queue));
+  }
+  return mc->config_pool->Run(std::move(work), std::move(continuation));
+}
+
+SharedCache *NgxEspEnv::GetSharedCache() {
+  ngx_esp_main_conf_t *mc = GetMainConf();
+  return mc ? mc->shared_cache.get() : nullptr;
+}
 
 }  // namespace nginx
 }  // namespace api_manager
@@ -48,6 +48,8 @@ class NgxEspEnv : public ApiManagerEnvInterface {
 
   virtual void Log(LogLevel level, const char *message);
 
+  virtual bool IsLogEnabled(LogLevel level);
+
   virtual std::unique_ptr<PeriodicTimer> StartPeriodicTimer(
       std::chrono::milliseconds interval, std::function<void()> continuation);
 
@@ -55,6 +57,14 @@ class NgxEspEnv : public ApiManagerEnvInterface {
 
   virtual void RunGRPCRequest(std::unique_ptr<GRPCRequest> request);
 
+  virtual bool RunInThreadPool(std::function<void()> work,
+                               std::function<void()> continuation);
+
+  virtual bool RunInBackground(std::function<void()> work,
+                               std::function<void()> continuation);
+
+  virtual SharedCache *GetSharedCache();
+
  private:
   ngx_log_t *log_;
 };
@@ -76,9 +76,12 @@ std::pair<Status, std::string> GrpcGetBackendAddress(
       Status(NGX_DECLINED, "No GRPC backend address specified"), std::string());
 }
 
+// Returns the stub of the channel a new call to the backend goes to, and sets
+// *on_finish to the function accounting for the call on the channel.
 std::pair<Status, std::shared_ptr<::grpc::GenericStub>> GrpcGetStub(
-    ngx_http_request_t *r, ngx_esp_loc_conf_t *espcf,
-    ngx_esp_request_ctx_t *ctx) {
+    ngx_http_request_t *r, ngx_esp_main_conf_t *espmf,
+    ngx_esp_loc_conf_t *espcf, ngx_esp_request_ctx_t *ctx,
+    std::function<void(const Status &)> *on_finish) {
   Status status = Status::OK;
   std::string address;
   std::tie(status, address) =
@@ -89,22 +92,16 @@ std::pair<Status, std::shared_ptr<::grpc::GenericStub>> GrpcGetStub(
   ngx_log_error(NGX_LOG_DEBUG, r->connection->log, 0,
                 "GrpcGetStub: connecting to backend=%s", address.c_str());
 
-  auto it = espcf->grpc_stubs.find(address);
-  if (it != espcf->grpc_stubs.end()) {
-    return std::make_pair(Status::OK, it->second);
+  auto it = espmf->grpc_channel_pools.find(address);
+  if (it == espmf->grpc_channel_pools.end()) {
+    it = espmf->grpc_channel_pools
+             .emplace(address, std::make_shared<NgxEspGrpcChannelPool>(
+                                   address, espmf->grpc_backend_channels))
+             .first;
   }
 
-  ::grpc::ChannelArguments channel_arguments;
-
-  channel_arguments.SetMaxReceiveMessageSize(INT_MAX);
-  channel_arguments.SetMaxSendMessageSize(INT_MAX);
-
-  auto result =
-      std::make_shared<::grpc::GenericStub>(::grpc::CreateCustomChannel(
-          address, ::grpc::InsecureChannelCredentials(), channel_arguments));
-
+  auto result = it->second->StartCall(on_finish);
   if (result) {
-    espcf->grpc_stubs.emplace(address, result);
     return std::make_pair(Status::OK, result);
   }
 
@@ -167,7 +164,8 @@ ngx_int_t GrpcBackendHandler(ngx_http_request_t *r) {
 
     ctx->grpc_backend = true;
     std::shared_ptr<::grpc::GenericStub> stub;
-    std::tie(status, stub) = GrpcGetStub(r, espcf, ctx);
+    std::function<void(const Status &)> on_finish;
+    std::tie(status, stub) = GrpcGetStub(r, espmf, espcf, ctx, &on_finish);
 
     if (status.ok()) {
       // We have a stub for this backend; proxy the call via libgrpc.
@@ -184,14 +182,16 @@ ngx_int_t GrpcBackendHandler(ngx_http_request_t *r) {
                        method.c_str());
 
         grpc::ProxyFlow::Start(espmf->grpc_queue.get(), std::move(server_call),
-                               std::move(stub), method, headers);
+                               std::move(stub), method, headers,
+                               std::move(on_finish));
         return NGX_DONE;
       }
     }
   } else if (ctx && ctx->request_handler && IsGrpcWeb(r)) {
     ctx->grpc_backend = true;
     std::shared_ptr<::grpc::GenericStub> stub;
-    std::tie(status, stub) = GrpcGetStub(r, espcf, ctx);
+    std::function<void(const Status &)> on_finish;
+    std::tie(status, stub) = GrpcGetStub(r, espmf, espcf, ctx, &on_finish);
 
     if (status.ok()) {
       // We have a stub for this backend; proxy the call via libgrpc.
@@ -208,7 +208,8 @@ ngx_int_t GrpcBackendHandler(ngx_http_request_t *r) {
                        method.c_str());
 
         grpc::ProxyFlow::Start(espmf->grpc_queue.get(), std::move(server_call),
-                               std::move(stub), method, headers);
+                               std::move(stub), method, headers,
+                               std::move(on_finish));
         return NGX_DONE;
       }
     }
@@ -217,7 +218,8 @@ ngx_int_t GrpcBackendHandler(ngx_http_request_t *r) {
     // this request to use.
     ctx->grpc_backend = true;
     std::shared_ptr<::grpc::GenericStub> stub;
-    std::tie(status, stub) = GrpcGetStub(r, espcf, ctx);
+    std::function<void(const Status &)> on_finish;
+    std::tie(status, stub) = GrpcGetStub(r, espmf, espcf, ctx, &on_finish);
 
     if (status.ok()) {
       std::shared_ptr<NgxEspTranscodedGrpcServerCall> server_call;
@@ -232,7 +234,8 @@ ngx_int_t GrpcBackendHandler(ngx_http_request_t *r) {
         const std::multimap<std::string, std::string> &headers =
             ExtractMetadata(r);
         grpc::ProxyFlow::Start(espmf->grpc_queue.get(), std::move(server_call),
-                               std::move(stub), method, headers);
+                               std::move(stub), method, headers,
+                               std::move(on_finish));
         return NGX_DONE;
       }
     }
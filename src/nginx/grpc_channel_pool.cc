@@ -0,0 +1,172 @@
+// Copyright (C) Extensible Service Proxy Authors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/nginx/grpc_channel_pool.h"
+
+#include <limits.h>
+#include <stdio.h>
+
+using ::google::api_manager::utils::Status;
+
+namespace google {
+namespace api_manager {
+namespace nginx {
+
+namespace {
+
+// Number of consecutive UNAVAILABLE errors after which a channel is evicted.
+const uint64_t kMaxConsecutiveErrors = 3;
+
+// A channel is not reconnected more often than this, so that an unreachable
+// backend is not hammered with connection attempts.
+const std::chrono::seconds kMinReconnectInterval(1);
+
+// Channel arguments making the channels of a pool distinct, since gRPC may
+// otherwise share the connection of channels with identical arguments.
+const char kChannelIndexArg[] = "esp.channel_index";
+const char kChannelGenerationArg[] = "esp.channel_generation";
+
+}  // namespace
+
+NgxEspGrpcChannelPool::CallGuard::CallGuard(
+    std::shared_ptr<NgxEspGrpcChannelPool> pool, size_t index,
+    uint64_t generation)
+    : pool(std::move(pool)), index(index), generation(generation) {
+  ++this->pool->channels_[index].in_flight;
+}
+
+NgxEspGrpcChannelPool::CallGuard::~CallGuard() {
+  Channel &channel = pool->channels_[index];
+  // The calls of a replaced channel do not load the new one.
+  if (generation == channel.reconnects) {
+    --channel.in_flight;
+  }
+}
+
+NgxEspGrpcChannelPool::NgxEspGrpcChannelPool(const std::string &address,
+                                             size_t size, Clock clock)
+    : address_(address),
+      clock_(std::move(clock)),
+      channels_(size > 0 ? size : 1),
+      next_(0) {
+  for (size_t i = 0; i < channels_.size(); ++i) {
+    Connect(i);
+  }
+}
+
+std::shared_ptr<::grpc::GenericStub> NgxEspGrpcChannelPool::StartCall(
+    std::function<void(const Status &)> *on_finish) {
+  auto now = clock_();
+  // Broken channels are only picked if all the channels are broken.
+  size_t best = channels_.size();
+  bool best_broken = true;
+  for (size_t n = 0; n < channels_.size(); ++n) {
+    size_t i = (next_ + n) % channels_.size();
+    bool broken = IsBroken(i);
+    if (broken && now - channels_[i].connected_at >= kMinReconnectInterval) {
+      ++channels_[i].reconnects;
+      Connect(i);
+      broken = false;
+    }
+    if (best == channels_.size() || (best_broken && !broken) ||
+        (best_broken == broken &&
+         channels_[i].in_flight < channels_[best].in_flight)) {
+      best = i;
+      best_broken = broken;
+    }
+  }
+  next_ = (best + 1) % channels_.size();
+
+  Channel &channel = channels_[best];
+  ++channel.calls;
+  auto guard = std::make_shared<CallGuard>(shared_from_this(), best,
+                                           channel.reconnects);
+  *on_finish = [guard](const Status &status) {
+    guard->pool->OnCallFinished(guard->index, guard->generation, status);
+  };
+  return channel.stub;
+}
+
+size_t NgxEspGrpcChannelPool::GetStatistics(ngx_esp_grpc_channel_stats_t *stats,
+                                            size_t max) const {
+  size_t count = 0;
+  for (; count < channels_.size() && count < max; ++count) {
+    const Channel &channel = channels_[count];
+    ngx_esp_grpc_channel_stats_t &stat = stats[count];
+    snprintf(stat.backend, sizeof(stat.backend), "%s", address_.c_str());
+    stat.channel = count;
+    stat.in_flight = channel.in_flight;
+    stat.calls = channel.calls;
+    stat.errors = channel.errors;
+    stat.reconnects = channel.reconnects;
+  }
+  return count;
+}
+
+void NgxEspGrpcChannelPool::Connect(size_t index) {
+  Channel &channel = channels_[index];
+
+  ::grpc::ChannelArguments channel_arguments;
+  channel_arguments.SetMaxReceiveMessageSize(INT_MAX);
+  channel_arguments.SetMaxSendMessageSize(INT_MAX);
+  channel_arguments.SetInt(kChannelIndexArg, index);
+  channel_arguments.SetInt(kChannelGenerationArg, channel.reconnects);
+
+  channel.channel = ::grpc::CreateCustomChannel(
+      address_, ::grpc::InsecureChannelCredentials(), channel_arguments);
+  channel.stub = std::make_shared<::grpc::GenericStub>(channel.channel);
+  channel.connected_at = clock_();
+  channel.consecutive_errors = 0;
+  channel.in_flight = 0;
+}
+
+bool NgxEspGrpcChannelPool::IsBroken(size_t index) const {
+  const Channel &channel = channels_[index];
+  if (channel.consecutive_errors >= kMaxConsecutiveErrors) {
+    return true;
+  }
+  grpc_connectivity_state state = channel.channel->GetState(false);
+  return state == GRPC_CHANNEL_TRANSIENT_FAILURE ||
+         state == GRPC_CHANNEL_SHUTDOWN;
+}
+
+void NgxEspGrpcChannelPool::OnCallFinished(size_t index, uint64_t generation,
+                                           const Status &status) {
+  Channel &channel = channels_[index];
+  bool unavailable = status.CanonicalCode() == Code::UNAVAILABLE;
+  if (unavailable) {
+    ++channel.errors;
+  }
+  // Calls started before a reconnect say nothing about the new channel.
+  if (generation != channel.reconnects) {
+    return;
+  }
+  channel.consecutive_errors = unavailable ? channel.consecutive_errors + 1 : 0;
+}
+
+}  // namespace nginx
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) Extensible Service Proxy Authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NGINX_NGX_ESP_GRPC_CHANNEL_POOL_H_
+#define NGINX_NGX_ESP_GRPC_CHANNEL_POOL_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <grpc++/generic/generic_stub.h>
+#include <grpc++/grpc++.h>
+
+#include "include/api_manager/utils/status.h"
+
+namespace google {
+namespace api_manager {
+namespace nginx {
+
+// Maximum size of the backend address kept in the channel statistics.
+const int kMaxGrpcBackendAddressSize = 128;
+
+// Maximum number of channels reported in the process statistics.
+const int kMaxGrpcChannelStats = 64;
+
+// Statistics of a channel of a gRPC backend channel pool.
+// Important note: please don't use std::string. These fields are directly
+// copied into a shared memory.
+struct ngx_esp_grpc_channel_stats_t {
+  // The backend address, truncated if too long.
+  char backend[kMaxGrpcBackendAddressSize];
+  // Index of the channel in the pool of the backend.
+  uint64_t channel;
+  // Calls started on the current channel and not finished yet.
+  uint64_t in_flight;
+  uint64_t calls;
+  // Calls failed with UNAVAILABLE, i.e. the backend was not reachable.
+  uint64_t errors;
+  // Number of times the channel was evicted and connected again.
+  uint64_t reconnects;
+};
+
+// A pool of channels to a gRPC backend. New calls go to the channel with
+// the fewest calls in flight, so that the load of a worker is spread over
+// several HTTP/2 connections instead of being limited by the concurrent
+// stream limit of one. A channel in transient failure, or whose calls keep
+// failing with UNAVAILABLE, is evicted and replaced by a new channel; calls
+// in flight on the evicted channel keep it alive until they finish.
+//
+// Not thread safe, it's only used from the nginx thread.
+class NgxEspGrpcChannelPool
+    : public std::enable_shared_from_this<NgxEspGrpcChannelPool> {
+ public:
+  // Returns the current time. Only replaced by the tests.
+  typedef std::function<std::chrono::steady_clock::time_point()> Clock;
+
+  NgxEspGrpcChannelPool(const std::string &address, size_t size,
+                        Clock clock = std::chrono::steady_clock::now);
+
+  // Picks a channel for a new call and returns its stub. The call is in
+  // flight until *on_finish is destroyed; it should be called with the final
+  // status of the call.
+  std::shared_ptr<::grpc::GenericStub> StartCall(
+      std::function<void(const utils::Status &)> *on_finish);
+
+  // Writes the statistics of at most max channels, returns the number of
+  // channels written.
+  size_t GetStatistics(ngx_esp_grpc_channel_stats_t *stats, size_t max) const;
+
+ private:
+  struct Channel {
+    std::shared_ptr<::grpc::Channel> channel;
+    std::shared_ptr<::grpc::GenericStub> stub;
+    std::chrono::steady_clock::time_point connected_at;
+    // UNAVAILABLE errors since the last call which reached the backend.
+    uint64_t consecutive_errors;
+    // Calls in flight on the current channel.
+    uint64_t in_flight;
+    // The counters survive reconnects.
+    uint64_t calls;
+    uint64_t errors;
+    uint64_t reconnects;
+  };
+
+  // Holds a call in flight on the given generation of the channel at the
+  // index, i.e. the number of reconnects when the call was started.
+  struct CallGuard {
+    CallGuard(std::shared_ptr<NgxEspGrpcChannelPool> pool, size_t index,
+              uint64_t generation);
+    ~CallGuard();
+
+    std::shared_ptr<NgxEspGrpcChannelPool> pool;
+    size_t index;
+    uint64_t generation;
+  };
+
+  // Creates the channel at the index, replacing the current one. The calls
+  // in flight on the replaced channel are no longer counted.
+  void Connect(size_t index);
+
+  // Returns true if the channel at the index should be evicted.
+  bool IsBroken(size_t index) const;
+
+  // Accounts for a call finished on the given generation of the channel at
+  // the index, i.e. the number of reconnects when the call was started.
+  void OnCallFinished(size_t index, uint64_t generation,
+                      const utils::Status &status);
+
+  std::string address_;
+  Clock clock_;
+  std::vector<Channel> channels_;
+  // Where the next search for the least loaded channel starts, so that
+  // channels with the same load are used in turn.
+  size_t next_;
+};
+
+}  // namespace nginx
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // NGINX_NGX_ESP_GRPC_CHANNEL_POOL_H_
@@ -0,0 +1,212 @@
+// Copyright (C) Extensible Service Proxy Authors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/nginx/grpc_channel_pool.h"
+
+#include "gtest/gtest.h"
+
+using ::google::api_manager::utils::Status;
+using ::google::protobuf::util::error::Code;
+
+namespace google {
+namespace api_manager {
+namespace nginx {
+namespace {
+
+// Nothing listens on the address. The channels never try to connect since
+// no call is made on them, so only the call results evict them.
+const char kAddress[] = "127.0.0.1:1";
+
+class GrpcChannelPoolTest : public ::testing::Test {
+ protected:
+  GrpcChannelPoolTest()
+      : now_(std::chrono::steady_clock::now()),
+        pool_(std::make_shared<NgxEspGrpcChannelPool>(
+            kAddress, 2, [this]() { return now_; })) {}
+
+  // Starts a call and finishes it with the code.
+  std::shared_ptr<::grpc::GenericStub> Call(Code code) {
+    std::function<void(const Status &)> on_finish;
+    auto stub = pool_->StartCall(&on_finish);
+    on_finish(Status(code, code == Code::OK ? "" : "Connection refused"));
+    return stub;
+  }
+
+  // Starts a call kept in flight until the test ends.
+  std::shared_ptr<::grpc::GenericStub> Hold() {
+    std::function<void(const Status &)> on_finish;
+    auto stub = pool_->StartCall(&on_finish);
+    held_.push_back(on_finish);
+    return stub;
+  }
+
+  ngx_esp_grpc_channel_stats_t Stats(size_t channel) {
+    ngx_esp_grpc_channel_stats_t stats[2];
+    EXPECT_EQ(2, pool_->GetStatistics(stats, 2));
+    return stats[channel];
+  }
+
+  std::chrono::steady_clock::time_point now_;
+  std::shared_ptr<NgxEspGrpcChannelPool> pool_;
+  std::vector<std::function<void(const Status &)>> held_;
+};
+
+TEST_F(GrpcChannelPoolTest, ChannelsUsedInTurn) {
+  auto first = Call(Code::OK);
+  auto second = Call(Code::OK);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(first, Call(Code::OK));
+  EXPECT_EQ(second, Call(Code::OK));
+}
+
+TEST_F(GrpcChannelPoolTest, LeastLoadedChannelPicked) {
+  auto busy = Hold();
+  auto idle = Call(Code::OK);
+  EXPECT_NE(busy, idle);
+  // The busy channel is next in turn, but has a call in flight.
+  EXPECT_EQ(idle, Call(Code::OK));
+  EXPECT_EQ(1, Stats(0).in_flight + Stats(1).in_flight);
+}
+
+TEST_F(GrpcChannelPoolTest, EvictedAfterThreeUnavailable) {
+  auto failing = Call(Code::UNAVAILABLE);
+  auto healthy = Call(Code::OK);
+  EXPECT_EQ(failing, Call(Code::UNAVAILABLE));
+  EXPECT_EQ(healthy, Call(Code::OK));
+  // After two errors in a row, the channel is still picked in turn.
+  EXPECT_EQ(failing, Call(Code::UNAVAILABLE));
+
+  // After the third one, it is not picked any more, even though the healthy
+  // channel is busier.
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(healthy, Hold());
+  }
+  EXPECT_EQ(3, Stats(0).errors);
+  EXPECT_EQ(0, Stats(0).reconnects);
+}
+
+TEST_F(GrpcChannelPoolTest, OtherErrorsDoNotEvict) {
+  auto channel = Call(Code::UNAVAILABLE);
+  Call(Code::OK);
+  EXPECT_EQ(channel, Call(Code::UNAVAILABLE));
+  Call(Code::OK);
+  // A call which reached the backend resets the consecutive errors.
+  EXPECT_EQ(channel, Call(Code::NOT_FOUND));
+  Call(Code::OK);
+  EXPECT_EQ(channel, Call(Code::UNAVAILABLE));
+  Call(Code::OK);
+  EXPECT_EQ(channel, Call(Code::INTERNAL));
+  EXPECT_EQ(0, Stats(0).reconnects);
+}
+
+TEST_F(GrpcChannelPoolTest, ReconnectedAtMostOncePerSecond) {
+  auto failing = Call(Code::UNAVAILABLE);
+  auto healthy = Call(Code::OK);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(failing, Call(Code::UNAVAILABLE));
+    EXPECT_EQ(healthy, Call(Code::OK));
+  }
+  // Keeps the healthy channel busy, so that the failing one would be picked
+  // if it were not evicted.
+  EXPECT_EQ(healthy, Hold());
+
+  now_ += std::chrono::milliseconds(999);
+  EXPECT_EQ(healthy, Hold());
+  EXPECT_EQ(0, Stats(0).reconnects);
+
+  // A second after the channel was connected, it is replaced.
+  now_ += std::chrono::milliseconds(1);
+  auto reconnected = Call(Code::UNAVAILABLE);
+  EXPECT_NE(failing, reconnected);
+  EXPECT_NE(healthy, reconnected);
+  EXPECT_EQ(1, Stats(0).reconnects);
+
+  // The new channel fails again at once: it is not replaced before another
+  // second has passed.
+  EXPECT_EQ(reconnected, Call(Code::UNAVAILABLE));
+  EXPECT_EQ(reconnected, Call(Code::UNAVAILABLE));
+  now_ += std::chrono::milliseconds(500);
+  EXPECT_EQ(healthy, Hold());
+  EXPECT_EQ(1, Stats(0).reconnects);
+
+  now_ += std::chrono::milliseconds(500);
+  auto replaced = Call(Code::OK);
+  EXPECT_NE(reconnected, replaced);
+  EXPECT_NE(healthy, replaced);
+  EXPECT_EQ(2, Stats(0).reconnects);
+}
+
+TEST_F(GrpcChannelPoolTest, CallsOfEvictedChannelIgnored) {
+  // With a single channel, the channel is picked even when evicted.
+  pool_ = std::make_shared<NgxEspGrpcChannelPool>(kAddress, 1,
+                                                  [this]() { return now_; });
+  std::function<void(const Status &)> old_call;
+  auto failing = pool_->StartCall(&old_call);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(failing, Call(Code::UNAVAILABLE));
+  }
+  now_ += std::chrono::seconds(1);
+  auto reconnected = Call(Code::OK);
+  EXPECT_NE(failing, reconnected);
+
+  // A call started on the evicted channel says nothing about the new one.
+  old_call(Status(Code::UNAVAILABLE, "Connection reset"));
+  old_call = nullptr;
+  EXPECT_EQ(reconnected, Call(Code::UNAVAILABLE));
+  EXPECT_EQ(reconnected, Call(Code::UNAVAILABLE));
+  now_ += std::chrono::seconds(1);
+  EXPECT_EQ(reconnected, Call(Code::OK));
+}
+
+TEST_F(GrpcChannelPoolTest, CallsOfEvictedChannelNotInFlight) {
+  auto failing = Hold();
+  auto healthy = Hold();
+  EXPECT_NE(failing, healthy);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(failing, Call(Code::UNAVAILABLE));
+    if (i < 2) {
+      EXPECT_EQ(healthy, Call(Code::OK));
+    }
+  }
+
+  // The call held on the evicted channel does not load the new one, which
+  // is picked over the busy healthy channel.
+  now_ += std::chrono::seconds(1);
+  auto reconnected = Hold();
+  EXPECT_NE(failing, reconnected);
+  EXPECT_NE(healthy, reconnected);
+  EXPECT_EQ(1, Stats(0).in_flight);
+  EXPECT_EQ(1, Stats(1).in_flight);
+
+  held_.clear();
+  EXPECT_EQ(0, Stats(0).in_flight);
+  EXPECT_EQ(0, Stats(1).in_flight);
+}
+
+}  // namespace
+}  // namespace nginx
+}  // namespace api_manager
+}  // namespace google
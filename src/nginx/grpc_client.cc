@@ -0,0 +1,213 @@
+// Copyright (C) Extensible Service Proxy Authors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/nginx/grpc_client.h"
+
+#include <chrono>
+#include <climits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <grpc++/generic/generic_stub.h>
+#include <grpc++/grpc++.h>
+
+#include "src/nginx/grpc_queue.h"
+#include "src/nginx/module.h"
+
+using ::google::api_manager::utils::Status;
+
+namespace google {
+namespace api_manager {
+namespace nginx {
+
+namespace {
+
+// The state of one unary call. Owned by the tags of its pending operations.
+//
+// The call runs as a sequence of streaming operations on the generic stub:
+//   Call -> Write (last message) -> Read -> Finish
+// Every step is completed on the NGINX main thread, so no locking is needed.
+struct GrpcUnaryCall {
+  std::unique_ptr<GRPCRequest> request;
+  std::shared_ptr<NgxEspGrpcQueue> queue;
+  std::shared_ptr<::grpc::GenericStub> stub;
+
+  ::grpc::ClientContext context;
+  std::unique_ptr<::grpc::GenericClientAsyncReaderWriter> stream;
+  ::grpc::ByteBuffer request_message;
+  ::grpc::ByteBuffer response_message;
+  bool has_response;
+  ::grpc::Status status;
+};
+
+// Returns the gRPC queue of this worker, starting it if needed.
+std::shared_ptr<NgxEspGrpcQueue> GetGrpcQueue(ngx_esp_main_conf_t *mc) {
+  if (!mc->grpc_queue) {
+    mc->grpc_queue = NgxEspGrpcQueue::Instance(mc->grpc_queue_threads);
+    mc->grpc_queue->Init((ngx_cycle_t *)ngx_cycle);
+  }
+  return mc->grpc_queue;
+}
+
+// Returns the stub of the long-lived channel to the server, creating the
+// channel if needed.
+std::shared_ptr<::grpc::GenericStub> GetGrpcStub(ngx_esp_main_conf_t *mc,
+                                                 const GRPCRequest &request) {
+  std::string key =
+      (request.use_ssl() ? "https://" : "http://") + request.server();
+
+  auto it = mc->grpc_client_stubs.find(key);
+  if (it != mc->grpc_client_stubs.end()) {
+    return it->second;
+  }
+
+  ::grpc::ChannelArguments channel_arguments;
+  channel_arguments.SetMaxReceiveMessageSize(INT_MAX);
+  channel_arguments.SetMaxSendMessageSize(INT_MAX);
+
+  std::shared_ptr<::grpc::ChannelCredentials> credentials;
+  if (request.use_ssl()) {
+    ::grpc::SslCredentialsOptions ssl_options;
+    credentials = ::grpc::SslCredentials(ssl_options);
+  } else {
+    credentials = ::grpc::InsecureChannelCredentials();
+  }
+
+  auto stub = std::make_shared<::grpc::GenericStub>(::grpc::CreateCustomChannel(
+      request.server(), credentials, channel_arguments));
+  mc->grpc_client_stubs.emplace(key, stub);
+  return stub;
+}
+
+void OnFinish(std::shared_ptr<GrpcUnaryCall> call) {
+  Status status = Status::OK;
+  std::string body;
+
+  if (!call->status.ok()) {
+    status = Status(call->status.error_code(), call->status.error_message());
+  } else if (!call->has_response) {
+    status = Status(::grpc::StatusCode::INTERNAL,
+                    "gRPC call completed without a response message");
+  } else {
+    std::vector<::grpc::Slice> slices;
+    call->response_message.Dump(&slices);
+    body.reserve(call->response_message.Length());
+    for (const auto &slice : slices) {
+      body.append(reinterpret_cast<const char *>(slice.begin()), slice.size());
+    }
+  }
+
+  call->request->OnComplete(status, std::move(body));
+}
+
+void StartFinish(std::shared_ptr<GrpcUnaryCall> call) {
+  call->stream->Finish(&call->status, call->queue->MakeTag([call](bool ok) {
+    if (!ok) {
+      call->status = ::grpc::Status(::grpc::StatusCode::UNKNOWN,
+                                    "Failed to finish the gRPC call");
+    }
+    OnFinish(call);
+  }));
+}
+
+void StartRead(std::shared_ptr<GrpcUnaryCall> call) {
+  call->stream->Read(&call->response_message,
+                     call->queue->MakeTag([call](bool ok) {
+                       call->has_response = ok;
+                       StartFinish(call);
+                     }));
+}
+
+void StartWrite(std::shared_ptr<GrpcUnaryCall> call) {
+  ::grpc::WriteOptions options;
+  options.set_last_message();
+  call->stream->Write(call->request_message, options,
+                      call->queue->MakeTag([call](bool ok) {
+                        if (!ok) {
+                          // The stream is broken, get the status.
+                          StartFinish(call);
+                          return;
+                        }
+                        StartRead(call);
+                      }));
+}
+
+}  // namespace
+
+void ngx_esp_send_grpc_request(std::unique_ptr<GRPCRequest> request) {
+  auto http_cctx = reinterpret_cast<ngx_http_conf_ctx_t *>(
+      ngx_get_conf(ngx_cycle->conf_ctx, ngx_http_module));
+  auto mc = http_cctx == nullptr
+                ? nullptr
+                : reinterpret_cast<ngx_esp_main_conf_t *>(
+                      http_cctx->main_conf[ngx_esp_module.ctx_index]);
+  if (mc == nullptr) {
+    request->OnComplete(Status(NGX_ERROR, "Unable to initiate gRPC request"),
+                        std::string());
+    return;
+  }
+
+  ngx_log_debug3(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                 "ESP: sending gRPC request: %s /%s/%s",
+                 request->server().c_str(), request->service().c_str(),
+                 request->method().c_str());
+
+  std::shared_ptr<GrpcUnaryCall> call = std::make_shared<GrpcUnaryCall>();
+  call->queue = GetGrpcQueue(mc);
+  call->stub = GetGrpcStub(mc, *request);
+  call->has_response = false;
+
+  if (request->timeout_ms() > 0) {
+    call->context.set_deadline(
+        std::chrono::system_clock::now() +
+        std::chrono::milliseconds(request->timeout_ms()));
+  }
+  if (!request->auth_token().empty()) {
+    call->context.AddMetadata("authorization",
+                              "Bearer " + request->auth_token());
+  }
+
+  ::grpc::Slice slice(request->body().data(), request->body().size());
+  call->request_message = ::grpc::ByteBuffer(&slice, 1);
+
+  std::string method = "/" + request->service() + "/" + request->method();
+  call->request = std::move(request);
+
+  call->stream = call->stub->Call(&call->context, method,
+                                  call->queue->GetQueue(),
+                                  call->queue->MakeTag([call](bool ok) {
+                                    if (!ok) {
+                                      StartFinish(call);
+                                      return;
+                                    }
+                                    StartWrite(call);
+                                  }));
+}
+
+}  // namespace nginx
+}  // namespace api_manager
+}  // namespace google
@@ -33,6 +33,7 @@
 #include "grpc++/support/byte_buffer.h"
 #include "src/nginx/error.h"
 #include "src/nginx/grpc_finish.h"
+#include "src/nginx/module.h"
 #include "src/nginx/util.h"
 
 extern "C" {
@@ -57,11 +58,49 @@ struct GrpcDeleter {
     grpc_byte_buffer_destroy(byte_buffer);
   }
 };
+
+// The gRPC pass-through statistics of this worker process.
+ngx_esp_grpc_passthrough_stats_t grpc_passthrough_stats;
+
+// Writes the gRPC message header: the compressed flag and the message
+// length, four bytes, big-endian.
+void WriteMessageHeader(grpc_byte_buffer *grpc_msg, size_t msglen,
+                        ngx_buf_t *buf) {
+  // Write the 'compressed' flag.
+  *buf->last++ = (grpc_msg->data.raw.compression == GRPC_COMPRESS_NONE ? 0 : 1);
+
+  // Write the message length: four bytes, big-endian.
+  // TODO: We should fail if asked to forward a message with length > uint32_max
+  buf->last[3] = msglen & 0xFF;
+  msglen >>= 8;
+  buf->last[2] = msglen & 0xFF;
+  msglen >>= 8;
+  buf->last[1] = msglen & 0xFF;
+  msglen >>= 8;
+  buf->last[0] = msglen & 0xFF;
+  buf->last += 4;
+}
 }  // namespace
 
+const ngx_esp_grpc_passthrough_stats_t &ngx_esp_grpc_passthrough_statistics() {
+  return grpc_passthrough_stats;
+}
+
 NgxEspGrpcPassThroughServerCall::NgxEspGrpcPassThroughServerCall(
     ngx_http_request_t *r)
-    : NgxEspGrpcServerCall(r, false) {}
+    : NgxEspGrpcServerCall(r, false), zero_copy_(false) {
+  ngx_esp_loc_conf_t *espcf = reinterpret_cast<ngx_esp_loc_conf_t *>(
+      ngx_http_get_module_loc_conf(r, ngx_esp_module));
+  if (espcf) {
+    zero_copy_ = espcf->grpc_zero_copy == 1;
+  }
+}
+
+NgxEspGrpcPassThroughServerCall::~NgxEspGrpcPassThroughServerCall() {
+  for (auto &response_slice : response_slices_) {
+    grpc_slice_unref(response_slice.slice);
+  }
+}
 
 utils::Status NgxEspGrpcPassThroughServerCall::Create(
     ngx_http_request_t *r,
@@ -105,6 +144,9 @@ void NgxEspGrpcPassThroughServerCall::Finish(
 bool NgxEspGrpcPassThroughServerCall::ConvertRequestBody(
     std::vector<grpc_slice> *out) {
   // Turn all incoming buffers into slices.
+  // The request data is always copied: nginx reuses the request body buffer
+  // for the next DATA frames as soon as its contents are consumed, while
+  // gRPC holds the slices until the message has been written upstream.
   ngx_http_request_body_t *body = r_->request_body;
   while (body->bufs) {
     ngx_chain_t *cl = body->bufs;
@@ -117,7 +159,7 @@ bool NgxEspGrpcPassThroughServerCall::ConvertRequestBody(
 }
 
 bool NgxEspGrpcPassThroughServerCall::ConvertResponseMessage(
-    const ::grpc::ByteBuffer &msg, ngx_chain_t *out) {
+    const ::grpc::ByteBuffer &msg, ngx_chain_t **out) {
   grpc_byte_buffer *grpc_msg = nullptr;
   bool own_buffer;
 
@@ -133,9 +175,11 @@ bool NgxEspGrpcPassThroughServerCall::ConvertResponseMessage(
     msg_deleter.reset(grpc_msg);
   }
 
-  // Since there's no good way to reuse the underlying grpc_slice for
-  // the nginx buffer, we need to allocate an nginx buffer and copy
-  // the data into it.
+  if (zero_copy_) {
+    return ReferenceResponseMessage(grpc_msg, out);
+  }
+
+  // Allocate an nginx buffer and copy the data into it.
   size_t buflen = 5;  // Compressed flag + four bytes of length.
 
   // Get the length of the actual message.  N.B. This is the
@@ -143,32 +187,20 @@ bool NgxEspGrpcPassThroughServerCall::ConvertResponseMessage(
   size_t msglen = grpc_byte_buffer_length(grpc_msg);
   buflen += msglen;
 
-  // Allocate the chain link and buffer.
-  ngx_buf_t *buf = ngx_create_temp_buf(r_->pool, buflen);
-  if (!buf) {
+  // Get the chain link and buffer.
+  ngx_chain_t *cl = GetOutputBuffer(buflen);
+  if (!cl) {
     ngx_log_error(
         NGX_LOG_ERR, r_->connection->log, 0,
         "Failed to allocate response buffer header for GRPC response message.");
     return false;
   }
+  ngx_buf_t *buf = cl->buf;
   buf->last_in_chain = 1;
   buf->flush = 1;
-  out->next = nullptr;
-  out->buf = buf;
+  *out = cl;
 
-  // Write the 'compressed' flag.
-  *buf->last++ = (grpc_msg->data.raw.compression == GRPC_COMPRESS_NONE ? 0 : 1);
-
-  // Write the message length: four bytes, big-endian.
-  // TODO: We should fail if asked to forward a message with length > uint32_max
-  buf->last[3] = msglen & 0xFF;
-  msglen >>= 8;
-  buf->last[2] = msglen & 0xFF;
-  msglen >>= 8;
-  buf->last[1] = msglen & 0xFF;
-  msglen >>= 8;
-  buf->last[0] = msglen & 0xFF;
-  buf->last += 4;
+  WriteMessageHeader(grpc_msg, msglen, buf);
 
   // Fill in the message.
   for (size_t sln = 0; sln < grpc_msg->data.raw.slice_buffer.count; sln++) {
@@ -177,10 +209,74 @@ bool NgxEspGrpcPassThroughServerCall::ConvertResponseMessage(
                GRPC_SLICE_LENGTH(*slice));
     buf->last += GRPC_SLICE_LENGTH(*slice);
   }
+  grpc_passthrough_stats.response_bytes_copied += msglen;
 
   return true;
 }
 
+bool NgxEspGrpcPassThroughServerCall::ReferenceResponseMessage(
+    grpc_byte_buffer *grpc_msg, ngx_chain_t **out) {
+  // The previous messages have most likely been sent by now.
+  ReleaseSentResponseSlices();
+
+  ngx_chain_t *last = GetOutputBuffer(5);
+  if (!last) {
+    ngx_log_error(
+        NGX_LOG_ERR, r_->connection->log, 0,
+        "Failed to allocate response buffer header for GRPC response message.");
+    return false;
+  }
+  size_t msglen = grpc_byte_buffer_length(grpc_msg);
+  WriteMessageHeader(grpc_msg, msglen, last->buf);
+  *out = last;
+
+  for (size_t sln = 0; sln < grpc_msg->data.raw.slice_buffer.count; sln++) {
+    grpc_slice *slice = grpc_msg->data.raw.slice_buffer.slices + sln;
+    if (GRPC_SLICE_LENGTH(*slice) == 0) {
+      continue;
+    }
+
+    ngx_chain_t *cl = GetOutputBuffer(0);
+    if (!cl) {
+      ngx_log_error(NGX_LOG_ERR, r_->connection->log, 0,
+                    "Failed to allocate response buffer for GRPC response "
+                    "message slice.");
+      return false;
+    }
+
+    // The buffer points at the copy of the slice in the list, so that the
+    // data of an inlined slice stays in place.
+    response_slices_.push_back({grpc_slice_ref(*slice), cl->buf});
+    const grpc_slice &ref = response_slices_.back().slice;
+
+    ngx_buf_t *buf = cl->buf;
+    buf->memory = 1;
+    buf->pos = GRPC_SLICE_START_PTR(ref);
+    buf->last = buf->pos + GRPC_SLICE_LENGTH(ref);
+    buf->start = buf->pos;
+    buf->end = buf->last;
+
+    last->next = cl;
+    last = cl;
+  }
+  last->buf->last_in_chain = 1;
+  last->buf->flush = 1;
+  grpc_passthrough_stats.response_bytes_zero_copied += msglen;
+
+  return true;
+}
+
+void NgxEspGrpcPassThroughServerCall::ReleaseSentResponseSlices() {
+  for (auto it = response_slices_.begin(); it != response_slices_.end();) {
+    if (ngx_buf_size(it->buf) > 0) {
+      ++it;
+      continue;
+    }
+    grpc_slice_unref(it->slice);
+    it = response_slices_.erase(it);
+  }
+}
+
 grpc_slice NgxEspGrpcPassThroughServerCall::GrpcSliceFromNginxBuffer(
     ngx_buf_t *buf) {
   if (!ngx_buf_in_memory(buf) && buf->file) {
@@ -188,6 +284,7 @@ grpc_slice NgxEspGrpcPassThroughServerCall::GrpcSliceFromNginxBuffer(
     grpc_slice result = grpc_slice_malloc(ngx_buf_size(buf));
     ngx_read_file(buf->file, GRPC_SLICE_START_PTR(result), ngx_buf_size(buf),
                   buf->file_pos);
+    grpc_passthrough_stats.request_bytes_copied += GRPC_SLICE_LENGTH(result);
     return result;
   }
 
@@ -196,6 +293,7 @@ grpc_slice NgxEspGrpcPassThroughServerCall::GrpcSliceFromNginxBuffer(
       reinterpret_cast<char *>(buf->pos), buf->last - buf->pos);
 
   buf->pos += GRPC_SLICE_LENGTH(result);
+  grpc_passthrough_stats.request_bytes_copied += GRPC_SLICE_LENGTH(result);
   return result;
 }
 }  // namespace nginx
@@ -26,6 +26,8 @@
 #ifndef NGINX_GRPC_PASSTHROUGH_SERVER_CALL_H_
 #define NGINX_GRPC_PASSTHROUGH_SERVER_CALL_H_
 
+#include <cstdint>
+#include <list>
 #include <map>
 #include <string>
 #include <vector>
@@ -42,6 +44,22 @@ namespace google {
 namespace api_manager {
 namespace nginx {
 
+// Statistics of the copies made by the gRPC pass-through calls of a worker
+// process, in bytes.
+// Important note: please don't use std::string. These fields are directly
+// copied into a shared memory.
+struct ngx_esp_grpc_passthrough_stats_t {
+  // Request bytes copied from the nginx buffers into gRPC slices.
+  uint64_t request_bytes_copied;
+  // Response bytes copied from the gRPC slices into nginx buffers.
+  uint64_t response_bytes_copied;
+  // Response bytes sent from the gRPC slices without a copy (grpc_zero_copy).
+  uint64_t response_bytes_zero_copied;
+};
+
+// Returns the gRPC pass-through statistics of this worker process.
+const ngx_esp_grpc_passthrough_stats_t& ngx_esp_grpc_passthrough_statistics();
+
 // grpc::ServerCall implementation for gRPC pass-through.
 //
 // Most of the ::grpc::ServerCall implementation is in the base class -
@@ -60,11 +78,21 @@ class NgxEspGrpcPassThroughServerCall : public NgxEspGrpcServerCall {
  protected:
   // Constructor
   NgxEspGrpcPassThroughServerCall(ngx_http_request_t* r);
+  virtual ~NgxEspGrpcPassThroughServerCall();
 
   // Builds a grpc_slice containing the same data as is contained in the
   // supplied nginx buffer.
   grpc_slice GrpcSliceFromNginxBuffer(ngx_buf_t* buf);
 
+  // Fills out with a buffer holding the gRPC message header, followed by one
+  // buffer per slice of the message pointing at the slice data. Each slice is
+  // referenced until nginx has sent its buffer, or until the call is
+  // destroyed.
+  bool ReferenceResponseMessage(grpc_byte_buffer* grpc_msg, ngx_chain_t** out);
+
+  // Releases the slices of the response buffers that nginx has sent.
+  void ReleaseSentResponseSlices();
+
   virtual const ngx_str_t& response_content_type() const;
 
   // ServerCall::Finish() implementation
@@ -76,7 +104,21 @@ class NgxEspGrpcPassThroughServerCall : public NgxEspGrpcServerCall {
   // NgxEspGrpcServerCall implementation
   virtual bool ConvertRequestBody(std::vector<grpc_slice>* out);
   virtual bool ConvertResponseMessage(const ::grpc::ByteBuffer& msg,
-                                      ngx_chain_t* out);
+                                      ngx_chain_t** out);
+
+  // A response slice referenced by an nginx buffer.
+  struct ResponseSlice {
+    grpc_slice slice;
+    ngx_buf_t* buf;
+  };
+
+  // If true, the response messages are sent from the gRPC slices without
+  // copying them (the grpc_zero_copy directive).
+  bool zero_copy_;
+
+  // The response slices not released yet. A list, so that the slices never
+  // move.
+  std::list<ResponseSlice> response_slices_;
 };
 
 }  // namespace nginx
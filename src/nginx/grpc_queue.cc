@@ -80,10 +80,10 @@ namespace nginx {
 // reference to it.
 //
 // When the last shared_ptr<> to the instance is destroyed,
-// NgxEspGrpcQueue's destructor will shut down the ::grpc::CompletionQueue,
-// and then join with the queue processing thread.  Libgrpc will
-// continue supplying events to the thread until the queue is clear;
-// then, the queue will return a shutdown event, and the thread will
+// NgxEspGrpcQueue's destructor will shut down the ::grpc::CompletionQueues,
+// and then join with the queue processing threads.  Libgrpc will
+// continue supplying events to the threads until the queues are clear;
+// then, the queues will return a shutdown event, and the threads will
 // exit, allowing the destructor to proceed to completion.
 //
 // The biggest downside of this approach is that it disables reverse
@@ -94,13 +94,96 @@ namespace nginx {
 // performance problem, it will likely be solved by working with the
 // GRPC team to create an API for integrating libgrpc into arbitrary
 // event loops.
+//
+// To keep one thread from becoming the bottleneck of all the gRPC
+// traffic of a worker, the queue may run several completion queues
+// (shards), each drained by its own thread.  GetQueue() hands out the
+// shards round robin, and a call stays on the shard it was started
+// on.  The shard threads hand the completed tags to the nginx thread
+// through a lock-free queue, and the tags are recycled through free
+// lists, so that a completion doesn't allocate or take a lock.
+
+namespace {
+
+// Tags are pooled in size classes of kTagSizeClassBytes, up to
+// kMaxPooledTagSize bytes.  Larger tags are allocated from the heap.
+const size_t kTagSizeClassBytes = 16;
+const size_t kMaxPooledTagSize = 256;
+const size_t kTagSizeClasses = kMaxPooledTagSize / kTagSizeClassBytes;
+
+// The maximum number of free tags kept per size class and thread.
+const size_t kMaxFreeTags = 1024;
+
+struct FreeTag {
+  FreeTag *next;
+};
+
+struct TagFreeList {
+  FreeTag *head;
+  size_t length;
+};
+
+// Tags are mostly created and destroyed on the nginx thread, but the free
+// lists are per thread so that a tag made on any other thread is safe.
+thread_local TagFreeList tag_free_lists[kTagSizeClasses];
+
+std::atomic<uint64_t> pooled_tags(0);
+std::atomic<uint64_t> allocated_tags(0);
+
+size_t TagSizeClass(size_t size) {
+  return (size + kTagSizeClassBytes - 1) / kTagSizeClassBytes - 1;
+}
+
+// Adapts a posted callback to the signature of the tags.
+struct PostedCallback {
+  std::function<void()> callback;
+  void operator()(bool) { callback(); }
+};
+
+}  // namespace
+
+void *NgxEspGrpcQueue::Tag::operator new(size_t size) {
+  if (size <= kMaxPooledTagSize) {
+    TagFreeList &free_list = tag_free_lists[TagSizeClass(size)];
+    if (free_list.head) {
+      FreeTag *tag = free_list.head;
+      free_list.head = tag->next;
+      --free_list.length;
+      pooled_tags.fetch_add(1, std::memory_order_relaxed);
+      return tag;
+    }
+    // Allocates the whole size class, so that the memory fits any tag of
+    // the class once recycled.
+    size = (TagSizeClass(size) + 1) * kTagSizeClassBytes;
+  }
+  allocated_tags.fetch_add(1, std::memory_order_relaxed);
+  return ::operator new(size);
+}
+
+void NgxEspGrpcQueue::Tag::operator delete(void *p, size_t size) {
+  if (p == nullptr) {
+    return;
+  }
+  if (size <= kMaxPooledTagSize) {
+    TagFreeList &free_list = tag_free_lists[TagSizeClass(size)];
+    if (free_list.length < kMaxFreeTags) {
+      FreeTag *tag = static_cast<FreeTag *>(p);
+      tag->next = free_list.head;
+      free_list.head = tag;
+      ++free_list.length;
+      return;
+    }
+  }
+  ::operator delete(p);
+}
 
 std::weak_ptr<NgxEspGrpcQueue> NgxEspGrpcQueue::instance;
 
-std::shared_ptr<NgxEspGrpcQueue> NgxEspGrpcQueue::Instance() {
+std::shared_ptr<NgxEspGrpcQueue> NgxEspGrpcQueue::Instance(size_t num_shards) {
   std::shared_ptr<NgxEspGrpcQueue> result = instance.lock();
   if (!result) {
-    result = std::shared_ptr<NgxEspGrpcQueue>(new NgxEspGrpcQueue, &Deleter);
+    result = std::shared_ptr<NgxEspGrpcQueue>(new NgxEspGrpcQueue(num_shards),
+                                              &Deleter);
     instance = result;
   }
   return result;
@@ -122,33 +205,62 @@ void NgxEspGrpcQueue::NginxTagHandler(ngx_event_t *) {
   }
 }
 
-void NgxEspGrpcQueue::WorkerThread(NgxEspGrpcQueue *queue) {
+::grpc::CompletionQueue *NgxEspGrpcQueue::GetQueue() {
+  ::grpc::CompletionQueue *cq = shards_[next_shard_]->cq.get();
+  next_shard_ = (next_shard_ + 1) % shards_.size();
+  return cq;
+}
+
+void NgxEspGrpcQueue::WorkerThread(NgxEspGrpcQueue *queue,
+                                   ::grpc::CompletionQueue *cq) {
   void *tag;
   bool ok;
-  while (queue->cq_->Next(&tag, &ok)) {
-    std::unique_ptr<Tag> cb(static_cast<Tag *>(tag));
+  while (cq->Next(&tag, &ok)) {
+    Tag *cb = static_cast<Tag *>(tag);
     if (cb) {
-      bool notify_nginx = false;
-      {
-        std::lock_guard<std::mutex> lock(queue->mu_);
-        queue->pending_.emplace_back(Finalizer{std::move(cb), ok});
-        if (!queue->notified_) {
-          notify_nginx = true;
-          queue->notified_ = true;
-        }
-      }
-      if (notify_nginx) {
-        ngx_notify(&queue->notify_);
-      }
+      cb->success_ = ok;
+      queue->Enqueue(cb);
     }
   }
 }
 
+void NgxEspGrpcQueue::Post(std::function<void()> callback) {
+  Tag *tag = new TypedTag<PostedCallback>(PostedCallback{std::move(callback)});
+  tag->success_ = true;
+  Enqueue(tag);
+}
+
+void NgxEspGrpcQueue::Enqueue(Tag *tag) {
+  tag->completed_at_ = std::chrono::steady_clock::now();
+  depth_.fetch_add(1, std::memory_order_relaxed);
+  pending_.Push(tag);
+  // Only the thread flipping notified_ notifies nginx.  The tag is fully
+  // linked at this point, so the drain started by any earlier notification
+  // either sees it, or resets notified_ first and gets notified again.
+  if (!notified_.exchange(true, std::memory_order_acq_rel)) {
+    ngx_notify(&notify_);
+  }
+}
+
 void NgxEspGrpcQueue::Deleter(NgxEspGrpcQueue *lib) { delete lib; }
 
-NgxEspGrpcQueue::NgxEspGrpcQueue()
-    : cq_(new ::grpc::CompletionQueue()), notified_(false) {
-  worker_thread_ = std::thread(&NgxEspGrpcQueue::WorkerThread, this);
+NgxEspGrpcQueue::NgxEspGrpcQueue(size_t num_shards)
+    : next_shard_(0),
+      depth_(0),
+      notified_(false),
+      completions_(0),
+      peak_depth_(0),
+      drain_latency_() {
+  if (num_shards == 0) {
+    num_shards = 1;
+  }
+  for (size_t i = 0; i < num_shards; ++i) {
+    std::unique_ptr<Shard> shard(new Shard);
+    shard->cq.reset(new ::grpc::CompletionQueue());
+    shard->thread =
+        std::thread(&NgxEspGrpcQueue::WorkerThread, this, shard->cq.get());
+    shards_.push_back(std::move(shard));
+  }
 }
 
 NgxEspGrpcQueue::~NgxEspGrpcQueue() {
@@ -167,32 +279,64 @@ NgxEspGrpcQueue::~NgxEspGrpcQueue() {
   //
   //   * Shutting down the queue
   //
-  //   * Waiting for the queue to drain (i.e. waiting for the event
-  //     worker thread to dequeue all pending tags and exit)
+  //   * Waiting for the queues to drain (i.e. waiting for the shard
+  //     threads to dequeue all pending tags and exit)
   //
   //   * Ignoring the outstanding events as they may try to enqueue
   //     new events, which is dangerous as the completion queue
   //     has been shut down.
 
-  cq_->Shutdown();
+  for (auto &shard : shards_) {
+    shard->cq->Shutdown();
+  }
 
-  // N.B. Joining on the worker thread is essential, as that thread
-  // maintains a raw pointer to this datastructure.
-  worker_thread_.join();
+  // N.B. Joining on the shard threads is essential, as they maintain a
+  // raw pointer to this datastructure.
+  for (auto &shard : shards_) {
+    shard->thread.join();
+  }
+
+  while (MpscQueueNode *node = pending_.Pop()) {
+    delete static_cast<Tag *>(node);
+  }
 }
 
 void NgxEspGrpcQueue::DrainPending() {
-  std::deque<Finalizer> pending;
-  {
-    std::lock_guard<std::mutex> lock(mu_);
-    pending.swap(pending_);
-    notified_ = false;
+  notified_.exchange(false, std::memory_order_acq_rel);
+  uint64_t depth = depth_.load(std::memory_order_relaxed);
+  if (depth > peak_depth_) {
+    peak_depth_ = depth;
   }
-  for (auto &it : pending) {
-    (*it.callback)(it.success);
+
+  // Only runs the tags queued so far, the tags completed by the callbacks
+  // come with a new notification.
+  for (; depth > 0; --depth) {
+    MpscQueueNode *node = pending_.Pop();
+    if (node == nullptr) {
+      // A shard thread is in the middle of queueing; it notifies again.
+      break;
+    }
+    depth_.fetch_sub(1, std::memory_order_relaxed);
+    std::unique_ptr<Tag> tag(static_cast<Tag *>(node));
+    ++completions_;
+    drain_latency_.Record(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - tag->completed_at_)
+            .count());
+    (*tag)(tag->success_);
   }
 }
 
+void NgxEspGrpcQueue::GetStatistics(ngx_esp_grpc_queue_stats_t *stats) const {
+  stats->shards = shards_.size();
+  stats->completions = completions_;
+  stats->depth = depth_.load(std::memory_order_relaxed);
+  stats->peak_depth = peak_depth_;
+  stats->pooled_tags = pooled_tags.load(std::memory_order_relaxed);
+  stats->allocated_tags = allocated_tags.load(std::memory_order_relaxed);
+  stats->drain_latency = drain_latency_;
+}
+
 }  // namespace nginx
 }  // namespace api_manager
 }  // namespace google
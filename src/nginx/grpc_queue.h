@@ -26,9 +26,13 @@
 #ifndef NGINX_NGX_ESP_GRPC_QUEUE_H_
 #define NGINX_NGX_ESP_GRPC_QUEUE_H_
 
-#include <deque>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <thread>
+#include <vector>
 
 #include <grpc++/grpc++.h>
 
@@ -37,20 +41,42 @@ extern "C" {
 #include "ngx_event.h"
 }
 
+#include "include/api_manager/latency_statistics.h"
 #include "src/grpc/async_grpc_queue.h"
+#include "src/nginx/mpsc_queue.h"
 
 namespace google {
 namespace api_manager {
 namespace nginx {
 
+// Statistics of the gRPC queue of a worker process.
+// Important note: please don't use std::string. These fields are directly
+// copied into a shared memory.
+struct ngx_esp_grpc_queue_stats_t {
+  // Number of completion queues, each drained by its own thread.
+  uint64_t shards;
+  // Number of completions and posted callbacks run on the nginx thread.
+  uint64_t completions;
+  // Completions waiting for the nginx thread, and the largest number seen.
+  uint64_t depth;
+  uint64_t peak_depth;
+  // Tags reused from the tag pool, and tags allocated from the heap.
+  uint64_t pooled_tags;
+  uint64_t allocated_tags;
+  // Time from a completion being dequeued by a shard thread until its
+  // callback runs on the nginx thread.
+  LatencyHistogram drain_latency;
+};
+
 // The nginx-event-loop-based GRPC queue implementation.
 class NgxEspGrpcQueue : public AsyncGrpcQueue {
  public:
-  // Returns the global library instance, initializing it if necessary
-  // and returning an empty pointer on initialization failure.  This
-  // call must be externally synchronized -- i.e. it's fine to call
-  // this from the main nginx thread, but not from any other thread.
-  static std::shared_ptr<NgxEspGrpcQueue> Instance();
+  // Returns the global library instance, initializing it with num_shards
+  // completion queues if necessary and returning an empty pointer on
+  // initialization failure.  This call must be externally synchronized --
+  // i.e. it's fine to call this from the main nginx thread, but not from
+  // any other thread.
+  static std::shared_ptr<NgxEspGrpcQueue> Instance(size_t num_shards);
 
   // Returns the global library instance, or an empty pointer if the
   // instance has not been initialized.  This call must be externally
@@ -58,24 +84,36 @@ class NgxEspGrpcQueue : public AsyncGrpcQueue {
   // thread, but not from any other thread.
   static std::shared_ptr<NgxEspGrpcQueue> TryInstance();
 
-  // Constructs a tag for use with the NgxEspGrpcQueue's completion queue.
+  // Constructs a tag for use with the NgxEspGrpcQueue's completion queues.
   // T must be MoveConstructible.
   template <typename T>
   static void *AllocTag(T callback) {
     return static_cast<void *>(new TypedTag<T>(std::move(callback)));
   }
 
-  // Constructs a tag for use with the NgxEspGrpcQueue's completion queue.
+  // Constructs a tag for use with the NgxEspGrpcQueue's completion queues.
   virtual void *MakeTag(std::function<void(bool)> callback) {
     return AllocTag(std::move(callback));
   }
 
-  // The completion queue processed by the library.  Tags queued to
-  // this queue must be created by MakeTag or AllocTag.
-  virtual ::grpc::CompletionQueue *GetQueue() { return cq_.get(); }
+  // Returns the completion queue of the next shard, round robin.  A gRPC
+  // call completes all its operations on the queue it was started with, so
+  // the calls are pinned to a shard and spread over the shards.  Tags
+  // queued to the queues must be created by MakeTag or AllocTag.  Must be
+  // called from the main nginx thread.
+  virtual ::grpc::CompletionQueue *GetQueue();
 
   void Init(ngx_cycle_t *cycle);
 
+  // Runs the callback on the main nginx thread, along with the completions.
+  // Lets other threads of the worker hand results back to nginx, as
+  // ngx_notify() only supports one handler per process.  Thread safe.
+  void Post(std::function<void()> callback);
+
+  // Fills in the queue statistics.  Must be called from the main nginx
+  // thread.
+  void GetStatistics(ngx_esp_grpc_queue_stats_t *stats) const;
+
  private:
   static std::weak_ptr<NgxEspGrpcQueue> instance;
 
@@ -84,10 +122,25 @@ class NgxEspGrpcQueue : public AsyncGrpcQueue {
   // C++ interfaces, all tags must subclass
   // ::grpc::CompletionQueueTag, since the framework will invoke the
   // virtual FinalizeResult method on the tag before returning it.
-  class Tag : public ::grpc::CompletionQueueTag {
+  //
+  // Once completed, a tag is handed to the nginx thread through the
+  // pending_ queue, without allocating.  The tag memory is recycled through
+  // per-thread free lists.
+  class Tag : public ::grpc::CompletionQueueTag, public MpscQueueNode {
    public:
+    Tag() : success_(false) {}
     virtual bool FinalizeResult(void **tag, bool *status) { return true; }
     virtual void operator()(bool ok) = 0;
+
+    static void *operator new(size_t size);
+    static void operator delete(void *p, size_t size);
+
+   private:
+    friend class NgxEspGrpcQueue;
+
+    // The result of the operation, and when the shard thread dequeued it.
+    bool success_;
+    std::chrono::steady_clock::time_point completed_at_;
   };
 
   // Specializes Tag for the continuation being queued to a completion
@@ -96,53 +149,63 @@ class NgxEspGrpcQueue : public AsyncGrpcQueue {
   class TypedTag : public Tag {
    public:
     TypedTag(T t) : t_(std::move(t)) {}
-
     virtual void operator()(bool ok) { t_(ok); }
 
    private:
     T t_;
   };
 
-  // The type stored in the pending event queue (pending_).  This
-  // holds the callback function and the result to pass to that
-  // function once the Nginx main thread picks up the pending event.
-  struct Finalizer {
-    std::unique_ptr<Tag> callback;
-    bool success;
+  // A completion queue and the thread draining it.
+  struct Shard {
+    std::unique_ptr<::grpc::CompletionQueue> cq;
+    std::thread thread;
   };
 
   // Runs GRPC callbacks on the main nginx thread.
   static void NginxTagHandler(ngx_event_t *);
 
-  // The GRPC worker thread main routine.  This shuttles events from
-  // the GRPC completion queue to the nginx event queue, getting them
+  // The shard thread main routine.  This shuttles events from the
+  // shard's completion queue to the nginx event queue, getting them
   // onto the main nginx thread.
   //
-  // Note that the worker thread's lifetime is strictly contained
-  // within the lifetime of its associated NgxEspGrpcQueue (the
-  // NgxEspGrpcQueue destructor joins on the thread).  This makes it
-  // possible to pass the queue to the worker thread via a raw
-  // pointer.
-  static void WorkerThread(NgxEspGrpcQueue *queue);
+  // Note that the shard threads' lifetime is strictly contained
+  // within the lifetime of their associated NgxEspGrpcQueue (the
+  // NgxEspGrpcQueue destructor joins on the threads).  This makes it
+  // possible to pass the queue to the threads via a raw pointer.
+  static void WorkerThread(NgxEspGrpcQueue *queue, ::grpc::CompletionQueue *cq);
 
   // Deletes the NgxEspGrpcQueue.  (This lets us avoid making the
   // constructor and destructor public, which is a little overly
   // paranoid, but doesn't hurt.)
   static void Deleter(NgxEspGrpcQueue *queue);
 
-  NgxEspGrpcQueue();
+  NgxEspGrpcQueue(size_t num_shards);
   virtual ~NgxEspGrpcQueue();
 
-  // Drains the contents of the pending_ queue.
+  // Queues the tag to pending_ and notifies the nginx thread if needed.
+  // Thread safe.
+  void Enqueue(Tag *tag);
+
+  // Runs the callbacks of the tags in the pending_ queue.
   void DrainPending();
 
-  std::mutex mu_;
   ngx_event_t notify_;
-  std::unique_ptr<::grpc::CompletionQueue> cq_;
-  std::deque<Finalizer> pending_;
-  bool notified_;
-
-  std::thread worker_thread_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  // The shard GetQueue() returns next.
+  size_t next_shard_;
+
+  // The completed tags, pushed by the shard threads.
+  MpscQueue pending_;
+  // Number of tags in pending_.
+  std::atomic<uint64_t> depth_;
+  // True if the nginx thread has been notified and has not started
+  // draining pending_ yet.
+  std::atomic<bool> notified_;
+
+  // Statistics, only accessed by the nginx thread.
+  uint64_t completions_;
+  uint64_t peak_depth_;
+  LatencyHistogram drain_latency_;
 };
 
 }  // namespace nginx
@@ -149,15 +149,44 @@ grpc_compression_algorithm GetCompressionAlgorithm(ngx_http_request_t *r) {
   return algorithm;
 }
 
+// Identifies the output buffers allocated by GetOutputBuffer().
+const ngx_buf_tag_t kOutputBufferTag =
+    reinterpret_cast<ngx_buf_tag_t>(&ngx_esp_module);
+
+// The minimum size of the memory of an output buffer. It is above the
+// largest allocation served from a request pool block, so that the memory
+// can be returned with ngx_pfree().
+const size_t kMinOutputBufferSize = 4096;
+
+// The output buffer statistics of this worker process.
+ngx_esp_grpc_output_buffer_stats_t output_buffer_stats;
+
 }  // namespace
 
+const ngx_esp_grpc_output_buffer_stats_t &
+ngx_esp_grpc_output_buffer_statistics() {
+  return output_buffer_stats;
+}
+
 NgxEspGrpcServerCall::NgxEspGrpcServerCall(ngx_http_request_t *r,
                                            bool delay_downstream_headers)
     : r_(r),
       add_header_failed_(false),
       reading_(false),
       read_msg_(nullptr),
-      delay_downstream_headers_(delay_downstream_headers) {
+      delay_downstream_headers_(delay_downstream_headers),
+      free_bufs_(nullptr),
+      busy_bufs_(nullptr),
+      output_buffer_cache_size_(0),
+      buffered_bytes_(0),
+      cached_bytes_(0) {
+  ngx_esp_loc_conf_t *espcf = reinterpret_cast<ngx_esp_loc_conf_t *>(
+      ngx_http_get_module_loc_conf(r, ngx_esp_module));
+  if (espcf) {
+    output_buffer_cache_size_ = espcf->grpc_output_buffer_cache_size;
+  }
+  ++output_buffer_stats.calls;
+
   // Add the cleanup handler.  This unlinks the NgxEspGrpcServerCall
   // from the request when the underlying nginx request is terminated,
   // since the NgxEspGrpcServerCall may outlive the request.
@@ -202,6 +231,8 @@ NgxEspGrpcServerCall::~NgxEspGrpcServerCall() {
     grpc_slice_unref(slice);
   }
   downstream_slices_.clear();
+  SetOutputBufferStats(0, 0);
+  --output_buffer_stats.calls;
 }
 
 void NgxEspGrpcServerCall::UpdateRequestMessageStat(int64_t size) {
@@ -318,6 +349,10 @@ void NgxEspGrpcServerCall::OnDownstreamWriteable(ngx_http_request_t *r) {
   ngx_int_t rc = ngx_esp_write_output(
       r, nullptr, &NgxEspGrpcServerCall::OnDownstreamWriteable);
 
+  if (server_call) {
+    server_call->UpdateOutputBuffers(nullptr);
+  }
+
   if (rc == NGX_AGAIN) {
     ngx_log_debug0(
         NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
@@ -683,7 +718,7 @@ void NgxEspGrpcServerCall::Write(const ::grpc::ByteBuffer &msg,
   ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r_->connection->log, 0,
                  "NgxEspGrpcServerCall::Write: Writing %z bytes", msg.Length());
 
-  ngx_chain_t out;
+  ngx_chain_t *out = nullptr;
   if (!ConvertResponseMessage(msg, &out)) {
     // Converting the response message failed. ConvertResponseMessage() has
     // finalized the request, call the continuation with false to abort the
@@ -695,7 +730,8 @@ void NgxEspGrpcServerCall::Write(const ::grpc::ByteBuffer &msg,
   }
 
   ngx_int_t rc = ngx_esp_write_output(
-      r_, &out, &NgxEspGrpcServerCall::OnDownstreamWriteable);
+      r_, out, &NgxEspGrpcServerCall::OnDownstreamWriteable);
+  UpdateOutputBuffers(out);
 
   if (rc == NGX_OK) {
     // We were immediately able to send the message downstream.
@@ -729,6 +765,134 @@ void NgxEspGrpcServerCall::RecordBackendTime(int64_t backend_time) {
   }
 }
 
+ngx_chain_t *NgxEspGrpcServerCall::GetOutputBuffer(size_t size) {
+  // Looks for a free buffer large enough, then for one without memory,
+  // then for any other one, whose memory is replaced.
+  ngx_chain_t **fit = nullptr;
+  ngx_chain_t **empty = nullptr;
+  ngx_chain_t **other = nullptr;
+  for (ngx_chain_t **ll = &free_bufs_; *ll; ll = &(*ll)->next) {
+    ngx_buf_t *buf = (*ll)->buf;
+    if (buf->start == nullptr) {
+      if (!empty) empty = ll;
+    } else if (size > 0 && static_cast<size_t>(buf->end - buf->start) >= size) {
+      fit = ll;
+      break;
+    } else if (!other) {
+      other = ll;
+    }
+  }
+
+  ngx_chain_t **found = fit ? fit : empty;
+  if (!found && size > 0) {
+    found = other;
+  }
+
+  ngx_chain_t *cl = nullptr;
+  size_t cached_bytes = cached_bytes_;
+  if (found) {
+    cl = *found;
+    *found = cl->next;
+    cl->next = nullptr;
+    ngx_buf_t *buf = cl->buf;
+    cached_bytes -= buf->end - buf->start;
+    if (buf->start && (size == 0 || fit == nullptr)) {
+      ngx_pfree(r_->pool, buf->start);
+      buf->start = buf->end = nullptr;
+    } else if (buf->start) {
+      ++output_buffer_stats.reused_buffers;
+    }
+  } else {
+    cl = ngx_alloc_chain_link(r_->pool);
+    if (!cl) {
+      return nullptr;
+    }
+    cl->next = nullptr;
+    cl->buf = ngx_calloc_buf(r_->pool);
+    if (!cl->buf) {
+      return nullptr;
+    }
+  }
+  SetOutputBufferStats(buffered_bytes_, cached_bytes);
+
+  ngx_buf_t *buf = cl->buf;
+  if (size > 0 && buf->start == nullptr) {
+    size_t capacity = size < kMinOutputBufferSize ? kMinOutputBufferSize : size;
+    buf->start = reinterpret_cast<u_char *>(ngx_palloc(r_->pool, capacity));
+    if (!buf->start) {
+      // Keeps the buffer for a later attempt.
+      cl->next = free_bufs_;
+      free_bufs_ = cl;
+      return nullptr;
+    }
+    buf->end = buf->start + capacity;
+    output_buffer_stats.allocated_bytes += capacity;
+  }
+
+  u_char *start = buf->start;
+  u_char *end = buf->end;
+  ngx_memzero(buf, sizeof(ngx_buf_t));
+  buf->start = buf->pos = buf->last = start;
+  buf->end = end;
+  buf->temporary = start != nullptr;
+  buf->tag = kOutputBufferTag;
+  return cl;
+}
+
+void NgxEspGrpcServerCall::UpdateOutputBuffers(ngx_chain_t *out) {
+  if (!cln_.data) {
+    return;
+  }
+
+  // Appends out to the busy buffers and takes the sent ones, the same way as
+  // the nginx output filters.
+  ngx_chain_t *sent = nullptr;
+  ngx_chain_update_chains(r_->pool, &sent, &busy_bufs_, &out,
+                          kOutputBufferTag);
+
+  size_t cached_bytes = cached_bytes_;
+  while (sent) {
+    ngx_chain_t *cl = sent;
+    sent = cl->next;
+
+    ngx_buf_t *buf = cl->buf;
+    if (buf->memory) {
+      // Read-only memory not owned by the buffer.
+      buf->start = buf->end = nullptr;
+    } else if (buf->start) {
+      size_t capacity = buf->end - buf->start;
+      if (cached_bytes + capacity > output_buffer_cache_size_) {
+        ngx_pfree(r_->pool, buf->start);
+        buf->start = buf->end = nullptr;
+      } else {
+        cached_bytes += capacity;
+      }
+    }
+    buf->pos = buf->last = buf->start;
+    cl->next = free_bufs_;
+    free_bufs_ = cl;
+  }
+
+  size_t buffered_bytes = 0;
+  for (ngx_chain_t *cl = busy_bufs_; cl; cl = cl->next) {
+    buffered_bytes += ngx_buf_size(cl->buf);
+  }
+  SetOutputBufferStats(buffered_bytes, cached_bytes);
+}
+
+void NgxEspGrpcServerCall::SetOutputBufferStats(size_t buffered_bytes,
+                                                size_t cached_bytes) {
+  output_buffer_stats.buffered_bytes += buffered_bytes;
+  output_buffer_stats.buffered_bytes -= buffered_bytes_;
+  output_buffer_stats.cached_bytes += cached_bytes;
+  output_buffer_stats.cached_bytes -= cached_bytes_;
+  if (buffered_bytes > output_buffer_stats.peak_call_buffered_bytes) {
+    output_buffer_stats.peak_call_buffered_bytes = buffered_bytes;
+  }
+  buffered_bytes_ = buffered_bytes;
+  cached_bytes_ = cached_bytes;
+}
+
 void NgxEspGrpcServerCall::Cleanup(void *server_call_ptr) {
   if (!server_call_ptr) {
     return;
@@ -738,6 +902,10 @@ void NgxEspGrpcServerCall::Cleanup(void *server_call_ptr) {
     server_call->CompletePendingRead(false, utils::Status::OK);
   }
   server_call->cln_.data = nullptr;
+  // The output buffers are freed with the request pool.
+  server_call->free_bufs_ = nullptr;
+  server_call->busy_bufs_ = nullptr;
+  server_call->SetOutputBufferStats(0, 0);
 }
 
 }  // namespace nginx
@@ -26,6 +26,8 @@
 #ifndef NGINX_NGX_ESP_GRPC_SERVER_CALL_H_
 #define NGINX_NGX_ESP_GRPC_SERVER_CALL_H_
 
+#include <cstdint>
+
 extern "C" {
 #include "src/http/ngx_http.h"
 }
@@ -36,6 +38,29 @@ namespace google {
 namespace api_manager {
 namespace nginx {
 
+// Statistics of the response output buffers of the gRPC calls of a worker
+// process.
+// Important note: please don't use std::string. These fields are directly
+// copied into a shared memory.
+struct ngx_esp_grpc_output_buffer_stats_t {
+  // Number of gRPC calls (pass-through and transcoded).
+  uint64_t calls;
+  // Response bytes waiting to be sent by nginx, over all the calls.
+  uint64_t buffered_bytes;
+  // Bytes of the sent output buffers kept for reuse, over all the calls.
+  uint64_t cached_bytes;
+  // The largest number of response bytes waiting to be sent by one call.
+  uint64_t peak_call_buffered_bytes;
+  // Bytes of output buffer memory allocated from the request pools.
+  uint64_t allocated_bytes;
+  // Number of output buffers whose memory was reused for a new message.
+  uint64_t reused_buffers;
+};
+
+// Returns the output buffer statistics of this worker process.
+const ngx_esp_grpc_output_buffer_stats_t&
+ngx_esp_grpc_output_buffer_statistics();
+
 // A common base class for implementing the grpc::ServerCall interface in a way
 // that wraps a downstream connection that's managed by an Nginx HTTP server. It
 // implements the common functionality shared between by gRPC pass-through and
@@ -85,12 +110,13 @@ class NgxEspGrpcServerCall : public grpc::ServerCall {
   // false.
   virtual bool ConvertRequestBody(std::vector<grpc_slice>* out) = 0;
 
-  // Converts the gRPC message into a response ngx_chain_t*
+  // Converts the gRPC message into a response ngx_chain_t*. All the chain
+  // links must be obtained from GetOutputBuffer().
   // Returns true if successful; otherwise ConvertResponseMessage() must take
   // care of sending the error to the client, finalizing the request and
   // return false.
   virtual bool ConvertResponseMessage(const ::grpc::ByteBuffer& msg,
-                                      ngx_chain_t* out) = 0;
+                                      ngx_chain_t** out) = 0;
 
   // Returns the response content-type
   virtual const ngx_str_t& response_content_type() const = 0;
@@ -103,6 +129,13 @@ class NgxEspGrpcServerCall : public grpc::ServerCall {
   // otherwise returns the error status.
   utils::Status WriteDownstreamHeaders();
 
+  // Returns a chain link with an empty temporary buffer of at least size
+  // bytes for the response, reusing the buffers that nginx has sent, so that
+  // the memory of a long-lived stream stays bounded. If size is 0, the
+  // buffer has no memory; the caller points it at read-only memory and sets
+  // buf->memory. Returns nullptr if the allocation failed.
+  ngx_chain_t* GetOutputBuffer(size_t size);
+
   // The request
   ngx_http_request_t* r_;
 
@@ -123,6 +156,15 @@ class NgxEspGrpcServerCall : public grpc::ServerCall {
   // calls CompletePendingRead and returns true if successful.
   bool TryReadDownstreamMessage();
 
+  // Appends out to the output buffers being sent, and moves the buffers that
+  // nginx has sent to the free list, releasing the memory above the cache
+  // size.
+  void UpdateOutputBuffers(ngx_chain_t* out);
+
+  // Sets the bytes buffered and cached by this call, updating the process
+  // statistics.
+  void SetOutputBufferStats(size_t buffered_bytes, size_t cached_bytes);
+
   // Indicates that the request is going away (being freed, &c).  This
   // causes currently outstanding and newly initiated operations to be
   // completed with 'false'.
@@ -137,6 +179,15 @@ class NgxEspGrpcServerCall : public grpc::ServerCall {
 
   // If true, sending of the headers will be delayed.
   bool delay_downstream_headers_;
+
+  // The output buffers available for reuse, and the ones being sent.
+  ngx_chain_t* free_bufs_;
+  ngx_chain_t* busy_bufs_;
+  // The maximum bytes of the free buffers (grpc_output_buffer_cache_size).
+  size_t output_buffer_cache_size_;
+  // The response bytes not sent yet, and the bytes of the free buffers.
+  size_t buffered_bytes_;
+  size_t cached_bytes_;
 };
 
 }  // namespace nginx
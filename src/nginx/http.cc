@@ -31,6 +31,7 @@
 
 #include "include/api_manager/http_request.h"
 #include "src/nginx/alloc.h"
+#include "src/nginx/http_keepalive.h"
 #include "src/nginx/module.h"
 #include "src/nginx/util.h"
 
@@ -243,17 +244,18 @@ ngx_int_t ngx_esp_upstream_create_request(ngx_http_request_t *r) {
 
   // <method> followed by a space.
   buffer_size += http_request->method().size() + sizeof(" ") - 1;
-  // <URL path> followed by 'HTTP/1.0' and a newline.
-  buffer_size += http_connection->url_path.len + sizeof(" HTTP/1.0" CRLF) - 1;
+  // <URL path> followed by 'HTTP/1.1' and a newline.
+  buffer_size += http_connection->url_path.len + sizeof(" HTTP/1.1" CRLF) - 1;
   // 'Host:' header, followed by a newline.
   buffer_size += sizeof("Host: ") - 1;
   buffer_size += http_connection->host_header.len;
   buffer_size += sizeof(CRLF) - 1;
-  // Right now all our subrequests close connection (both old and new
-  // implementation).
-  // TODO: investigate NGINX ability for connection reuse. This may especially
-  // benefit service control connections.
-  buffer_size += sizeof("Connection: close" CRLF) - 1;
+  // Connections are kept alive for reuse by the following requests to the
+  // same server, unless the keep-alive pool is disabled.
+  bool keepalive = http_connection->keepalive_peer != nullptr;
+  if (!keepalive) {
+    buffer_size += sizeof("Connection: close" CRLF) - 1;
+  }
 
   // Add sizes of all headers and their values.
   for (const auto &header : http_request->request_headers()) {
@@ -291,13 +293,15 @@ ngx_int_t ngx_esp_upstream_create_request(ngx_http_request_t *r) {
   append(buf, http_request->method());
   append(buf, " ");
   append(buf, http_connection->url_path);
-  append(buf, " HTTP/1.0" CRLF);
+  append(buf, " HTTP/1.1" CRLF);
 
   // Append the Host and Connection headers.
   append(buf, "Host: ");
   append(buf, http_connection->host_header);
   append(buf, CRLF);
-  append(buf, "Connection: close" CRLF);
+  if (!keepalive) {
+    append(buf, "Connection: close" CRLF);
+  }
 
   // Append the headers provided by the caller.
   for (const auto &header : http_request->request_headers()) {
@@ -358,8 +362,14 @@ ngx_int_t ngx_esp_upstream_reinit_request(ngx_http_request_t *r) {
     return NGX_ERROR;
   }
 
-  // We only reset state to start parsing status line again.
+  // Reset state to start parsing status line again. The request may be
+  // retried on a new connection if a pooled one turned out to be closed.
   r->upstream->process_header = ngx_esp_upstream_process_status_line;
+  ngx_memzero(&http_connection->response_status,
+              sizeof(http_connection->response_status));
+  ngx_memzero(&http_connection->chunked, sizeof(http_connection->chunked));
+  http_connection->response_body.str(std::string());
+  http_connection->response_headers.clear();
   return NGX_OK;
 }
 
@@ -407,6 +417,11 @@ ngx_int_t ngx_esp_upstream_process_status_line(ngx_http_request_t *r) {
   // continuation as a status).
   http_connection->response_status = status;
 
+  // HTTP/1.0 servers close the connection after the response.
+  if (status.http_version < NGX_HTTP_VERSION_11) {
+    r->upstream->headers_in.connection_close = 1;
+  }
+
   // Advance the state machine to parse individual headers next.
   r->upstream->process_header = ngx_esp_upstream_process_header;
   return ngx_esp_upstream_process_header(r);
@@ -452,6 +467,25 @@ ngx_int_t ngx_esp_upstream_process_header(ngx_http_request_t *r) {
         r->upstream->headers_in.content_length_n =
             ngx_atoof(value.data, value.len);
       }
+
+      // Check if the server is going to close the connection.
+      static ngx_str_t connection = ngx_string("Connection");
+      if (name.len == connection.len &&
+          ngx_strncasecmp(name.data, connection.data, connection.len) == 0 &&
+          ngx_strlcasestrn(value.data, value.data + value.len,
+                           (u_char *)"close", 5 - 1) != nullptr) {
+        r->upstream->headers_in.connection_close = 1;
+      }
+
+      // Check if the response body is chunked.
+      static ngx_str_t transfer_encoding = ngx_string("Transfer-Encoding");
+      if (name.len == transfer_encoding.len &&
+          ngx_strncasecmp(name.data, transfer_encoding.data,
+                          transfer_encoding.len) == 0 &&
+          ngx_strlcasestrn(value.data, value.data + value.len,
+                           (u_char *)"chunked", 7 - 1) != nullptr) {
+        r->upstream->headers_in.chunked = 1;
+      }
     } else if (rc == NGX_HTTP_PARSE_HEADER_DONE) {
       return NGX_OK;
     } else if (rc == NGX_AGAIN) {
@@ -523,6 +557,10 @@ void ngx_esp_upstream_finalize_request(ngx_http_request_t *r, ngx_int_t rc) {
                  "ngx_esp_upstream_finalize_request called: %V%V",
                  &http_connection->host_header, &http_connection->url_path);
 
+  // Return a reusable upstream connection to the keep-alive pool before NGINX
+  // closes it.
+  ngx_esp_http_keepalive_release(r, http_connection->keepalive_peer, rc);
+
   std::string message;
   if (rc == NGX_OK) {
     // If the overall transmission succeeded (rc == NGX_OK), use the HTTP
@@ -631,9 +669,70 @@ ngx_int_t ngx_esp_upstream_input_filter_init(void *data) {
       esp_request != nullptr ? esp_request->url().c_str() : "<unknown URL>");
 #endif
 
+  // Determine where the response body ends. The connection can only be
+  // reused if the body is delimited by its length or by chunked encoding,
+  // rather than by the server closing the connection.
+  ngx_http_upstream_t *u = r->upstream;
+  ngx_uint_t code = http_connection->response_status.code;
+
+  if (code == NGX_HTTP_NO_CONTENT || code == NGX_HTTP_NOT_MODIFIED ||
+      (http_connection->esp_request &&
+       http_connection->esp_request->method() == "HEAD")) {
+    u->length = 0;
+    u->keepalive = !u->headers_in.connection_close;
+  } else if (u->headers_in.chunked) {
+    u->length = -1;
+  } else {
+    u->length = u->headers_in.content_length_n;
+    if (u->length == 0) {
+      u->keepalive = !u->headers_in.connection_close;
+    }
+  }
+
   return NGX_OK;
 }
 
+// Decodes a chunked response body and accumulates it in the response body
+// stream.
+ngx_int_t ngx_esp_upstream_chunked_filter(ngx_http_request_t *r,
+                                          ngx_esp_http_connection *conn,
+                                          ssize_t bytes) {
+  ngx_http_upstream_t *u = r->upstream;
+
+  ngx_buf_t buf;
+  ngx_memzero(&buf, sizeof(buf));
+  buf.pos = u->buffer.last;
+  buf.last = u->buffer.last + bytes;
+
+  for (;;) {
+    ngx_int_t rc = ngx_http_parse_chunked(r, &buf, &conn->chunked);
+
+    if (rc == NGX_OK) {
+      // A chunk has been parsed, its data (or a part of it) follows.
+      off_t size = ngx_min(conn->chunked.size, buf.last - buf.pos);
+      conn->response_body.write(reinterpret_cast<char *>(buf.pos), size);
+      buf.pos += size;
+      conn->chunked.size -= size;
+      continue;
+    }
+
+    if (rc == NGX_DONE) {
+      // The whole response body has been parsed.
+      u->length = 0;
+      u->keepalive = !u->headers_in.connection_close && buf.pos == buf.last;
+      return NGX_OK;
+    }
+
+    if (rc == NGX_AGAIN) {
+      return NGX_OK;
+    }
+
+    ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                  "upstream sent invalid chunked response");
+    return NGX_ERROR;
+  }
+}
+
 // An upstream input filter handler.
 //
 // After initialization, NGINX calls this filter handler whenever new data
@@ -657,8 +756,27 @@ ngx_int_t ngx_esp_upstream_input_filter(void *data, ssize_t bytes) {
                  "endpoints received %d bytes: %V", (int)bytes, &body);
 #endif
 
+  ngx_http_upstream_t *u = r->upstream;
+  if (u->headers_in.chunked) {
+    return ngx_esp_upstream_chunked_filter(r, http_connection, bytes);
+  }
+
+  if (u->length != -1) {
+    if (bytes > u->length) {
+      ngx_log_error(NGX_LOG_WARN, r->connection->log, 0,
+                    "upstream sent more data than specified in "
+                    "\"Content-Length\" header");
+      bytes = u->length;
+      u->length = 0;
+      u->keepalive = 0;
+    } else {
+      u->length -= bytes;
+      u->keepalive = u->length == 0 && !u->headers_in.connection_close;
+    }
+  }
+
   http_connection->response_body.write(
-      reinterpret_cast<char *>(r->upstream->buffer.last), bytes);
+      reinterpret_cast<char *>(u->buffer.last), bytes);
 
   return NGX_OK;
 }
@@ -1012,6 +1130,9 @@ Status initialize_upstream_request(ngx_log_t *log, HTTPRequest *request,
   upstream->conf = &http_connection->upstream_conf;
   upstream->buffering = 1;
 
+  // Use the keep-alive connection pool of the target server, if enabled.
+  http_connection->keepalive_peer = ngx_esp_http_keepalive_attach(r);
+
   // Set up the upstream handlers which create the request HTTP buffers, and
   // process the response data as the upstream module reads it from the wire.
 
@@ -32,6 +32,7 @@
 
 #include "include/api_manager/http_request.h"
 #include "include/api_manager/utils/status.h"
+#include "src/nginx/http_keepalive.h"
 
 extern "C" {
 #include "src/http/ngx_http.h"
@@ -75,6 +76,10 @@ struct ngx_esp_http_connection {
   // Upstream connection configuration, timeouts etc.
   ngx_http_upstream_conf_t upstream_conf;
 
+  // The keep-alive pool entry of the target server, nullptr if connections
+  // are not reused.
+  ngx_esp_http_peer_t *keepalive_peer;
+
   // Request information.
 
   // The nginx_http_request_t used to handle the HTTP request.
@@ -101,6 +106,9 @@ struct ngx_esp_http_connection {
   // Response headers captured in a map.
   std::map<std::string, std::string> response_headers;
 
+  // State of the chunked response body decoder.
+  ngx_http_chunked_t chunked;
+
   // Wake up information.
 
   // An event pre-allocated for the tear-down of the request.
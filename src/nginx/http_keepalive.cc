@@ -0,0 +1,514 @@
+// Copyright (C) Extensible Service Proxy Authors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/nginx/http_keepalive.h"
+
+#include <sys/socket.h>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+extern "C" {
+#include "src/core/ngx_core.h"
+#include "src/http/ngx_http.h"
+}
+
+namespace google {
+namespace api_manager {
+namespace nginx {
+
+// A pool entry. Owns the idle connections to one (scheme, host, port) and the
+// implicit upstream configuration NGINX uses to obtain peers from the pool.
+struct ngx_esp_http_peer_s {
+  // "scheme://host:port", used for logging.
+  std::string key;
+  // Owned copy of the host name, referenced by upstream.host.
+  std::string host;
+
+  // The implicit upstream configuration. Its peer.init points at
+  // ngx_esp_http_keepalive_init_peer and peer.data at this entry.
+  ngx_http_upstream_srv_conf_t upstream;
+
+  // The address of the server the last successful request was sent to.
+  // Valid if address_expires is not 0.
+  struct sockaddr_storage sockaddr;
+  socklen_t socklen;
+  std::string name;
+  ngx_http_upstream_resolved_t resolved;
+  ngx_msec_t address_expires;
+
+  // Idle connections, most recently used at the back.
+  std::list<ngx_connection_t *> idle;
+
+#if NGX_HTTP_SSL
+  // TLS session of the server, used to resume new TLS connections.
+  ngx_ssl_session_t *ssl_session;
+#endif
+};
+
+namespace {
+
+// How long the address of a server is reused without resolving the host name
+// again, in milliseconds.
+const ngx_msec_t kAddressTtlMilliseconds = 60000;
+
+// Per-request data wrapping the round robin peer created for the request.
+struct ngx_esp_http_peer_data_t {
+  ngx_esp_http_peer_t *peer;
+
+  void *data;
+  ngx_event_get_peer_pt original_get_peer;
+  ngx_event_free_peer_pt original_free_peer;
+};
+
+// The pool configuration and statistics of this worker process.
+ngx_uint_t max_idle_connections = 0;
+ngx_msec_t idle_timeout = 0;
+ngx_esp_http_keepalive_stats_t statistics;
+
+// Pool entries keyed by "scheme://host:port". The entries are never removed;
+// their number is bounded by the number of servers ESP talks to.
+std::map<std::string, std::unique_ptr<ngx_esp_http_peer_t>> *peers = nullptr;
+
+ngx_int_t ngx_esp_http_keepalive_init_peer(ngx_http_request_t *r,
+                                           ngx_http_upstream_srv_conf_t *us);
+
+void ngx_esp_http_keepalive_close(ngx_connection_t *c);
+
+#if NGX_HTTP_SSL
+void ngx_esp_http_keepalive_close_ssl(ngx_connection_t *c) {
+  ngx_pool_t *pool = c->pool;
+  ngx_close_connection(c);
+  ngx_destroy_pool(pool);
+}
+#endif
+
+// Closes an idle connection which is no longer in the pool.
+void ngx_esp_http_keepalive_close(ngx_connection_t *c) {
+#if NGX_HTTP_SSL
+  if (c->ssl) {
+    c->ssl->no_wait_shutdown = 1;
+    c->ssl->no_send_shutdown = 1;
+
+    if (ngx_ssl_shutdown(c) == NGX_AGAIN) {
+      c->ssl->handler = ngx_esp_http_keepalive_close_ssl;
+      return;
+    }
+  }
+#endif
+
+  ngx_pool_t *pool = c->pool;
+  ngx_close_connection(c);
+  ngx_destroy_pool(pool);
+}
+
+void ngx_esp_http_keepalive_remove(ngx_esp_http_peer_t *peer,
+                                   ngx_connection_t *c) {
+  peer->idle.remove(c);
+  statistics.idle_connections--;
+}
+
+// Write handler of an idle connection. There is nothing to write.
+void ngx_esp_http_keepalive_dummy_handler(ngx_event_t *ev) {
+  ngx_log_debug0(NGX_LOG_DEBUG_HTTP, ev->log, 0,
+                 "esp: keepalive dummy handler");
+}
+
+// Read handler of an idle connection. Called when the server closes the
+// connection (or unexpectedly sends data), when the idle timeout expires,
+// or when the worker process shuts down.
+void ngx_esp_http_keepalive_close_handler(ngx_event_t *ev) {
+  ngx_connection_t *c = reinterpret_cast<ngx_connection_t *>(ev->data);
+  ngx_esp_http_peer_t *peer = reinterpret_cast<ngx_esp_http_peer_t *>(c->data);
+
+  ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ev->log, 0,
+                 "esp: keepalive close handler (%s)", peer->key.c_str());
+
+  if (!c->close && !ev->timedout) {
+    char buf[1];
+    ssize_t n = recv(c->fd, buf, 1, MSG_PEEK);
+
+    if (n == -1 && ngx_socket_errno == NGX_EAGAIN) {
+      ev->ready = 0;
+
+      if (ngx_handle_read_event(c->read, 0) == NGX_OK) {
+        return;
+      }
+    }
+  }
+
+  ngx_esp_http_keepalive_remove(peer, c);
+  ngx_esp_http_keepalive_close(c);
+}
+
+// Finds or creates the pool entry for the upstream.
+ngx_esp_http_peer_t *ngx_esp_http_keepalive_find(ngx_http_upstream_t *u) {
+  std::string host(reinterpret_cast<const char *>(u->resolved->host.data),
+                   u->resolved->host.len);
+  std::string key(reinterpret_cast<const char *>(u->schema.data),
+                  u->schema.len);
+  key += host + ":" + std::to_string(u->resolved->port);
+
+  if (peers == nullptr) {
+    peers = new std::map<std::string, std::unique_ptr<ngx_esp_http_peer_t>>();
+  }
+
+  std::unique_ptr<ngx_esp_http_peer_t> &peer = (*peers)[key];
+  if (peer == nullptr) {
+    peer.reset(new ngx_esp_http_peer_t());
+    peer->key = key;
+    peer->host = host;
+    peer->name = host + ":" + std::to_string(u->resolved->port);
+
+    ngx_memzero(&peer->upstream, sizeof(peer->upstream));
+    peer->upstream.host.data =
+        reinterpret_cast<u_char *>(const_cast<char *>(peer->host.data()));
+    peer->upstream.host.len = peer->host.size();
+    peer->upstream.port = u->resolved->port;
+    peer->upstream.peer.init = ngx_esp_http_keepalive_init_peer;
+    peer->upstream.peer.data = peer.get();
+
+    ngx_memzero(&peer->resolved, sizeof(peer->resolved));
+    peer->resolved.host = peer->upstream.host;
+    peer->resolved.port = u->resolved->port;
+    peer->resolved.name.data =
+        reinterpret_cast<u_char *>(const_cast<char *>(peer->name.data()));
+    peer->resolved.name.len = peer->name.size();
+  }
+  return peer.get();
+}
+
+// Remembers the address of the server so the following requests can skip
+// the host name resolution.
+void ngx_esp_http_keepalive_set_address(ngx_esp_http_peer_t *peer,
+                                        struct sockaddr *sockaddr,
+                                        socklen_t socklen) {
+  if (socklen > sizeof(peer->sockaddr)) {
+    return;
+  }
+
+  ngx_memcpy(&peer->sockaddr, sockaddr, socklen);
+  peer->socklen = socklen;
+  peer->resolved.sockaddr =
+      reinterpret_cast<struct sockaddr *>(&peer->sockaddr);
+  peer->resolved.socklen = socklen;
+  peer->resolved.naddrs = 1;
+  peer->address_expires = ngx_current_msec + kAddressTtlMilliseconds;
+  if (peer->address_expires == 0) {
+    peer->address_expires = 1;
+  }
+}
+
+bool ngx_esp_http_keepalive_address_fresh(ngx_esp_http_peer_t *peer) {
+  return peer->address_expires != 0 &&
+         static_cast<ngx_msec_int_t>(peer->address_expires - ngx_current_msec) >
+             0;
+}
+
+// Peer selection. Runs the round robin selection first so that the peer
+// connection has its address and name set, and then, if the pool has an idle
+// connection, returns it instead of connecting.
+ngx_int_t ngx_esp_http_keepalive_get_peer(ngx_peer_connection_t *pc,
+                                          void *data) {
+  ngx_esp_http_peer_data_t *kp =
+      reinterpret_cast<ngx_esp_http_peer_data_t *>(data);
+  ngx_esp_http_peer_t *peer = kp->peer;
+
+  pc->cached = 0;
+  pc->connection = nullptr;
+
+  ngx_int_t rc = kp->original_get_peer(pc, kp->data);
+  if (rc != NGX_OK) {
+    return rc;
+  }
+
+  if (peer->idle.empty()) {
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                   "esp: keepalive pool miss (%s)", peer->key.c_str());
+    statistics.pool_misses++;
+    return NGX_OK;
+  }
+
+  ngx_connection_t *c = peer->idle.back();
+  ngx_esp_http_keepalive_remove(peer, c);
+
+  ngx_log_debug2(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                 "esp: keepalive pool hit (%s), connection %p",
+                 peer->key.c_str(), c);
+  statistics.pool_hits++;
+
+  c->idle = 0;
+  c->sent = 0;
+  c->data = nullptr;
+  c->log = pc->log;
+  c->read->log = pc->log;
+  c->write->log = pc->log;
+  c->pool->log = pc->log;
+
+  if (c->read->timer_set) {
+    ngx_del_timer(c->read);
+  }
+
+  pc->connection = c;
+  // Makes NGINX retry the request on a different connection if this one
+  // turns out to be closed by the server.
+  pc->cached = 1;
+
+  return NGX_DONE;
+}
+
+void ngx_esp_http_keepalive_free_peer(ngx_peer_connection_t *pc, void *data,
+                                      ngx_uint_t state) {
+  ngx_esp_http_peer_data_t *kp =
+      reinterpret_cast<ngx_esp_http_peer_data_t *>(data);
+
+  if (pc->cached && (state & NGX_PEER_FAILED)) {
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                   "esp: keepalive connection to %s is stale",
+                   kp->peer->key.c_str());
+    statistics.stale_connections++;
+  }
+
+  kp->original_free_peer(pc, kp->data, state);
+}
+
+#if NGX_HTTP_SSL
+ngx_int_t ngx_esp_http_keepalive_set_session(ngx_peer_connection_t *pc,
+                                             void *data) {
+  ngx_esp_http_peer_data_t *kp =
+      reinterpret_cast<ngx_esp_http_peer_data_t *>(data);
+
+  if (kp->peer->ssl_session == nullptr) {
+    return NGX_OK;
+  }
+  return ngx_ssl_set_session(pc->connection, kp->peer->ssl_session);
+}
+
+void ngx_esp_http_keepalive_save_session(ngx_peer_connection_t *pc,
+                                         void *data) {
+  ngx_esp_http_peer_data_t *kp =
+      reinterpret_cast<ngx_esp_http_peer_data_t *>(data);
+
+  ngx_ssl_session_t *session = ngx_ssl_get_session(pc->connection);
+  if (session == nullptr) {
+    return;
+  }
+
+  if (kp->peer->ssl_session != nullptr) {
+    ngx_ssl_free_session(kp->peer->ssl_session);
+  }
+  kp->peer->ssl_session = session;
+}
+#endif
+
+// The peer.init handler of the implicit upstream configuration. Creates a
+// round robin peer for the cached server address and wraps its handlers.
+ngx_int_t ngx_esp_http_keepalive_init_peer(ngx_http_request_t *r,
+                                           ngx_http_upstream_srv_conf_t *us) {
+  ngx_esp_http_peer_t *peer =
+      reinterpret_cast<ngx_esp_http_peer_t *>(us->peer.data);
+  ngx_http_upstream_t *u = r->upstream;
+
+  if (ngx_http_upstream_create_round_robin_peer(r, &peer->resolved) !=
+      NGX_OK) {
+    return NGX_ERROR;
+  }
+
+  ngx_esp_http_peer_data_t *kp = reinterpret_cast<ngx_esp_http_peer_data_t *>(
+      ngx_palloc(r->pool, sizeof(ngx_esp_http_peer_data_t)));
+  if (kp == nullptr) {
+    return NGX_ERROR;
+  }
+
+  kp->peer = peer;
+  kp->data = u->peer.data;
+  kp->original_get_peer = u->peer.get;
+  kp->original_free_peer = u->peer.free;
+
+  u->peer.data = kp;
+  u->peer.get = ngx_esp_http_keepalive_get_peer;
+  u->peer.free = ngx_esp_http_keepalive_free_peer;
+#if NGX_HTTP_SSL
+  u->peer.set_session = ngx_esp_http_keepalive_set_session;
+  u->peer.save_session = ngx_esp_http_keepalive_save_session;
+#endif
+
+  return NGX_OK;
+}
+
+}  // namespace
+
+void ngx_esp_http_keepalive_configure(ngx_uint_t max_idle,
+                                      ngx_msec_t timeout) {
+  max_idle_connections = max_idle;
+  idle_timeout = timeout;
+}
+
+bool ngx_esp_http_keepalive_enabled() { return max_idle_connections > 0; }
+
+ngx_esp_http_peer_t *ngx_esp_http_keepalive_attach(ngx_http_request_t *r) {
+  ngx_http_upstream_t *u = r->upstream;
+  if (!ngx_esp_http_keepalive_enabled() || u->resolved == nullptr) {
+    return nullptr;
+  }
+
+  ngx_esp_http_peer_t *peer = ngx_esp_http_keepalive_find(u);
+
+  // The URL contained an IP address, no need to resolve it.
+  if (u->resolved->sockaddr != nullptr && !peer->address_expires) {
+    ngx_esp_http_keepalive_set_address(peer, u->resolved->sockaddr,
+                                       u->resolved->socklen);
+  }
+
+  // Idle connections are only kept for the current address of the server,
+  // so they can be used even if the address is due to be resolved again.
+  if (peer->address_expires != 0 &&
+      (!peer->idle.empty() || ngx_esp_http_keepalive_address_fresh(peer))) {
+    // NGINX uses the upstream configuration (u->conf->upstream) if the
+    // upstream has no resolved address.
+    u->resolved = nullptr;
+    u->conf->upstream = &peer->upstream;
+    // Lets NGINX retry the request on a new connection if a pooled one was
+    // closed by the server (see ngx_esp_http_keepalive_get_peer).
+    u->conf->next_upstream |= NGX_HTTP_UPSTREAM_FT_ERROR;
+  } else {
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "esp: keepalive pool miss (%s), resolving",
+                   peer->key.c_str());
+    statistics.pool_misses++;
+  }
+
+  return peer;
+}
+
+bool ngx_esp_http_keepalive_release(ngx_http_request_t *r,
+                                    ngx_esp_http_peer_t *peer, ngx_int_t rc) {
+  ngx_http_upstream_t *u = r->upstream;
+  if (peer == nullptr || u == nullptr) {
+    return false;
+  }
+
+  if (rc != NGX_OK) {
+    // The server may have moved, resolve the host name again.
+    if (peer->idle.empty()) {
+      peer->address_expires = 0;
+    }
+    return false;
+  }
+
+  ngx_connection_t *c = u->peer.connection;
+  if (c == nullptr || !u->keepalive || !u->request_sent ||
+      u->headers_in.connection_close || c->read->eof || c->read->error ||
+      c->read->timedout || c->write->error || c->write->timedout ||
+      ngx_terminate || ngx_exiting) {
+    return false;
+  }
+
+  if (c->read->timer_set) {
+    ngx_del_timer(c->read);
+  }
+  if (c->write->timer_set) {
+    ngx_del_timer(c->write);
+  }
+
+  if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
+    return false;
+  }
+
+  // The round robin peer of the pool path points at the cached address.
+  bool resolved = u->peer.sockaddr !=
+                  reinterpret_cast<struct sockaddr *>(&peer->sockaddr);
+
+  if (!resolved && !ngx_esp_http_keepalive_address_fresh(peer)) {
+    // Let the connections to the old address drain so that the host name is
+    // resolved again.
+    return false;
+  }
+
+  if (resolved && u->peer.sockaddr != nullptr) {
+    if (u->peer.socklen != peer->socklen ||
+        ngx_memcmp(u->peer.sockaddr, &peer->sockaddr, peer->socklen) != 0) {
+      // The server moved. The connections to the previous address cannot be
+      // served by the round robin peer of the new address.
+      while (!peer->idle.empty()) {
+        ngx_connection_t *stale = peer->idle.front();
+        ngx_esp_http_keepalive_remove(peer, stale);
+        ngx_esp_http_keepalive_close(stale);
+      }
+    }
+    ngx_esp_http_keepalive_set_address(peer, u->peer.sockaddr,
+                                       u->peer.socklen);
+  }
+
+#if NGX_HTTP_SSL
+  if (c->ssl && peer->ssl_session == nullptr) {
+    peer->ssl_session = ngx_ssl_get_session(c);
+  }
+#endif
+
+  if (peer->idle.size() >= max_idle_connections) {
+    ngx_connection_t *oldest = peer->idle.front();
+    ngx_esp_http_keepalive_remove(peer, oldest);
+    ngx_esp_http_keepalive_close(oldest);
+  }
+
+  ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                 "esp: keeping connection %p to %s", c, peer->key.c_str());
+
+  peer->idle.push_back(c);
+  statistics.idle_connections++;
+
+  c->write->handler = ngx_esp_http_keepalive_dummy_handler;
+  c->read->handler = ngx_esp_http_keepalive_close_handler;
+
+  c->data = peer;
+  c->idle = 1;
+  c->log = ngx_cycle->log;
+  c->read->log = ngx_cycle->log;
+  c->write->log = ngx_cycle->log;
+  c->pool->log = ngx_cycle->log;
+
+  ngx_add_timer(c->read, idle_timeout);
+
+  // Detach the connection from the upstream so NGINX does not close it.
+  u->peer.connection = nullptr;
+
+  if (c->read->ready) {
+    ngx_esp_http_keepalive_close_handler(c->read);
+  }
+
+  return true;
+}
+
+const ngx_esp_http_keepalive_stats_t &ngx_esp_http_keepalive_statistics() {
+  return statistics;
+}
+
+}  // namespace nginx
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,95 @@
+// Copyright (C) Extensible Service Proxy Authors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#ifndef NGINX_NGX_ESP_HTTP_KEEPALIVE_H_
+#define NGINX_NGX_ESP_HTTP_KEEPALIVE_H_
+
+#include <cstdint>
+
+extern "C" {
+#include "src/http/ngx_http.h"
+}
+
+namespace google {
+namespace api_manager {
+namespace nginx {
+
+// Statistics of the per-worker keep-alive pool used by the outbound HTTP
+// requests (service control, JWKS, metadata, Firebase rules).
+// Important note: please don't use std::string. These fields are directly
+// copied into a shared memory.
+struct ngx_esp_http_keepalive_stats_t {
+  // Requests sent over an idle connection taken from the pool.
+  uint64_t pool_hits;
+  // Requests which had to open a new upstream connection.
+  uint64_t pool_misses;
+  // Requests retried because a pooled connection was closed by the server.
+  uint64_t stale_connections;
+  // Idle connections currently held by the pool.
+  uint64_t idle_connections;
+};
+
+// A pool entry, one per (scheme, host, port) of the outbound requests.
+typedef struct ngx_esp_http_peer_s ngx_esp_http_peer_t;
+
+// Configures the keep-alive pool. Must be called before the first request
+// is sent. max_idle is the maximum number of idle connections kept per
+// (scheme, host, port); 0 disables the pool and makes all outbound requests
+// use "Connection: close". idle_timeout is the time an idle connection is
+// kept open, in milliseconds.
+void ngx_esp_http_keepalive_configure(ngx_uint_t max_idle,
+                                      ngx_msec_t idle_timeout);
+
+// Returns true if the outbound requests should keep connections alive.
+bool ngx_esp_http_keepalive_enabled();
+
+// Looks up the pool entry for the upstream about to be initialized. The
+// upstream URL (schema and resolved host and port) must already be set.
+// If the pool can serve the request (it has an idle connection or knows a
+// recently used address of the server), the upstream is pointed at the
+// pool's implicit upstream configuration so that NGINX obtains its peer
+// connection from the pool instead of resolving the host name again.
+//
+// Returns the pool entry, or nullptr if the pool is disabled.
+ngx_esp_http_peer_t *ngx_esp_http_keepalive_attach(ngx_http_request_t *r);
+
+// Called from the upstream finalize handler (before NGINX frees the peer).
+// If the request succeeded and the upstream connection is reusable, moves it
+// to the pool of idle connections so that NGINX does not close it.
+// On failure, drops the cached server address of the pool entry so that the
+// next request resolves the host name again.
+// Returns true if the connection was kept.
+bool ngx_esp_http_keepalive_release(ngx_http_request_t *r,
+                                    ngx_esp_http_peer_t *peer, ngx_int_t rc);
+
+// Returns the keep-alive pool statistics of this worker process.
+const ngx_esp_http_keepalive_stats_t &ngx_esp_http_keepalive_statistics();
+
+}  // namespace nginx
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // NGINX_NGX_ESP_HTTP_KEEPALIVE_H_
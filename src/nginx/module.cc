@@ -37,6 +37,7 @@
 #include "src/nginx/config.h"
 #include "src/nginx/environment.h"
 #include "src/nginx/error.h"
+#include "src/nginx/http_keepalive.h"
 #include "src/nginx/response.h"
 #include "src/nginx/status.h"
 #include "src/nginx/util.h"
@@ -51,6 +52,25 @@ namespace nginx {
 
 namespace {
 
+// Default number of idle keep-alive connections kept per server by the
+// outbound HTTP requests, and their idle timeout in milliseconds.
+const ngx_uint_t kDefaultUpstreamKeepalive = 8;
+const ngx_msec_t kDefaultUpstreamKeepaliveTimeout = 60000;
+
+// Default number of gRPC completion queue threads per worker process.
+const ngx_uint_t kDefaultGrpcQueueThreads = 1;
+
+// Default number of channels per gRPC backend.
+const ngx_uint_t kDefaultGrpcBackendChannels = 1;
+
+// Default number of crypto pool threads per worker process, 0 verifies the
+// JWT signatures on the nginx thread.
+const ngx_uint_t kDefaultCryptoThreads = 0;
+
+// Maximum number of jobs queued per crypto pool thread. Further jobs run on
+// the nginx thread.
+const size_t kMaxQueuedCryptoJobsPerThread = 64;
+
 // Internal debugging header
 static ngx_str_t kXEndpointsDebugUrlRewrite =
     ngx_string("x-endpoints-debug-url-rewrite");
@@ -150,6 +170,21 @@ ngx_esp_request_ctx_s::ngx_esp_request_ctx_s(ngx_http_request_t *r,
       transcoder_factory = std::make_shared<transcoding::TranscoderFactory>(
           lc->esp->service(config_id), json_print_options);
       lc->transcoder_factory_map[config_id] = transcoder_factory;
+
+      // A new service config was deployed, drops the factories of the
+      // service configs which are no longer rolled out. The requests still
+      // using them hold their own references.
+      ServiceConfigRolloutsInfo rollouts;
+      lc->esp->GetServiceConfigRollouts(&rollouts);
+      for (auto factory = lc->transcoder_factory_map.begin();
+           factory != lc->transcoder_factory_map.end();) {
+        if (rollouts.percentages.find(factory->first) ==
+            rollouts.percentages.end()) {
+          factory = lc->transcoder_factory_map.erase(factory);
+        } else {
+          ++factory;
+        }
+      }
     }
   }
 }
@@ -241,6 +276,50 @@ ngx_command_t ngx_esp_commands[] = {
         NGX_HTTP_LOC_CONF | NGX_CONF_NOARGS | NGX_CONF_TAKE12,
         ConfigureGrpcBackendHandler, NGX_HTTP_LOC_CONF_OFFSET, 0, nullptr,
     },
+    {
+        // grpc_zero_copy makes the gRPC pass-through send the response
+        // messages straight from the gRPC slices, instead of copying them
+        // into nginx buffers. The slices are released once nginx has sent
+        // them. Defaults to off.
+        //
+        // Usage:
+        //   location / {
+        //     grpc_pass;
+        //     grpc_zero_copy on;
+        //   }
+        //
+        ngx_string("grpc_zero_copy"),
+        NGX_HTTP_MAIN_CONF | NGX_HTTP_SRV_CONF | NGX_HTTP_LOC_CONF |
+            NGX_CONF_FLAG,
+        [](ngx_conf_t *cf, ngx_command_t *cmd, void *conf) -> char * {
+          return ngx_conf_set_flag_slot(
+              cf, cmd,
+              &reinterpret_cast<ngx_esp_loc_conf_t *>(conf)->grpc_zero_copy);
+        },
+        NGX_HTTP_LOC_CONF_OFFSET, 0, nullptr,
+    },
+    {
+        // grpc_output_buffer_cache_size limits the memory of the response
+        // buffers that a gRPC call keeps for reuse once nginx has sent them.
+        // The buffers above the limit are freed, so that long-lived streams
+        // don't grow the request pool. Defaults to 32k.
+        //
+        // Usage:
+        //   location / {
+        //     grpc_pass;
+        //     grpc_output_buffer_cache_size 64k;
+        //   }
+        //
+        ngx_string("grpc_output_buffer_cache_size"),
+        NGX_HTTP_MAIN_CONF | NGX_HTTP_SRV_CONF | NGX_HTTP_LOC_CONF |
+            NGX_CONF_TAKE1,
+        [](ngx_conf_t *cf, ngx_command_t *cmd, void *conf) -> char * {
+          return ngx_conf_set_size_slot(
+              cf, cmd, &reinterpret_cast<ngx_esp_loc_conf_t *>(conf)
+                            ->grpc_output_buffer_cache_size);
+        },
+        NGX_HTTP_LOC_CONF_OFFSET, 0, nullptr,
+    },
     {
         ngx_string("endpoints_status"), NGX_HTTP_LOC_CONF | NGX_CONF_NOARGS,
         ngx_esp_configure_status_handler, NGX_HTTP_LOC_CONF_OFFSET, 0, nullptr,
@@ -264,6 +343,112 @@ ngx_command_t ngx_esp_commands[] = {
         },
         NGX_HTTP_MAIN_CONF_OFFSET, 0, nullptr,
     },
+    {
+        ngx_string("endpoints_keepalive"), NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+        [](ngx_conf_t *cf, ngx_command_t *cmd, void *conf) -> char * {
+          return ngx_conf_set_num_slot(
+              cf, cmd, &reinterpret_cast<ngx_esp_main_conf_t *>(conf)
+                            ->upstream_keepalive);
+        },
+        NGX_HTTP_MAIN_CONF_OFFSET, 0, nullptr,
+    },
+    {
+        ngx_string("endpoints_keepalive_timeout"),
+        NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+        [](ngx_conf_t *cf, ngx_command_t *cmd, void *conf) -> char * {
+          return ngx_conf_set_msec_slot(
+              cf, cmd, &reinterpret_cast<ngx_esp_main_conf_t *>(conf)
+                            ->upstream_keepalive_timeout);
+        },
+        NGX_HTTP_MAIN_CONF_OFFSET, 0, nullptr,
+    },
+    {
+        // endpoints_grpc_queue_threads sets the number of gRPC completion
+        // queues of a worker process, each drained by its own thread. The
+        // gRPC calls are spread over the queues.
+        //
+        // Usage:
+        //   http {
+        //     endpoints_grpc_queue_threads 4;
+        //   }
+        //
+        ngx_string("endpoints_grpc_queue_threads"),
+        NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+        [](ngx_conf_t *cf, ngx_command_t *cmd, void *conf) -> char * {
+          return ngx_conf_set_num_slot(
+              cf, cmd, &reinterpret_cast<ngx_esp_main_conf_t *>(conf)
+                            ->grpc_queue_threads);
+        },
+        NGX_HTTP_MAIN_CONF_OFFSET, 0, nullptr,
+    },
+    {
+        // endpoints_grpc_backend_channels sets the number of channels, i.e.
+        // HTTP/2 connections, a worker process opens to each gRPC backend.
+        // New calls go to the channel with the fewest calls in flight.
+        //
+        // Usage:
+        //   http {
+        //     endpoints_grpc_backend_channels 4;
+        //   }
+        //
+        ngx_string("endpoints_grpc_backend_channels"),
+        NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+        [](ngx_conf_t *cf, ngx_command_t *cmd, void *conf) -> char * {
+          return ngx_conf_set_num_slot(
+              cf, cmd, &reinterpret_cast<ngx_esp_main_conf_t *>(conf)
+                            ->grpc_backend_channels);
+        },
+        NGX_HTTP_MAIN_CONF_OFFSET, 0, nullptr,
+    },
+    {
+        // endpoints_crypto_threads sets the number of threads of a worker
+        // process verifying the JWT signatures, so that public key
+        // operations do not stall the nginx event loop. When all the
+        // threads are busy and their queue is full, signatures are verified
+        // on the nginx thread. 0, the default, disables the threads.
+        //
+        // Usage:
+        //   http {
+        //     endpoints_crypto_threads 2;
+        //   }
+        //
+        ngx_string("endpoints_crypto_threads"),
+        NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+        [](ngx_conf_t *cf, ngx_command_t *cmd, void *conf) -> char * {
+          return ngx_conf_set_num_slot(
+              cf, cmd, &reinterpret_cast<ngx_esp_main_conf_t *>(conf)
+                            ->crypto_threads);
+        },
+        NGX_HTTP_MAIN_CONF_OFFSET, 0, nullptr,
+    },
+    {
+        // endpoints_shared_cache enables a check and quota cache in shared
+        // memory, so that service control responses obtained by one worker
+        // process are used by all of them.
+        //
+        // Usage:
+        //   http {
+        //     endpoints_shared_cache 10m;
+        //   }
+        //
+        ngx_string("endpoints_shared_cache"),
+        NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+        [](ngx_conf_t *cf, ngx_command_t *cmd, void *conf) -> char * {
+          ngx_str_t *value = reinterpret_cast<ngx_str_t *>(cf->args->elts);
+          ssize_t size = ngx_parse_size(&value[1]);
+          if (size == NGX_ERROR) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid endpoints shared cache size \"%V\"",
+                               &value[1]);
+            return reinterpret_cast<char *>(NGX_CONF_ERROR);
+          }
+          if (ngx_esp_add_shared_cache_memory(cf, size) != NGX_OK) {
+            return reinterpret_cast<char *>(NGX_CONF_ERROR);
+          }
+          return NGX_CONF_OK;
+        },
+        NGX_HTTP_MAIN_CONF_OFFSET, 0, nullptr,
+    },
     ngx_null_command  // last entry
 };
 
@@ -358,12 +543,37 @@ void *ngx_esp_create_main_conf(ngx_conf_t *cf) {
     return nullptr;
   }
 
+  conf->upstream_keepalive = NGX_CONF_UNSET_UINT;
+  conf->upstream_keepalive_timeout = NGX_CONF_UNSET_MSEC;
+  conf->grpc_queue_threads = NGX_CONF_UNSET_UINT;
+  conf->grpc_backend_channels = NGX_CONF_UNSET_UINT;
+  conf->crypto_threads = NGX_CONF_UNSET_UINT;
+
   return conf;
 }
 
 // Initialize module's main context configuration.
 char *ngx_esp_init_main_conf(ngx_conf_t *cf, void *conf) {
-  // noop
+  auto *mc = reinterpret_cast<ngx_esp_main_conf_t *>(conf);
+
+  ngx_conf_init_uint_value(mc->upstream_keepalive, kDefaultUpstreamKeepalive);
+  ngx_conf_init_msec_value(mc->upstream_keepalive_timeout,
+                           kDefaultUpstreamKeepaliveTimeout);
+  ngx_conf_init_uint_value(mc->grpc_queue_threads, kDefaultGrpcQueueThreads);
+  if (mc->grpc_queue_threads == 0) {
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "endpoints_grpc_queue_threads must be positive");
+    return reinterpret_cast<char *>(NGX_CONF_ERROR);
+  }
+  ngx_conf_init_uint_value(mc->grpc_backend_channels,
+                           kDefaultGrpcBackendChannels);
+  if (mc->grpc_backend_channels == 0) {
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "endpoints_grpc_backend_channels must be positive");
+    return reinterpret_cast<char *>(NGX_CONF_ERROR);
+  }
+  ngx_conf_init_uint_value(mc->crypto_threads, kDefaultCryptoThreads);
+
   return NGX_CONF_OK;
 }
 
@@ -387,6 +597,8 @@ void *ngx_esp_create_loc_conf(ngx_conf_t *cf) {
   lc->service_control = NGX_CONF_UNSET;
   lc->cloud_tracing = NGX_CONF_UNSET;
   lc->api_authentication = NGX_CONF_UNSET;
+  lc->grpc_zero_copy = NGX_CONF_UNSET;
+  lc->grpc_output_buffer_cache_size = NGX_CONF_UNSET_SIZE;
 
   return lc;
 }
@@ -448,6 +660,10 @@ char *ngx_esp_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child) {
   ngx_conf_merge_str_value(conf->grpc_backend_address_fallback,
                            prev->grpc_backend_address_fallback, nullptr);
 
+  ngx_conf_merge_value(conf->grpc_zero_copy, prev->grpc_zero_copy, 0);
+  ngx_conf_merge_size_value(conf->grpc_output_buffer_cache_size,
+                            prev->grpc_output_buffer_cache_size, 32 * 1024);
+
   if (conf->metadata_server == NGX_CONF_UNSET) {
     conf->metadata_server = prev->metadata_server;
     conf->metadata_server_url = prev->metadata_server_url;
@@ -1138,6 +1354,12 @@ ngx_int_t ngx_esp_init_process(ngx_cycle_t *cycle) {
     // Handle the case where there is no http section at all.
     return NGX_OK;
   }
+  // The shared cache must be available before service control is
+  // initialized.
+  if (mc->shared_cache_zone != nullptr) {
+    mc->shared_cache.reset(new NgxEspSharedCache(mc->shared_cache_zone));
+  }
+
   bool has_esp = false;
   ngx_esp_loc_conf_t **endpoints =
       reinterpret_cast<ngx_esp_loc_conf_t **>(mc->endpoints.elts);
@@ -1149,11 +1371,26 @@ ngx_int_t ngx_esp_init_process(ngx_cycle_t *cycle) {
       has_esp = true;
     }
     if (lc->grpc_pass && !mc->grpc_queue) {
-      mc->grpc_queue = NgxEspGrpcQueue::Instance();
+      mc->grpc_queue = NgxEspGrpcQueue::Instance(mc->grpc_queue_threads);
       mc->grpc_queue->Init(cycle);
     }
   }
 
+  if (has_esp && mc->crypto_threads > 0) {
+    // The continuations of the crypto jobs run on the nginx thread through
+    // the gRPC queue.
+    if (!mc->grpc_queue) {
+      mc->grpc_queue = NgxEspGrpcQueue::Instance(mc->grpc_queue_threads);
+      mc->grpc_queue->Init(cycle);
+    }
+    mc->crypto_pool.reset(new NgxEspWorkerPool(
+        mc->crypto_threads,
+        mc->crypto_threads * kMaxQueuedCryptoJobsPerThread, mc->grpc_queue));
+  }
+
+  ngx_esp_http_keepalive_configure(mc->upstream_keepalive,
+                                   mc->upstream_keepalive_timeout);
+
   if (mc->stats_zone != nullptr) {
     ngx_int_t rc = ngx_esp_init_process_stats(cycle);
     if (rc != NGX_OK) {
@@ -1185,6 +1422,11 @@ void ngx_esp_exit_process(ngx_cycle_t *cycle) {
     // Handle the case where there is no http section at all.
     return;
   }
+  // Joins the crypto and config threads while the ESP objects are still
+  // alive.
+  mc->crypto_pool.reset();
+  mc->config_pool.reset();
+
   ngx_esp_loc_conf_t **endpoints =
       reinterpret_cast<ngx_esp_loc_conf_t **>(mc->endpoints.elts);
   for (ngx_uint_t i = 0, napis = mc->endpoints.nelts; i < napis; i++) {
@@ -43,10 +43,13 @@ extern "C" {
 #include "src/grpc/transcoding/transcoder_factory.h"
 #include "src/nginx/alloc.h"
 #include "src/nginx/grpc.h"
+#include "src/nginx/grpc_channel_pool.h"
+#include "src/nginx/worker_pool.h"
 #include "src/nginx/grpc_queue.h"
 #include "src/nginx/grpc_server_call.h"
 #include "src/nginx/http.h"
 #include "src/nginx/request.h"
+#include "src/nginx/shared_cache.h"
 
 namespace google {
 namespace api_manager {
@@ -56,6 +59,12 @@ namespace nginx {
 // * Extensible Service Proxy - Configuration declarations. *
 // ********************************************************
 
+typedef std::map<std::string, std::shared_ptr<::grpc::GenericStub>>
+    ngx_esp_grpc_stub_map_t;
+
+typedef std::map<std::string, std::shared_ptr<NgxEspGrpcChannelPool>>
+    ngx_esp_grpc_channel_pool_map_t;
+
 //
 // ESP Module Configuration - main context.
 //
@@ -73,6 +82,32 @@ typedef struct {
   // The module-level GRPC library interface.
   std::shared_ptr<NgxEspGrpcQueue> grpc_queue;
 
+  // Number of completion queues of grpc_queue, each drained by its own
+  // thread.
+  ngx_uint_t grpc_queue_threads;
+
+  // The map of gRPC servers (service control etc.) to the stubs of their
+  // long-lived channels. These are constructed on-demand.
+  ngx_esp_grpc_stub_map_t grpc_client_stubs;
+
+  // The map of gRPC backends to the pools of channels the proxied calls are
+  // sent on. These are constructed on-demand.
+  ngx_esp_grpc_channel_pool_map_t grpc_channel_pools;
+
+  // Number of channels in the pool of a gRPC backend.
+  ngx_uint_t grpc_backend_channels;
+
+  // The pool of threads verifying the JWT signatures, nullptr if the
+  // signatures are verified on the nginx thread.
+  std::unique_ptr<NgxEspWorkerPool> crypto_pool;
+
+  // Number of threads of crypto_pool, 0 to disable the pool.
+  ngx_uint_t crypto_threads;
+
+  // The single thread building the service configs of the managed rollouts,
+  // started by the first rollout.
+  std::unique_ptr<NgxEspWorkerPool> config_pool;
+
   // Shared memory zone for stats per process
   ngx_shm_zone_t *stats_zone;
 
@@ -82,6 +117,13 @@ typedef struct {
   // Timer to log endpoints status.
   std::unique_ptr<PeriodicTimer> log_stats_timer;
 
+  // Shared memory zone for the check and quota cache shared by the workers,
+  // nullptr if endpoints_shared_cache is not configured.
+  ngx_shm_zone_t *shared_cache_zone;
+
+  // The per-process view of the shared cache.
+  std::unique_ptr<NgxEspSharedCache> shared_cache;
+
   // A timer event to detect worker process existing.
   ngx_event_t exit_timer;
   // the start time to wait for active connections to be closed.
@@ -97,6 +139,13 @@ typedef struct {
   // Address of the http.cc upstream DNS resolver
   ngx_str_t upstream_resolver;
 
+  // Maximum number of idle keep-alive connections kept per server by the
+  // http.cc outbound requests. 0 disables connection reuse.
+  ngx_uint_t upstream_keepalive;
+
+  // Timeout after which an idle keep-alive connection is closed.
+  ngx_msec_t upstream_keepalive_timeout;
+
   // HTTP module configuration context pointers used for the HTTP implementation
   // based on NGINX upstream module. Only used in the HTTP subrequest path.
   ngx_http_conf_ctx_t http_module_conf_ctx;
@@ -108,9 +157,6 @@ typedef struct {
 
 } ngx_esp_main_conf_t;
 
-typedef std::map<std::string, std::shared_ptr<::grpc::GenericStub>>
-    ngx_esp_grpc_stub_map_t;
-
 //
 // ESP Module Configuration - location context.
 //
@@ -157,10 +203,6 @@ typedef struct {
   // Server config
   ngx_str_t endpoints_server_config;
 
-  // The map of backends to GRPC stubs.  These are constructed
-  // on-demand.
-  ngx_esp_grpc_stub_map_t grpc_stubs;
-
   // The GRPC backend address override.  If this is a non-zero-length
   // string, this is where all GRPC API traffic will be sent,
   // regardless of the contents of the service config.
@@ -172,6 +214,13 @@ typedef struct {
   // configured backend address for the API method in the API service
   // configuration.
   ngx_str_t grpc_backend_address_fallback;
+
+  // If on, gRPC pass-through response messages are sent from the gRPC
+  // slices without copying them into nginx buffers.
+  ngx_flag_t grpc_zero_copy;
+
+  // The maximum bytes of sent response buffers a gRPC call keeps for reuse.
+  size_t grpc_output_buffer_cache_size;
 } ngx_esp_loc_conf_t;
 
 // **************************************************
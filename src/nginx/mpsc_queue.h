@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) Extensible Service Proxy Authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NGINX_NGX_ESP_MPSC_QUEUE_H_
+#define NGINX_NGX_ESP_MPSC_QUEUE_H_
+
+#include <atomic>
+
+namespace google {
+namespace api_manager {
+namespace nginx {
+
+// A node of an MpscQueue. The objects queued to an MpscQueue derive from it,
+// so that queueing them never allocates.
+class MpscQueueNode {
+ public:
+  MpscQueueNode() : next_(nullptr) {}
+
+ private:
+  friend class MpscQueue;
+  std::atomic<MpscQueueNode *> next_;
+};
+
+// An intrusive, unbounded, lock-free multiple-producer single-consumer
+// queue (Dmitry Vyukov's algorithm). Push() may be called from any thread;
+// it is a single atomic exchange. Pop() must only be called from the
+// consumer thread.
+class MpscQueue {
+ public:
+  MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+  // Appends the node to the queue. The node must not be in a queue.
+  void Push(MpscQueueNode *node) {
+    node->next_.store(nullptr, std::memory_order_relaxed);
+    MpscQueueNode *prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next_.store(node, std::memory_order_release);
+  }
+
+  // Removes and returns the oldest node. Returns nullptr if the queue is
+  // empty, or if the oldest node is being pushed by a producer that has not
+  // linked it yet; that producer is expected to signal the consumer after
+  // Push() returns.
+  MpscQueueNode *Pop() {
+    MpscQueueNode *tail = tail_;
+    MpscQueueNode *next = tail->next_.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (next == nullptr) {
+        return nullptr;
+      }
+      tail_ = next;
+      tail = next;
+      next = next->next_.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+      tail_ = next;
+      return tail;
+    }
+    if (tail != head_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    // tail is the last node; the stub takes its place so that it can be
+    // returned.
+    Push(&stub_);
+    next = tail->next_.load(std::memory_order_acquire);
+    if (next != nullptr) {
+      tail_ = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+ private:
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  // The most recently pushed node.
+  std::atomic<MpscQueueNode *> head_;
+  // The oldest node, only accessed by the consumer.
+  MpscQueueNode *tail_;
+  MpscQueueNode stub_;
+};
+
+}  // namespace nginx
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // NGINX_NGX_ESP_MPSC_QUEUE_H_
@@ -0,0 +1,296 @@
+// Copyright (C) Extensible Service Proxy Authors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/nginx/shared_cache.h"
+
+#include "src/nginx/module.h"
+
+extern "C" {
+#include "src/core/ngx_md5.h"
+}
+
+namespace google {
+namespace api_manager {
+namespace nginx {
+
+namespace {
+
+ngx_str_t shm_name = ngx_string("esp_shared_cache");
+
+// Number of slots per bucket.
+const ngx_uint_t kSlotsPerBucket = 4;
+// Number of locks protecting the buckets.
+const ngx_uint_t kLockStripes = 64;
+// Number of spins before a worker yields the CPU waiting for a lock, and
+// checks whether the holder of the lock is still alive.
+const ngx_uint_t kLockSpin = 1024;
+// Maximum size of a cached value. Check responses and quota denials are
+// typically a few hundred bytes.
+const size_t kMaxValueSize = 1024;
+// The smallest zone which can hold at least one bucket per lock stripe.
+const size_t kMinZoneSize = 8 * 64 * 1024;
+
+// A cache entry. Keys are stored as their MD5 digest.
+// Important note: the zone is shared by the processes, only store plain
+// data here.
+struct ngx_esp_shared_cache_slot_t {
+  u_char digest[16];
+  // Expiration time, in milliseconds since the epoch. 0 if the slot is free.
+  int64_t expires_at;
+  uint32_t value_length;
+  u_char value[kMaxValueSize];
+};
+
+struct ngx_esp_shared_cache_bucket_t {
+  ngx_esp_shared_cache_slot_t slots[kSlotsPerBucket];
+};
+
+struct ngx_esp_shared_cache_header_t {
+  ngx_uint_t num_buckets;
+
+  ngx_atomic_t lookups;
+  ngx_atomic_t hits;
+  ngx_atomic_t inserts;
+  ngx_atomic_t evictions;
+  ngx_atomic_t oversized;
+
+  // The locks are in the zone, so that the semaphores they may use are
+  // shared by the processes.
+  ngx_shmtx_sh_t lock_states[kLockStripes];
+  ngx_shmtx_t locks[kLockStripes];
+
+  // Followed by num_buckets buckets.
+};
+
+ngx_esp_shared_cache_header_t *get_header(ngx_shm_zone_t *zone) {
+  return reinterpret_cast<ngx_esp_shared_cache_header_t *>(zone->data);
+}
+
+ngx_esp_shared_cache_bucket_t *get_buckets(
+    ngx_esp_shared_cache_header_t *header) {
+  return reinterpret_cast<ngx_esp_shared_cache_bucket_t *>(header + 1);
+}
+
+int64_t now_ms() {
+  ngx_time_t *tp = ngx_timeofday();
+  return static_cast<int64_t>(tp->sec) * 1000 + tp->msec;
+}
+
+// Hashes the key, returns the bucket index.
+ngx_uint_t hash_key(ngx_esp_shared_cache_header_t *header,
+                    const std::string &key, u_char digest[16]) {
+  ngx_md5_t md5;
+  ngx_md5_init(&md5);
+  ngx_md5_update(&md5, key.data(), key.size());
+  ngx_md5_final(digest, &md5);
+
+  uint64_t hash;
+  ngx_memcpy(&hash, digest, sizeof(hash));
+  return hash % header->num_buckets;
+}
+
+// Releases the lock if the process holding it is gone. A worker process may
+// crash while holding a lock, nginx only releases the locks of the slab
+// pools of the crashed workers.
+void force_unlock_if_orphaned(ngx_shmtx_t *mutex) {
+  ngx_pid_t holder = static_cast<ngx_pid_t>(*mutex->lock);
+  if (holder == 0 || holder == ngx_pid) {
+    return;
+  }
+  if (kill(holder, 0) == -1 && ngx_errno == NGX_ESRCH &&
+      ngx_shmtx_force_unlock(mutex, holder)) {
+    ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
+                  "ESP shared cache was locked by %P", holder);
+  }
+}
+
+// Holds the lock of the stripe of a bucket while in scope.
+class StripeLock {
+ public:
+  StripeLock(ngx_esp_shared_cache_header_t *header, ngx_uint_t bucket)
+      : mutex_(&header->locks[bucket % kLockStripes]) {
+    for (ngx_uint_t spin = 1; !ngx_shmtx_trylock(mutex_); spin++) {
+      if (spin % kLockSpin == 0) {
+        force_unlock_if_orphaned(mutex_);
+        ngx_sched_yield();
+      } else if (ngx_ncpu > 1) {
+        ngx_cpu_pause();
+      }
+    }
+  }
+  ~StripeLock() { ngx_shmtx_unlock(mutex_); }
+
+ private:
+  ngx_shmtx_t *mutex_;
+};
+
+ngx_int_t ngx_esp_shared_cache_init_zone(ngx_shm_zone_t *shm_zone,
+                                         void *data) {
+  if (data) {  // nginx is being reloaded, propagate the data
+    shm_zone->data = data;
+    return NGX_OK;
+  }
+
+  // nginx will initialize a slab pool in shared memory but we don't need it
+  auto *header = reinterpret_cast<ngx_esp_shared_cache_header_t *>(
+      shm_zone->shm.addr + sizeof(ngx_slab_pool_t));
+  size_t size = shm_zone->shm.size - sizeof(ngx_slab_pool_t);
+
+  // The slab pool initialization wrote into the zone. Clear it, which also
+  // marks all the slots free.
+  ngx_memzero(header, size);
+  header->num_buckets = (size - sizeof(ngx_esp_shared_cache_header_t)) /
+                        sizeof(ngx_esp_shared_cache_bucket_t);
+  for (ngx_uint_t i = 0; i < kLockStripes; i++) {
+    if (ngx_shmtx_create(&header->locks[i], &header->lock_states[i],
+                         shm_zone->shm.name.data) != NGX_OK) {
+      return NGX_ERROR;
+    }
+  }
+  shm_zone->data = header;
+
+  ngx_log_error(NGX_LOG_INFO, shm_zone->shm.log, 0,
+                "ESP shared cache: %ui entries of up to %uz bytes",
+                header->num_buckets * kSlotsPerBucket, kMaxValueSize);
+
+  return NGX_OK;
+}
+
+}  // namespace
+
+NgxEspSharedCache::NgxEspSharedCache(ngx_shm_zone_t *zone) : zone_(zone) {}
+
+bool NgxEspSharedCache::Lookup(const std::string &key, std::string *value) {
+  auto *header = get_header(zone_);
+  u_char digest[16];
+  ngx_uint_t index = hash_key(header, key, digest);
+  auto *bucket = &get_buckets(header)[index];
+  int64_t now = now_ms();
+
+  ngx_atomic_fetch_add(&header->lookups, 1);
+
+  StripeLock lock(header, index);
+  for (ngx_uint_t i = 0; i < kSlotsPerBucket; i++) {
+    auto *slot = &bucket->slots[i];
+    if (slot->expires_at > now && ngx_memcmp(slot->digest, digest, 16) == 0) {
+      value->assign(reinterpret_cast<const char *>(slot->value),
+                    slot->value_length);
+      ngx_atomic_fetch_add(&header->hits, 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+void NgxEspSharedCache::Insert(const std::string &key, const std::string &value,
+                               std::chrono::milliseconds ttl) {
+  auto *header = get_header(zone_);
+  if (value.size() > kMaxValueSize) {
+    ngx_atomic_fetch_add(&header->oversized, 1);
+    return;
+  }
+
+  u_char digest[16];
+  ngx_uint_t index = hash_key(header, key, digest);
+  auto *bucket = &get_buckets(header)[index];
+  int64_t now = now_ms();
+
+  StripeLock lock(header, index);
+
+  // Reuse the slot of the key if present, otherwise a free or expired
+  // slot, otherwise evict the slot expiring first.
+  ngx_esp_shared_cache_slot_t *target = nullptr;
+  ngx_esp_shared_cache_slot_t *oldest = &bucket->slots[0];
+  for (ngx_uint_t i = 0; i < kSlotsPerBucket; i++) {
+    auto *slot = &bucket->slots[i];
+    if (ngx_memcmp(slot->digest, digest, 16) == 0) {
+      target = slot;
+      break;
+    }
+    if (target == nullptr && slot->expires_at <= now) {
+      target = slot;
+    }
+    if (slot->expires_at < oldest->expires_at) {
+      oldest = slot;
+    }
+  }
+  if (target == nullptr) {
+    target = oldest;
+    ngx_atomic_fetch_add(&header->evictions, 1);
+  }
+
+  ngx_memcpy(target->digest, digest, 16);
+  target->expires_at = now + ttl.count();
+  target->value_length = value.size();
+  ngx_memcpy(target->value, value.data(), value.size());
+
+  ngx_atomic_fetch_add(&header->inserts, 1);
+}
+
+ngx_int_t ngx_esp_add_shared_cache_memory(ngx_conf_t *cf, size_t size) {
+  ngx_esp_main_conf_t *mc = reinterpret_cast<ngx_esp_main_conf_t *>(
+      ngx_http_conf_get_module_main_conf(cf, ngx_esp_module));
+
+  if (mc->shared_cache_zone != nullptr) {
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "duplicate endpoints shared cache");
+    return NGX_ERROR;
+  }
+
+  if (size < kMinZoneSize) {
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "endpoints shared cache size must be at least %uzk",
+                       kMinZoneSize / 1024);
+    return NGX_ERROR;
+  }
+
+  auto *shm = ngx_shared_memory_add(cf, &shm_name, size, &ngx_esp_module);
+  if (shm == nullptr) {
+    ngx_log_error(NGX_LOG_ERR, cf->log, 0,
+                  "Failed to add shared memory for the shared cache");
+    return NGX_ERROR;
+  }
+
+  shm->init = ngx_esp_shared_cache_init_zone;
+  mc->shared_cache_zone = shm;
+
+  return NGX_OK;
+}
+
+void ngx_esp_shared_cache_statistics(ngx_shm_zone_t *zone,
+                                     ngx_esp_shared_cache_stats_t *stats) {
+  auto *header = get_header(zone);
+  stats->capacity = header->num_buckets * kSlotsPerBucket;
+  stats->lookups = header->lookups;
+  stats->hits = header->hits;
+  stats->inserts = header->inserts;
+  stats->evictions = header->evictions;
+  stats->oversized = header->oversized;
+}
+
+}  // namespace nginx
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,92 @@
+// Copyright (C) Extensible Service Proxy Authors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#ifndef NGINX_NGX_ESP_SHARED_CACHE_H_
+#define NGINX_NGX_ESP_SHARED_CACHE_H_
+
+#include <cstdint>
+
+#include "include/api_manager/shared_cache.h"
+
+extern "C" {
+#include "src/http/ngx_http.h"
+}
+
+namespace google {
+namespace api_manager {
+namespace nginx {
+
+// Statistics of the shared cache, aggregated over all the worker processes.
+struct ngx_esp_shared_cache_stats_t {
+  // Maximum number of entries the cache can hold.
+  uint64_t capacity;
+  // Number of lookups, and how many of them found a live entry.
+  uint64_t lookups;
+  uint64_t hits;
+  // Number of entries stored.
+  uint64_t inserts;
+  // Number of live entries replaced to make room for a new one.
+  uint64_t evictions;
+  // Number of values dropped because they were too large for a slot.
+  uint64_t oversized;
+};
+
+// The nginx implementation of SharedCache, stored in a shared memory zone
+// so that a value stored by one worker process is seen by all of them.
+//
+// The zone is divided in fixed-size slots, grouped in small buckets. A key
+// is hashed to a bucket, and only the slots of that bucket are searched.
+// When the bucket is full, the entry closest to its expiration is evicted.
+// Buckets are protected by a fixed number of ngx_shmtx locks (lock
+// striping), so that workers only contend when they access the same stripe.
+// A lock held by a crashed worker is released by the next worker waiting
+// for it.
+class NgxEspSharedCache : public SharedCache {
+ public:
+  NgxEspSharedCache(ngx_shm_zone_t *zone);
+
+  virtual bool Lookup(const std::string &key, std::string *value);
+
+  virtual void Insert(const std::string &key, const std::string &value,
+                      std::chrono::milliseconds ttl);
+
+ private:
+  ngx_shm_zone_t *zone_;
+};
+
+// Adds the shared memory zone of the cache. Called while parsing the
+// configuration (endpoints_shared_cache directive).
+ngx_int_t ngx_esp_add_shared_cache_memory(ngx_conf_t *cf, size_t size);
+
+// Returns the statistics of the shared cache in the zone.
+void ngx_esp_shared_cache_statistics(ngx_shm_zone_t *zone,
+                                     ngx_esp_shared_cache_stats_t *stats);
+
+}  // namespace nginx
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // NGINX_NGX_ESP_SHARED_CACHE_H_
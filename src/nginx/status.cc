@@ -55,6 +55,12 @@ using service_control::Statistics;
 using utils::Status;
 using ServiceControlStatisticsProto =
     ::google::api_manager::proto::ServiceControlStatistics;
+using KeyFetchStatisticsProto =
+    ::google::api_manager::proto::KeyFetchStatistics;
+using ConfigLoadStatisticsProto =
+    ::google::api_manager::proto::ConfigLoadStatistics;
+using ServiceGenerationStatisticsProto =
+    ::google::api_manager::proto::ServiceGenerationStatistics;
 using ServiceConfigRolloutsProto =
     ::google::api_manager::proto::ServiceConfigRollouts;
 
@@ -112,6 +118,65 @@ void fill_service_control_statistics(const Statistics &stat,
   pb->set_max_report_size(stat.max_report_size);
 }
 
+void fill_key_fetch_statistics(const KeyFetchStatistics &stat,
+                               KeyFetchStatisticsProto *pb) {
+  pb->set_fetches(stat.fetches);
+  pb->set_coalesced_waits(stat.coalesced_waits);
+  pb->set_refreshes(stat.refreshes);
+  pb->set_stale_keys_used(stat.stale_keys_used);
+}
+
+void fill_config_load_statistics(const ConfigLoadStatistics &stat,
+                                  ConfigLoadStatisticsProto *pb) {
+  pb->set_loads(stat.loads);
+  pb->set_background_loads(stat.background_loads);
+  pb->set_failures(stat.failures);
+  pb->set_last_parse_us(stat.last_parse_us);
+  pb->set_last_build_us(stat.last_build_us);
+  pb->set_total_parse_us(stat.total_parse_us);
+  pb->set_total_build_us(stat.total_build_us);
+  pb->set_stale_rollouts(stat.stale_rollouts);
+}
+
+void fill_service_generation_statistics(
+    const ServiceGenerationStatistics &stat,
+    ServiceGenerationStatisticsProto *pb) {
+  pb->set_active(stat.active);
+  pb->set_retired(stat.retired);
+  pb->set_reclaimed(stat.reclaimed);
+  pb->set_active_memory_bytes(stat.active_memory_bytes);
+  pb->set_retired_memory_bytes(stat.retired_memory_bytes);
+}
+
+void fill_latency_distribution(const LatencyHistogram &histogram,
+                               proto::LatencyDistribution *pb) {
+  pb->set_count(histogram.count);
+  if (histogram.count > 0) {
+    pb->set_mean_us(histogram.sum_us / histogram.count);
+  }
+  pb->set_p50_us(histogram.Percentile(50));
+  pb->set_p90_us(histogram.Percentile(90));
+  pb->set_p99_us(histogram.Percentile(99));
+  pb->set_p999_us(histogram.Percentile(99.9));
+  pb->set_max_us(histogram.max_us);
+}
+
+void fill_latency_status(const LatencyStatistics &stat,
+                         proto::LatencyStatus *pb) {
+  fill_latency_distribution(stat.auth, pb->mutable_auth());
+  fill_latency_distribution(stat.security_rules, pb->mutable_security_rules());
+  fill_latency_distribution(stat.check, pb->mutable_check());
+  fill_latency_distribution(stat.quota, pb->mutable_quota());
+  fill_latency_distribution(stat.backend, pb->mutable_backend());
+  fill_latency_distribution(stat.request, pb->mutable_request());
+  fill_latency_distribution(stat.check_transport,
+                            pb->mutable_check_transport());
+  fill_latency_distribution(stat.quota_transport,
+                            pb->mutable_quota_transport());
+  fill_latency_distribution(stat.report_transport,
+                            pb->mutable_report_transport());
+}
+
 void fill_process_stats(const ngx_esp_process_stats_t &stat,
                         ProcessStatus *process_status) {
   process_status->set_process_id(stat.pid);
@@ -129,9 +194,92 @@ void fill_process_stats(const ngx_esp_process_stats_t &stat,
     fill_service_control_statistics(
         stat.esp_stats[j].statistics.service_control_statistics,
         esp_status_proto->mutable_service_control_statistics());
+    fill_key_fetch_statistics(
+        stat.esp_stats[j].statistics.key_fetch_statistics,
+        esp_status_proto->mutable_key_fetch_statistics());
+    fill_config_load_statistics(
+        stat.esp_stats[j].statistics.config_load_statistics,
+        esp_status_proto->mutable_config_load_statistics());
+    fill_service_generation_statistics(
+        stat.esp_stats[j].statistics.service_generation_statistics,
+        esp_status_proto->mutable_service_generation_statistics());
     esp_status_proto->mutable_service_config_rollouts()->ParseFromArray(
         stat.esp_stats[j].rollouts, stat.esp_stats[j].rollouts_length);
   }
+
+  fill_latency_status(stat.latency, process_status->mutable_latency());
+
+  auto *pool = process_status->mutable_http_connection_pool();
+  pool->set_pool_hits(stat.http_keepalive.pool_hits);
+  pool->set_pool_misses(stat.http_keepalive.pool_misses);
+  pool->set_stale_connections(stat.http_keepalive.stale_connections);
+  pool->set_idle_connections(stat.http_keepalive.idle_connections);
+
+  auto *passthrough = process_status->mutable_grpc_pass_through();
+  passthrough->set_request_bytes_copied(
+      stat.grpc_passthrough.request_bytes_copied);
+  passthrough->set_response_bytes_copied(
+      stat.grpc_passthrough.response_bytes_copied);
+  passthrough->set_response_bytes_zero_copied(
+      stat.grpc_passthrough.response_bytes_zero_copied);
+
+  auto *output_buffers = process_status->mutable_grpc_output_buffers();
+  output_buffers->set_calls(stat.grpc_output_buffers.calls);
+  output_buffers->set_buffered_bytes(stat.grpc_output_buffers.buffered_bytes);
+  output_buffers->set_cached_bytes(stat.grpc_output_buffers.cached_bytes);
+  output_buffers->set_peak_call_buffered_bytes(
+      stat.grpc_output_buffers.peak_call_buffered_bytes);
+  output_buffers->set_allocated_bytes(stat.grpc_output_buffers.allocated_bytes);
+  output_buffers->set_reused_buffers(stat.grpc_output_buffers.reused_buffers);
+
+  auto *grpc_queue = process_status->mutable_grpc_queue();
+  grpc_queue->set_shards(stat.grpc_queue.shards);
+  grpc_queue->set_completions(stat.grpc_queue.completions);
+  grpc_queue->set_depth(stat.grpc_queue.depth);
+  grpc_queue->set_peak_depth(stat.grpc_queue.peak_depth);
+  grpc_queue->set_pooled_tags(stat.grpc_queue.pooled_tags);
+  grpc_queue->set_allocated_tags(stat.grpc_queue.allocated_tags);
+  fill_latency_distribution(stat.grpc_queue.drain_latency,
+                            grpc_queue->mutable_drain_latency());
+
+  auto *crypto_pool = process_status->mutable_crypto_pool();
+  crypto_pool->set_threads(stat.crypto_pool.threads);
+  crypto_pool->set_offloaded(stat.crypto_pool.offloaded);
+  crypto_pool->set_rejected(stat.crypto_pool.rejected);
+  crypto_pool->set_depth(stat.crypto_pool.depth);
+  crypto_pool->set_peak_depth(stat.crypto_pool.peak_depth);
+  fill_latency_distribution(stat.crypto_pool.queue_latency,
+                            crypto_pool->mutable_queue_latency());
+  fill_latency_distribution(stat.crypto_pool.run_latency,
+                            crypto_pool->mutable_run_latency());
+
+  for (int i = 0; i < stat.num_grpc_channels; ++i) {
+    const ngx_esp_grpc_channel_stats_t &channel_stat = stat.grpc_channels[i];
+    auto *channel = process_status->add_grpc_channels();
+    channel->set_backend(channel_stat.backend);
+    channel->set_channel(channel_stat.channel);
+    channel->set_in_flight(channel_stat.in_flight);
+    channel->set_calls(channel_stat.calls);
+    channel->set_errors(channel_stat.errors);
+    channel->set_reconnects(channel_stat.reconnects);
+  }
+}
+
+void fill_shared_cache_status(ngx_shm_zone_t *zone,
+                              proto::SharedCacheStatus *cache_status) {
+  ngx_esp_shared_cache_stats_t stats;
+  ngx_esp_shared_cache_statistics(zone, &stats);
+
+  cache_status->set_capacity(stats.capacity);
+  cache_status->set_lookups(stats.lookups);
+  cache_status->set_hits(stats.hits);
+  if (stats.lookups > 0) {
+    cache_status->set_hit_rate(static_cast<double>(stats.hits) /
+                               stats.lookups);
+  }
+  cache_status->set_inserts(stats.inserts);
+  cache_status->set_evictions(stats.evictions);
+  cache_status->set_oversized(stats.oversized);
 }
 
 Status create_status_json(ngx_http_request_t *r, std::string *json) {
@@ -150,8 +298,18 @@ Status create_status_json(ngx_http_request_t *r, std::string *json) {
   auto *process_stats =
       reinterpret_cast<ngx_esp_process_stats_t *>(mc->stats_zone->data);
 
+  // Latencies aggregated across the processes.
+  LatencyStatistics latency;
+  ngx_memzero(&latency, sizeof(LatencyStatistics));
   for (int i = 0; i < worker_processes; ++i) {
     fill_process_stats(process_stats[i], status.add_processes());
+    latency.Merge(process_stats[i].latency);
+  }
+  fill_latency_status(latency, status.mutable_latency());
+
+  if (mc->shared_cache_zone != nullptr) {
+    fill_shared_cache_status(mc->shared_cache_zone,
+                             status.mutable_shared_cache());
   }
 
   return utils::ProtoToJson(
@@ -300,6 +458,10 @@ ngx_int_t ngx_esp_update_rollout(std::shared_ptr<ApiManager> esp,
   for (auto percentage : rollouts_info.percentages) {
     (*new_rollouts.mutable_percentages())[percentage.first] = percentage.second;
   }
+  for (auto memory_bytes : rollouts_info.memory_bytes) {
+    (*new_rollouts.mutable_memory_bytes())[memory_bytes.first] =
+        memory_bytes.second;
+  }
 
   int length = new_rollouts.ByteSize();
   if (0 < length && length <= kMaxServiceRolloutsInfoSize) {
@@ -382,6 +544,42 @@ ngx_int_t ngx_esp_init_process_stats(ngx_cycle_t *cycle) {
         if (++esp_idx >= kMaxEspNum) break;
       }
     }
+
+    // Merges the histograms of all the esp objects, so that the status
+    // handler only reads one set per process.
+    ngx_memzero(&process_stat->latency, sizeof(LatencyStatistics));
+    for (ngx_uint_t i = 0, napis = mc->endpoints.nelts; i < napis; i++) {
+      ngx_esp_loc_conf_t *lc = endpoints[i];
+      if (lc->esp) {
+        LatencyStatistics latency;
+        if (lc->esp->GetLatencyStatistics(&latency).ok()) {
+          process_stat->latency.Merge(latency);
+        }
+      }
+    }
+
+    process_stat->http_keepalive = ngx_esp_http_keepalive_statistics();
+    process_stat->grpc_passthrough = ngx_esp_grpc_passthrough_statistics();
+    process_stat->grpc_output_buffers = ngx_esp_grpc_output_buffer_statistics();
+    if (mc->grpc_queue) {
+      mc->grpc_queue->GetStatistics(&process_stat->grpc_queue);
+    } else {
+      ngx_memzero(&process_stat->grpc_queue, sizeof(process_stat->grpc_queue));
+    }
+    if (mc->crypto_pool) {
+      mc->crypto_pool->GetStatistics(&process_stat->crypto_pool);
+    } else {
+      ngx_memzero(&process_stat->crypto_pool,
+                  sizeof(process_stat->crypto_pool));
+    }
+
+    size_t num_grpc_channels = 0;
+    for (const auto &it : mc->grpc_channel_pools) {
+      num_grpc_channels += it.second->GetStatistics(
+          process_stat->grpc_channels + num_grpc_channels,
+          kMaxGrpcChannelStats - num_grpc_channels);
+    }
+    process_stat->num_grpc_channels = num_grpc_channels;
   };
 
   auto log_func = [cycle, process_stat]() {
@@ -29,6 +29,11 @@
 #include <chrono>
 
 #include "include/api_manager/api_manager.h"
+#include "src/nginx/worker_pool.h"
+#include "src/nginx/grpc_channel_pool.h"
+#include "src/nginx/grpc_passthrough_server_call.h"
+#include "src/nginx/grpc_queue.h"
+#include "src/nginx/http_keepalive.h"
 
 extern "C" {
 #include "src/http/ngx_http.h"
@@ -77,6 +82,28 @@ typedef struct {
   };
   EspData esp_stats[kMaxEspNum];
 
+  // Keep-alive connection pool of the outbound HTTP requests.
+  ngx_esp_http_keepalive_stats_t http_keepalive;
+
+  // Bytes copied by the gRPC pass-through calls.
+  ngx_esp_grpc_passthrough_stats_t grpc_passthrough;
+
+  // Response output buffers of the gRPC calls.
+  ngx_esp_grpc_output_buffer_stats_t grpc_output_buffers;
+
+  // The gRPC completion queues.
+  ngx_esp_grpc_queue_stats_t grpc_queue;
+
+  // The threads verifying the JWT signatures.
+  ngx_esp_worker_pool_stats_t crypto_pool;
+
+  // Channels of the gRPC backend channel pools.
+  int num_grpc_channels;
+  ngx_esp_grpc_channel_stats_t grpc_channels[kMaxGrpcChannelStats];
+
+  // Latency histograms of the requests of all the esp objects.
+  LatencyStatistics latency;
+
 } ngx_esp_process_stats_t;
 
 // Adds shared memory for process stats
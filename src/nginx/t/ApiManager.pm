@@ -326,6 +326,13 @@ sub grpc_test_server {
   exec $server, @args;
 }
 
+# Runs a fake gRPC service control server, which appends the calls to a file.
+sub grpc_service_control_server {
+  my ($t, $port, $file) = @_;
+  my $server = './test/grpc/fake-service-control-server';
+  exec $server, "127.0.0.1:${port}", $t->testdir() . '/' . $file;
+}
+
 sub grpc_interop_server {
   my ($t, $port) = @_;
   my $server = './external/org_golang_google_grpc/interop/server/server';
@@ -0,0 +1,243 @@
+# Copyright (C) Extensible Service Proxy Authors
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+################################################################################
+#
+use strict;
+use warnings;
+
+################################################################################
+
+use src::nginx::t::ApiManager;   # Must be first (sets up import path to the Nginx test module)
+use src::nginx::t::HttpServer;
+use Test::Nginx;  # Imports Nginx's test module
+use Test::More;   # And the test framework
+
+################################################################################
+
+# Port assignments
+my $NginxPort = ApiManager::pick_port();
+my $BackendPort = ApiManager::pick_port();
+my $ServiceControlPort = ApiManager::pick_port();
+
+my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(22);
+
+# Check, AllocateQuota and Report are called over gRPC, without caching.
+$t->write_file('server.pb.txt', <<"EOF");
+service_control_config {
+  check_timeout_ms: 1000
+  transport: GRPC
+  check_aggregator_config {
+    cache_entries: 0
+  }
+  report_aggregator_config {
+    cache_entries: 0
+  }
+}
+EOF
+
+$t->write_file('service.pb.txt',
+  ApiManager::get_bookstore_service_config . <<"EOF");
+control {
+  environment: "http://127.0.0.1:${ServiceControlPort}"
+}
+quota {
+ metric_rules [
+   {
+     selector: "ListShelves"
+     metric_costs: [
+       {
+         key: "metrics_first"
+         value: 2
+       }
+     ]
+   }
+ ]
+}
+EOF
+
+ApiManager::write_file_expand($t, 'nginx.conf', <<"EOF");
+%%TEST_GLOBALS%%
+daemon off;
+events {
+  worker_connections 32;
+}
+http {
+  %%TEST_GLOBALS_HTTP%%
+  server_tokens off;
+  server {
+    listen 127.0.0.1:${NginxPort};
+    server_name localhost;
+    location / {
+      endpoints {
+        api service.pb.txt;
+        server_config server.pb.txt;
+        %%TEST_CONFIG%%
+        on;
+      }
+      proxy_pass http://127.0.0.1:${BackendPort};
+    }
+  }
+}
+EOF
+
+$t->run_daemon(\&bookstore, $t, $BackendPort, 'bookstore.log');
+$t->run_daemon(\&ApiManager::grpc_service_control_server, $t,
+               $ServiceControlPort, 'servicecontrol.log');
+is($t->waitforsocket("127.0.0.1:${BackendPort}"), 1, 'Bookstore socket ready.');
+is($t->waitforsocket("127.0.0.1:${ServiceControlPort}"), 1,
+   'Service control socket ready.');
+$t->run();
+
+my $check_method = '/google.api.servicecontrol.v1.ServiceController/Check';
+my $report_method = '/google.api.servicecontrol.v1.ServiceController/Report';
+my $quota_method =
+    '/google.api.servicecontrol.v1.QuotaController/AllocateQuota';
+
+################################################################################
+#
+#  Check, AllocateQuota and Report succeed.
+#
+################################################################################
+
+my $response = ApiManager::http_get($NginxPort, '/shelves?key=this-is-an-api-key');
+
+my ($response_headers, $response_body) = split /\r\n\r\n/, $response, 2;
+like($response_headers, qr/HTTP\/1\.1 200 OK/, 'Returned HTTP 200.');
+is($response_body, <<'EOF', 'Shelves returned in the response body.');
+{ "shelves": [
+    { "name": "shelves/1", "theme": "Fiction" },
+    { "name": "shelves/2", "theme": "Fantasy" }
+  ]
+}
+EOF
+
+is(wait_for_calls($t, 'servicecontrol.log', $report_method, 1), 1,
+   'Report was called.');
+
+my @calls = read_calls($t, 'servicecontrol.log');
+is(scalar @calls, 3, 'Service control received three calls.');
+
+my ($method, $request) = @{shift @calls};
+is($method, $check_method, 'Check was called first.');
+like($request, qr/service_name: "endpoints-test.cloudendpointsapis.com"/,
+     'Check has the service name.');
+like($request, qr/consumer_id: "api_key:this-is-an-api-key"/,
+     'Check has the api key.');
+
+($method, $request) = @{shift @calls};
+is($method, $quota_method, 'AllocateQuota was called after Check.');
+like($request, qr/metric_name: "metrics_first"/,
+     'AllocateQuota has the quota metric.');
+like($request, qr/consumer_id: "api_key:this-is-an-api-key"/,
+     'AllocateQuota has the api key.');
+
+($method, $request) = @{shift @calls};
+is($method, $report_method, 'Report was called last.');
+like($request, qr/operation_name: "ListShelves"/,
+     'Report has the operation.');
+
+################################################################################
+#
+#  A failed Check call is returned as 503.
+#
+################################################################################
+
+$response = ApiManager::http_get($NginxPort, '/shelves?key=unavailable');
+like($response, qr/HTTP\/1\.1 503 Service Temporarily Unavailable/,
+     'Returned HTTP 503 when Check failed.');
+like($response, qr/Service control gRPC request failed/,
+     'Check failure was returned.');
+
+################################################################################
+#
+#  A Check call exceeding check_timeout_ms is cancelled.
+#
+################################################################################
+
+my $start = time;
+$response = ApiManager::http_get($NginxPort, '/shelves?key=slow');
+my $elapsed = time - $start;
+like($response, qr/HTTP\/1\.1 503 Service Temporarily Unavailable/,
+     'Returned HTTP 503 when Check timed out.');
+like($response, qr/DEADLINE_EXCEEDED/, 'Check deadline was exceeded.');
+ok($elapsed < 3, 'Check was cancelled before the server answered.');
+
+is(wait_for_calls($t, 'servicecontrol.log', $report_method, 3), 1,
+   'Failed requests were reported.');
+
+$t->stop_daemons();
+
+@calls = read_calls($t, 'servicecontrol.log');
+my @quota_calls = grep { $_->[0] eq $quota_method } @calls;
+is(scalar @quota_calls, 1, 'No quota allocated for the failed checks.');
+
+my @requests = ApiManager::read_http_stream($t, 'bookstore.log');
+is(scalar @requests, 1, 'Backend received one request.');
+
+################################################################################
+
+# Returns the calls logged by the fake service control server, as an array of
+# [method, request in text format].
+sub read_calls {
+  my ($t, $file) = @_;
+  my @calls = ();
+  foreach my $line (split /\n/, $t->read_file($file)) {
+    my ($method, $request) = split / /, $line, 2;
+    push @calls, [$method, $request];
+  }
+  return @calls;
+}
+
+# Waits until the method was called the given number of times.
+sub wait_for_calls {
+  my ($t, $file, $method, $count) = @_;
+  for (1 .. 50) {
+    my @calls = grep { $_->[0] eq $method } read_calls($t, $file);
+    return 1 if scalar @calls >= $count;
+    select undef, undef, undef, 0.1;
+  }
+  return 0;
+}
+
+sub bookstore {
+  my ($t, $port, $file) = @_;
+  my $server = HttpServer->new($port, $t->testdir() . '/' . $file)
+    or die "Can't create test server socket: $!\n";
+  local $SIG{PIPE} = 'IGNORE';
+
+  $server->on('GET', '/shelves?key=this-is-an-api-key', <<'EOF');
+HTTP/1.1 200 OK
+Connection: close
+
+{ "shelves": [
+    { "name": "shelves/1", "theme": "Fiction" },
+    { "name": "shelves/2", "theme": "Fantasy" }
+  ]
+}
+EOF
+  $server->run();
+}
+
+################################################################################
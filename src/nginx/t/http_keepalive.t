@@ -0,0 +1,189 @@
+# Copyright (C) Extensible Service Proxy Authors
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+################################################################################
+#
+use strict;
+use warnings;
+
+################################################################################
+
+use src::nginx::t::ApiManager;   # Must be first (sets up import path to the Nginx test module)
+use src::nginx::t::HttpServer;
+use Test::Nginx;  # Imports Nginx's test module
+use Test::More;   # And the test framework
+use IO::Socket::INET;
+
+################################################################################
+
+# Port assignments
+my $NginxPort = ApiManager::pick_port();
+my $BackendPort = ApiManager::pick_port();
+my $ServiceControlPort = ApiManager::pick_port();
+
+my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(12);
+
+# Save service name in the service configuration protocol buffer file.
+
+$t->write_file('service.pb.txt', ApiManager::get_bookstore_service_config . <<"EOF");
+control {
+  environment: "http://127.0.0.1:${ServiceControlPort}"
+}
+EOF
+
+ApiManager::write_file_expand($t, 'nginx.conf', <<"EOF");
+%%TEST_GLOBALS%%
+daemon off;
+events {
+  worker_connections 32;
+}
+http {
+  %%TEST_GLOBALS_HTTP%%
+  server_tokens off;
+  endpoints_keepalive 4;
+  endpoints_keepalive_timeout 30s;
+  server {
+    listen 127.0.0.1:${NginxPort};
+    server_name localhost;
+    location /status {
+      endpoints_status;
+    }
+    location / {
+      endpoints {
+        api service.pb.txt;
+        %%TEST_CONFIG%%
+        on;
+      }
+      proxy_pass http://127.0.0.1:${BackendPort};
+    }
+  }
+}
+EOF
+
+$t->run_daemon(\&bookstore, $t, $BackendPort, 'bookstore.log');
+$t->run_daemon(\&servicecontrol, $t, $ServiceControlPort, 'servicecontrol.log');
+is($t->waitforsocket("127.0.0.1:${BackendPort}"), 1, 'Bookstore socket ready.');
+is($t->waitforsocket("127.0.0.1:${ServiceControlPort}"), 1, 'Service control socket ready.');
+$t->run();
+
+################################################################################
+
+# Different API keys so that each call is checked by service control.
+my $response1 = ApiManager::http_get($NginxPort,'/shelves?key=api-key-1');
+my $response2 = ApiManager::http_get($NginxPort,'/shelves?key=api-key-2');
+
+# Wait for the process stats to be refreshed.
+sleep 2;
+my $status = ApiManager::http_get($NginxPort,'/status');
+
+$t->stop_daemons();
+
+like($response1, qr/HTTP\/1\.1 200 OK/, 'First call returned HTTP 200.');
+like($response2, qr/HTTP\/1\.1 200 OK/, 'Second call returned HTTP 200.');
+
+my @requests = grep { $_->{uri} =~ /:check$/ }
+    ApiManager::read_http_stream($t, 'servicecontrol.log');
+is(scalar @requests, 2, 'Service control received two :check requests');
+
+my $r = shift @requests;
+is($r->{headers}->{connection}, undef, 'First :check kept the connection alive');
+is($r->{headers}->{'x-test-connection'}, '1', 'First :check used the first connection');
+
+$r = shift @requests;
+is($r->{headers}->{connection}, undef, 'Second :check kept the connection alive');
+is($r->{headers}->{'x-test-connection'}, '1', 'Second :check reused the connection');
+
+like($status, qr/"httpConnectionPool": \{/, 'Returned connection pool status.');
+like($status, qr/"poolHits": "[1-9]\d*"/, 'Returned connection pool hits.');
+like($status, qr/"poolMisses": "[1-9]\d*"/, 'Returned connection pool misses.');
+
+################################################################################
+
+sub bookstore {
+  my ($t, $port, $file) = @_;
+  my $server = HttpServer->new($port, $t->testdir() . '/' . $file)
+    or die "Can't create test server socket: $!\n";
+  local $SIG{PIPE} = 'IGNORE';
+
+  foreach my $key ('api-key-1', 'api-key-2') {
+    $server->on('GET', "/shelves?key=${key}", <<'EOF');
+HTTP/1.1 200 OK
+Connection: close
+
+{ "shelves": [] }
+EOF
+  }
+  $server->run();
+}
+
+################################################################################
+
+# A service control server which serves multiple requests per connection.
+# Each logged request is annotated with the sequence number of the connection
+# it arrived on (X-Test-Connection header).
+sub servicecontrol {
+  my ($t, $port, $file) = @_;
+  my $server = IO::Socket::INET->new(
+      Proto => 'tcp',
+      LocalHost => '127.0.0.1',
+      LocalPort => $port,
+      Listen => 5,
+      Reuse => 1
+  )
+  or die "Can't create test server socket: $!\n";
+  local $SIG{PIPE} = 'IGNORE';
+  local $SIG{CHLD} = 'IGNORE';
+
+  open my $rh, '>', $t->testdir() . '/' . $file or die "cannot open $file";
+  select $rh; $| = 1; # Enable auto-flush.
+
+  my $connection = 0;
+  while (my $client = $server->accept()) {
+    $connection++;
+    if (fork() == 0) {
+      $client->autoflush(1);
+      while (1) {
+        my $request = '';
+        while (<$client>) {
+          last if (/^\x0d?\x0a?$/);
+          $request .= $_;
+        }
+        last if ($request eq '');
+
+        my ($content_length) = $request =~ /^content-length:\s*(\d+)/mi;
+        my $body = '';
+        $client->read($body, $content_length) if $content_length;
+
+        print $rh $request . "X-Test-Connection: ${connection}\r\n\r\n" . $body;
+        print $client "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+      }
+      close $client;
+      exit 0;
+    }
+    close $client;
+  }
+  close $rh;
+}
+
+################################################################################
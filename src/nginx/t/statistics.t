@@ -40,7 +40,7 @@ use Test::More;   # And the test framework
 my $NginxPort = ApiManager::pick_port();
 my $NoopPort = ApiManager::pick_port();
 
-my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(8);
+my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(10);
 $t->write_file('service.pb.txt', ApiManager::get_bookstore_service_config . <<"EOF");
 control {
   environment: "http://127.0.0.1:${NoopPort}"
@@ -91,6 +91,10 @@ like($response, qr/"totalCalledReports": "0"/, 'Returned total called reports.')
 like($response, qr/"sendReportsByFlush": "0"/, 'Returned reports by flush.');
 like($response, qr/"sendReportsInFlight": "0"/, 'Returned reports in flight.');
 like($response, qr/"sendReportOperations": "0"/, 'Returned sent report operations.');
+like($response, qr/"checkTransport": \{\s*"count": "0"/,
+     'Returned check transport latency.');
+like($response, qr/"request": \{\s*"count": "0",\s*"meanUs": "0",\s*"p50Us": "0"/,
+     'Returned request latency percentiles.');
 
 ################################################################################
 
@@ -156,15 +156,15 @@ void NgxEspTranscodedGrpcServerCall::Finish(
   // Finish the Transcoder input response stream and read the translated
   // response output.
   grpc_response_stream_->Finish();
-  ngx_chain_t out;
+  ngx_chain_t *out = nullptr;
   if (!ReadTranslatedResponse(&out)) {
     return;
   }
   // Mark this as the last buffer in the request
-  out.buf->last_buf = 1;
+  out->buf->last_buf = 1;
 
   // Send the final buffer and finalize the request
-  ngx_int_t rc = ngx_http_output_filter(r_, &out);
+  ngx_int_t rc = ngx_http_output_filter(r_, out);
   if (rc == NGX_ERROR) {
     ngx_log_error(NGX_LOG_DEBUG, r_->connection->log, 0,
                   "Failed to send the last buffer - rc=%d", rc);
@@ -202,7 +202,7 @@ bool NgxEspTranscodedGrpcServerCall::ConvertRequestBody(
 }
 
 bool NgxEspTranscodedGrpcServerCall::ConvertResponseMessage(
-    const ::grpc::ByteBuffer &msg, ngx_chain_t *out) {
+    const ::grpc::ByteBuffer &msg, ngx_chain_t **out) {
   grpc_byte_buffer *grpc_msg = nullptr;
   bool own_buffer;
 
@@ -223,15 +223,17 @@ bool NgxEspTranscodedGrpcServerCall::ConvertResponseMessage(
   return ReadTranslatedResponse(out);
 }
 
-bool NgxEspTranscodedGrpcServerCall::ReadTranslatedResponse(ngx_chain_t *out) {
-  // Allocate an ngx_buf.
-  ngx_buf_t *buf = reinterpret_cast<ngx_buf_t *>(ngx_calloc_buf(r_->pool));
-  if (!buf) {
+bool NgxEspTranscodedGrpcServerCall::ReadTranslatedResponse(
+    ngx_chain_t **out) {
+  // Get an ngx_buf, the data stays in the transcoder.
+  ngx_chain_t *cl = GetOutputBuffer(0);
+  if (!cl) {
     ngx_log_error(NGX_LOG_ERR, r_->connection->log, 0,
                   "Failed to allocate response buffer header for GRPC "
                   "response message.");
     return false;
   }
+  ngx_buf_t *buf = cl->buf;
 
   // Read the translated response into an ngx_buf.
   const void *buffer = nullptr;
@@ -246,7 +248,7 @@ bool NgxEspTranscodedGrpcServerCall::ReadTranslatedResponse(ngx_chain_t *out) {
     buf->end = buf->start + size;
     buf->pos = buf->start;
     buf->last = buf->pos + size;
-    buf->temporary = 1;
+    buf->memory = 1;
   } else if (!transcoder_->ResponseStatus().ok()) {
     HandleError(utils::Status::FromProto(transcoder_->ResponseStatus()));
     return false;
@@ -255,8 +257,7 @@ bool NgxEspTranscodedGrpcServerCall::ReadTranslatedResponse(ngx_chain_t *out) {
 
   buf->last_in_chain = 1;
   buf->flush = 1;
-  out->next = nullptr;
-  out->buf = buf;
+  *out = cl;
 
   return true;
 }
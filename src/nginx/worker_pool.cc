@@ -0,0 +1,124 @@
+// Copyright (C) Extensible Service Proxy Authors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "src/nginx/worker_pool.h"
+
+namespace google {
+namespace api_manager {
+namespace nginx {
+
+namespace {
+
+uint64_t ElapsedMicroseconds(std::chrono::steady_clock::time_point start,
+                             std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+      .count();
+}
+
+}  // namespace
+
+NgxEspWorkerPool::NgxEspWorkerPool(size_t num_threads, size_t max_queued,
+                                   std::shared_ptr<NgxEspGrpcQueue> queue)
+    : max_queued_(max_queued),
+      queue_(std::move(queue)),
+      stopped_(false),
+      stats_() {
+  stats_.threads = num_threads;
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(&NgxEspWorkerPool::WorkerThread, this);
+  }
+}
+
+NgxEspWorkerPool::~NgxEspWorkerPool() {
+  std::deque<Job> dropped;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+    dropped.swap(jobs_);
+  }
+  cv_.notify_all();
+  // N.B. Joining on the threads is essential, as they maintain a raw
+  // pointer to this pool.
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+bool NgxEspWorkerPool::Run(std::function<void()> work,
+                           std::function<void()> continuation) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopped_ || jobs_.size() >= max_queued_) {
+      ++stats_.rejected;
+      return false;
+    }
+    jobs_.push_back({std::move(work), std::move(continuation),
+                     std::chrono::steady_clock::now()});
+    stats_.depth = jobs_.size();
+    if (stats_.depth > stats_.peak_depth) {
+      stats_.peak_depth = stats_.depth;
+    }
+  }
+  cv_.notify_one();
+  return true;
+}
+
+void NgxEspWorkerPool::WorkerThread() {
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return stopped_ || !jobs_.empty(); });
+      if (stopped_) {
+        return;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+      stats_.depth = jobs_.size();
+    }
+
+    auto started_at = std::chrono::steady_clock::now();
+    job.work();
+    auto finished_at = std::chrono::steady_clock::now();
+    // The work is released here, the continuation on the nginx thread.
+    job.work = nullptr;
+    queue_->Post(std::move(job.continuation));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.offloaded;
+    stats_.queue_latency.Record(ElapsedMicroseconds(job.queued_at, started_at));
+    stats_.run_latency.Record(ElapsedMicroseconds(started_at, finished_at));
+  }
+}
+
+void NgxEspWorkerPool::GetStatistics(ngx_esp_worker_pool_stats_t *stats) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  *stats = stats_;
+}
+
+}  // namespace nginx
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) Extensible Service Proxy Authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NGINX_NGX_ESP_WORKER_POOL_H_
+#define NGINX_NGX_ESP_WORKER_POOL_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "include/api_manager/latency_statistics.h"
+#include "src/nginx/grpc_queue.h"
+
+namespace google {
+namespace api_manager {
+namespace nginx {
+
+// Statistics of a thread pool of a worker process.
+// Important note: please don't use std::string. These fields are directly
+// copied into a shared memory.
+struct ngx_esp_worker_pool_stats_t {
+  // Number of threads of the pool, 0 if the pool is disabled.
+  uint64_t threads;
+  // Number of jobs run on the pool threads.
+  uint64_t offloaded;
+  // Number of jobs run inline on the nginx thread as the queue was full.
+  uint64_t rejected;
+  // Jobs waiting for a pool thread, and the largest number seen.
+  uint64_t depth;
+  uint64_t peak_depth;
+  // Time from a job being queued until a pool thread starts it.
+  LatencyHistogram queue_latency;
+  // Time a pool thread spends running a job.
+  LatencyHistogram run_latency;
+};
+
+// A per-worker pool of threads running CPU bound work off the nginx event
+// loop. The continuations of the jobs are handed back to the nginx thread
+// through the gRPC queue, which owns the ngx_notify() handler of the process.
+//
+// Each worker process has a pool verifying the JWT signatures, and a single
+// thread pool building the service configs of the managed rollouts.
+//
+// The queue is bounded: when it is full, Run() fails and the caller runs
+// the job inline, so that a burst of jobs cannot build an unbounded
+// backlog.
+class NgxEspWorkerPool {
+ public:
+  // Starts num_threads threads, queueing at most max_queued jobs. Must be
+  // called from the main nginx thread.
+  NgxEspWorkerPool(size_t num_threads, size_t max_queued,
+                   std::shared_ptr<NgxEspGrpcQueue> queue);
+
+  // Stops and joins the threads. The queued jobs are dropped, neither their
+  // work nor their continuation runs.
+  ~NgxEspWorkerPool();
+
+  // Queues the work to run on a pool thread, then the continuation on the
+  // main nginx thread. Returns false, running neither, if the queue is
+  // full. Must be called from the main nginx thread.
+  bool Run(std::function<void()> work, std::function<void()> continuation);
+
+  // Fills in the pool statistics.
+  void GetStatistics(ngx_esp_worker_pool_stats_t *stats) const;
+
+ private:
+  struct Job {
+    std::function<void()> work;
+    std::function<void()> continuation;
+    std::chrono::steady_clock::time_point queued_at;
+  };
+
+  // The pool thread main routine.
+  void WorkerThread();
+
+  const size_t max_queued_;
+  std::shared_ptr<NgxEspGrpcQueue> queue_;
+  std::vector<std::thread> threads_;
+
+  // Guards the fields below.
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Job> jobs_;
+  bool stopped_;
+  ngx_esp_worker_pool_stats_t stats_;
+};
+
+}  // namespace nginx
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // NGINX_NGX_ESP_WORKER_POOL_H_
@@ -0,0 +1,126 @@
+// Copyright (C) Extensible Service Proxy Authors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "src/api_manager/auth/lib/auth_jwt_validator.h"
+
+using ::google::api_manager::UserInfo;
+using ::google::api_manager::auth::JwtValidator;
+using ::google::api_manager::auth::PublicKeys;
+
+namespace {
+
+const int kDefaultIterations = 10000;
+
+bool ReadFile(const char *path, std::string *content) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  *content = buffer.str();
+  // Tokens generated by jwt_generator.py end with a new line.
+  while (!content->empty() && isspace(content->back())) {
+    content->pop_back();
+  }
+  return true;
+}
+
+void print_usage() {
+  fprintf(stderr,
+          "Usage: jwt_verify_perf jwt_file public_key_file [iterations].\n"
+          "  jwt_file: a JWT, e.g. generated by jwt_generator.py.\n"
+          "  public_key_file: the x509 keys or JWK set of the issuer.\n"
+          "  iterations: (default %d) the number of verifications.\n",
+          kDefaultIterations);
+}
+
+// Verifies the JWT the given number of times, as on JWT cache misses, and
+// returns the number of verifications per second.
+template <class Verify>
+double Run(const std::string &jwt, int iterations, Verify verify) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    UserInfo user_info;
+    std::unique_ptr<JwtValidator> validator =
+        JwtValidator::Create(jwt.c_str(), jwt.size());
+    if (!validator->Parse(&user_info).ok() || !verify(validator.get())) {
+      fprintf(stderr, "JWT verification failed.\n");
+      exit(1);
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return iterations / elapsed.count();
+}
+
+}  //  namespace
+
+// Compare the performance of JWT signature verification:
+// 1. Parse the public key document for each verification.
+// 2. Verify with the public keys parsed once, as cached by auth::Certs.
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    print_usage();
+    return 1;
+  }
+  std::string jwt, pkey;
+  if (!ReadFile(argv[1], &jwt) || !ReadFile(argv[2], &pkey)) {
+    print_usage();
+    return 1;
+  }
+  int iterations = argc > 3 ? atoi(argv[3]) : kDefaultIterations;
+  if (iterations <= 0) {
+    print_usage();
+    return 1;
+  }
+
+  // 1. Parse the public key document for each verification.
+  double raw_rate = Run(jwt, iterations, [&pkey](JwtValidator *validator) {
+    return validator->VerifySignature(pkey.c_str(), pkey.size()).ok();
+  });
+  printf("Verifications with the key document: %.0f/s\n", raw_rate);
+
+  // 2. Verify with the parsed public keys.
+  std::unique_ptr<PublicKeys> keys =
+      PublicKeys::Create(pkey.c_str(), pkey.size());
+  double parsed_rate = Run(jwt, iterations, [&keys](JwtValidator *validator) {
+    return validator->VerifySignature(*keys).ok();
+  });
+  printf("Verifications with the parsed keys: %.0f/s (%.2fx)\n", parsed_rate,
+         parsed_rate / raw_rate);
+
+  return 0;
+}
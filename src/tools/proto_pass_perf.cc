@@ -25,21 +25,26 @@
 ////////////////////////////////////////////////////////////////////////////////
 //
 #include <stdio.h>
-#include <string.h>
-#include <ctime>
-#include <fstream>
-#include <iostream>
+#include <stdlib.h>
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <new>
 #include <string>
+#include <utility>
+#include <vector>
 
-#include "google/protobuf/text_format.h"
 #include "include/service_control_client.h"
 #include "src/api_manager/service_control/info.h"
 #include "src/api_manager/service_control/proto.h"
+#include "src/api_manager/service_control/request_arena.h"
 
+using google::api_manager::service_control::CheckRequestInfo;
 using google::api_manager::service_control::OperationInfo;
-using google::api_manager::service_control::ReportRequestInfo;
 using google::api_manager::service_control::Proto;
+using google::api_manager::service_control::QuotaRequestInfo;
+using google::api_manager::service_control::ReportRequestInfo;
+using google::api_manager::service_control::RequestArena;
 
 using ::google::api::servicecontrol::v1::CheckRequest;
 using ::google::api::servicecontrol::v1::CheckResponse;
@@ -47,7 +52,6 @@ using ::google::api::servicecontrol::v1::AllocateQuotaRequest;
 using ::google::api::servicecontrol::v1::AllocateQuotaResponse;
 using ::google::api::servicecontrol::v1::ReportRequest;
 using ::google::api::servicecontrol::v1::ReportResponse;
-using ::google::protobuf::Arena;
 using ::google::protobuf::util::Status;
 
 using ::google::service_control_client::CheckAggregationOptions;
@@ -57,13 +61,37 @@ using ::google::service_control_client::ServiceControlClient;
 using ::google::service_control_client::ServiceControlClientOptions;
 using ::google::service_control_client::TransportDoneFunc;
 
+// The number of heap allocations made by the process.
+static uint64_t total_allocations = 0;
+
+void* operator new(size_t size) {
+  ++total_allocations;
+  void* p = malloc(size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+
 namespace {
 
 const char kServiceName[] = "library.googleapis.com";
 const char kServiceConfigId[] = "2016-09-19r0";
-const int MAX_PROTO_PASS_SIZE = 1000000;
+const int kDefaultIterations = 1000000;
 
-}  //  namespace
+// The ways to build the request protobufs.
+enum Mode {
+  // Allocates a new protobuf for each call.
+  NEW,
+  // Re-uses a cleared protobuf, as the former protobuf pool did.
+  POOLED,
+  // Builds the protobuf on a RequestArena, as Aggregated does.
+  ARENA,
+};
+
+const char* const kModeNames[] = {"new", "pooled", "arena"};
 
 void FillOperationInfo(OperationInfo* op) {
   op->operation_id = "operation_id";
@@ -88,21 +116,9 @@ void FillReportRequestInfo(ReportRequestInfo* request) {
   request->auth_audience = "auth-audience";
 }
 
-int total_called_checks = 0;
-int total_called_reports = 0;
-int total_called_quotas = 0;
-std::string request_text;
-
-// Compare the performance for passing Service Control Report protobuf to its
-// aggregator.
-// 1. Allocate a new protobuf for each call.
-// 2. Re-use protobuf from a pool.
-// 3. Use proto arena allocation.
-int main() {
-  Proto scp({"local_test_log"}, kServiceName, kServiceConfigId);
-
-  std::unique_ptr<ServiceControlClient> client;
-  // To set the cache, flush interval large enough for this test.
+// Creates a client whose caches are never flushed during a benchmark, and
+// whose transports succeed right away.
+std::unique_ptr<ServiceControlClient> CreateClient() {
   ServiceControlClientOptions options(
       CheckAggregationOptions(1000000 /*entries*/,
                               1000000 /* refresh_interval_ms */,
@@ -112,67 +128,125 @@ int main() {
       ReportAggregationOptions(1000000 /*entries*/,
                                1000000 /* refresh_interval_ms */));
   options.check_transport = [](const CheckRequest&, CheckResponse*,
-                               TransportDoneFunc) { ++total_called_checks; };
+                               TransportDoneFunc on_done) {
+    on_done(Status::OK);
+  };
   options.quota_transport = [](const AllocateQuotaRequest&,
                                AllocateQuotaResponse*,
-                               TransportDoneFunc) { ++total_called_quotas; };
+                               TransportDoneFunc on_done) {
+    on_done(Status::OK);
+  };
   options.report_transport = [](const ReportRequest&, ReportResponse*,
-                                TransportDoneFunc) { ++total_called_reports; };
-  client = CreateServiceControlClient(kServiceName, kServiceConfigId, options);
-
-  ReportRequestInfo info;
-  FillOperationInfo(&info);
-  FillReportRequestInfo(&info);
-  ReportResponse response;
-
-  // 1. Allocate proto for each call.
-  std::clock_t start = std::clock();
-  for (int i = 0; i < MAX_PROTO_PASS_SIZE; i++) {
-    std::unique_ptr<ReportRequest> request(new ReportRequest());
-    scp.FillReportRequest(info, request.get());
-    client->Report(*request, &response, [](Status status) {});
+                                TransportDoneFunc on_done) {
+    on_done(Status::OK);
+  };
+  return CreateServiceControlClient(kServiceName, kServiceConfigId, options);
+}
+
+// Builds and passes a request to the client for the given number of
+// iterations, then prints the time and the heap allocations per call.
+template <class Request>
+void Benchmark(const char* name, Mode mode, int iterations,
+               const std::function<void(Request*)>& fill_and_pass) {
+  Request pooled;
+  RequestArena arena;
+  uint64_t allocations = total_allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    switch (mode) {
+      case NEW: {
+        std::unique_ptr<Request> request(new Request);
+        fill_and_pass(request.get());
+        break;
+      }
+      case POOLED:
+        pooled.Clear();
+        fill_and_pass(&pooled);
+        break;
+      case ARENA:
+        fill_and_pass(arena.Alloc<Request>());
+        arena.Free();
+        break;
+    }
+  }
+  double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  printf("%-8s %-8s %12.1f ns/call %10.2f allocations/call\n", name,
+         kModeNames[mode], ns / iterations,
+         static_cast<double>(total_allocations - allocations) / iterations);
+}
+
+}  //  namespace
+
+// Compares the ways to build the Service Control Check, AllocateQuota and
+// Report protobufs and to pass them to the service control client.
+//
+// Usage: proto_pass_perf [iterations]
+int main(int argc, char** argv) {
+  int iterations = kDefaultIterations;
+  if (argc > 1) {
+    iterations = atoi(argv[1]);
+    if (iterations <= 0) {
+      fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  Proto scp({"local_test_log"}, kServiceName, kServiceConfigId);
+
+  CheckRequestInfo check_info;
+  FillOperationInfo(&check_info);
+  check_info.allow_unregistered_calls = false;
+
+  std::vector<std::pair<std::string, int>> metric_cost_vector = {
+      {"metric_first", 1}, {"metric_second", 2}};
+  QuotaRequestInfo quota_info;
+  FillOperationInfo(&quota_info);
+  quota_info.method_name = "operation_name";
+  quota_info.metric_cost_vector = &metric_cost_vector;
+
+  ReportRequestInfo report_info;
+  FillOperationInfo(&report_info);
+  FillReportRequestInfo(&report_info);
+
+  for (Mode mode : {NEW, POOLED, ARENA}) {
+    std::unique_ptr<ServiceControlClient> client = CreateClient();
+    CheckResponse response;
+    Benchmark<CheckRequest>(
+        "Check", mode, iterations, [&](CheckRequest* request) {
+          scp.FillCheckRequest(check_info, request);
+          client->Check(*request, &response, [](Status status) {});
+        });
   }
 
-  GOOGLE_LOG(INFO) << "Report 1 million requests time: "
-                   << 1000.0 * (std::clock() - start) / CLOCKS_PER_SEC << "ms";
-  GOOGLE_CHECK(total_called_reports == 0);
-  client = CreateServiceControlClient(kServiceName, kServiceConfigId, options);
-  GOOGLE_CHECK(total_called_reports == 1);
-  total_called_reports = 0;
-
-  // 2. Reuse proto allocation.
-  std::clock_t start_reuse = std::clock();
-  std::unique_ptr<ReportRequest> request_reuse(new ReportRequest());
-  for (int i = 0; i < MAX_PROTO_PASS_SIZE; i++) {
-    scp.FillReportRequest(info, request_reuse.get());
-    client->Report(*request_reuse, &response, [](Status status) {});
-    request_reuse->Clear();
+  for (Mode mode : {NEW, POOLED, ARENA}) {
+    std::unique_ptr<ServiceControlClient> client = CreateClient();
+    AllocateQuotaResponse response;
+    Benchmark<AllocateQuotaRequest>(
+        "Quota", mode, iterations, [&](AllocateQuotaRequest* request) {
+          scp.FillAllocateQuotaRequest(quota_info, request);
+          client->Quota(*request, &response, [](Status status) {});
+        });
   }
 
-  GOOGLE_LOG(INFO) << "Report 1 million requests reuse the proto: "
-                   << 1000.0 * (std::clock() - start_reuse) / CLOCKS_PER_SEC
-                   << "ms";
-  GOOGLE_CHECK(total_called_reports == 0);
-  client = CreateServiceControlClient(kServiceName, kServiceConfigId, options);
-  // GOOGLE_CHECK(total_called_reports == 1) does not hold here.
-  total_called_reports = 0;
-
-  // 3. Use proto arena allocation.
-  std::clock_t start_arena = std::clock();
-  for (int i = 0; i < MAX_PROTO_PASS_SIZE; i++) {
-    std::unique_ptr<Arena> arena(new Arena);
-    ReportRequest* request_arena =
-        Arena::CreateMessage<ReportRequest>(arena.get());
-    scp.FillReportRequest(info, request_arena);
-    client->Report(*request_arena, &response, [](Status status) {});
+  // Filling the report alone, as done for every request.
+  for (Mode mode : {NEW, POOLED, ARENA}) {
+    Benchmark<ReportRequest>("Fill", mode, iterations,
+                             [&](ReportRequest* request) {
+                               scp.FillReportRequest(report_info, request);
+                             });
   }
 
-  GOOGLE_LOG(INFO) << "Report 1 million requests using arena:"
-                   << 1000.0 * (std::clock() - start_arena) / CLOCKS_PER_SEC
-                   << "ms";
-  GOOGLE_CHECK(total_called_reports == 0);
-  client = CreateServiceControlClient(kServiceName, kServiceConfigId, options);
-  GOOGLE_CHECK(total_called_reports == 1);
+  for (Mode mode : {NEW, POOLED, ARENA}) {
+    std::unique_ptr<ServiceControlClient> client = CreateClient();
+    ReportResponse response;
+    Benchmark<ReportRequest>(
+        "Report", mode, iterations, [&](ReportRequest* request) {
+          scp.FillReportRequest(report_info, request);
+          client->Report(*request, &response, [](Status status) {});
+        });
+  }
 
   return 0;
 }
@@ -0,0 +1,260 @@
+// Copyright (C) Extensible Service Proxy Authors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+// A fake service control server, serving Check, AllocateQuota and Report over
+// gRPC. Each call is appended to a log file, on one line:
+//   <method> <request in text format>
+//
+// The Check calls are answered according to their api key:
+//   "unavailable": fails with UNAVAILABLE,
+//   "slow": answered with an empty response after 3 seconds,
+//   any other key: answered with an empty response.
+// AllocateQuota and Report calls are answered with an empty response.
+//
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <grpc++/alarm.h>
+#include <grpc++/generic/async_generic_service.h>
+#include <grpc++/grpc++.h>
+
+#include "google/api/servicecontrol/v1/quota_controller.pb.h"
+#include "google/api/servicecontrol/v1/service_controller.pb.h"
+
+using ::google::api::servicecontrol::v1::AllocateQuotaRequest;
+using ::google::api::servicecontrol::v1::AllocateQuotaResponse;
+using ::google::api::servicecontrol::v1::CheckRequest;
+using ::google::api::servicecontrol::v1::CheckResponse;
+using ::google::api::servicecontrol::v1::ReportRequest;
+using ::google::api::servicecontrol::v1::ReportResponse;
+using ::grpc::Alarm;
+using ::grpc::AsyncGenericService;
+using ::grpc::ByteBuffer;
+using ::grpc::GenericServerAsyncReaderWriter;
+using ::grpc::GenericServerContext;
+using ::grpc::InsecureServerCredentials;
+using ::grpc::Server;
+using ::grpc::ServerBuilder;
+using ::grpc::ServerCompletionQueue;
+using ::grpc::Slice;
+using ::grpc::Status;
+using ::grpc::StatusCode;
+
+namespace test {
+namespace grpc {
+namespace {
+
+const char kCheckMethod[] =
+    "/google.api.servicecontrol.v1.ServiceController/Check";
+const char kReportMethod[] =
+    "/google.api.servicecontrol.v1.ServiceController/Report";
+const char kAllocateQuotaMethod[] =
+    "/google.api.servicecontrol.v1.QuotaController/AllocateQuota";
+
+// The delay of the Check calls with the "slow" api key.
+const std::chrono::seconds kSlowCheckDelay(3);
+
+typedef std::function<void(bool)> Tag;
+
+void *MakeTag(std::function<void(bool)> continuation) {
+  return reinterpret_cast<void *>(new Tag(continuation));
+}
+
+std::string ToString(const ByteBuffer &buffer) {
+  std::vector<Slice> slices;
+  buffer.Dump(&slices);
+  std::string result;
+  for (const auto &slice : slices) {
+    result.append(reinterpret_cast<const char *>(slice.begin()), slice.size());
+  }
+  return result;
+}
+
+ByteBuffer ToByteBuffer(const ::google::protobuf::Message &message) {
+  std::string serialized;
+  message.SerializeToString(&serialized);
+  Slice slice(serialized.data(), serialized.size());
+  return ByteBuffer(&slice, 1);
+}
+
+class FakeServiceControl final {
+ public:
+  FakeServiceControl(const char *log_file) : log_(log_file) {}
+
+  void Run(const char *addr);
+
+  ServerCompletionQueue *completion_queue() { return cq_.get(); }
+  AsyncGenericService *service() { return &service_; }
+
+  // Appends a call to the log file.
+  void Log(const std::string &method, const std::string &request) {
+    log_ << method << " " << request << std::endl;
+  }
+
+ private:
+  void StartCall();
+
+  AsyncGenericService service_;
+  std::unique_ptr<ServerCompletionQueue> cq_;
+  std::ofstream log_;
+};
+
+// A unary call: reads the request, logs it and sends the response.
+class Call final {
+ public:
+  Call(FakeServiceControl *server) : server_(server), stream_(&context_) {}
+
+  void Start(void *tag) {
+    server_->service()->RequestCall(&context_, &stream_,
+                                    server_->completion_queue(),
+                                    server_->completion_queue(), tag);
+  }
+
+  void Run() {
+    stream_.Read(&request_, MakeTag([this](bool ok) {
+      if (!ok) {
+        Finish(Status(StatusCode::INVALID_ARGUMENT, "Missing request"));
+        return;
+      }
+      OnRequest();
+    }));
+  }
+
+ private:
+  void OnRequest() {
+    const std::string &method = context_.method();
+    std::string body = ToString(request_);
+
+    if (method == kCheckMethod) {
+      CheckRequest request;
+      request.ParseFromString(body);
+      server_->Log(method, request.ShortDebugString());
+      const std::string &consumer_id = request.operation().consumer_id();
+      if (consumer_id == "api_key:unavailable") {
+        Finish(Status(StatusCode::UNAVAILABLE, "Service control unavailable"));
+      } else if (consumer_id == "api_key:slow") {
+        alarm_.reset(new Alarm(server_->completion_queue(),
+                               std::chrono::system_clock::now() +
+                                   kSlowCheckDelay,
+                               MakeTag([this](bool ok) {
+                                 Respond(CheckResponse());
+                               })));
+      } else {
+        Respond(CheckResponse());
+      }
+    } else if (method == kAllocateQuotaMethod) {
+      AllocateQuotaRequest request;
+      request.ParseFromString(body);
+      server_->Log(method, request.ShortDebugString());
+      Respond(AllocateQuotaResponse());
+    } else if (method == kReportMethod) {
+      ReportRequest request;
+      request.ParseFromString(body);
+      server_->Log(method, request.ShortDebugString());
+      Respond(ReportResponse());
+    } else {
+      server_->Log(method, "");
+      Finish(Status(StatusCode::UNIMPLEMENTED, "Unknown method " + method));
+    }
+  }
+
+  void Respond(const ::google::protobuf::Message &response) {
+    response_ = ToByteBuffer(response);
+    stream_.Write(response_, MakeTag([this](bool ok) {
+                    Finish(ok ? Status::OK
+                              : Status(StatusCode::INTERNAL,
+                                       "Failed to send the response"));
+                  }));
+  }
+
+  void Finish(const Status &status) {
+    stream_.Finish(status, MakeTag([this](bool ok) { delete this; }));
+  }
+
+  FakeServiceControl *server_;
+  GenericServerContext context_;
+  GenericServerAsyncReaderWriter stream_;
+  ByteBuffer request_;
+  ByteBuffer response_;
+  std::unique_ptr<Alarm> alarm_;
+};
+
+void FakeServiceControl::StartCall() {
+  auto *call = new Call(this);
+  call->Start(MakeTag([this, call](bool ok) {
+    if (!ok) {
+      delete call;
+      return;
+    }
+    StartCall();
+    call->Run();
+  }));
+}
+
+void FakeServiceControl::Run(const char *addr) {
+  ServerBuilder builder;
+  builder.AddListeningPort(addr, InsecureServerCredentials());
+  builder.RegisterAsyncGenericService(&service_);
+  cq_ = builder.AddCompletionQueue();
+  std::unique_ptr<Server> server(builder.BuildAndStart());
+
+  StartCall();
+
+  std::cout << "Fake service control listening at address " << addr
+            << std::endl;
+
+  void *tag;
+  bool ok;
+  while (cq_->Next(&tag, &ok)) {
+    Tag *func = reinterpret_cast<Tag *>(tag);
+    (*func)(ok);
+    delete func;
+  }
+}
+
+}  // namespace
+}  // namespace grpc
+}  // namespace test
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: fake-service-control-server <listening address> "
+                 "<log file>"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ::test::grpc::FakeServiceControl server(argv[2]);
+  server.Run(argv[1]);
+
+  return EXIT_SUCCESS;
+}